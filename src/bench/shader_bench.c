@@ -0,0 +1,1267 @@
+/* Shader Benchmark - Implementation
+ * Headless, reproducible performance measurements for shaders
+ *
+ * Shaders are rendered into an offscreen framebuffer of an EGL context of
+ * the same GL version the preview requests (3.3 core), through the
+ * unchanged multipass_create / multipass_compile_all / multipass_render
+ * path, so the numbers match what the editor does. Every frame ends with
+ * glFinish: the wall-clock frame time covers CPU submission and GPU
+ * execution, while per-pass GPU times come from the library's timer
+ * queries. Shader time advances by a fixed step for reproducible frames.
+ *
+ * Suite mode (--suite) benchmarks every shader in test_shaders/ plus the
+ * built-in templates and compares the median frame time and compile time
+ * against a stored baseline, and against budgets declared in the shaders
+ * themselves ("// @budget 4ms @1080p"), failing on regressions.
+ */
+
+#include "shader_bench.h"
+#include "../shader_lib/shader_multipass.h"
+#include "../shader_lib/shader_include.h"
+#include "../shader_lib/shader_trace.h"
+#include "../editor/editor_templates.h"
+#include "platform_compat.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(PLATFORM_LINUX) || defined(PLATFORM_UNIX)
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <dirent.h>
+#include <strings.h>
+#define BENCH_HAVE_EGL 1
+#endif
+
+#define BENCH_DEFAULT_WIDTH 1920
+#define BENCH_DEFAULT_HEIGHT 1080
+#define BENCH_DEFAULT_FRAMES 300
+#define BENCH_DEFAULT_WARMUP 60
+#define BENCH_TIME_STEP (1.0f / 60.0f)   /* Shader seconds per frame */
+
+/* Frames allowed for specialized variants to settle and build before measuring */
+#define BENCH_SPECIALIZE_FRAMES 120
+
+/* Suite defaults: small enough to run every shader on llvmpipe in CI */
+#define BENCH_SUITE_WIDTH 640
+#define BENCH_SUITE_HEIGHT 360
+#define BENCH_SUITE_FRAMES 30
+#define BENCH_SUITE_WARMUP 5
+#define BENCH_SUITE_DIR "test_shaders"
+#define BENCH_BASELINE_NAME "bench_baseline.ini"
+#define BENCH_SUITE_MAX 256
+
+/* Default regression tolerances (percent over baseline, plus an absolute
+ * slack so tiny shaders don't trip on timer noise) */
+#define BENCH_FRAME_TOLERANCE 15.0
+#define BENCH_COMPILE_TOLERANCE 50.0
+#define BENCH_FRAME_SLACK_MS 0.5
+#define BENCH_COMPILE_SLACK_MS 10.0
+
+/* Benchmark settings */
+typedef struct {
+    int width;
+    int height;
+    float scale;
+    int frames;
+    int warmup;
+    multipass_reconstruct_mode_t reconstruction;
+    size_t vram_budget;             /* Bytes (0 = unlimited) */
+    bool optimize;                  /* Optimize sources before compiling (glsl_optimize) */
+    bool specialize;                /* Bake resolution, mouse and date into variants */
+    bool json;
+    bool size_set;                  /* Explicit options override suite defaults */
+    bool frames_set;
+    bool warmup_set;
+    bool suite;
+    const char *suite_dir;
+    const char *baseline_path;
+    bool update_baseline;
+    const char *trace_path;         /* Chrome trace output (NULL = GLEDITOR_TRACE or none) */
+} bench_options_t;
+
+/* Distribution of one series of per-frame samples (ms) */
+typedef struct {
+    double min;
+    double median;
+    double p95;
+    double p99;
+    double mean;
+} bench_stats_t;
+
+/* Results for one shader file or template */
+typedef struct {
+    char *name;                                 /* Display name / baseline key */
+    char *path;                                 /* File to read, or NULL */
+    const char *source;                         /* In-memory source (templates) */
+    int width;                                  /* Render size for this shader */
+    int height;
+    double budget_ms;                           /* Declared @budget (0 if none) */
+    bool regressed;
+    char verdict[512];                          /* Suite findings, one per line */
+    bool ok;
+    char *error;
+    int pass_count;
+    const char *pass_names[MULTIPASS_MAX_PASSES];
+    double pass_gpu_ms[MULTIPASS_MAX_PASSES];   /* Mean over measured frames (0 while skipped) */
+    bool pass_specialized[MULTIPASS_MAX_PASSES]; /* Measured with a specialized variant */
+    double reconstruct_gpu_ms;                  /* Mean reconstruction/upscale time */
+    double parse_ms;
+    double compile_ms;
+    bench_stats_t frame_ms;
+    bench_stats_t gpu_ms;
+    bool has_gpu_timers;
+    multipass_vram_usage_t vram;                /* After the last measured frame */
+    float scale;                                /* Buffer scale rendered (capped by the VRAM budget) */
+    multipass_cost_estimate_t estimate;         /* Static cost estimate (calibrated if timers ran) */
+    multipass_shader_t *shader;                 /* Kept alive for pass names */
+} bench_result_t;
+
+/* ============================================
+ * Command line
+ * ============================================ */
+
+bool shader_bench_requested(int argc, char **argv) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--bench") == 0) return true;
+    }
+    return false;
+}
+
+void shader_bench_print_usage(void) {
+    printf("Benchmark:\n");
+    printf("  --bench FILE...   Render shaders headless and report timings\n");
+    printf("    --size WxH            Render resolution (default %dx%d)\n",
+           BENCH_DEFAULT_WIDTH, BENCH_DEFAULT_HEIGHT);
+    printf("    --scale F             Fixed resolution scale (default 1.0)\n");
+    printf("    --frames N            Measured frames (default %d)\n", BENCH_DEFAULT_FRAMES);
+    printf("    --warmup N            Frames rendered before measuring (default %d)\n",
+           BENCH_DEFAULT_WARMUP);
+    printf("    --reconstruction M    off, checkerboard, temporal or spatial\n");
+    printf("    --vram-budget MB      Degrade shaders that would hold more GPU memory\n");
+    printf("    --optimize            Optimize shader sources before compiling\n");
+    printf("    --specialize          Compile resolution, mouse and date in as constants\n");
+    printf("    --json                Print results as JSON\n");
+    printf("    --trace FILE          Record a Chrome/Perfetto trace of the run\n");
+    printf("  --bench --suite [DIR]     Regression suite: every DIR/*.glsl (default %s)\n",
+           BENCH_SUITE_DIR);
+    printf("                            and built-in template at %dx%d, %d frames\n",
+           BENCH_SUITE_WIDTH, BENCH_SUITE_HEIGHT, BENCH_SUITE_FRAMES);
+    printf("    --baseline FILE       Baseline to compare against (default DIR/%s)\n",
+           BENCH_BASELINE_NAME);
+    printf("    --update-baseline     Record the current results as the new baseline\n");
+    printf("\n");
+}
+
+#ifdef BENCH_HAVE_EGL
+
+static const char *reconstruction_names[] = { "off", "checkerboard", "temporal", "spatial" };
+
+/* ============================================
+ * Helpers
+ * ============================================ */
+
+static double now_ms(void) {
+    return platform_get_time() * 1000.0;
+}
+
+static char *read_file(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if (size < 0) {
+        fclose(f);
+        return NULL;
+    }
+
+    char *data = malloc((size_t)size + 1);
+    if (data) {
+        size_t read = fread(data, 1, (size_t)size, f);
+        data[read] = '\0';
+    }
+    fclose(f);
+    return data;
+}
+
+/* Directory part of a path ("." if it has none) */
+static void path_dir(const char *path, char *dir, size_t size) {
+    const char *slash = strrchr(path, PATH_SEPARATOR);
+    if (!slash) {
+        snprintf(dir, size, ".");
+    } else {
+        snprintf(dir, size, "%.*s", (int)(slash == path ? 1 : slash - path), path);
+    }
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* Nearest-rank percentile of sorted samples */
+static double percentile(const double *sorted, int count, double p) {
+    int rank = (int)(p / 100.0 * count + 0.999999);
+    if (rank < 1) rank = 1;
+    if (rank > count) rank = count;
+    return sorted[rank - 1];
+}
+
+static bench_stats_t compute_stats(double *samples, int count) {
+    bench_stats_t stats = {0};
+    if (count <= 0) return stats;
+
+    qsort(samples, (size_t)count, sizeof(double), compare_double);
+
+    double sum = 0.0;
+    for (int i = 0; i < count; i++) sum += samples[i];
+
+    stats.min = samples[0];
+    stats.median = percentile(samples, count, 50.0);
+    stats.p95 = percentile(samples, count, 95.0);
+    stats.p99 = percentile(samples, count, 99.0);
+    stats.mean = sum / count;
+    return stats;
+}
+
+static void json_string(FILE *out, const char *s) {
+    fputc('"', out);
+    for (; s && *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') {
+            fprintf(out, "\\%c", c);
+        } else if (c == '\n') {
+            fputs("\\n", out);
+        } else if (c == '\t') {
+            fputs("\\t", out);
+        } else if (c < 0x20) {
+            fprintf(out, "\\u%04x", c);
+        } else {
+            fputc(c, out);
+        }
+    }
+    fputc('"', out);
+}
+
+static void json_stats(FILE *out, const bench_stats_t *s) {
+    fprintf(out, "{\"min\": %.4f, \"median\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"mean\": %.4f}",
+            s->min, s->median, s->p95, s->p99, s->mean);
+}
+
+/* Parse options; remaining arguments are shader files. Returns file count or -1. */
+static int parse_options(int argc, char **argv, bench_options_t *opts, const char **files) {
+    int count = 0;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = (i + 1 < argc) ? argv[i + 1] : NULL;
+
+        if (strcmp(arg, "--bench") == 0) {
+            continue;
+        } else if (strcmp(arg, "--json") == 0) {
+            opts->json = true;
+        } else if (strcmp(arg, "--optimize") == 0) {
+            opts->optimize = true;
+        } else if (strcmp(arg, "--specialize") == 0) {
+            opts->specialize = true;
+        } else if (strcmp(arg, "--suite") == 0) {
+            opts->suite = true;
+        } else if (strcmp(arg, "--update-baseline") == 0) {
+            opts->update_baseline = true;
+        } else if (strcmp(arg, "--baseline") == 0 && value) {
+            opts->baseline_path = value;
+            i++;
+        } else if (strcmp(arg, "--trace") == 0 && value) {
+            opts->trace_path = value;
+            i++;
+        } else if (strcmp(arg, "--size") == 0 && value) {
+            if (sscanf(value, "%dx%d", &opts->width, &opts->height) != 2 ||
+                opts->width < 1 || opts->height < 1 || opts->width > 16384 || opts->height > 16384) {
+                fprintf(stderr, "Invalid --size '%s' (expected WxH)\n", value);
+                return -1;
+            }
+            opts->size_set = true;
+            i++;
+        } else if (strcmp(arg, "--scale") == 0 && value) {
+            opts->scale = (float)atof(value);
+            if (opts->scale < 0.1f || opts->scale > 2.0f) {
+                fprintf(stderr, "Invalid --scale '%s' (0.1 - 2.0)\n", value);
+                return -1;
+            }
+            i++;
+        } else if (strcmp(arg, "--frames") == 0 && value) {
+            opts->frames = atoi(value);
+            if (opts->frames < 1) {
+                fprintf(stderr, "Invalid --frames '%s'\n", value);
+                return -1;
+            }
+            opts->frames_set = true;
+            i++;
+        } else if (strcmp(arg, "--warmup") == 0 && value) {
+            opts->warmup = atoi(value);
+            if (opts->warmup < 0) opts->warmup = 0;
+            opts->warmup_set = true;
+            i++;
+        } else if (strcmp(arg, "--reconstruction") == 0 && value) {
+            int mode = -1;
+            for (int m = 0; m <= MULTIPASS_RECONSTRUCT_SPATIAL; m++) {
+                if (strcmp(value, reconstruction_names[m]) == 0) mode = m;
+            }
+            if (mode < 0) {
+                fprintf(stderr, "Invalid --reconstruction '%s'\n", value);
+                return -1;
+            }
+            opts->reconstruction = (multipass_reconstruct_mode_t)mode;
+            i++;
+        } else if (strcmp(arg, "--vram-budget") == 0 && value) {
+            double mb = atof(value);
+            if (mb <= 0.0 || mb > 1048576.0) {
+                fprintf(stderr, "Invalid --vram-budget '%s' (MB)\n", value);
+                return -1;
+            }
+            opts->vram_budget = (size_t)(mb * 1024.0 * 1024.0);
+            i++;
+        } else if (arg[0] == '-') {
+            fprintf(stderr, "Unknown or incomplete benchmark option '%s'\n", arg);
+            return -1;
+        } else {
+            files[count++] = arg;
+        }
+    }
+
+    if (opts->suite) {
+        if (count > 1) {
+            fprintf(stderr, "--suite takes a single shader directory\n");
+            return -1;
+        }
+        opts->suite_dir = count ? files[0] : BENCH_SUITE_DIR;
+        if (!opts->size_set) {
+            opts->width = BENCH_SUITE_WIDTH;
+            opts->height = BENCH_SUITE_HEIGHT;
+        }
+        if (!opts->frames_set) opts->frames = BENCH_SUITE_FRAMES;
+        if (!opts->warmup_set) opts->warmup = BENCH_SUITE_WARMUP;
+        return 1;
+    }
+    if (opts->baseline_path || opts->update_baseline) {
+        fprintf(stderr, "--baseline and --update-baseline need --suite\n");
+        return -1;
+    }
+    return count;
+}
+
+/* ============================================
+ * Headless GL context
+ * ============================================ */
+
+typedef struct {
+    EGLDisplay display;
+    EGLContext context;
+    EGLSurface surface;
+    GLuint fbo;
+    GLuint texture;
+    int width;
+    int height;
+} bench_gl_t;
+
+static bool gl_create(bench_gl_t *gl, int width, int height) {
+    memset(gl, 0, sizeof(*gl));
+    gl->display = EGL_NO_DISPLAY;
+    gl->surface = EGL_NO_SURFACE;
+
+    /* Prefer a surfaceless display: no window system needed */
+    PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+#ifdef EGL_PLATFORM_SURFACELESS_MESA
+    if (get_platform_display) {
+        gl->display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    }
+#endif
+    if (gl->display == EGL_NO_DISPLAY || !eglInitialize(gl->display, NULL, NULL)) {
+        gl->display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        if (gl->display == EGL_NO_DISPLAY || !eglInitialize(gl->display, NULL, NULL)) {
+            fprintf(stderr, "EGL: no display available\n");
+            return false;
+        }
+    }
+
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        fprintf(stderr, "EGL: desktop OpenGL not available\n");
+        return false;
+    }
+
+    static const EGLint config_attribs[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8,
+        EGL_NONE
+    };
+    EGLConfig config;
+    EGLint config_count = 0;
+    if (!eglChooseConfig(gl->display, config_attribs, &config, 1, &config_count) || config_count < 1) {
+        fprintf(stderr, "EGL: no suitable config\n");
+        return false;
+    }
+
+    /* Same version the preview's GtkGLArea asks for */
+    static const EGLint context_attribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    gl->context = eglCreateContext(gl->display, config, EGL_NO_CONTEXT, context_attribs);
+    if (gl->context == EGL_NO_CONTEXT) {
+        fprintf(stderr, "EGL: could not create an OpenGL 3.3 core context\n");
+        return false;
+    }
+
+    /* Surfaceless if supported, otherwise a 1x1 pbuffer just to make current */
+    if (!eglMakeCurrent(gl->display, EGL_NO_SURFACE, EGL_NO_SURFACE, gl->context)) {
+        static const EGLint pbuffer_attribs[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+        gl->surface = eglCreatePbufferSurface(gl->display, config, pbuffer_attribs);
+        if (gl->surface == EGL_NO_SURFACE ||
+            !eglMakeCurrent(gl->display, gl->surface, gl->surface, gl->context)) {
+            fprintf(stderr, "EGL: could not make the context current\n");
+            return false;
+        }
+    }
+
+    /* Offscreen target standing in for the GtkGLArea framebuffer */
+    glGenTextures(1, &gl->texture);
+    glBindTexture(GL_TEXTURE_2D, gl->texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glGenFramebuffers(1, &gl->fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, gl->fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gl->texture, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        fprintf(stderr, "GL: offscreen framebuffer incomplete (%dx%d)\n", width, height);
+        return false;
+    }
+    gl->width = width;
+    gl->height = height;
+    return true;
+}
+
+/* Reallocate the offscreen target (suite shaders may declare their own size) */
+static bool gl_set_size(bench_gl_t *gl, int width, int height) {
+    if (gl->width == width && gl->height == height) return true;
+
+    glBindTexture(GL_TEXTURE_2D, gl->texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glBindFramebuffer(GL_FRAMEBUFFER, gl->fbo);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        fprintf(stderr, "GL: offscreen framebuffer incomplete (%dx%d)\n", width, height);
+        return false;
+    }
+    gl->width = width;
+    gl->height = height;
+    return true;
+}
+
+static void gl_destroy(bench_gl_t *gl) {
+    if (gl->context != EGL_NO_CONTEXT && gl->context) {
+        if (gl->fbo) glDeleteFramebuffers(1, &gl->fbo);
+        if (gl->texture) glDeleteTextures(1, &gl->texture);
+        eglMakeCurrent(gl->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroyContext(gl->display, gl->context);
+    }
+    if (gl->surface != EGL_NO_SURFACE) {
+        eglDestroySurface(gl->display, gl->surface);
+    }
+    if (gl->display != EGL_NO_DISPLAY) {
+        eglTerminate(gl->display);
+    }
+}
+
+/* ============================================
+ * Measurement
+ * ============================================ */
+
+/* Record the latest GPU sample if it is new and one of the measured frames
+ * produced it (samples of warm-up frames arrive during measurement) */
+static void take_gpu_sample(bench_result_t *r, int first_measured, unsigned int *last_seq,
+                            double *gpu_samples, int *gpu_count, int max) {
+    float total_ms = 0.0f;
+    float slot_ms[MULTIPASS_TIMER_SLOTS];
+    int frame = 0;
+    unsigned int seq = multipass_get_gpu_sample(r->shader, &total_ms, slot_ms, &frame);
+    if (seq == *last_seq) return;
+    *last_seq = seq;
+    if (frame < first_measured || *gpu_count >= max) return;
+
+    gpu_samples[(*gpu_count)++] = total_ms;
+    for (int p = 0; p < r->shader->pass_count; p++) {
+        r->pass_gpu_ms[p] += slot_ms[p];
+    }
+    r->reconstruct_gpu_ms += slot_ms[MULTIPASS_TIMER_SLOTS - 1];
+}
+
+static void bench_shader(const bench_options_t *opts, bench_gl_t *gl, bench_result_t *r) {
+    char *source = r->source ? strdup(r->source) : read_file(r->path);
+    if (!source) {
+        r->error = strdup("cannot read file");
+        return;
+    }
+
+    if (!gl_set_size(gl, r->width, r->height)) {
+        free(source);
+        r->error = strdup("cannot allocate render target");
+        return;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, gl->fbo);
+    glFinish();
+
+    double start = now_ms();
+    r->shader = multipass_create(source);
+    r->parse_ms = now_ms() - start;
+    free(source);
+    if (!r->shader) {
+        r->error = strdup("failed to parse shader");
+        return;
+    }
+
+    /* #include resolves next to the benchmarked file, then in the library */
+    if (r->path) {
+        char dir[PATH_MAX];
+        path_dir(r->path, dir, sizeof(dir));
+        multipass_set_include_context(r->shader, dir, -1);
+    }
+    multipass_set_source_optimization(r->shader, opts->optimize);
+
+    if (!multipass_init_gl(r->shader, r->width, r->height)) {
+        r->error = strdup("failed to initialize GL resources");
+        return;
+    }
+
+    /* Compile and link, including any work the driver defers to first use */
+    start = now_ms();
+    bool compiled = multipass_compile_all(r->shader);
+    glFinish();
+    r->compile_ms = now_ms() - start;
+    if (!compiled) {
+        r->error = multipass_get_all_errors(r->shader);
+        if (!r->error) r->error = strdup("compilation failed");
+        return;
+    }
+
+    multipass_set_adaptive_resolution(r->shader, false, 0, 0, 0);
+    multipass_set_resolution_scale(r->shader, opts->scale);
+    multipass_set_reconstruction(r->shader, opts->reconstruction);
+    multipass_set_vram_budget(r->shader, opts->vram_budget);
+
+    float mouse_x = r->width * 0.5f;
+    float mouse_y = r->height * 0.5f;
+
+    /* Size and mouse are fixed here: wait for the variants before measuring */
+    if (opts->specialize) {
+        multipass_set_specialization(r->shader, MULTIPASS_INPUT_SPECIALIZABLE);
+        for (int frame = 0; frame < BENCH_SPECIALIZE_FRAMES; frame++) {
+            multipass_resize(r->shader, r->width, r->height);
+            multipass_render(r->shader, frame * BENCH_TIME_STEP, mouse_x, mouse_y, false);
+            while (multipass_build_variants(r->shader)) {
+                /* Builds the driver can't run in the background */
+            }
+            glFinish();
+            if (!multipass_specialization_pending(r->shader)) break;
+        }
+    }
+
+    double *frame_samples = calloc((size_t)opts->frames, sizeof(double));
+    double *gpu_samples = calloc((size_t)opts->frames, sizeof(double));
+    if (!frame_samples || !gpu_samples) {
+        free(frame_samples);
+        free(gpu_samples);
+        r->error = strdup("out of memory");
+        return;
+    }
+
+    bool timers = multipass_has_gpu_timers(r->shader);
+    unsigned int last_seq = multipass_get_gpu_sample(r->shader, NULL, NULL, NULL);
+    int first_measured = r->shader->frame_count + opts->warmup;
+    int frame_count = 0;
+    int gpu_count = 0;
+
+    for (int frame = 0; frame < opts->warmup + opts->frames; frame++) {
+        double frame_start = now_ms();
+        multipass_resize(r->shader, r->width, r->height);
+        multipass_render(r->shader, frame * BENCH_TIME_STEP, mouse_x, mouse_y, false);
+        glFinish();
+        double frame_time = now_ms() - frame_start;
+
+        if (frame >= opts->warmup) {
+            frame_samples[frame_count++] = frame_time;
+        }
+        take_gpu_sample(r, first_measured, &last_seq, gpu_samples, &gpu_count, opts->frames);
+    }
+
+    /* GPU samples trail rendering by a few frames: collect the last ones */
+    glFinish();
+    while (multipass_collect_gpu_sample(r->shader)) {
+        take_gpu_sample(r, first_measured, &last_seq, gpu_samples, &gpu_count, opts->frames);
+    }
+
+    r->has_gpu_timers = timers && gpu_count > 0;
+    r->frame_ms = compute_stats(frame_samples, frame_count);
+    r->gpu_ms = compute_stats(gpu_samples, gpu_count);
+    r->pass_count = r->shader->pass_count;
+    for (int p = 0; p < r->pass_count; p++) {
+        r->pass_names[p] = r->shader->passes[p].name;
+        r->pass_specialized[p] = r->shader->passes[p].active_variant != NULL;
+        if (gpu_count > 0) r->pass_gpu_ms[p] /= gpu_count;
+    }
+    if (gpu_count > 0) r->reconstruct_gpu_ms /= gpu_count;
+    multipass_get_vram_usage(r->shader, &r->vram);
+    r->scale = multipass_get_resolution_scale(r->shader);
+    r->estimate = *multipass_get_cost_estimate(r->shader);
+    r->ok = (glGetError() == GL_NO_ERROR);
+    if (!r->ok) r->error = strdup("OpenGL error during rendering");
+
+    free(frame_samples);
+    free(gpu_samples);
+}
+
+/* ============================================
+ * Regression suite
+ * ============================================ */
+
+/* One [section] of the baseline file */
+typedef struct {
+    char name[128];
+    int width;
+    int height;
+    double frame_ms;            /* Median wall-clock frame time */
+    double compile_ms;
+    double frame_tolerance;     /* Percent, < 0 = default */
+    double compile_tolerance;
+    float scale;                /* Options the entry was recorded with */
+    multipass_reconstruct_mode_t reconstruction;
+    bool optimize;
+    bool specialize;
+    double vram_budget_mb;      /* 0 = unlimited */
+} bench_baseline_t;
+
+typedef struct {
+    bench_baseline_t *entries;
+    int count;
+    char renderer[256];
+} bench_baseline_set_t;
+
+static const struct {
+    const char *name;
+    int width;
+    int height;
+} budget_resolutions[] = {
+    { "720p", 1280, 720 },
+    { "1080p", 1920, 1080 },
+    { "1440p", 2560, 1440 },
+    { "2160p", 3840, 2160 },
+    { "4k", 3840, 2160 },
+};
+
+static char *trim(char *s) {
+    while (*s == ' ' || *s == '\t') s++;
+    char *end = s + strlen(s);
+    while (end > s && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\n' || end[-1] == '\r')) {
+        *--end = '\0';
+    }
+    return s;
+}
+
+/* Append one line to a result's findings */
+static void add_verdict(bench_result_t *r, const char *fmt, ...) {
+    size_t len = strlen(r->verdict);
+    if (len + 1 >= sizeof(r->verdict)) return;
+
+    va_list args;
+    va_start(args, fmt);
+    int written = vsnprintf(r->verdict + len, sizeof(r->verdict) - len, fmt, args);
+    va_end(args);
+    if (written > 0 && len + (size_t)written + 1 < sizeof(r->verdict)) {
+        strcat(r->verdict, "\n");
+    }
+}
+
+/* Parse a "@budget 4ms @1080p" annotation (resolution optional, WxH also
+ * accepted). Without a resolution the budget applies at the suite size. */
+static void parse_budget(const char *source, bench_result_t *r) {
+    const char *tag = source ? strstr(source, "@budget") : NULL;
+    if (!tag) return;
+
+    char *end = NULL;
+    double ms = strtod(tag + 7, &end);
+    if (end == tag + 7 || ms <= 0.0) return;
+    while (*end == ' ' || *end == '\t') end++;
+    if (strncmp(end, "ms", 2) == 0) end += 2;
+    r->budget_ms = ms;
+
+    while (*end == ' ' || *end == '\t') end++;
+    if (*end != '@') return;
+    end++;
+
+    for (size_t i = 0; i < sizeof(budget_resolutions) / sizeof(budget_resolutions[0]); i++) {
+        size_t len = strlen(budget_resolutions[i].name);
+        if (strncasecmp(end, budget_resolutions[i].name, len) == 0) {
+            r->width = budget_resolutions[i].width;
+            r->height = budget_resolutions[i].height;
+            return;
+        }
+    }
+    int width = 0, height = 0;
+    if (sscanf(end, "%dx%d", &width, &height) == 2 &&
+        width > 0 && height > 0 && width <= 16384 && height <= 16384) {
+        r->width = width;
+        r->height = height;
+    }
+}
+
+static int compare_names(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/* Fill results with every .glsl file in the suite directory (sorted) and
+ * every built-in template */
+static int suite_collect(const bench_options_t *opts, bench_result_t *results, int max) {
+    int count = 0;
+
+    DIR *dir = opendir(opts->suite_dir);
+    if (dir) {
+        char *names[BENCH_SUITE_MAX];
+        int name_count = 0;
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != NULL && name_count < BENCH_SUITE_MAX) {
+            size_t len = strlen(entry->d_name);
+            if (len > 5 && strcmp(entry->d_name + len - 5, ".glsl") == 0) {
+                names[name_count++] = strdup(entry->d_name);
+            }
+        }
+        closedir(dir);
+        qsort(names, (size_t)name_count, sizeof(char *), compare_names);
+
+        for (int i = 0; i < name_count; i++) {
+            if (count < max && names[i]) {
+                size_t len = strlen(opts->suite_dir) + strlen(names[i]) + 2;
+                results[count].path = malloc(len);
+                if (results[count].path) {
+                    snprintf(results[count].path, len, "%s/%s", opts->suite_dir, names[i]);
+                    results[count].name = names[i];
+                    count++;
+                    continue;
+                }
+            }
+            free(names[i]);
+        }
+    } else {
+        fprintf(stderr, "Warning: cannot open shader directory '%s'\n", opts->suite_dir);
+    }
+
+    size_t template_count = 0;
+    const TemplateInfo *templates = editor_templates_get_list(&template_count);
+    for (size_t i = 0; i < template_count && count < max; i++) {
+        size_t len = strlen(templates[i].name) + 10;
+        results[count].name = malloc(len);
+        if (!results[count].name) break;
+        snprintf(results[count].name, len, "template:%s", templates[i].name);
+        results[count].source = templates[i].code;
+        count++;
+    }
+
+    /* Budgets may move a shader to its own resolution */
+    for (int i = 0; i < count; i++) {
+        bench_result_t *r = &results[i];
+        r->width = opts->width;
+        r->height = opts->height;
+        if (r->source) {
+            parse_budget(r->source, r);
+        } else {
+            char *source = read_file(r->path);
+            parse_budget(source, r);
+            free(source);
+        }
+    }
+    return count;
+}
+
+/* Load the baseline file (missing file = empty baseline) */
+static void baseline_load(const char *path, bench_baseline_set_t *set) {
+    memset(set, 0, sizeof(*set));
+
+    FILE *f = fopen(path, "r");
+    if (!f) return;
+
+    char line[512];
+    bench_baseline_t *current = NULL;
+    while (fgets(line, sizeof(line), f)) {
+        char *text = trim(line);
+        if (*text == '\0' || *text == '#' || *text == ';') continue;
+
+        if (*text == '[') {
+            char *close = strchr(text, ']');
+            if (!close) continue;
+            *close = '\0';
+            bench_baseline_t *grown = realloc(set->entries, (size_t)(set->count + 1) * sizeof(bench_baseline_t));
+            if (!grown) break;
+            set->entries = grown;
+            current = &set->entries[set->count++];
+            memset(current, 0, sizeof(*current));
+            snprintf(current->name, sizeof(current->name), "%s", text + 1);
+            current->frame_tolerance = -1.0;
+            current->compile_tolerance = -1.0;
+            current->scale = 1.0f;   /* Entries without options used the defaults */
+            continue;
+        }
+
+        char *eq = strchr(text, '=');
+        if (!eq) continue;
+        *eq = '\0';
+        char *key = trim(text);
+        char *value = trim(eq + 1);
+
+        if (!current) {
+            if (strcmp(key, "renderer") == 0) {
+                snprintf(set->renderer, sizeof(set->renderer), "%s", value);
+            }
+        } else if (strcmp(key, "size") == 0) {
+            sscanf(value, "%dx%d", &current->width, &current->height);
+        } else if (strcmp(key, "frame_ms") == 0) {
+            current->frame_ms = atof(value);
+        } else if (strcmp(key, "compile_ms") == 0) {
+            current->compile_ms = atof(value);
+        } else if (strcmp(key, "frame_tolerance") == 0) {
+            current->frame_tolerance = atof(value);
+        } else if (strcmp(key, "compile_tolerance") == 0) {
+            current->compile_tolerance = atof(value);
+        } else if (strcmp(key, "scale") == 0) {
+            current->scale = (float)atof(value);
+        } else if (strcmp(key, "reconstruction") == 0) {
+            for (int m = 0; m < (int)(sizeof(reconstruction_names) / sizeof(reconstruction_names[0])); m++) {
+                if (strcmp(value, reconstruction_names[m]) == 0) {
+                    current->reconstruction = (multipass_reconstruct_mode_t)m;
+                }
+            }
+        } else if (strcmp(key, "optimize") == 0) {
+            current->optimize = strcmp(value, "on") == 0;
+        } else if (strcmp(key, "specialize") == 0) {
+            current->specialize = strcmp(value, "on") == 0;
+        } else if (strcmp(key, "vram_budget_mb") == 0) {
+            current->vram_budget_mb = atof(value);
+        }
+    }
+    fclose(f);
+}
+
+static const bench_baseline_t *baseline_find(const bench_baseline_set_t *set, const char *name) {
+    for (int i = 0; i < set->count; i++) {
+        if (strcmp(set->entries[i].name, name) == 0) return &set->entries[i];
+    }
+    return NULL;
+}
+
+static double vram_budget_mb(const bench_options_t *opts) {
+    return opts->vram_budget / (1024.0 * 1024.0);
+}
+
+/* Did the run use the options the baseline entry was recorded with? */
+static bool baseline_options_match(const bench_baseline_t *base, const bench_options_t *opts) {
+    double budget_change = base->vram_budget_mb - vram_budget_mb(opts);
+    float scale_change = base->scale - opts->scale;
+    return scale_change > -0.005f && scale_change < 0.005f &&
+           base->reconstruction == opts->reconstruction &&
+           base->optimize == opts->optimize &&
+           base->specialize == opts->specialize &&
+           budget_change > -0.05 && budget_change < 0.05;
+}
+
+/* Write current results as the new baseline, keeping hand-edited tolerances */
+static bool baseline_save(const char *path, const char *renderer, const bench_options_t *opts,
+                          const bench_baseline_set_t *old, const bench_result_t *results, int count) {
+    FILE *f = fopen(path, "w");
+    if (!f) return false;
+
+    fprintf(f, "# gleditor benchmark baseline\n");
+    fprintf(f, "# Regenerate with: gleditor --bench --suite %s --update-baseline\n", opts->suite_dir);
+    fprintf(f, "# Entries are only compared against runs with the same options\n");
+    fprintf(f, "# Per-shader frame_tolerance / compile_tolerance (percent) are kept on update\n");
+    fprintf(f, "renderer = %s\n", renderer ? renderer : "unknown");
+
+    for (int i = 0; i < count; i++) {
+        const bench_result_t *r = &results[i];
+        if (!r->ok) continue;
+
+        fprintf(f, "\n[%s]\n", r->name);
+        fprintf(f, "size = %dx%d\n", r->width, r->height);
+        fprintf(f, "frame_ms = %.4f\n", r->frame_ms.median);
+        fprintf(f, "compile_ms = %.4f\n", r->compile_ms);
+        fprintf(f, "scale = %.2f\n", opts->scale);
+        fprintf(f, "reconstruction = %s\n", reconstruction_names[opts->reconstruction]);
+        fprintf(f, "optimize = %s\n", opts->optimize ? "on" : "off");
+        fprintf(f, "specialize = %s\n", opts->specialize ? "on" : "off");
+        fprintf(f, "vram_budget_mb = %.1f\n", vram_budget_mb(opts));
+
+        const bench_baseline_t *base = baseline_find(old, r->name);
+        if (base && base->frame_tolerance >= 0.0) {
+            fprintf(f, "frame_tolerance = %g\n", base->frame_tolerance);
+        }
+        if (base && base->compile_tolerance >= 0.0) {
+            fprintf(f, "compile_tolerance = %g\n", base->compile_tolerance);
+        }
+    }
+    return fclose(f) == 0;
+}
+
+/* Compare one result against the budget declared in its source */
+static void check_budget(bench_result_t *r) {
+    if (!r->ok || r->budget_ms <= 0.0) return;
+
+    if (r->frame_ms.median > r->budget_ms) {
+        r->regressed = true;
+        add_verdict(r, "over budget: %.3f ms > %.3f ms at %dx%d",
+                    r->frame_ms.median, r->budget_ms, r->width, r->height);
+    } else {
+        add_verdict(r, "within budget: %.3f ms <= %.3f ms at %dx%d",
+                    r->frame_ms.median, r->budget_ms, r->width, r->height);
+    }
+}
+
+/* Compare one result against its baseline entry */
+static void check_baseline(bench_result_t *r, const bench_baseline_t *base, const bench_options_t *opts) {
+    if (!r->ok) return;
+
+    if (!base) {
+        add_verdict(r, "new: no baseline entry");
+        return;
+    }
+    if (base->width != r->width || base->height != r->height) {
+        add_verdict(r, "baseline recorded at %dx%d, not compared", base->width, base->height);
+        return;
+    }
+    if (!baseline_options_match(base, opts)) {
+        add_verdict(r, "baseline recorded with scale %.2f, reconstruction %s, optimize %s, "
+                    "specialize %s, VRAM budget %.1f MB; not compared",
+                    base->scale, reconstruction_names[base->reconstruction],
+                    base->optimize ? "on" : "off", base->specialize ? "on" : "off",
+                    base->vram_budget_mb);
+        return;
+    }
+
+    double tolerance = base->frame_tolerance >= 0.0 ? base->frame_tolerance : BENCH_FRAME_TOLERANCE;
+    double limit = base->frame_ms * (1.0 + tolerance / 100.0) + BENCH_FRAME_SLACK_MS;
+    double change = base->frame_ms > 0.0 ? (r->frame_ms.median / base->frame_ms - 1.0) * 100.0 : 0.0;
+    if (r->frame_ms.median > limit) {
+        r->regressed = true;
+        add_verdict(r, "frame time regressed: %.3f ms vs baseline %.3f ms (%+.1f%%)",
+                    r->frame_ms.median, base->frame_ms, change);
+    } else {
+        add_verdict(r, "frame time %.3f ms vs baseline %.3f ms (%+.1f%%)",
+                    r->frame_ms.median, base->frame_ms, change);
+    }
+
+    tolerance = base->compile_tolerance >= 0.0 ? base->compile_tolerance : BENCH_COMPILE_TOLERANCE;
+    limit = base->compile_ms * (1.0 + tolerance / 100.0) + BENCH_COMPILE_SLACK_MS;
+    change = base->compile_ms > 0.0 ? (r->compile_ms / base->compile_ms - 1.0) * 100.0 : 0.0;
+    if (r->compile_ms > limit) {
+        r->regressed = true;
+        add_verdict(r, "compile time regressed: %.2f ms vs baseline %.2f ms (%+.1f%%)",
+                    r->compile_ms, base->compile_ms, change);
+    } else {
+        add_verdict(r, "compile time %.2f ms vs baseline %.2f ms (%+.1f%%)",
+                    r->compile_ms, base->compile_ms, change);
+    }
+}
+
+/* ============================================
+ * Reporting
+ * ============================================ */
+
+static void print_text(const bench_options_t *opts, const char *renderer,
+                       const bench_result_t *results, int count) {
+    printf("Renderer:   %s\n", renderer ? renderer : "unknown");
+    printf("Resolution: %dx%d @ scale %.2f, reconstruction %s%s%s\n",
+           opts->width, opts->height, opts->scale, reconstruction_names[opts->reconstruction],
+           opts->optimize ? ", optimized sources" : "",
+           opts->specialize ? ", specialized" : "");
+    printf("Frames:     %d measured after %d warm-up\n\n", opts->frames, opts->warmup);
+
+    for (int i = 0; i < count; i++) {
+        const bench_result_t *r = &results[i];
+        if (r->width != opts->width || r->height != opts->height) {
+            printf("%s (%dx%d)\n", r->name, r->width, r->height);
+        } else {
+            printf("%s\n", r->name);
+        }
+        if (!r->ok) {
+            printf("  FAILED: %s\n\n", r->error ? r->error : "unknown error");
+            continue;
+        }
+
+        printf("  parse %.2f ms, compile+link %.2f ms, VRAM %.1f MB",
+               r->parse_ms, r->compile_ms, r->vram.total_bytes / (1024.0 * 1024.0));
+        if (r->vram.budget_bytes > 0) {
+            printf(" (budget %.1f MB: %s at scale %.2f%s)", r->vram.budget_bytes / (1024.0 * 1024.0),
+                   multipass_vram_stage_name(r->vram.stage), r->scale,
+                   r->vram.over_budget ? ", still over" : "");
+        }
+        printf("\n");
+        if (r->estimate.valid) {
+            printf("  estimate  %.1f ms @1080p%s, wallpaper suitability %d (%s)\n",
+                   r->estimate.frame_ms_1080p, r->estimate.calibrated ? "" : " (uncalibrated)",
+                   r->estimate.suitability, multipass_suitability_name(r->estimate.suitability));
+        }
+        printf("  frame ms  min %7.3f  median %7.3f  p95 %7.3f  p99 %7.3f  mean %7.3f\n",
+               r->frame_ms.min, r->frame_ms.median, r->frame_ms.p95, r->frame_ms.p99, r->frame_ms.mean);
+        if (r->has_gpu_timers) {
+            printf("  GPU ms    min %7.3f  median %7.3f  p95 %7.3f  p99 %7.3f  mean %7.3f\n",
+                   r->gpu_ms.min, r->gpu_ms.median, r->gpu_ms.p95, r->gpu_ms.p99, r->gpu_ms.mean);
+            for (int p = 0; p < r->pass_count; p++) {
+                printf("    %-12s %7.3f ms%s\n", r->pass_names[p] ? r->pass_names[p] : "?", r->pass_gpu_ms[p],
+                       r->pass_specialized[p] ? "  (specialized)" : "");
+            }
+            if (opts->reconstruction != MULTIPASS_RECONSTRUCT_NONE) {
+                printf("    %-12s %7.3f ms\n", "Reconstruct", r->reconstruct_gpu_ms);
+            }
+        } else {
+            printf("  GPU ms    n/a (timer queries unsupported)\n");
+        }
+        if (opts->suite) {
+            /* Findings are newline-separated; indent each one */
+            const char *line = r->verdict;
+            while (*line) {
+                const char *next = strchr(line, '\n');
+                int len = next ? (int)(next - line) : (int)strlen(line);
+                printf("  > %.*s\n", len, line);
+                line = next ? next + 1 : line + len;
+            }
+        }
+        printf("\n");
+    }
+}
+
+static void print_json(const bench_options_t *opts, const char *renderer,
+                       const bench_result_t *results, int count) {
+    printf("{\n");
+    printf("  \"version\": ");
+    json_string(stdout, VERSION);
+    printf(",\n  \"renderer\": ");
+    json_string(stdout, renderer ? renderer : "unknown");
+    printf(",\n  \"width\": %d,\n  \"height\": %d,\n  \"scale\": %.3f,\n",
+           opts->width, opts->height, opts->scale);
+    printf("  \"reconstruction\": \"%s\",\n", reconstruction_names[opts->reconstruction]);
+    printf("  \"optimize\": %s,\n", opts->optimize ? "true" : "false");
+    printf("  \"specialize\": %s,\n", opts->specialize ? "true" : "false");
+    printf("  \"frames\": %d,\n  \"warmup\": %d,\n", opts->frames, opts->warmup);
+    printf("  \"shaders\": [");
+
+    for (int i = 0; i < count; i++) {
+        const bench_result_t *r = &results[i];
+        printf("%s\n    {\n      \"file\": ", i ? "," : "");
+        json_string(stdout, r->name);
+        printf(",\n      \"ok\": %s", r->ok ? "true" : "false");
+        if (opts->suite) {
+            printf(",\n      \"width\": %d,\n      \"height\": %d", r->width, r->height);
+            printf(",\n      \"regressed\": %s,\n      \"findings\": ", r->regressed ? "true" : "false");
+            json_string(stdout, r->verdict);
+            if (r->budget_ms > 0.0) printf(",\n      \"budget_ms\": %.4f", r->budget_ms);
+        }
+        if (!r->ok) {
+            printf(",\n      \"error\": ");
+            json_string(stdout, r->error ? r->error : "unknown error");
+            printf("\n    }");
+            continue;
+        }
+
+        printf(",\n      \"parse_ms\": %.4f,\n      \"compile_ms\": %.4f,\n", r->parse_ms, r->compile_ms);
+        printf("      \"vram_bytes\": %zu,\n", r->vram.total_bytes);
+        if (r->vram.budget_bytes > 0) {
+            printf("      \"vram_budget_bytes\": %zu,\n      \"vram_stage\": ",
+                   r->vram.budget_bytes);
+            json_string(stdout, multipass_vram_stage_name(r->vram.stage));
+            printf(",\n      \"vram_scale\": %.4f,\n      \"vram_over_budget\": %s,\n",
+                   r->scale, r->vram.over_budget ? "true" : "false");
+        }
+        if (r->estimate.valid) {
+            printf("      \"estimate_ms_1080p\": %.4f,\n      \"suitability\": %d,\n",
+                   r->estimate.frame_ms_1080p, r->estimate.suitability);
+        }
+        printf("      \"frame_ms\": ");
+        json_stats(stdout, &r->frame_ms);
+        printf(",\n      \"gpu_ms\": ");
+        if (r->has_gpu_timers) {
+            json_stats(stdout, &r->gpu_ms);
+        } else {
+            printf("null");
+        }
+        printf(",\n      \"passes\": [");
+        for (int p = 0; p < r->pass_count; p++) {
+            printf("%s{\"name\": ", p ? ", " : "");
+            json_string(stdout, r->pass_names[p] ? r->pass_names[p] : "?");
+            printf(", \"specialized\": %s", r->pass_specialized[p] ? "true" : "false");
+            printf(", \"estimate_units\": %.0f", r->estimate.pass_units[p]);
+            printf(", \"vram_bytes\": %zu", r->vram.pass_bytes[p]);
+            if (r->has_gpu_timers) {
+                printf(", \"gpu_ms\": %.4f}", r->pass_gpu_ms[p]);
+            } else {
+                printf(", \"gpu_ms\": null}");
+            }
+        }
+        printf("]");
+        if (r->has_gpu_timers && opts->reconstruction != MULTIPASS_RECONSTRUCT_NONE) {
+            printf(",\n      \"reconstruct_gpu_ms\": %.4f", r->reconstruct_gpu_ms);
+        }
+        printf("\n    }");
+    }
+    printf("\n  ]\n}\n");
+}
+
+int shader_bench_main(int argc, char **argv) {
+    bench_options_t opts = {
+        .width = BENCH_DEFAULT_WIDTH,
+        .height = BENCH_DEFAULT_HEIGHT,
+        .scale = 1.0f,
+        .frames = BENCH_DEFAULT_FRAMES,
+        .warmup = BENCH_DEFAULT_WARMUP,
+        .reconstruction = MULTIPASS_RECONSTRUCT_NONE,
+        .json = false
+    };
+
+    const char **files = calloc((size_t)argc, sizeof(char *));
+    if (!files) return 1;
+
+    int count = parse_options(argc, argv, &opts, files);
+    if (count <= 0) {
+        if (count == 0) fprintf(stderr, "No shader files given\n\n");
+        shader_bench_print_usage();
+        free(files);
+        return 2;
+    }
+
+    if (opts.trace_path) {
+        shader_trace_start(opts.trace_path);
+    }
+
+    int capacity = opts.suite ? BENCH_SUITE_MAX : count;
+    bench_result_t *results = calloc((size_t)capacity, sizeof(bench_result_t));
+    if (!results) {
+        free(files);
+        return 1;
+    }
+
+    if (opts.suite) {
+        count = suite_collect(&opts, results, capacity);
+        if (count == 0) {
+            fprintf(stderr, "No shaders found for the suite\n");
+            free(results);
+            free(files);
+            return 2;
+        }
+    } else {
+        for (int i = 0; i < count; i++) {
+            results[i].name = strdup(files[i]);
+            results[i].path = strdup(files[i]);
+            results[i].width = opts.width;
+            results[i].height = opts.height;
+        }
+    }
+
+    bench_gl_t gl;
+    if (!gl_create(&gl, opts.width, opts.height)) {
+        gl_destroy(&gl);
+        for (int i = 0; i < count; i++) {
+            free(results[i].name);
+            free(results[i].path);
+        }
+        free(results);
+        free(files);
+        return 1;
+    }
+    const char *renderer = (const char *)glGetString(GL_RENDERER);
+
+    int failed = 0;
+    for (int i = 0; i < count; i++) {
+        if (opts.suite) {
+            fprintf(stderr, "[%d/%d] %s\n", i + 1, count, results[i].name);
+        }
+        uint64_t span = shader_trace_begin();
+        bench_shader(&opts, &gl, &results[i]);
+        shader_trace_end(span, SHADER_TRACE_RENDER, "bench", results[i].name);
+        if (!results[i].ok) failed++;
+    }
+
+    int regressions = 0;
+    if (opts.suite) {
+        char default_path[1024];
+        const char *baseline_path = opts.baseline_path;
+        if (!baseline_path) {
+            snprintf(default_path, sizeof(default_path), "%s/%s", opts.suite_dir, BENCH_BASELINE_NAME);
+            baseline_path = default_path;
+        }
+
+        bench_baseline_set_t baseline;
+        baseline_load(baseline_path, &baseline);
+        if (!opts.update_baseline) {
+            if (baseline.count == 0) {
+                fprintf(stderr, "Warning: no baseline at %s (create one with --update-baseline)\n",
+                        baseline_path);
+            } else if (renderer && baseline.renderer[0] && strcmp(baseline.renderer, renderer) != 0) {
+                fprintf(stderr, "Warning: baseline was recorded on '%s', running on '%s'\n",
+                        baseline.renderer, renderer);
+            }
+        }
+
+        for (int i = 0; i < count; i++) {
+            check_budget(&results[i]);
+            if (!opts.update_baseline) {
+                check_baseline(&results[i], baseline_find(&baseline, results[i].name), &opts);
+            }
+            if (results[i].regressed) regressions++;
+        }
+
+        if (opts.update_baseline) {
+            if (baseline_save(baseline_path, renderer, &opts, &baseline, results, count)) {
+                fprintf(stderr, "Baseline written to %s\n", baseline_path);
+            } else {
+                fprintf(stderr, "Error: cannot write baseline %s\n", baseline_path);
+                failed++;
+            }
+        }
+        free(baseline.entries);
+    }
+
+    if (opts.json) {
+        print_json(&opts, renderer, results, count);
+    } else {
+        print_text(&opts, renderer, results, count);
+        if (opts.suite) {
+            printf("Suite: %d shaders, %d failed, %d regressed\n", count, failed, regressions);
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        multipass_destroy(results[i].shader);
+        free(results[i].error);
+        free(results[i].name);
+        free(results[i].path);
+    }
+    free(results);
+    shader_include_clear();
+    gl_destroy(&gl);
+    free(files);
+
+    return (failed || regressions) ? 1 : 0;
+}
+
+#else /* !BENCH_HAVE_EGL */
+
+int shader_bench_main(int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+    fprintf(stderr, "Benchmark mode needs EGL and is not available on %s\n", PLATFORM_NAME);
+    return 1;
+}
+
+#endif /* BENCH_HAVE_EGL */
@@ -0,0 +1,35 @@
+/* Shader Benchmark - Header
+ * Headless, reproducible performance measurements for shaders
+ */
+
+#ifndef SHADER_BENCH_H
+#define SHADER_BENCH_H
+
+#include <stdbool.h>
+
+/**
+ * Check whether the command line asks for benchmark mode
+ *
+ * @param argc Argument count
+ * @param argv Argument vector
+ * @return true if --bench is present
+ */
+bool shader_bench_requested(int argc, char **argv);
+
+/**
+ * Run the benchmark command (gleditor --bench [options] FILE...)
+ * Renders every shader offscreen through the same multipass code the
+ * editor uses and prints the results as text or JSON.
+ *
+ * @param argc Argument count
+ * @param argv Argument vector
+ * @return Process exit status (0 if every shader compiled and ran)
+ */
+int shader_bench_main(int argc, char **argv);
+
+/**
+ * Print the benchmark options for --help
+ */
+void shader_bench_print_usage(void);
+
+#endif /* SHADER_BENCH_H */
@@ -0,0 +1,503 @@
+/* Performance HUD - Implementation
+ * Frame-time graph and per-pass GPU times drawn over the preview
+ *
+ * Everything the HUD shows is a coloured rectangle: the panel, the graph
+ * bars, and one per character, masked by a 3x5 bitmap font kept in a tiny
+ * texture. Each rectangle is one 24 byte instance whose corners the vertex
+ * shader expands; the instances are rebuilt on the CPU each frame,
+ * uploaded with one buffer orphan and drawn with one instanced draw call,
+ * so the HUD costs a few microseconds of CPU and a small blended quad's
+ * worth of GPU time.
+ */
+
+#include "editor_hud.h"
+#define SHADER_LOG_SUBSYSTEM SHADER_LOG_PREVIEW
+#include "../shader_lib/shader_log.h"
+#include "../shader_lib/shader_trace.h"
+#include "platform_compat.h"
+#include <ctype.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define HUD_MAX_RECTS 512            /* Rectangles one HUD frame may use */
+#define HUD_DROP_FACTOR 1.5          /* Interval over expected that counts as dropped */
+#define HUD_AVERAGE_FRAMES 30        /* Frames averaged for the ms/FPS readout */
+
+/* Layout in font pixels (one font pixel is hud_state.scale screen pixels) */
+#define HUD_MARGIN 4                 /* Panel distance from the corner */
+#define HUD_PADDING 3                /* Panel border */
+#define HUD_CHAR_ADVANCE 4           /* 3 pixel glyph + 1 pixel gap */
+#define HUD_LINE_HEIGHT 7            /* 5 pixel glyph + 2 pixel gap */
+#define HUD_GRAPH_HEIGHT 30          /* Graph spans twice the expected interval */
+#define HUD_WIDTH EDITOR_HUD_HISTORY /* One graph column per frame */
+#define HUD_NAME_CHARS 8             /* Pass name column */
+#define HUD_BAR_X 36                 /* Pass bars start after the name column */
+#define HUD_BAR_WIDTH 60             /* A bar this long is the whole frame budget */
+
+typedef struct {
+    float x, y, w, h;                /* Screen pixels, y down */
+    uint8_t r, g, b, a;
+    uint8_t glyph;                   /* Character masking the rectangle (0 = solid) */
+    uint8_t padding[3];
+} hud_rect_t;
+
+typedef struct {
+    uint8_t r, g, b, a;
+} hud_color_t;
+
+static const hud_color_t HUD_PANEL = {0, 0, 0, 170};
+static const hud_color_t HUD_TEXT = {230, 230, 230, 255};
+static const hud_color_t HUD_DIM = {140, 140, 140, 255};
+static const hud_color_t HUD_GOOD = {90, 200, 90, 255};
+static const hud_color_t HUD_SLOW = {230, 190, 60, 255};
+static const hud_color_t HUD_BAD = {230, 70, 60, 255};
+static const hud_color_t HUD_LINE = {255, 255, 255, 90};
+
+/* 3x5 glyphs, one octal digit per row (top first), high bit = left column.
+ * The font texture holds them side by side, indexed by character code. */
+static const unsigned short hud_glyphs[128] = {
+    ['0'] = 075557, ['1'] = 026227, ['2'] = 071747, ['3'] = 071717, ['4'] = 055711,
+    ['5'] = 074717, ['6'] = 074757, ['7'] = 071111, ['8'] = 075757, ['9'] = 075717,
+    ['.'] = 000002, ['%'] = 051245, [':'] = 002020, ['-'] = 000700, ['/'] = 011244,
+    ['A'] = 025755, ['B'] = 065656, ['C'] = 034443, ['D'] = 065556, ['E'] = 074647,
+    ['F'] = 074644, ['G'] = 034553, ['H'] = 055755, ['I'] = 072227, ['J'] = 011152,
+    ['K'] = 055655, ['L'] = 044447, ['M'] = 057755, ['N'] = 065555, ['O'] = 025552,
+    ['P'] = 065644, ['Q'] = 025563, ['R'] = 065655, ['S'] = 034216, ['T'] = 072222,
+    ['U'] = 055557, ['V'] = 055552, ['W'] = 055775, ['X'] = 055255, ['Y'] = 055222,
+    ['Z'] = 071247,
+};
+
+static const char *hud_vertex_source =
+    "#version 330 core\n"
+    "layout(location = 0) in vec4 a_rect;\n"
+    "layout(location = 1) in vec4 a_color;\n"
+    "layout(location = 2) in int a_glyph;\n"
+    "uniform vec2 u_scale;\n"
+    "out vec4 v_color;\n"
+    "out vec2 v_cell;\n"
+    "flat out int v_glyph;\n"
+    "void main() {\n"
+    "    vec2 corner = vec2(float(gl_VertexID & 1), float(gl_VertexID >> 1));\n"
+    "    vec2 position = a_rect.xy + corner * a_rect.zw;\n"
+    "    v_color = a_color;\n"
+    "    v_cell = corner * vec2(3.0, 5.0);\n"
+    "    v_glyph = a_glyph;\n"
+    "    gl_Position = vec4(position * u_scale + vec2(-1.0, 1.0), 0.0, 1.0);\n"
+    "}\n";
+
+static const char *hud_fragment_source =
+    "#version 330 core\n"
+    "#ifdef GL_ES\n"
+    "precision mediump float;\n"
+    "#endif\n"
+    "uniform sampler2D u_font;\n"
+    "in vec4 v_color;\n"
+    "in vec2 v_cell;\n"
+    "flat in int v_glyph;\n"
+    "out vec4 fragColor;\n"
+    "void main() {\n"
+    "    if (v_glyph > 0) {\n"
+    "        ivec2 texel = ivec2(min(v_cell, vec2(2.5, 4.5))) + ivec2(v_glyph * 3, 0);\n"
+    "        if (texelFetch(u_font, texel, 0).r < 0.5) discard;\n"
+    "    }\n"
+    "    fragColor = v_color;\n"
+    "}\n";
+
+/* Module state */
+static struct {
+    GLuint program;
+    GLint scale_location;
+    GLuint font_texture;             /* 3x5 cell per character code, R8 */
+    GLuint vao;
+    GLuint vbo;
+    bool gl_failed;                  /* Program didn't build - stop trying */
+
+    hud_rect_t rects[HUD_MAX_RECTS];
+    int rect_count;
+    float scale;                     /* Screen pixels per font pixel this frame */
+    float origin_x;                  /* Panel interior, in screen pixels */
+    float origin_y;
+
+    float history[EDITOR_HUD_HISTORY];  /* Frame intervals (ms), oldest overwritten */
+    int history_next;
+    int history_count;
+    double expected_ms;              /* Interval the display asked for */
+    unsigned int dropped;            /* Frames over HUD_DROP_FACTOR * expected */
+    double cost_ms;                  /* Smoothed CPU time of building and submitting the HUD */
+} hud_state = {
+    .program = 0,
+    .scale_location = -1,
+    .font_texture = 0,
+    .vao = 0,
+    .vbo = 0,
+    .gl_failed = false,
+    .rect_count = 0,
+    .history_next = 0,
+    .history_count = 0,
+    .expected_ms = 0.0,
+    .dropped = 0,
+    .cost_ms = 0.0,
+};
+
+/* ============================================
+ * Frame statistics
+ * ============================================ */
+
+void editor_hud_record_frame(double interval_ms, double expected_ms) {
+    if (interval_ms <= 0.0) return;
+
+    hud_state.history[hud_state.history_next] = (float)interval_ms;
+    hud_state.history_next = (hud_state.history_next + 1) % EDITOR_HUD_HISTORY;
+    if (hud_state.history_count < EDITOR_HUD_HISTORY) {
+        hud_state.history_count++;
+    }
+
+    if (expected_ms > 0.0) {
+        hud_state.expected_ms = expected_ms;
+        if (interval_ms > expected_ms * HUD_DROP_FACTOR) {
+            hud_state.dropped++;
+        }
+    }
+}
+
+void editor_hud_reset(void) {
+    hud_state.history_next = 0;
+    hud_state.history_count = 0;
+    hud_state.dropped = 0;
+}
+
+/* Interval i frames back (0 = latest) */
+static float history_at(int i) {
+    int index = hud_state.history_next - 1 - i;
+    if (index < 0) index += EDITOR_HUD_HISTORY;
+    return hud_state.history[index];
+}
+
+static hud_color_t frame_color(double ms, double limit_ms) {
+    if (ms > limit_ms * HUD_DROP_FACTOR) return HUD_BAD;
+    if (ms > limit_ms * 1.1) return HUD_SLOW;
+    return HUD_GOOD;
+}
+
+/* ============================================
+ * Geometry
+ * ============================================ */
+
+/* Rectangle in font pixels relative to the panel interior, masked by a glyph or solid (0) */
+static void push_glyph(float x, float y, float w, float h, hud_color_t c, unsigned char glyph) {
+    if (hud_state.rect_count >= HUD_MAX_RECTS || w <= 0.0f || h <= 0.0f) return;
+
+    hud_rect_t *r = &hud_state.rects[hud_state.rect_count++];
+    r->x = hud_state.origin_x + x * hud_state.scale;
+    r->y = hud_state.origin_y + y * hud_state.scale;
+    r->w = w * hud_state.scale;
+    r->h = h * hud_state.scale;
+    r->r = c.r;
+    r->g = c.g;
+    r->b = c.b;
+    r->a = c.a;
+    r->glyph = glyph;
+}
+
+static void push_rect(float x, float y, float w, float h, hud_color_t c) {
+    push_glyph(x, y, w, h, c, 0);
+}
+
+/* Draw text at a position in font pixels; returns the x after the last character */
+static float push_text(float x, float y, const char *text, hud_color_t c) {
+    for (; *text; text++, x += HUD_CHAR_ADVANCE) {
+        unsigned char ch = (unsigned char)toupper((unsigned char)*text);
+        if (ch < 128 && hud_glyphs[ch]) {
+            push_glyph(x, y, 3.0f, 5.0f, c, ch);
+        }
+    }
+    return x;
+}
+
+static float push_textf(float x, float y, hud_color_t c, const char *fmt, ...)
+    __attribute__((format(printf, 4, 5)));
+
+static float push_textf(float x, float y, hud_color_t c, const char *fmt, ...) {
+    char text[64];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(text, sizeof(text), fmt, args);
+    va_end(args);
+    return push_text(x, y, text, c);
+}
+
+/* One pass row: name, bar against the frame budget, milliseconds */
+static void push_pass_row(float y, const char *name, float ms, float budget_ms) {
+    char label[HUD_NAME_CHARS + 1];
+    snprintf(label, sizeof(label), "%s", name ? name : "?");
+    push_text(0.0f, y, label, HUD_TEXT);
+
+    float fraction = budget_ms > 0.0f ? ms / budget_ms : 0.0f;
+    hud_color_t c = fraction > 1.0f ? HUD_BAD : (fraction > 0.5f ? HUD_SLOW : HUD_GOOD);
+    push_rect(HUD_BAR_X, y, (fraction > 1.0f ? 1.0f : fraction) * HUD_BAR_WIDTH, 5.0f, c);
+    push_textf(HUD_BAR_X + HUD_BAR_WIDTH + 4, y, HUD_TEXT, "%.2f", ms);
+}
+
+/* Build the whole HUD; returns the interior height in font pixels */
+static float build_hud(const multipass_shader_t *shader) {
+    float y = 0.0f;
+
+    /* Frame interval readout over the most recent frames */
+    int averaged = hud_state.history_count < HUD_AVERAGE_FRAMES ?
+                   hud_state.history_count : HUD_AVERAGE_FRAMES;
+    if (averaged > 0) {
+        double sum = 0.0;
+        for (int i = 0; i < averaged; i++) sum += history_at(i);
+        double mean = sum / averaged;
+        float x = push_textf(0.0f, y, HUD_TEXT, "%.1f MS", mean);
+        push_textf(x + HUD_CHAR_ADVANCE, y, HUD_DIM, "%.0f FPS", 1000.0 / mean);
+    } else {
+        push_text(0.0f, y, "NO FRAMES", HUD_DIM);
+    }
+    y += HUD_LINE_HEIGHT;
+
+    /* Scrolling graph, newest on the right; full height is twice the expected interval */
+    double expected = hud_state.expected_ms > 0.0 ? hud_state.expected_ms : 1000.0 / 60.0;
+    float graph_bottom = y + HUD_GRAPH_HEIGHT;
+    for (int i = 0; i < hud_state.history_count; i++) {
+        double ms = history_at(i);
+        float h = (float)(ms / (2.0 * expected)) * HUD_GRAPH_HEIGHT;
+        if (h > HUD_GRAPH_HEIGHT) h = HUD_GRAPH_HEIGHT;
+        if (h < 0.5f) h = 0.5f;
+        push_rect((float)(HUD_WIDTH - 1 - i), graph_bottom - h, 1.0f, h,
+                  frame_color(ms, expected));
+    }
+    push_rect(0.0f, y + HUD_GRAPH_HEIGHT / 2.0f, HUD_WIDTH, 0.5f, HUD_LINE);
+    y = graph_bottom + 2.0f;
+
+    if (shader) {
+        float x;
+        if (multipass_has_gpu_timers(shader)) {
+            x = push_textf(0.0f, y, HUD_TEXT, "GPU %.2f MS", multipass_get_gpu_time_ms(shader));
+        } else {
+            x = push_text(0.0f, y, "GPU N/A", HUD_DIM);
+        }
+        push_textf(x + HUD_CHAR_ADVANCE, y, HUD_TEXT, "SCALE %.0f%%",
+                   multipass_get_resolution_scale(shader) * 100.0f);
+        y += HUD_LINE_HEIGHT;
+
+        /* Per-pass GPU time against the budget the adaptive resolution aims for */
+        if (multipass_has_gpu_timers(shader)) {
+            for (int i = 0; i < shader->pass_count; i++) {
+                push_pass_row(y, shader->passes[i].name,
+                              multipass_get_pass_gpu_time_ms(shader, i), shader->frame_budget_ms);
+                y += HUD_LINE_HEIGHT;
+            }
+            if (shader->reconstruct.mode != MULTIPASS_RECONSTRUCT_NONE) {
+                push_pass_row(y, "Upscale", shader->reconstruct_gpu_ms, shader->frame_budget_ms);
+                y += HUD_LINE_HEIGHT;
+            }
+        }
+    }
+
+    float x = push_textf(0.0f, y, hud_state.dropped ? HUD_BAD : HUD_TEXT,
+                         "DROP %u", hud_state.dropped);
+    multipass_vram_usage_t vram;
+    multipass_get_vram_usage(shader, &vram);
+    if (shader && vram.budget_bytes > 0) {
+        hud_color_t c = vram.over_budget ? HUD_BAD :
+                        (vram.stage != MULTIPASS_VRAM_FULL ? HUD_SLOW : HUD_TEXT);
+        push_textf(x + HUD_CHAR_ADVANCE, y, c, "VRAM %.1f/%.0f MB",
+                   (double)vram.total_bytes / (1024.0 * 1024.0),
+                   (double)vram.budget_bytes / (1024.0 * 1024.0));
+    } else if (shader) {
+        push_textf(x + HUD_CHAR_ADVANCE, y, HUD_TEXT, "VRAM %.1f MB",
+                   (double)vram.total_bytes / (1024.0 * 1024.0));
+    }
+    y += HUD_LINE_HEIGHT;
+
+    /* What the budget took away */
+    if (shader && vram.stage != MULTIPASS_VRAM_FULL) {
+        push_text(0.0f, y, multipass_vram_stage_name(vram.stage), HUD_SLOW);
+        y += HUD_LINE_HEIGHT;
+    }
+
+    push_textf(0.0f, y, HUD_DIM, "HUD %.3f MS", hud_state.cost_ms);
+    return y + 5.0f;
+}
+
+/* ============================================
+ * GL
+ * ============================================ */
+
+static GLuint compile_stage(GLenum type, const char *source) {
+    GLuint shader = glCreateShader(type);
+    if (!shader) return 0;
+
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+
+    GLint compiled = 0;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+    if (!compiled) {
+        char info[512];
+        glGetShaderInfoLog(shader, sizeof(info), NULL, info);
+        log_warn("HUD shader failed to compile: %s", info);
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+static bool ensure_gl(void) {
+    if (hud_state.program) return true;
+    if (hud_state.gl_failed) return false;
+    hud_state.gl_failed = true;
+
+    GLuint vs = compile_stage(GL_VERTEX_SHADER, hud_vertex_source);
+    GLuint fs = compile_stage(GL_FRAGMENT_SHADER, hud_fragment_source);
+    if (!vs || !fs) {
+        if (vs) glDeleteShader(vs);
+        if (fs) glDeleteShader(fs);
+        return false;
+    }
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vs);
+    glAttachShader(program, fs);
+    glLinkProgram(program);
+    glDeleteShader(vs);
+    glDeleteShader(fs);
+
+    GLint linked = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (!linked) {
+        char info[512];
+        glGetProgramInfoLog(program, sizeof(info), NULL, info);
+        log_warn("HUD program failed to link: %s", info);
+        glDeleteProgram(program);
+        return false;
+    }
+
+    hud_state.program = program;
+    hud_state.scale_location = glGetUniformLocation(program, "u_scale");
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "u_font"), 0);
+    glUseProgram(0);
+
+    /* Unpack the glyph table into the font texture */
+    static uint8_t font[5][128 * 3];
+    for (int ch = 0; ch < 128; ch++) {
+        for (int row = 0; row < 5; row++) {
+            for (int col = 0; col < 3; col++) {
+                bool lit = (hud_glyphs[ch] >> ((4 - row) * 3 + (2 - col))) & 1;
+                font[row][ch * 3 + col] = lit ? 255 : 0;
+            }
+        }
+    }
+    glGenTextures(1, &hud_state.font_texture);
+    glBindTexture(GL_TEXTURE_2D, hud_state.font_texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, 128 * 3, 5, 0, GL_RED, GL_UNSIGNED_BYTE, font);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+#if defined(HAVE_GLES3) || defined(USE_EPOXY)
+    glGenVertexArrays(1, &hud_state.vao);
+    glBindVertexArray(hud_state.vao);
+#endif
+    glGenBuffers(1, &hud_state.vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, hud_state.vbo);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(hud_rect_t),
+                          (void *)offsetof(hud_rect_t, x));
+    glVertexAttribDivisor(0, 1);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(hud_rect_t),
+                          (void *)offsetof(hud_rect_t, r));
+    glVertexAttribDivisor(1, 1);
+    glEnableVertexAttribArray(2);
+    glVertexAttribIPointer(2, 1, GL_UNSIGNED_BYTE, sizeof(hud_rect_t),
+                           (void *)offsetof(hud_rect_t, glyph));
+    glVertexAttribDivisor(2, 1);
+
+    hud_state.gl_failed = false;
+    return true;
+}
+
+void editor_hud_draw(const multipass_shader_t *shader, GLuint framebuffer,
+                     int width, int height) {
+    if (width < 1 || height < 1 || !ensure_gl()) return;
+
+    uint64_t start = shader_trace_clock();
+
+    /* Bigger font pixels on large outputs so the HUD stays readable fullscreen */
+    hud_state.scale = height >= 1200 ? 3.0f : (width < 400 ? 1.0f : 2.0f);
+
+    /* The panel is sized after its contents are known; its rectangle comes first */
+    hud_state.rect_count = 1;
+    hud_state.origin_x = HUD_MARGIN * hud_state.scale;
+    hud_state.origin_y = HUD_MARGIN * hud_state.scale;
+    hud_state.origin_x += HUD_PADDING * hud_state.scale;
+    hud_state.origin_y += HUD_PADDING * hud_state.scale;
+
+    float interior = build_hud(shader);
+
+    int count = hud_state.rect_count;
+    hud_state.rect_count = 0;
+    hud_state.origin_x -= HUD_PADDING * hud_state.scale;
+    hud_state.origin_y -= HUD_PADDING * hud_state.scale;
+    push_rect(0.0f, 0.0f, HUD_WIDTH + 2 * HUD_PADDING, interior + 2 * HUD_PADDING, HUD_PANEL);
+    hud_state.rect_count = count;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(0, 0, width, height);
+    glEnable(GL_BLEND);
+    /* Keep the destination alpha: the area may be composited with it */
+    glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ZERO, GL_ONE);
+
+    glUseProgram(hud_state.program);
+    glUniform2f(hud_state.scale_location, 2.0f / (float)width, -2.0f / (float)height);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, hud_state.font_texture);
+#if defined(HAVE_GLES3) || defined(USE_EPOXY)
+    glBindVertexArray(hud_state.vao);
+#endif
+    glBindBuffer(GL_ARRAY_BUFFER, hud_state.vbo);
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(count * sizeof(hud_rect_t)),
+                 hud_state.rects, GL_STREAM_DRAW);
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, count);
+
+#if defined(HAVE_GLES3) || defined(USE_EPOXY)
+    glBindVertexArray(0);
+#endif
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glUseProgram(0);
+    glDisable(GL_BLEND);
+
+    double ms = (double)(shader_trace_clock() - start) / 1000000.0;
+    hud_state.cost_ms = hud_state.cost_ms > 0.0 ? hud_state.cost_ms * 0.9 + ms * 0.1 : ms;
+    shader_trace_record(start, SHADER_TRACE_RENDER, "hud", NULL);
+}
+
+void editor_hud_cleanup(void) {
+    if (hud_state.vbo) {
+        glDeleteBuffers(1, &hud_state.vbo);
+        hud_state.vbo = 0;
+    }
+#if defined(HAVE_GLES3) || defined(USE_EPOXY)
+    if (hud_state.vao) {
+        glDeleteVertexArrays(1, &hud_state.vao);
+        hud_state.vao = 0;
+    }
+#endif
+    if (hud_state.font_texture) {
+        glDeleteTextures(1, &hud_state.font_texture);
+        hud_state.font_texture = 0;
+    }
+    if (hud_state.program) {
+        glDeleteProgram(hud_state.program);
+        hud_state.program = 0;
+    }
+    hud_state.gl_failed = false;
+}
@@ -0,0 +1,49 @@
+/* Performance HUD - Header
+ * Frame-time graph and per-pass GPU times drawn over the preview
+ */
+
+#ifndef EDITOR_HUD_H
+#define EDITOR_HUD_H
+
+#include "../shader_lib/shader_multipass.h"
+#include <stdbool.h>
+
+/* Frame intervals kept for the scrolling graph */
+#define EDITOR_HUD_HISTORY 120
+
+/**
+ * Record the interval since the previous presented frame
+ *
+ * @param interval_ms Time since the previous frame
+ * @param expected_ms Interval the display asked for; frames taking more
+ *                    than 1.5 times as long count as dropped
+ */
+void editor_hud_record_frame(double interval_ms, double expected_ms);
+
+/**
+ * Clear the graph and the dropped-frame counter (new shader)
+ */
+void editor_hud_reset(void);
+
+/**
+ * Draw the HUD over what has been rendered
+ * Requires the preview's GL context to be current. Everything is drawn
+ * with one draw call from a buffer rebuilt on the CPU; nothing is read
+ * back. Leaves blending disabled and no program, vertex array or texture
+ * bound.
+ *
+ * @param shader Shader whose timings are shown (may be NULL)
+ * @param framebuffer Framebuffer to draw into (the GL area's)
+ * @param width Framebuffer width
+ * @param height Framebuffer height
+ */
+void editor_hud_draw(const multipass_shader_t *shader, GLuint framebuffer,
+                     int width, int height);
+
+/**
+ * Release the HUD's GL resources
+ * Requires the preview's GL context to be current.
+ */
+void editor_hud_cleanup(void);
+
+#endif /* EDITOR_HUD_H */
@@ -4,8 +4,11 @@
  */
 
 #include "editor_preview.h"
+#include "editor_hud.h"
 #include "../shader_lib/shader_multipass.h"
+#define SHADER_LOG_SUBSYSTEM SHADER_LOG_PREVIEW
 #include "../shader_lib/shader_log.h"
+#include "../shader_lib/shader_trace.h"
 #include "platform_compat.h"
 #include <stdio.h>
 #include <stdlib.h>
@@ -20,6 +23,20 @@
 
 /* OpenGL headers included via platform_compat.h */
 
+/* Interval at which a background compile is checked for finished passes */
+#define PREVIEW_COMPILE_POLL_MS 8
+
+/* Warm shader cache: compiled instances of background tabs */
+#define PREVIEW_CACHE_MAX_ENTRIES 8
+#define PREVIEW_CACHE_DEFAULT_MB 256
+
+typedef struct {
+    int tab_id;
+    guint64 source_hash;
+    multipass_shader_t *shader;
+    gint64 last_used;                /* Monotonic time of last use (LRU) */
+} preview_cache_entry_t;
+
 /* Module state */
 static struct {
     GtkWidget *gl_area;
@@ -41,16 +58,52 @@ static struct {
     long long total_frame_count;
     double last_render_time;
     guint tick_callback_id;
+    int pending_frames;
+    int max_fps;                     /* Frame cap, 0 = every vblank */
+    gint64 next_frame_us;            /* Frame clock time the next capped frame is due */
+    bool mapped;                     /* GL area is on screen */
+    bool window_visible;             /* Toplevel not minimised */
+    bool active;                     /* Tick callback running (frames being produced) */
+    double expected_interval_ms;     /* Frame interval the cap and refresh rate ask for */
+    bool show_hud;                   /* Draw the performance HUD over the output */
+    double hud_last_time;            /* Previous continuous frame, for the HUD graph (0 = none) */
+    editor_preview_activity_callback_t activity_callback;
+    gpointer activity_callback_data;
+    GLuint cache_fbo;                /* Last frame before pausing, shown while paused */
+    GLuint cache_texture;
+    int cache_width;
+    int cache_height;
+    bool cache_valid;
     editor_preview_error_callback_t error_callback;
     gpointer error_callback_data;
     editor_preview_double_click_callback_t double_click_callback;
     gpointer double_click_callback_data;
+    editor_preview_compile_callback_t compile_callback;
+    gpointer compile_callback_data;
     char *error_message;
     bool has_error;
     
     /* Multipass rendering (handles both single and multi-pass shaders) */
     multipass_shader_t *multipass_shader;
     char *current_shader_source;
+    multipass_shader_t *pending_shader;   /* Compile in flight, replaces multipass_shader when done */
+    char *pending_source;
+    double pending_start;            /* Time the pending compile was started */
+    guint pending_poll_id;           /* Timeout collecting the pending compile */
+    char *include_dir;               /* Directory of the current tab's file, for #include */
+    multipass_reconstruct_mode_t reconstruction;
+    float frame_budget_ms;
+    size_t vram_budget;              /* Bytes the active shader may hold (0 = unlimited) */
+    bool optimize_source;            /* Run passes through the source optimizer */
+    unsigned int specialize_inputs;  /* Inputs baked into program variants */
+    guint variant_idle_id;           /* Idle building variants the render queued */
+
+    /* Warm per-tab cache */
+    int current_tab;                 /* Tab the current shader belongs to (-1 = none) */
+    guint64 current_hash;            /* Source hash of the current shader */
+    preview_cache_entry_t shader_cache[PREVIEW_CACHE_MAX_ENTRIES];
+    int shader_cache_count;
+    size_t shader_cache_budget;      /* Bytes of render targets background tabs may keep */
 } preview_state = {
     .gl_area = NULL,
     .vao = 0,
@@ -71,14 +124,47 @@ static struct {
     .total_frame_count = 0,
     .last_render_time = 0.0,
     .tick_callback_id = 0,
+    .pending_frames = 0,
+    .max_fps = 0,
+    .next_frame_us = 0,
+    .mapped = false,
+    .window_visible = true,
+    .active = false,
+    .expected_interval_ms = 0.0,
+    .show_hud = false,
+    .hud_last_time = 0.0,
+    .activity_callback = NULL,
+    .activity_callback_data = NULL,
+    .cache_fbo = 0,
+    .cache_texture = 0,
+    .cache_width = 0,
+    .cache_height = 0,
+    .cache_valid = false,
     .error_callback = NULL,
     .error_callback_data = NULL,
     .double_click_callback = NULL,
     .double_click_callback_data = NULL,
+    .compile_callback = NULL,
+    .compile_callback_data = NULL,
     .error_message = NULL,
     .has_error = false,
     .multipass_shader = NULL,
-    .current_shader_source = NULL
+    .current_shader_source = NULL,
+    .pending_shader = NULL,
+    .pending_source = NULL,
+    .pending_start = 0.0,
+    .pending_poll_id = 0,
+    .variant_idle_id = 0,
+    .include_dir = NULL,
+    .reconstruction = MULTIPASS_RECONSTRUCT_NONE,
+    .frame_budget_ms = MULTIPASS_DEFAULT_FRAME_BUDGET_MS,
+    .vram_budget = 0,
+    .optimize_source = false,
+    .specialize_inputs = 0,
+    .current_tab = -1,
+    .current_hash = 0,
+    .shader_cache_count = 0,
+    .shader_cache_budget = (size_t)PREVIEW_CACHE_DEFAULT_MB * 1024 * 1024
 };
 
 /* Helper: Get current time in seconds */
@@ -111,14 +197,101 @@ static void clear_error(void) {
     preview_state.has_error = false;
 }
 
-/* Render tick callback - invalidates the GL area to trigger continuous rendering */
+/* True if the current shader only needs rendering when one of its inputs changes */
+static bool preview_is_on_demand(void) {
+    return preview_state.multipass_shader == NULL ||
+           multipass_is_static(preview_state.multipass_shader);
+}
+
+/*
+ * Frame scheduler
+ * The tick callback only exists while frames are actually being produced:
+ * paused, hidden or idle static previews have no tick callback at all, so
+ * the frame clock (and the process) can sleep.
+ */
+static gboolean render_tick_callback(GtkWidget *widget, GdkFrameClock *frame_clock, gpointer user_data);
+
+static bool preview_needs_ticks(void) {
+    if (!preview_state.gl_area || !preview_state.gl_initialized) return false;
+    if (preview_state.paused || !preview_state.mapped || !preview_state.window_visible) return false;
+    return !preview_is_on_demand() || preview_state.pending_frames > 0;
+}
+
+static void set_active(bool active) {
+    if (preview_state.active == active) return;
+    preview_state.active = active;
+    /* The gap until frames resume is not a dropped frame */
+    preview_state.hud_last_time = 0.0;
+    if (preview_state.activity_callback) {
+        preview_state.activity_callback(active, preview_state.activity_callback_data);
+    }
+}
+
+static void update_scheduler(void) {
+    bool want = preview_needs_ticks();
+
+    if (want && preview_state.tick_callback_id == 0) {
+        preview_state.next_frame_us = 0;
+        preview_state.tick_callback_id = gtk_widget_add_tick_callback(
+            preview_state.gl_area, render_tick_callback, NULL, NULL);
+    } else if (!want && preview_state.tick_callback_id > 0) {
+        gtk_widget_remove_tick_callback(preview_state.gl_area, preview_state.tick_callback_id);
+        preview_state.tick_callback_id = 0;
+    }
+    set_active(want);
+}
+
+/* An input of the shader changed - render until the image has settled */
+static void request_frames(void) {
+    int frames = preview_state.multipass_shader ?
+                 multipass_get_settle_frames(preview_state.multipass_shader) : 1;
+    if (preview_state.pending_frames < frames) {
+        preview_state.pending_frames = frames;
+    }
+    if (preview_state.gl_area) {
+        gtk_gl_area_queue_render(GTK_GL_AREA(preview_state.gl_area));
+    }
+    update_scheduler();
+}
+
+/* Render tick callback - invalidates the GL area when a new frame is due.
+ * Static shaders are left alone; GtkGLArea keeps presenting the last frame. */
 static gboolean render_tick_callback(GtkWidget *widget, GdkFrameClock *frame_clock, gpointer user_data) {
-    (void)frame_clock;
     (void)user_data;
 
-    /* Skip rendering if paused */
-    if (preview_state.paused) {
-        return G_SOURCE_CONTINUE;
+    /* Nothing left to draw - drop the callback so the frame clock can stop */
+    if (!preview_needs_ticks()) {
+        preview_state.tick_callback_id = 0;
+        set_active(false);
+        return G_SOURCE_REMOVE;
+    }
+
+    /* Interval frames are paced at: the cap, or the refresh rate. The HUD
+     * measures frames against it and adaptive resolution discounts it. */
+    gint64 refresh_us = 0;
+    gdk_frame_clock_get_refresh_info(frame_clock, gdk_frame_clock_get_frame_time(frame_clock),
+                                     &refresh_us, NULL);
+    double expected_ms = refresh_us > 0 ? refresh_us / 1000.0 : 1000.0 / 60.0;
+    if (preview_state.max_fps > 0 && 1000.0 / preview_state.max_fps > expected_ms) {
+        expected_ms = 1000.0 / preview_state.max_fps;
+    }
+    preview_state.expected_interval_ms = expected_ms;
+
+    /* Frame cap: skip vblanks until the next frame is due. A quarter
+     * interval of slack absorbs frame clock jitter at matching rates. */
+    if (preview_state.max_fps > 0) {
+        gint64 now = gdk_frame_clock_get_frame_time(frame_clock);
+        gint64 interval = G_USEC_PER_SEC / preview_state.max_fps;
+        gint64 slack = interval / 4;
+
+        if (now + slack < preview_state.next_frame_us) {
+            return G_SOURCE_CONTINUE;
+        }
+        preview_state.next_frame_us += interval;
+        if (preview_state.next_frame_us + slack < now) {
+            /* Fell behind (first frame, stall) - restart the cadence */
+            preview_state.next_frame_us = now + interval;
+        }
     }
 
     /* Invalidate the GL area to trigger a render on this frame */
@@ -127,7 +300,153 @@ static gboolean render_tick_callback(GtkWidget *widget, GdkFrameClock *frame_clo
     return G_SOURCE_CONTINUE;
 }
 
+/* Copy what the GL area currently shows into the paused-frame cache.
+ * Requires the area's context to be current. */
+static void cache_last_frame(GtkGLArea *area) {
+    int width = gtk_widget_get_allocated_width(GTK_WIDGET(area));
+    int height = gtk_widget_get_allocated_height(GTK_WIDGET(area));
+    if (width < 1 || height < 1) return;
+
+    if (!preview_state.cache_fbo) {
+        glGenFramebuffers(1, &preview_state.cache_fbo);
+        glGenTextures(1, &preview_state.cache_texture);
+    }
+    if (preview_state.cache_width != width || preview_state.cache_height != height) {
+        glBindTexture(GL_TEXTURE_2D, preview_state.cache_texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glBindFramebuffer(GL_FRAMEBUFFER, preview_state.cache_fbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                               GL_TEXTURE_2D, preview_state.cache_texture, 0);
+        preview_state.cache_width = width;
+        preview_state.cache_height = height;
+    }
+
+    /* attach_buffers binds the area's own framebuffer */
+    gtk_gl_area_attach_buffers(area);
+    GLint area_fbo = 0;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &area_fbo);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, (GLuint)area_fbo);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, preview_state.cache_fbo);
+    glBlitFramebuffer(0, 0, width, height, 0, 0, width, height,
+                      GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, (GLuint)area_fbo);
+
+    preview_state.cache_valid = true;
+}
+
+static void release_frame_cache(void) {
+    if (preview_state.cache_fbo) {
+        glDeleteFramebuffers(1, &preview_state.cache_fbo);
+        preview_state.cache_fbo = 0;
+    }
+    if (preview_state.cache_texture) {
+        glDeleteTextures(1, &preview_state.cache_texture);
+        preview_state.cache_texture = 0;
+    }
+    preview_state.cache_width = 0;
+    preview_state.cache_height = 0;
+    preview_state.cache_valid = false;
+}
+
+/* 64-bit FNV-1a over the shader source (cache key together with the tab id) */
+static guint64 source_hash(const char *code) {
+    guint64 hash = 14695981039346656037ULL;
+    for (const unsigned char *p = (const unsigned char *)code; *p; p++) {
+        hash ^= *p;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static void shader_cache_remove_at(int index, bool destroy) {
+    if (destroy) {
+        multipass_destroy(preview_state.shader_cache[index].shader);
+    }
+    preview_state.shader_cache_count--;
+    preview_state.shader_cache[index] = preview_state.shader_cache[preview_state.shader_cache_count];
+}
+
+static int shader_cache_find(int tab_id) {
+    for (int i = 0; i < preview_state.shader_cache_count; i++) {
+        if (preview_state.shader_cache[i].tab_id == tab_id) return i;
+    }
+    return -1;
+}
+
+static int shader_cache_lru(bool with_targets_only) {
+    int lru = -1;
+    for (int i = 0; i < preview_state.shader_cache_count; i++) {
+        const preview_cache_entry_t *e = &preview_state.shader_cache[i];
+        if (with_targets_only && multipass_estimate_vram(e->shader) == 0) continue;
+        if (lru < 0 || e->last_used < preview_state.shader_cache[lru].last_used) {
+            lru = i;
+        }
+    }
+    return lru;
+}
+
+/*
+ * Keep background tabs within the VRAM budget: release render targets of
+ * the least recently used instances first (programs stay compiled, so the
+ * tab still comes back without a recompile). Requires a current context.
+ */
+static void shader_cache_enforce_budget(void) {
+    for (;;) {
+        size_t total = 0;
+        for (int i = 0; i < preview_state.shader_cache_count; i++) {
+            total += multipass_estimate_vram(preview_state.shader_cache[i].shader);
+        }
+        if (total <= preview_state.shader_cache_budget) break;
+
+        int lru = shader_cache_lru(true);
+        if (lru < 0) break;
+        log_info("Tab cache over budget (%zu KB), releasing targets of tab %d",
+                 total / 1024, preview_state.shader_cache[lru].tab_id);
+        multipass_release_render_targets(preview_state.shader_cache[lru].shader);
+    }
+}
+
+/* Drop every cached instance (GL context must be current) */
+static void shader_cache_clear(void) {
+    while (preview_state.shader_cache_count > 0) {
+        shader_cache_remove_at(preview_state.shader_cache_count - 1, true);
+    }
+}
 
+/* Move the current shader into the cache, or destroy it if it can't be kept */
+static void shader_cache_park_current(void) {
+    multipass_shader_t *shader = preview_state.multipass_shader;
+    if (!shader) return;
+
+    preview_state.multipass_shader = NULL;
+    preview_state.shader_valid = false;
+
+    if (preview_state.current_tab < 0 || preview_state.shader_cache_budget == 0 ||
+        !multipass_is_ready(shader)) {
+        multipass_destroy(shader);
+        return;
+    }
+
+    /* One instance per tab - an older version is stale */
+    int old = shader_cache_find(preview_state.current_tab);
+    if (old >= 0) {
+        shader_cache_remove_at(old, true);
+    }
+    if (preview_state.shader_cache_count == PREVIEW_CACHE_MAX_ENTRIES) {
+        shader_cache_remove_at(shader_cache_lru(false), true);
+    }
+
+    preview_cache_entry_t *e = &preview_state.shader_cache[preview_state.shader_cache_count++];
+    e->tab_id = preview_state.current_tab;
+    e->source_hash = preview_state.current_hash;
+    e->shader = shader;
+    e->last_used = g_get_monotonic_time();
+
+    shader_cache_enforce_budget();
+}
 
 /* OpenGL realize callback - called when GL context is created */
 static void on_gl_realize(GtkGLArea *area, gpointer user_data) {
@@ -194,31 +513,67 @@ static void on_gl_realize(GtkGLArea *area, gpointer user_data) {
         preview_state.frame_count = 0;
     }
 
-    /* Add tick callback for continuous rendering now that widget is realized */
-    if (preview_state.tick_callback_id == 0) {
-        preview_state.tick_callback_id = gtk_widget_add_tick_callback(
-            GTK_WIDGET(area),
-            render_tick_callback,
-            NULL,
-            NULL
-        );
-    }
-
     clear_error();
+
+    /* Start producing frames now that the widget is realized */
+    request_frames();
 }
 
 /* OpenGL render callback - called every frame */
+/* Build the specialized variants rendering queued, one per idle call */
+static gboolean build_queued_variants(gpointer user_data) {
+    (void)user_data;
+
+    GtkGLArea *area = GTK_GL_AREA(preview_state.gl_area);
+    if (!preview_state.multipass_shader || !gtk_widget_get_realized(preview_state.gl_area)) {
+        preview_state.variant_idle_id = 0;
+        return G_SOURCE_REMOVE;
+    }
+    gtk_gl_area_make_current(area);
+    if (gtk_gl_area_get_error(area) != NULL) {
+        preview_state.variant_idle_id = 0;
+        return G_SOURCE_REMOVE;
+    }
+
+    uint64_t span = shader_trace_begin();
+    bool more = multipass_build_variants(preview_state.multipass_shader);
+    shader_trace_end(span, SHADER_TRACE_COMPILE, "specialize", NULL);
+
+    /* Settling sizes need frames too, and a new variant should show */
+    request_frames();
+    if (more) return G_SOURCE_CONTINUE;
+    preview_state.variant_idle_id = 0;
+    return G_SOURCE_REMOVE;
+}
+
 static gboolean on_gl_render(GtkGLArea *area, GdkGLContext *context, gpointer user_data) {
     (void)context;
     (void)user_data;
 
-    /* If paused, don't update FPS or render */
+    /* If paused, don't update FPS or render - present the cached frame instead */
     if (preview_state.paused) {
-        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT);
+        if (preview_state.cache_valid) {
+            int width = gtk_widget_get_allocated_width(GTK_WIDGET(area));
+            int height = gtk_widget_get_allocated_height(GTK_WIDGET(area));
+            GLint area_fbo = 0;
+            glGetIntegerv(GL_FRAMEBUFFER_BINDING, &area_fbo);
+
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, preview_state.cache_fbo);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, (GLuint)area_fbo);
+            glBlitFramebuffer(0, 0, preview_state.cache_width, preview_state.cache_height,
+                              0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+            glBindFramebuffer(GL_FRAMEBUFFER, (GLuint)area_fbo);
+        } else {
+            glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT);
+        }
         return TRUE;
     }
 
+    if (preview_state.pending_frames > 0) {
+        preview_state.pending_frames--;
+    }
+
     /* Update FPS counter (do this first, even if no shader) */
     preview_state.frame_count++;
     preview_state.total_frame_count++;
@@ -257,8 +612,18 @@ static gboolean on_gl_render(GtkGLArea *area, GdkGLContext *context, gpointer us
             return TRUE;
         }
         
+        uint64_t span = shader_trace_begin();
+
+        /* The area's framebuffer, which the HUD draws into after the passes */
+        GLint area_fbo = 0;
+        if (preview_state.show_hud) {
+            glGetIntegerv(GL_FRAMEBUFFER_BINDING, &area_fbo);
+        }
+
         /* Resize if needed */
         multipass_resize(preview_state.multipass_shader, width, height);
+        multipass_set_frame_interval(preview_state.multipass_shader,
+                                     (float)preview_state.expected_interval_ms);
         
         /* Render all passes */
         float mouse_px = preview_state.mouse_x * width;
@@ -268,7 +633,26 @@ static gboolean on_gl_render(GtkGLArea *area, GdkGLContext *context, gpointer us
                         (float)current_time,
                         mouse_px, mouse_py,
                         preview_state.mouse_click);
+
+        /* Variants the driver can't build in the background are built
+         * between frames instead */
+        if (preview_state.specialize_inputs && !preview_state.variant_idle_id &&
+            multipass_specialization_pending(preview_state.multipass_shader)) {
+            preview_state.variant_idle_id = g_idle_add(build_queued_variants, NULL);
+        }
+
+        if (preview_state.show_hud) {
+            /* Only frames of a running animation are plotted; on-demand
+             * redraws have no cadence to drop from */
+            if (preview_state.hud_last_time > 0.0 && !preview_is_on_demand()) {
+                editor_hud_record_frame((current - preview_state.hud_last_time) * 1000.0,
+                                        preview_state.expected_interval_ms);
+            }
+            preview_state.hud_last_time = preview_is_on_demand() ? 0.0 : current;
+            editor_hud_draw(preview_state.multipass_shader, (GLuint)area_fbo, width, height);
+        }
         
+        shader_trace_end(span, SHADER_TRACE_RENDER, "preview render", NULL);
         return TRUE;
     }
 
@@ -293,13 +677,16 @@ static void on_gl_unrealize(GtkGLArea *area, gpointer user_data) {
         return;
     }
 
-    /* Remove tick callback */
-    if (preview_state.tick_callback_id > 0) {
-        gtk_widget_remove_tick_callback(GTK_WIDGET(area), preview_state.tick_callback_id);
-        preview_state.tick_callback_id = 0;
+    /* Free OpenGL resources */
+    editor_preview_cancel_compile();
+    if (preview_state.variant_idle_id) {
+        g_source_remove(preview_state.variant_idle_id);
+        preview_state.variant_idle_id = 0;
     }
+    release_frame_cache();
+    editor_hud_cleanup();
+    shader_cache_clear();
 
-    /* Free OpenGL resources */
     /* Cleanup error message */
     if (preview_state.error_message) {
         g_free(preview_state.error_message);
@@ -326,6 +713,9 @@ static void on_gl_unrealize(GtkGLArea *area, gpointer user_data) {
 
     preview_state.gl_initialized = false;
     preview_state.shader_valid = false;
+
+    /* Remove tick callback */
+    update_scheduler();
 }
 
 /* Mouse motion callback */
@@ -340,9 +730,41 @@ static gboolean on_preview_motion(GtkWidget *widget, GdkEventMotion *event, gpoi
         preview_state.mouse_y = 1.0f - ((float)event->y / height); /* Flip Y for OpenGL */
     }
 
+    if (preview_state.multipass_shader &&
+        (multipass_get_input_mask(preview_state.multipass_shader) & MULTIPASS_INPUT_MOUSE)) {
+        request_frames();
+    }
+
     return FALSE;
 }
 
+/* Map/unmap callbacks - hidden previews (editor-only view, other stack page) don't tick */
+static void on_gl_map(GtkWidget *widget, gpointer user_data) {
+    (void)widget;
+    (void)user_data;
+
+    preview_state.mapped = true;
+    request_frames();
+}
+
+static void on_gl_unmap(GtkWidget *widget, gpointer user_data) {
+    (void)widget;
+    (void)user_data;
+
+    preview_state.mapped = false;
+    update_scheduler();
+}
+
+/* GL area resize callback - GtkGLArea re-renders once by itself, reconstruction may need more */
+static void on_gl_resize(GtkGLArea *area, gint width, gint height, gpointer user_data) {
+    (void)area;
+    (void)width;
+    (void)height;
+    (void)user_data;
+
+    request_frames();
+}
+
 /* Button press callback for double-click detection */
 static gboolean on_preview_button_press(GtkWidget *widget, GdkEventButton *event, gpointer user_data) {
     (void)widget;
@@ -388,6 +810,12 @@ GtkWidget *editor_preview_create(void) {
                      G_CALLBACK(on_gl_render), NULL);
     g_signal_connect(preview_state.gl_area, "unrealize",
                      G_CALLBACK(on_gl_unrealize), NULL);
+    g_signal_connect(preview_state.gl_area, "resize",
+                     G_CALLBACK(on_gl_resize), NULL);
+    g_signal_connect(preview_state.gl_area, "map",
+                     G_CALLBACK(on_gl_map), NULL);
+    g_signal_connect(preview_state.gl_area, "unmap",
+                     G_CALLBACK(on_gl_unmap), NULL);
 
     /* Connect mouse motion for shader mouse input */
     gtk_widget_add_events(preview_state.gl_area, GDK_POINTER_MOTION_MASK | GDK_BUTTON_PRESS_MASK);
@@ -410,12 +838,8 @@ GtkWidget *editor_preview_create(void) {
     return preview_state.gl_area;
 }
 
-bool editor_preview_compile_shader(const char *shader_code) {
-    if (!shader_code) {
-        set_error("No shader code provided");
-        return false;
-    }
-
+/* Make the GL context current for a compile (sets the error if it can't be) */
+static bool compile_context_current(void) {
     /* Check if GL context is initialized */
     if (!preview_state.gl_area) {
         set_error("GL area not created");
@@ -439,31 +863,34 @@ bool editor_preview_compile_shader(const char *shader_code) {
         g_free(full_error);
         return false;
     }
+    return true;
+}
 
-    /* Store shader source for potential recompilation */
-    if (preview_state.current_shader_source) {
-        free(preview_state.current_shader_source);
-    }
-    preview_state.current_shader_source = strdup(shader_code);
-
-    /* Clean up old multipass shader if exists */
+/* Destroy the shader being shown */
+static void release_current_shader(void) {
     if (preview_state.multipass_shader) {
         multipass_destroy(preview_state.multipass_shader);
         preview_state.multipass_shader = NULL;
     }
     preview_state.shader_valid = false;
+    request_frames();
+}
 
+/* Parse a source and set up its GL resources with the preview's options */
+static multipass_shader_t *create_shader(const char *shader_code) {
     /* All shaders go through multipass system (single-pass = Image-only multipass) */
     int main_count = multipass_count_main_functions(shader_code);
     log_info("Compiling shader with %d mainImage function(s)", main_count);
     
     /* Create multipass shader */
-    preview_state.multipass_shader = multipass_create(shader_code);
+    multipass_shader_t *shader = multipass_create(shader_code);
     
-    if (!preview_state.multipass_shader) {
+    if (!shader) {
         set_error("Failed to parse shader");
-        return false;
+        return NULL;
     }
+    multipass_set_include_context(shader, preview_state.include_dir, preview_state.current_tab);
+    multipass_set_source_optimization(shader, preview_state.optimize_source);
     
     int width = gtk_widget_get_allocated_width(preview_state.gl_area);
     int height = gtk_widget_get_allocated_height(preview_state.gl_area);
@@ -473,17 +900,30 @@ bool editor_preview_compile_shader(const char *shader_code) {
     if (height < 16) height = 600;
     
     /* Initialize GL resources */
-    if (!multipass_init_gl(preview_state.multipass_shader, width, height)) {
+    if (!multipass_init_gl(shader, width, height)) {
         set_error("Failed to initialize GL resources");
-        multipass_destroy(preview_state.multipass_shader);
-        preview_state.multipass_shader = NULL;
-        return false;
+        multipass_destroy(shader);
+        return NULL;
     }
     
-    /* Compile all passes */
-    if (!multipass_compile_all(preview_state.multipass_shader)) {
+    multipass_set_reconstruction(shader, preview_state.reconstruction);
+    multipass_set_specialization(shader, preview_state.specialize_inputs);
+    multipass_set_adaptive_resolution(shader, true, preview_state.frame_budget_ms, 0.25f, 1.0f);
+    multipass_set_vram_budget(shader, preview_state.vram_budget);
+    return shader;
+}
+
+/* Show a shader whose compile finished, or its errors */
+static bool adopt_shader(multipass_shader_t *shader, const char *shader_code, bool compiled) {
+    release_current_shader();
+
+    /* Store shader source for potential recompilation */
+    free(preview_state.current_shader_source);
+    preview_state.current_shader_source = strdup(shader_code);
+
+    if (!compiled) {
         /* Compilation failed - get errors */
-        char *errors = multipass_get_all_errors(preview_state.multipass_shader);
+        char *errors = multipass_get_all_errors(shader);
         GString *detailed_error = g_string_new("=== SHADER COMPILATION FAILED ===\n\n");
         
         if (errors) {
@@ -496,24 +936,137 @@ bool editor_preview_compile_shader(const char *shader_code) {
         set_error(detailed_error->str);
         g_string_free(detailed_error, TRUE);
         
-        multipass_destroy(preview_state.multipass_shader);
-        preview_state.multipass_shader = NULL;
+        multipass_destroy(shader);
         return false;
     }
     
     /* Success */
+    preview_state.multipass_shader = shader;
     preview_state.shader_valid = true;
+    preview_state.current_hash = source_hash(shader_code);
+    editor_hud_reset();
+    preview_state.hud_last_time = 0.0;
     clear_error();
+    request_frames();
     
-    log_info("Successfully compiled shader with %d pass(es)",
-             preview_state.multipass_shader->pass_count);
+    log_info("Successfully compiled shader with %d pass(es)", shader->pass_count);
     
     /* Debug dump */
-    multipass_debug_dump(preview_state.multipass_shader);
+    multipass_debug_dump(shader);
     
     return true;
 }
 
+bool editor_preview_compile_shader(const char *shader_code) {
+    editor_preview_cancel_compile();
+
+    if (!shader_code) {
+        set_error("No shader code provided");
+        return false;
+    }
+    if (!compile_context_current()) {
+        return false;
+    }
+
+    /* The old shader's resources are freed before the new one allocates its own */
+    release_current_shader();
+
+    multipass_shader_t *shader = create_shader(shader_code);
+    if (!shader) {
+        return false;
+    }
+    
+    /* Compile all passes */
+    bool compiled = multipass_compile_all(shader);
+    return adopt_shader(shader, shader_code, compiled);
+}
+
+/* Collect the passes of the pending compile that have finished */
+static gboolean poll_pending_compile(gpointer user_data) {
+    (void)user_data;
+
+    GtkGLArea *area = GTK_GL_AREA(preview_state.gl_area);
+    gtk_gl_area_make_current(area);
+    if (gtk_gl_area_get_error(area) != NULL) {
+        preview_state.pending_poll_id = 0;
+        editor_preview_cancel_compile();
+        return G_SOURCE_REMOVE;
+    }
+
+    uint64_t span = shader_trace_begin();
+    multipass_compile_status_t status = multipass_compile_poll(preview_state.pending_shader, false);
+    shader_trace_end(span, SHADER_TRACE_COMPILE, "poll", NULL);
+    if (status == MULTIPASS_COMPILE_PENDING) {
+        return G_SOURCE_CONTINUE;
+    }
+
+    multipass_shader_t *shader = preview_state.pending_shader;
+    char *source = preview_state.pending_source;
+    double compile_ms = (get_time() - preview_state.pending_start) * 1000.0;
+    preview_state.pending_shader = NULL;
+    preview_state.pending_source = NULL;
+    preview_state.pending_poll_id = 0;
+
+    bool compiled = adopt_shader(shader, source, status == MULTIPASS_COMPILE_SUCCEEDED);
+    free(source);
+    log_debug("Background compile finished in %.1f ms", compile_ms);
+
+    if (preview_state.compile_callback) {
+        preview_state.compile_callback(compiled, compile_ms, preview_state.compile_callback_data);
+    }
+    return G_SOURCE_REMOVE;
+}
+
+bool editor_preview_compile_shader_async(const char *shader_code) {
+    editor_preview_cancel_compile();
+
+    if (!shader_code) {
+        set_error("No shader code provided");
+        return false;
+    }
+    if (!compile_context_current()) {
+        return false;
+    }
+
+    double start = get_time();
+    multipass_shader_t *shader = create_shader(shader_code);
+    if (!shader) {
+        /* Same outcome as a failed compile */
+        release_current_shader();
+        return false;
+    }
+
+    /* The current shader keeps rendering until the new one is ready */
+    multipass_compile_begin(shader);
+    preview_state.pending_shader = shader;
+    preview_state.pending_source = strdup(shader_code);
+    preview_state.pending_start = start;
+    preview_state.pending_poll_id = g_timeout_add(PREVIEW_COMPILE_POLL_MS, poll_pending_compile, NULL);
+    return true;
+}
+
+void editor_preview_cancel_compile(void) {
+    if (preview_state.pending_poll_id) {
+        g_source_remove(preview_state.pending_poll_id);
+        preview_state.pending_poll_id = 0;
+    }
+    if (preview_state.pending_shader) {
+        /* Its GL objects belong to the preview's context */
+        if (preview_state.gl_area && gtk_widget_get_realized(preview_state.gl_area)) {
+            gtk_gl_area_make_current(GTK_GL_AREA(preview_state.gl_area));
+        }
+        multipass_destroy(preview_state.pending_shader);
+        preview_state.pending_shader = NULL;
+        log_debug("Cancelled the compile in flight");
+    }
+    free(preview_state.pending_source);
+    preview_state.pending_source = NULL;
+}
+
+bool editor_preview_compile_pending(void) {
+    return preview_state.pending_shader != NULL;
+}
+
 const char *editor_preview_get_error(void) {
     return preview_state.has_error ? preview_state.error_message : NULL;
 }
@@ -530,14 +1083,25 @@ void editor_preview_set_paused(bool paused) {
         preview_state.pause_time = (get_time() - preview_state.start_time) * preview_state.time_speed;
         preview_state.current_fps = 0.0;
         preview_state.frame_count = 0;
+
+        /* Keep the last frame so redraws while paused don't blank the preview */
+        if (preview_state.gl_initialized && preview_state.multipass_shader &&
+            gtk_widget_get_realized(preview_state.gl_area)) {
+            gtk_gl_area_make_current(GTK_GL_AREA(preview_state.gl_area));
+            if (gtk_gl_area_get_error(GTK_GL_AREA(preview_state.gl_area)) == NULL) {
+                cache_last_frame(GTK_GL_AREA(preview_state.gl_area));
+            }
+        }
     } else if (!paused && preview_state.paused) {
         /* Resuming - adjust start time and reset FPS tracking */
         preview_state.start_time = get_time() - (preview_state.pause_time / preview_state.time_speed);
         preview_state.last_fps_time = get_time();
         preview_state.frame_count = 0;
+        preview_state.cache_valid = false;
     }
 
     preview_state.paused = paused;
+    request_frames();
 }
 
 bool editor_preview_is_paused(void) {
@@ -563,6 +1127,7 @@ void editor_preview_reset_time(void) {
     if (preview_state.multipass_shader) {
         multipass_reset(preview_state.multipass_shader);
     }
+    request_frames();
 }
 
 double editor_preview_get_fps(void) {
@@ -581,6 +1146,7 @@ void editor_preview_set_resolution_scale(float scale) {
         /* Disable adaptive when manually setting scale */
         multipass_set_adaptive_resolution(preview_state.multipass_shader, false, 0, 0, 0);
         multipass_set_resolution_scale(preview_state.multipass_shader, scale);
+        request_frames();
     }
 }
 
@@ -588,12 +1154,260 @@ void editor_preview_set_adaptive_resolution(bool enabled) {
     if (preview_state.multipass_shader) {
         multipass_set_adaptive_resolution(preview_state.multipass_shader, 
                                           enabled, 
-                                          55.0f,   /* target FPS */
+                                          preview_state.frame_budget_ms,
                                           0.25f,   /* min scale */
                                           1.0f);   /* max scale */
     }
 }
 
+void editor_preview_set_reconstruction(int mode) {
+    if (mode < MULTIPASS_RECONSTRUCT_NONE || mode > MULTIPASS_RECONSTRUCT_SPATIAL) {
+        mode = MULTIPASS_RECONSTRUCT_NONE;
+    }
+    preview_state.reconstruction = (multipass_reconstruct_mode_t)mode;
+
+    if (preview_state.multipass_shader && gtk_widget_get_realized(preview_state.gl_area)) {
+        /* Switching modes frees the previous mode's targets */
+        gtk_gl_area_make_current(GTK_GL_AREA(preview_state.gl_area));
+        multipass_set_reconstruction(preview_state.multipass_shader, preview_state.reconstruction);
+        request_frames();
+    }
+}
+
+void editor_preview_set_source_optimization(bool enabled) {
+    preview_state.optimize_source = enabled;
+
+    /* Passes recompiled later (include changes) follow the new setting */
+    if (preview_state.multipass_shader) {
+        multipass_set_source_optimization(preview_state.multipass_shader, enabled);
+    }
+}
+
+void editor_preview_set_specialize_resolution(bool enabled) {
+    preview_state.specialize_inputs = enabled ? MULTIPASS_INPUT_RESOLUTION : 0;
+
+    if (preview_state.multipass_shader) {
+        multipass_set_specialization(preview_state.multipass_shader, preview_state.specialize_inputs);
+        request_frames();
+    }
+}
+
+void editor_preview_set_hud(bool enabled) {
+    if (preview_state.show_hud == enabled) return;
+    preview_state.show_hud = enabled;
+    preview_state.hud_last_time = 0.0;
+    editor_hud_reset();
+
+    /* Redraw so the HUD appears or goes away on static previews too */
+    if (preview_state.gl_area) {
+        gtk_gl_area_queue_render(GTK_GL_AREA(preview_state.gl_area));
+    }
+}
+
+void editor_preview_set_frame_budget(float budget_ms) {
+    if (budget_ms <= 0.0f) {
+        budget_ms = MULTIPASS_DEFAULT_FRAME_BUDGET_MS;
+    }
+    preview_state.frame_budget_ms = budget_ms;
+
+    if (preview_state.multipass_shader) {
+        multipass_set_adaptive_resolution(preview_state.multipass_shader,
+                                          multipass_is_adaptive_resolution(preview_state.multipass_shader),
+                                          budget_ms, 0.25f, 1.0f);
+    }
+}
+
+void editor_preview_set_vram_budget_mb(int budget_mb) {
+    preview_state.vram_budget = (budget_mb > 0) ? (size_t)budget_mb * 1024 * 1024 : 0;
+
+    if (preview_state.multipass_shader) {
+        multipass_set_vram_budget(preview_state.multipass_shader, preview_state.vram_budget);
+        request_frames();
+    }
+}
+
+float editor_preview_get_gpu_time_ms(void) {
+    if (preview_state.multipass_shader) {
+        return multipass_get_gpu_time_ms(preview_state.multipass_shader);
+    }
+    return 0.0f;
+}
+
+int editor_preview_get_wallpaper_suitability(float *frame_ms) {
+    const multipass_cost_estimate_t *estimate = multipass_get_cost_estimate(preview_state.multipass_shader);
+    if (!estimate->valid) return -1;
+    if (frame_ms) *frame_ms = estimate->frame_ms_1080p;
+    return estimate->suitability;
+}
+
+bool editor_preview_switch_tab(int tab_id, const char *shader_code) {
+    guint64 hash = shader_code ? source_hash(shader_code) : 0;
+
+    /* Already showing this tab's current source */
+    if (tab_id == preview_state.current_tab && preview_state.multipass_shader &&
+        preview_state.shader_valid && hash == preview_state.current_hash) {
+        return true;
+    }
+
+    if (!preview_state.gl_area || !gtk_widget_get_realized(preview_state.gl_area)) {
+        preview_state.current_tab = tab_id;
+        return false;
+    }
+    gtk_gl_area_make_current(GTK_GL_AREA(preview_state.gl_area));
+    if (gtk_gl_area_get_error(GTK_GL_AREA(preview_state.gl_area)) != NULL) {
+        preview_state.current_tab = tab_id;
+        return false;
+    }
+
+    /* A compile started for the tab being left would replace the wrong shader */
+    editor_preview_cancel_compile();
+    shader_cache_park_current();
+    preview_state.current_tab = tab_id;
+
+    int index = shader_cache_find(tab_id);
+    if (index < 0) {
+        return false;
+    }
+
+    preview_cache_entry_t entry = preview_state.shader_cache[index];
+    if (!shader_code || entry.source_hash != hash) {
+        /* Source changed since the tab was last shown */
+        shader_cache_remove_at(index, true);
+        return false;
+    }
+    shader_cache_remove_at(index, false);
+
+    /* Passes built from an included file that changed in the background */
+    if (multipass_refresh_includes(entry.shader) > 0 && multipass_has_errors(entry.shader)) {
+        multipass_destroy(entry.shader);
+        return false;
+    }
+
+    preview_state.multipass_shader = entry.shader;
+    preview_state.shader_valid = true;
+    preview_state.current_hash = hash;
+    free(preview_state.current_shader_source);
+    preview_state.current_shader_source = strdup(shader_code);
+
+    /* Preview options may have changed while the tab was in the background */
+    multipass_set_reconstruction(entry.shader, preview_state.reconstruction);
+    multipass_set_specialization(entry.shader, preview_state.specialize_inputs);
+    multipass_set_adaptive_resolution(entry.shader, multipass_is_adaptive_resolution(entry.shader),
+                                      preview_state.frame_budget_ms, 0.25f, 1.0f);
+    multipass_set_vram_budget(entry.shader, preview_state.vram_budget);
+
+    editor_hud_reset();
+    preview_state.hud_last_time = 0.0;
+    clear_error();
+    request_frames();
+    log_info("Restored shader of tab %d from cache", tab_id);
+    return true;
+}
+
+void editor_preview_set_include_dir(const char *dir) {
+    free(preview_state.include_dir);
+    preview_state.include_dir = dir ? strdup(dir) : NULL;
+}
+
+int editor_preview_refresh_includes(void) {
+    multipass_shader_t *shader = preview_state.multipass_shader;
+    if (!shader || !preview_state.gl_area || !gtk_widget_get_realized(preview_state.gl_area)) {
+        return 0;
+    }
+    gtk_gl_area_make_current(GTK_GL_AREA(preview_state.gl_area));
+    if (gtk_gl_area_get_error(GTK_GL_AREA(preview_state.gl_area)) != NULL) {
+        return 0;
+    }
+
+    int recompiled = multipass_refresh_includes(shader);
+    if (recompiled == 0) {
+        return 0;
+    }
+
+    if (multipass_has_errors(shader)) {
+        /* Same outcome as a failed compile of the tab's own source */
+        char *errors = multipass_get_all_errors(shader);
+        GString *detailed_error = g_string_new("=== SHADER COMPILATION FAILED ===\n\n");
+        g_string_append(detailed_error, errors ? errors : "Unknown compilation error\n");
+        free(errors);
+        set_error(detailed_error->str);
+        g_string_free(detailed_error, TRUE);
+
+        multipass_destroy(shader);
+        preview_state.multipass_shader = NULL;
+        preview_state.shader_valid = false;
+        return -1;
+    }
+
+    clear_error();
+    request_frames();
+    return recompiled;
+}
+
+void editor_preview_forget_tab(int tab_id) {
+    if (preview_state.current_tab == tab_id) {
+        /* Current shader is destroyed instead of parked on the next switch */
+        preview_state.current_tab = -1;
+    }
+
+    int index = shader_cache_find(tab_id);
+    if (index < 0 || !preview_state.gl_area || !gtk_widget_get_realized(preview_state.gl_area)) {
+        return;
+    }
+    gtk_gl_area_make_current(GTK_GL_AREA(preview_state.gl_area));
+    if (gtk_gl_area_get_error(GTK_GL_AREA(preview_state.gl_area)) == NULL) {
+        shader_cache_remove_at(index, true);
+    }
+}
+
+void editor_preview_set_cache_budget_mb(int megabytes) {
+    preview_state.shader_cache_budget = (megabytes > 0) ? (size_t)megabytes * 1024 * 1024 : 0;
+
+    if (!preview_state.gl_area || !gtk_widget_get_realized(preview_state.gl_area)) {
+        return;
+    }
+    gtk_gl_area_make_current(GTK_GL_AREA(preview_state.gl_area));
+    if (gtk_gl_area_get_error(GTK_GL_AREA(preview_state.gl_area)) != NULL) {
+        return;
+    }
+
+    if (preview_state.shader_cache_budget == 0) {
+        shader_cache_clear();
+    } else {
+        shader_cache_enforce_budget();
+    }
+}
+
+void editor_preview_set_max_fps(int fps) {
+    preview_state.max_fps = (fps > 0) ? fps : 0;
+    preview_state.next_frame_us = 0;
+}
+
+void editor_preview_set_window_visible(bool visible) {
+    if (preview_state.window_visible == visible) return;
+    preview_state.window_visible = visible;
+
+    if (visible) {
+        request_frames();
+    } else {
+        update_scheduler();
+    }
+}
+
+bool editor_preview_is_active(void) {
+    return preview_state.active;
+}
+
+void editor_preview_set_activity_callback(editor_preview_activity_callback_t callback,
+                                          gpointer user_data) {
+    preview_state.activity_callback = callback;
+    preview_state.activity_callback_data = user_data;
+}
+
+bool editor_preview_is_on_demand(void) {
+    return preview_state.multipass_shader && preview_is_on_demand();
+}
+
 bool editor_preview_is_adaptive_resolution(void) {
     if (preview_state.multipass_shader) {
         return multipass_is_adaptive_resolution(preview_state.multipass_shader);
@@ -618,10 +1432,14 @@ void editor_preview_set_double_click_callback(editor_preview_double_click_callba
     preview_state.double_click_callback_data = user_data;
 }
 
+void editor_preview_set_compile_callback(editor_preview_compile_callback_t callback,
+                                         gpointer user_data) {
+    preview_state.compile_callback = callback;
+    preview_state.compile_callback_data = user_data;
+}
+
 void editor_preview_queue_render(void) {
-    if (preview_state.gl_area) {
-        gtk_widget_queue_draw(preview_state.gl_area);
-    }
+    request_frames();
 }
 
 void editor_preview_destroy(void) {
@@ -630,6 +1448,14 @@ void editor_preview_destroy(void) {
         gtk_widget_remove_tick_callback(preview_state.gl_area, preview_state.tick_callback_id);
         preview_state.tick_callback_id = 0;
     }
+    preview_state.active = false;
+    preview_state.activity_callback = NULL;
+    preview_state.activity_callback_data = NULL;
+    preview_state.compile_callback = NULL;
+    preview_state.compile_callback_data = NULL;
+
+    /* Drop a compile in flight (makes the context current itself) */
+    editor_preview_cancel_compile();
 
     /* Clean up OpenGL resources if context is still valid */
     if (preview_state.gl_area && gtk_widget_get_realized(preview_state.gl_area)) {
@@ -658,6 +1484,9 @@ void editor_preview_destroy(void) {
                 glDeleteTextures(1, &preview_state.default_texture);
                 preview_state.default_texture = 0;
             }
+
+            release_frame_cache();
+            shader_cache_clear();
         }
     }
 
@@ -672,6 +1501,8 @@ void editor_preview_destroy(void) {
         free(preview_state.current_shader_source);
         preview_state.current_shader_source = NULL;
     }
+    free(preview_state.include_dir);
+    preview_state.include_dir = NULL;
 
     /* Reset state */
     preview_state.gl_area = NULL;
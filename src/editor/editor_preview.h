@@ -12,6 +12,8 @@
 /* Preview state callback signatures */
 typedef void (*editor_preview_error_callback_t)(const char *error, gpointer user_data);
 typedef void (*editor_preview_double_click_callback_t)(gpointer user_data);
+typedef void (*editor_preview_activity_callback_t)(bool active, gpointer user_data);
+typedef void (*editor_preview_compile_callback_t)(bool success, double compile_ms, gpointer user_data);
 
 /**
  * Create the OpenGL preview widget
@@ -28,6 +30,34 @@ GtkWidget *editor_preview_create(void);
  */
 bool editor_preview_compile_shader(const char *shader_code);
 
+/**
+ * Start compiling a shader without blocking the UI
+ * The current shader keeps rendering while the passes are built and is
+ * replaced when the compile finishes; the compile callback then reports
+ * the result. Starting another compile, a synchronous compile or a tab
+ * switch cancels one still in flight. Without KHR_parallel_shader_compile
+ * the driver still blocks while each pass builds, so the UI runs (and the
+ * compile can be cancelled) only between passes.
+ *
+ * @param shader_code GLSL shader source code
+ * @return true if the compile was started; false if it failed right away
+ *         (the error is set as for editor_preview_compile_shader)
+ */
+bool editor_preview_compile_shader_async(const char *shader_code);
+
+/**
+ * Cancel a compile started with editor_preview_compile_shader_async
+ * Nothing happens if none is in flight; the current shader stays.
+ */
+void editor_preview_cancel_compile(void);
+
+/**
+ * Check whether a background compile is in flight
+ *
+ * @return true between editor_preview_compile_shader_async and its callback
+ */
+bool editor_preview_compile_pending(void);
+
 /**
  * Get the last compilation error message
  * 
@@ -103,6 +133,158 @@ void editor_preview_set_resolution_scale(float scale);
  */
 void editor_preview_set_adaptive_resolution(bool enabled);
 
+/**
+ * Set output reconstruction mode for the Image pass
+ * Persists across shader recompiles
+ * 
+ * @param mode 0 = off, 1 = checkerboard, 2 = temporal, 3 = spatial upscale
+ */
+void editor_preview_set_reconstruction(int mode);
+
+/**
+ * Run shader sources through the optimizer before compiling
+ * Takes effect on the next compile; error line numbers are unchanged
+ *
+ * @param enabled Whether sources are optimized
+ */
+void editor_preview_set_source_optimization(bool enabled);
+
+/**
+ * Compile iResolution into a specialized variant once the preview size
+ * has settled. Persists across shader recompiles
+ *
+ * @param enabled Whether resolution is baked in
+ */
+void editor_preview_set_specialize_resolution(bool enabled);
+
+/**
+ * Draw the performance HUD (frame-time graph, per-pass GPU time, resolution
+ * scale, dropped frames and VRAM) over the preview output
+ *
+ * @param enabled Whether the HUD is shown
+ */
+void editor_preview_set_hud(bool enabled);
+
+/**
+ * Set the GPU frame-time budget the adaptive resolution controller aims for
+ * Persists across shader recompiles
+ * 
+ * @param budget_ms Budget in milliseconds (<= 0 selects the default)
+ */
+void editor_preview_set_frame_budget(float budget_ms);
+
+/**
+ * Set the GPU memory the active shader may hold
+ * Over budget, buffers degrade in stages (lower scale, no mipmaps, RGBA8).
+ * Persists across shader recompiles and tab switches.
+ * 
+ * @param budget_mb Budget in megabytes (<= 0 = unlimited)
+ */
+void editor_preview_set_vram_budget_mb(int budget_mb);
+
+/**
+ * Get smoothed GPU time of the last frames
+ * 
+ * @return GPU milliseconds per frame, 0 if timer queries are unavailable
+ */
+float editor_preview_get_gpu_time_ms(void);
+
+/**
+ * Get how well the current shader suits running as a wallpaper
+ * Predicted from the sources when the shader compiled, then corrected by
+ * GPU timer measurements.
+ * 
+ * @param frame_ms Receives the predicted GPU time at 1920x1080 (may be NULL)
+ * @return Score from 0 (heavy) to 100 (light), -1 if no shader is compiled
+ */
+int editor_preview_get_wallpaper_suitability(float *frame_ms);
+
+/**
+ * Switch the preview to a tab, reusing its compiled shader if cached
+ * The previous tab's shader is parked in a warm LRU cache instead of
+ * being destroyed. Returns false when the tab has no cached instance for
+ * this exact source; the caller then compiles as usual.
+ * 
+ * @param tab_id Tab becoming current
+ * @param shader_code Tab's shader source
+ * @return true if the cached shader is now shown (no compile needed)
+ */
+bool editor_preview_switch_tab(int tab_id, const char *shader_code);
+
+/**
+ * Drop a closed tab's cached shader
+ * 
+ * @param tab_id Tab being closed
+ */
+void editor_preview_forget_tab(int tab_id);
+
+/**
+ * Set the directory #include directives of the next compile resolve against
+ * 
+ * @param dir Directory of the current tab's file (NULL for unsaved tabs)
+ */
+void editor_preview_set_include_dir(const char *dir);
+
+/**
+ * Recompile the passes of the current shader built from an included file
+ * that changed (see shader_include_check_changes)
+ * 
+ * @return Number of passes recompiled, -1 if they no longer compile
+ *         (the error is reported like a failed compile)
+ */
+int editor_preview_refresh_includes(void);
+
+/**
+ * Set how much VRAM background tabs may keep in render targets
+ * Over budget, least recently used tabs release their render targets
+ * but keep their programs. 0 disables the cache.
+ * 
+ * @param megabytes Budget in MB
+ */
+void editor_preview_set_cache_budget_mb(int megabytes);
+
+/**
+ * Cap the preview frame rate
+ * 
+ * @param fps Maximum frames per second (0 = render every vblank)
+ */
+void editor_preview_set_max_fps(int fps);
+
+/**
+ * Tell the preview whether its toplevel window is visible (not minimised)
+ * Hidden previews stop their tick callback entirely.
+ * 
+ * @param visible false while the window is iconified
+ */
+void editor_preview_set_window_visible(bool visible);
+
+/**
+ * Check if the preview is currently producing frames
+ * False while paused, hidden or idle on a static shader
+ * 
+ * @return true if the frame clock tick callback is running
+ */
+bool editor_preview_is_active(void);
+
+/**
+ * Set callback invoked when the preview starts or stops producing frames
+ * Lets periodic UI updates (FPS display) sleep while the preview is idle.
+ * 
+ * @param callback Callback function
+ * @param user_data User data for callback
+ */
+void editor_preview_set_activity_callback(editor_preview_activity_callback_t callback,
+                                          gpointer user_data);
+
+/**
+ * Check if the current shader is rendered on demand
+ * True when it reads no time/frame/date/feedback input, so frames are only
+ * produced on resize, mouse movement (if used) or settings changes.
+ * 
+ * @return true if the preview is idle between input changes
+ */
+bool editor_preview_is_on_demand(void);
+
 /**
  * Check if adaptive resolution is enabled
  * 
@@ -138,6 +320,16 @@ void editor_preview_set_error_callback(editor_preview_error_callback_t callback,
 void editor_preview_set_double_click_callback(editor_preview_double_click_callback_t callback,
                                                gpointer user_data);
 
+/**
+ * Set callback invoked when a background compile finishes
+ *
+ * @param callback Callback function, given whether the shader compiled and
+ *                 how long the compile took
+ * @param user_data User data passed to callback
+ */
+void editor_preview_set_compile_callback(editor_preview_compile_callback_t callback,
+                                         gpointer user_data);
+
 /**
  * Force a redraw of the preview
  */
@@ -49,8 +49,17 @@ void editor_settings_save(const EditorSettings *settings) {
     fprintf(f, "auto_completion=%d\n", settings->auto_completion ? 1 : 0);
     fprintf(f, "# Compilation\n");
     fprintf(f, "auto_compile=%d\n", settings->auto_compile ? 1 : 0);
+    fprintf(f, "optimize_source=%d\n", settings->optimize_source ? 1 : 0);
     fprintf(f, "# Preview\n");
     fprintf(f, "preview_fps=%d\n", settings->preview_fps);
+    fprintf(f, "reconstruction=%d\n", settings->reconstruction);
+    fprintf(f, "frame_budget_ms=%d\n", settings->frame_budget_ms);
+    fprintf(f, "vram_budget_mb=%d\n", settings->vram_budget_mb);
+    fprintf(f, "specialize_resolution=%d\n", settings->specialize_resolution ? 1 : 0);
+    fprintf(f, "show_hud=%d\n", settings->show_hud ? 1 : 0);
+    fprintf(f, "shader_cache_mb=%d\n", settings->shader_cache_mb);
+    fprintf(f, "tab_thumbnails=%d\n", settings->tab_thumbnails ? 1 : 0);
+    fprintf(f, "include_library=%s\n", settings->include_library);
     fprintf(f, "# Session\n");
     fprintf(f, "remember_open_tabs=%d\n", settings->remember_open_tabs ? 1 : 0);
     fprintf(f, "shader_speed=%.2f\n", settings->shader_speed);
@@ -86,8 +95,17 @@ void editor_settings_load(EditorSettings *settings) {
     settings->bracket_matching = true;
     settings->auto_completion = true;
     settings->auto_compile = true;
+    settings->optimize_source = false;
     settings->preview_fps = 60;
     settings->shader_speed = 1.0;
+    settings->reconstruction = RECONSTRUCTION_OFF;
+    settings->frame_budget_ms = 12;
+    settings->vram_budget_mb = 0;
+    settings->specialize_resolution = false;
+    settings->show_hud = false;
+    settings->shader_cache_mb = 256;
+    settings->tab_thumbnails = true;
+    settings->include_library[0] = '\0';
     settings->split_orientation = SPLIT_HORIZONTAL;
     settings->remember_open_tabs = true;
 
@@ -168,12 +186,44 @@ void editor_settings_load(EditorSettings *settings) {
             settings->auto_completion = (value != 0);
         } else if (sscanf(line, "auto_compile=%d", &value) == 1) {
             settings->auto_compile = (value != 0);
+        } else if (sscanf(line, "optimize_source=%d", &value) == 1) {
+            settings->optimize_source = (value != 0);
         } else if (sscanf(line, "remember_open_tabs=%d", &value) == 1) {
             settings->remember_open_tabs = (value != 0);
         } else if (sscanf(line, "preview_fps=%d", &value) == 1) {
             if (value >= 15 && value <= 120) {
                 settings->preview_fps = value;
             }
+        } else if (sscanf(line, "reconstruction=%d", &value) == 1) {
+            if (value >= RECONSTRUCTION_OFF && value <= RECONSTRUCTION_SPATIAL) {
+                settings->reconstruction = (ReconstructionMode)value;
+            }
+        } else if (sscanf(line, "frame_budget_ms=%d", &value) == 1) {
+            if (value >= 2 && value <= 50) {
+                settings->frame_budget_ms = value;
+            }
+        } else if (sscanf(line, "vram_budget_mb=%d", &value) == 1) {
+            if (value >= 0 && value <= 8192) {
+                settings->vram_budget_mb = value;
+            }
+        } else if (strncmp(line, "include_library=", 16) == 0) {
+            char *value = line + 16;
+            size_t len = strlen(value);
+            if (len > 0 && value[len-1] == '\n') {
+                value[len-1] = '\0';
+            }
+            strncpy(settings->include_library, value, sizeof(settings->include_library) - 1);
+            settings->include_library[sizeof(settings->include_library) - 1] = '\0';
+        } else if (sscanf(line, "tab_thumbnails=%d", &value) == 1) {
+            settings->tab_thumbnails = (value != 0);
+        } else if (sscanf(line, "specialize_resolution=%d", &value) == 1) {
+            settings->specialize_resolution = (value != 0);
+        } else if (sscanf(line, "show_hud=%d", &value) == 1) {
+            settings->show_hud = (value != 0);
+        } else if (sscanf(line, "shader_cache_mb=%d", &value) == 1) {
+            if (value >= 0 && value <= 2048) {
+                settings->shader_cache_mb = value;
+            }
         } else if (sscanf(line, "shader_speed=%lf", &dvalue) == 1) {
             if (dvalue >= 0.1 && dvalue <= 5.0) {
                 settings->shader_speed = dvalue;
@@ -254,6 +304,17 @@ static void on_auto_compile_toggled(GtkSwitch *sw, GParamSpec *pspec, gpointer d
     }
 }
 
+/* Source optimization toggled */
+static void on_optimize_source_toggled(GtkSwitch *sw, GParamSpec *pspec, gpointer data) {
+    (void)pspec;
+    SettingsCallbackData *cb_data = (SettingsCallbackData *)data;
+    cb_data->settings->optimize_source = gtk_switch_get_active(sw);
+    editor_settings_save(cb_data->settings);
+    if (cb_data->on_change) {
+        cb_data->on_change(cb_data->settings, cb_data->user_data);
+    }
+}
+
 static void on_remember_tabs_toggled(GtkSwitch *sw, GParamSpec *pspec, gpointer data) {
     (void)pspec;
     SettingsCallbackData *cb_data = (SettingsCallbackData *)data;
@@ -343,6 +404,80 @@ static void on_cursor_style_changed(GtkComboBox *combo, gpointer data) {
     if (cb_data->on_change) cb_data->on_change(cb_data->settings, cb_data->user_data);
 }
 
+static void on_reconstruction_changed(GtkComboBox *combo, gpointer data) {
+    SettingsCallbackData *cb_data = (SettingsCallbackData *)data;
+    cb_data->settings->reconstruction = (ReconstructionMode)gtk_combo_box_get_active(combo);
+    editor_settings_save(cb_data->settings);
+    if (cb_data->on_change) cb_data->on_change(cb_data->settings, cb_data->user_data);
+}
+
+static void on_preview_fps_changed(GtkSpinButton *spin, gpointer data) {
+    SettingsCallbackData *cb_data = (SettingsCallbackData *)data;
+    cb_data->settings->preview_fps = gtk_spin_button_get_value_as_int(spin);
+    editor_settings_save(cb_data->settings);
+    if (cb_data->on_change) cb_data->on_change(cb_data->settings, cb_data->user_data);
+}
+
+static void on_frame_budget_changed(GtkSpinButton *spin, gpointer data) {
+    SettingsCallbackData *cb_data = (SettingsCallbackData *)data;
+    cb_data->settings->frame_budget_ms = gtk_spin_button_get_value_as_int(spin);
+    editor_settings_save(cb_data->settings);
+    if (cb_data->on_change) cb_data->on_change(cb_data->settings, cb_data->user_data);
+}
+
+static void on_vram_budget_changed(GtkSpinButton *spin, gpointer data) {
+    SettingsCallbackData *cb_data = (SettingsCallbackData *)data;
+    cb_data->settings->vram_budget_mb = gtk_spin_button_get_value_as_int(spin);
+    editor_settings_save(cb_data->settings);
+    if (cb_data->on_change) cb_data->on_change(cb_data->settings, cb_data->user_data);
+}
+
+static void on_shader_cache_changed(GtkSpinButton *spin, gpointer data) {
+    SettingsCallbackData *cb_data = (SettingsCallbackData *)data;
+    cb_data->settings->shader_cache_mb = gtk_spin_button_get_value_as_int(spin);
+    editor_settings_save(cb_data->settings);
+    if (cb_data->on_change) cb_data->on_change(cb_data->settings, cb_data->user_data);
+}
+
+static void on_include_library_changed(GtkEntry *entry, gpointer data) {
+    SettingsCallbackData *cb_data = (SettingsCallbackData *)data;
+    const char *text = gtk_entry_get_text(entry);
+    strncpy(cb_data->settings->include_library, text, sizeof(cb_data->settings->include_library) - 1);
+    cb_data->settings->include_library[sizeof(cb_data->settings->include_library) - 1] = '\0';
+    editor_settings_save(cb_data->settings);
+    if (cb_data->on_change) cb_data->on_change(cb_data->settings, cb_data->user_data);
+}
+
+static void on_specialize_resolution_toggled(GtkSwitch *sw, GParamSpec *pspec, gpointer data) {
+    (void)pspec;
+    SettingsCallbackData *cb_data = (SettingsCallbackData *)data;
+    cb_data->settings->specialize_resolution = gtk_switch_get_active(sw);
+    editor_settings_save(cb_data->settings);
+    if (cb_data->on_change) {
+        cb_data->on_change(cb_data->settings, cb_data->user_data);
+    }
+}
+
+static void on_show_hud_toggled(GtkSwitch *sw, GParamSpec *pspec, gpointer data) {
+    (void)pspec;
+    SettingsCallbackData *cb_data = (SettingsCallbackData *)data;
+    cb_data->settings->show_hud = gtk_switch_get_active(sw);
+    editor_settings_save(cb_data->settings);
+    if (cb_data->on_change) {
+        cb_data->on_change(cb_data->settings, cb_data->user_data);
+    }
+}
+
+static void on_tab_thumbnails_toggled(GtkSwitch *sw, GParamSpec *pspec, gpointer data) {
+    (void)pspec;
+    SettingsCallbackData *cb_data = (SettingsCallbackData *)data;
+    cb_data->settings->tab_thumbnails = gtk_switch_get_active(sw);
+    editor_settings_save(cb_data->settings);
+    if (cb_data->on_change) {
+        cb_data->on_change(cb_data->settings, cb_data->user_data);
+    }
+}
+
 static void on_reset_speed_clicked(GtkButton *button, gpointer data) {
     (void)button;
     GtkSpinButton *spin = GTK_SPIN_BUTTON(data);
@@ -705,6 +840,18 @@ void editor_settings_show_dialog(GtkWindow *parent,
     gtk_grid_attach(GTK_GRID(behavior_grid), auto_switch, 1, row, 1, 1);
     row++;
 
+    /* Source optimization */
+    GtkWidget *optimize_label = gtk_label_new("Optimize Source:");
+    gtk_widget_set_halign(optimize_label, GTK_ALIGN_END);
+    gtk_grid_attach(GTK_GRID(behavior_grid), optimize_label, 0, row, 1, 1);
+
+    GtkWidget *optimize_switch = gtk_switch_new();
+    gtk_switch_set_active(GTK_SWITCH(optimize_switch), settings->optimize_source);
+    gtk_widget_set_tooltip_text(optimize_switch, "Drop unused functions, fold constants and strip comments before compiling (error lines are unchanged)");
+    g_signal_connect(optimize_switch, "notify::active", G_CALLBACK(on_optimize_source_toggled), &cb_data);
+    gtk_grid_attach(GTK_GRID(behavior_grid), optimize_switch, 1, row, 1, 1);
+    row++;
+
     /* Auto-completion */
     GtkWidget *completion_label = gtk_label_new("Auto-Completion:");
     gtk_widget_set_halign(completion_label, GTK_ALIGN_END);
@@ -770,6 +917,148 @@ void editor_settings_show_dialog(GtkWindow *parent,
     gtk_grid_attach(GTK_GRID(preview_grid), speed_box, 1, row, 1, 1);
     row++;
 
+    /* Frame rate cap */
+    GtkWidget *fps_label = gtk_label_new("Max FPS:");
+    gtk_widget_set_halign(fps_label, GTK_ALIGN_END);
+    gtk_grid_attach(GTK_GRID(preview_grid), fps_label, 0, row, 1, 1);
+
+    GtkWidget *fps_spin = gtk_spin_button_new_with_range(15, 120, 1);
+    gtk_spin_button_set_value(GTK_SPIN_BUTTON(fps_spin), settings->preview_fps);
+    gtk_widget_set_tooltip_text(fps_spin,
+        "Upper limit for preview frames per second (15-120)\n"
+        "Lower values save power; the display refresh rate still applies");
+    g_signal_connect(fps_spin, "value-changed", G_CALLBACK(on_preview_fps_changed), &cb_data);
+    gtk_grid_attach(GTK_GRID(preview_grid), fps_spin, 1, row, 1, 1);
+    row++;
+
+    /* Output reconstruction */
+    GtkWidget *reconstruction_label = gtk_label_new("Reconstruction:");
+    gtk_widget_set_halign(reconstruction_label, GTK_ALIGN_END);
+    gtk_grid_attach(GTK_GRID(preview_grid), reconstruction_label, 0, row, 1, 1);
+
+    GtkWidget *reconstruction_combo = gtk_combo_box_text_new();
+    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(reconstruction_combo), "Off (native)");
+    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(reconstruction_combo), "Checkerboard");
+    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(reconstruction_combo), "Temporal");
+    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(reconstruction_combo), "Spatial upscale");
+    gtk_combo_box_set_active(GTK_COMBO_BOX(reconstruction_combo), settings->reconstruction);
+    gtk_widget_set_tooltip_text(reconstruction_combo,
+        "Shade about half the Image pass pixels per frame and reconstruct the rest\n"
+        "Checkerboard: alternate pixels each frame, history fills the gaps\n"
+        "Temporal: reduced resolution with sub-pixel jitter and history accumulation\n"
+        "Spatial upscale: render at the adaptive scale (50-100%) and upscale with\n"
+        "an edge-aware filter plus sharpening instead of plain bilinear stretching");
+    g_signal_connect(reconstruction_combo, "changed", G_CALLBACK(on_reconstruction_changed), &cb_data);
+    gtk_grid_attach(GTK_GRID(preview_grid), reconstruction_combo, 1, row, 1, 1);
+    row++;
+
+    /* GPU frame budget for adaptive resolution */
+    GtkWidget *budget_label = gtk_label_new("Frame Budget (ms):");
+    gtk_widget_set_halign(budget_label, GTK_ALIGN_END);
+    gtk_grid_attach(GTK_GRID(preview_grid), budget_label, 0, row, 1, 1);
+
+    GtkWidget *budget_spin = gtk_spin_button_new_with_range(2, 50, 1);
+    gtk_spin_button_set_value(GTK_SPIN_BUTTON(budget_spin), settings->frame_budget_ms);
+    gtk_widget_set_tooltip_text(budget_spin,
+        "GPU time per frame the adaptive resolution aims for (2-50 ms)\n"
+        "Measured with GPU timer queries; lower values trade resolution for headroom");
+    g_signal_connect(budget_spin, "value-changed", G_CALLBACK(on_frame_budget_changed), &cb_data);
+    gtk_grid_attach(GTK_GRID(preview_grid), budget_spin, 1, row, 1, 1);
+    row++;
+
+    /* GPU memory budget for the active shader */
+    GtkWidget *vram_label = gtk_label_new("VRAM Budget (MB):");
+    gtk_widget_set_halign(vram_label, GTK_ALIGN_END);
+    gtk_grid_attach(GTK_GRID(preview_grid), vram_label, 0, row, 1, 1);
+
+    GtkWidget *vram_spin = gtk_spin_button_new_with_range(0, 8192, 16);
+    gtk_spin_button_set_value(GTK_SPIN_BUTTON(vram_spin), settings->vram_budget_mb);
+    gtk_widget_set_tooltip_text(vram_spin,
+        "GPU memory the shader's buffers may hold (0 = unlimited)\n"
+        "Over budget, buffers drop resolution first, then mipmaps,\n"
+        "then switch from 16-bit float to 8-bit storage");
+    g_signal_connect(vram_spin, "value-changed", G_CALLBACK(on_vram_budget_changed), &cb_data);
+    gtk_grid_attach(GTK_GRID(preview_grid), vram_spin, 1, row, 1, 1);
+    row++;
+
+    /* iResolution as a compile-time constant */
+    GtkWidget *specialize_label = gtk_label_new("Bake Resolution:");
+    gtk_widget_set_halign(specialize_label, GTK_ALIGN_END);
+    gtk_grid_attach(GTK_GRID(preview_grid), specialize_label, 0, row, 1, 1);
+
+    GtkWidget *specialize_switch = gtk_switch_new();
+    gtk_switch_set_active(GTK_SWITCH(specialize_switch), settings->specialize_resolution);
+    gtk_widget_set_tooltip_text(specialize_switch,
+        "Once the preview size settles, compile a variant with iResolution as a constant\n"
+        "so the driver can fold and unroll what depends on it (one extra compile per size).\n"
+        "Only while the resolution scale is fixed - adaptive resolution changes it too often");
+    g_signal_connect(specialize_switch, "notify::active", G_CALLBACK(on_specialize_resolution_toggled), &cb_data);
+    gtk_grid_attach(GTK_GRID(preview_grid), specialize_switch, 1, row, 1, 1);
+    row++;
+
+    /* In-preview performance overlay */
+    GtkWidget *hud_label = gtk_label_new("Performance HUD:");
+    gtk_widget_set_halign(hud_label, GTK_ALIGN_END);
+    gtk_grid_attach(GTK_GRID(preview_grid), hud_label, 0, row, 1, 1);
+
+    GtkWidget *hud_switch = gtk_switch_new();
+    gtk_switch_set_active(GTK_SWITCH(hud_switch), settings->show_hud);
+    gtk_widget_set_tooltip_text(hud_switch,
+        "Draw a frame-time graph, per-pass GPU times, resolution scale,\n"
+        "dropped frames and VRAM use over the preview");
+    g_signal_connect(hud_switch, "notify::active", G_CALLBACK(on_show_hud_toggled), &cb_data);
+    gtk_grid_attach(GTK_GRID(preview_grid), hud_switch, 1, row, 1, 1);
+    row++;
+
+    /* VRAM kept by background tabs */
+    GtkWidget *cache_label = gtk_label_new("Tab Cache (MB):");
+    gtk_widget_set_halign(cache_label, GTK_ALIGN_END);
+    gtk_grid_attach(GTK_GRID(preview_grid), cache_label, 0, row, 1, 1);
+
+    GtkWidget *cache_spin = gtk_spin_button_new_with_range(0, 2048, 16);
+    gtk_spin_button_set_value(GTK_SPIN_BUTTON(cache_spin), settings->shader_cache_mb);
+    gtk_widget_set_tooltip_text(cache_spin,
+        "Video memory background tabs may keep for instant switching (0-2048 MB)\n"
+        "Compiled programs are always kept; 0 disables the tab cache");
+    g_signal_connect(cache_spin, "value-changed", G_CALLBACK(on_shader_cache_changed), &cb_data);
+    gtk_grid_attach(GTK_GRID(preview_grid), cache_spin, 1, row, 1, 1);
+    row++;
+
+    /* Live tab thumbnails */
+    GtkWidget *thumbnails_label = gtk_label_new("Tab Thumbnails:");
+    gtk_widget_set_halign(thumbnails_label, GTK_ALIGN_END);
+    gtk_grid_attach(GTK_GRID(preview_grid), thumbnails_label, 0, row, 1, 1);
+
+    GtkWidget *thumbnails_switch = gtk_switch_new();
+    gtk_switch_set_active(GTK_SWITCH(thumbnails_switch), settings->tab_thumbnails);
+    gtk_widget_set_tooltip_text(thumbnails_switch,
+        "Show a small live preview of every open shader in its tab\n"
+        "Rendered in the background within a fixed GPU time per frame");
+    g_signal_connect(thumbnails_switch, "notify::active", G_CALLBACK(on_tab_thumbnails_toggled), &cb_data);
+    gtk_grid_attach(GTK_GRID(preview_grid), thumbnails_switch, 1, row, 1, 1);
+    row++;
+
+    /* Directory searched by #include after the shader's own */
+    GtkWidget *library_label = gtk_label_new("Include Library:");
+    gtk_widget_set_halign(library_label, GTK_ALIGN_END);
+    gtk_grid_attach(GTK_GRID(preview_grid), library_label, 0, row, 1, 1);
+
+    char config_dir[PATH_MAX];
+    char default_library[PATH_MAX];
+    platform_get_config_dir(config_dir, sizeof(config_dir));
+    platform_path_join(default_library, sizeof(default_library), config_dir, "library");
+
+    GtkWidget *library_entry = gtk_entry_new();
+    gtk_entry_set_text(GTK_ENTRY(library_entry), settings->include_library);
+    gtk_entry_set_placeholder_text(GTK_ENTRY(library_entry), default_library);
+    gtk_entry_set_max_length(GTK_ENTRY(library_entry), sizeof(settings->include_library) - 1);
+    gtk_widget_set_tooltip_text(library_entry,
+        "Directory for #include \"file.glsl\" after the shader's own folder\n"
+        "Leave empty for the default; changed files recompile the tabs using them");
+    g_signal_connect(library_entry, "changed", G_CALLBACK(on_include_library_changed), &cb_data);
+    gtk_grid_attach(GTK_GRID(preview_grid), library_entry, 1, row, 1, 1);
+    row++;
+
     gtk_widget_show_all(dialog);
     gtk_dialog_run(GTK_DIALOG(dialog));
     gtk_widget_destroy(dialog);
@@ -20,6 +20,14 @@ typedef enum {
     CURSOR_STYLE_IBEAM = 1
 } CursorStyle;
 
+/* Preview output reconstruction (mirrors multipass_reconstruct_mode_t) */
+typedef enum {
+    RECONSTRUCTION_OFF = 0,
+    RECONSTRUCTION_CHECKERBOARD = 1,
+    RECONSTRUCTION_TEMPORAL = 2,
+    RECONSTRUCTION_SPATIAL = 3
+} ReconstructionMode;
+
 /* Editor settings structure */
 typedef struct {
     /* Editor appearance */
@@ -48,10 +56,19 @@ typedef struct {
     
     /* Compilation */
     bool auto_compile;
+    bool optimize_source;                /* Strip unused code and minify before compiling */
     
     /* Preview */
     int preview_fps;
     double shader_speed;
+    ReconstructionMode reconstruction;
+    int frame_budget_ms;
+    int vram_budget_mb;                  /* GPU memory the active shader may hold (0 = unlimited) */
+    bool specialize_resolution;          /* Compile iResolution in as a constant once the size settles */
+    bool show_hud;                       /* Performance HUD over the preview */
+    int shader_cache_mb;
+    bool tab_thumbnails;
+    char include_library[200];           /* #include search directory ("" = <config dir>/library) */
     
     /* Layout */
     SplitOrientation split_orientation;
@@ -83,8 +100,17 @@ typedef struct {
     .bracket_matching = true, \
     .auto_completion = true, \
     .auto_compile = true, \
+    .optimize_source = false, \
     .preview_fps = 60, \
     .shader_speed = 1.0, \
+    .reconstruction = RECONSTRUCTION_OFF, \
+    .frame_budget_ms = 12, \
+    .vram_budget_mb = 0, \
+    .specialize_resolution = false, \
+    .show_hud = false, \
+    .shader_cache_mb = 256, \
+    .tab_thumbnails = true, \
+    .include_library = "", \
     .split_orientation = SPLIT_HORIZONTAL, \
     .remember_open_tabs = true \
 }
@@ -3,6 +3,7 @@
  */
 
 #include "editor_tabs.h"
+#include "editor_text.h"
 #include "platform_compat.h"
 #include <stdlib.h>
 #include <string.h>
@@ -11,14 +12,23 @@
 /* Maximum number of tabs */
 #define MAX_TABS 20
 
+/* Size of the live thumbnail shown in the tab label */
+#define TAB_THUMBNAIL_WIDTH 64
+#define TAB_THUMBNAIL_HEIGHT 36
+
 /* Tab state structure */
 typedef struct {
     int tab_id;
     GtkWidget *label_box;
+    GtkWidget *thumbnail;
     GtkWidget *label;
     GtkWidget *close_button;
     char *title;
-    char *code;
+    GtkSourceBuffer *buffer;     /* The tab's text, shown in the editor while active */
+    gulong changed_handler;
+    char *code;                  /* Copy of the text, taken on request */
+    bool code_stale;             /* buffer edited since code was taken */
+    guint revision;              /* Bumped on every edit */
     char *file_path;
     bool is_modified;
     bool has_compiled;
@@ -86,6 +96,39 @@ static int get_tab_index(int tab_id) {
     return -1;
 }
 
+/* Helper: Copy the text out of the buffer if it was edited since the last copy */
+static const char *tab_code(Tab *tab) {
+    if (tab->code_stale || !tab->code) {
+        g_free(tab->code);
+        GtkTextIter start, end;
+        gtk_text_buffer_get_bounds(GTK_TEXT_BUFFER(tab->buffer), &start, &end);
+        tab->code = gtk_text_buffer_get_text(GTK_TEXT_BUFFER(tab->buffer), &start, &end, FALSE);
+        tab->code_stale = false;
+    }
+    return tab->code;
+}
+
+/* Helper: Release a tab's buffer */
+static void release_buffer(Tab *tab) {
+    if (!tab->buffer) return;
+
+    /* The editor may still show it; it keeps its own reference */
+    g_signal_handler_disconnect(tab->buffer, tab->changed_handler);
+    g_object_unref(tab->buffer);
+    tab->buffer = NULL;
+}
+
+/* Callback: Tab's buffer edited - only remember that the copy is out of date */
+static void on_tab_buffer_changed(GtkTextBuffer *buffer, gpointer user_data) {
+    (void)buffer;
+
+    Tab *tab = find_tab_by_id(GPOINTER_TO_INT(user_data));
+    if (tab) {
+        tab->code_stale = true;
+        tab->revision++;
+    }
+}
+
 /* Helper: Update tab label with title and modified indicator */
 static void update_tab_label(Tab *tab) {
     if (!tab || !tab->label) return;
@@ -172,7 +215,13 @@ int editor_tabs_new(const char *title, const char *code) {
     Tab *tab = &state.tabs[state.tab_count];
     tab->tab_id = state.next_tab_id++;
     tab->title = g_strdup(title ? title : "Untitled");
+    tab->buffer = editor_text_buffer_new(code);
+    tab->changed_handler = g_signal_connect(tab->buffer, "changed",
+                                            G_CALLBACK(on_tab_buffer_changed),
+                                            GINT_TO_POINTER(tab->tab_id));
     tab->code = g_strdup(code ? code : "");
+    tab->code_stale = false;
+    tab->revision = 0;
     tab->file_path = NULL;
     tab->is_modified = false;
     tab->has_compiled = false;
@@ -181,6 +230,10 @@ int editor_tabs_new(const char *title, const char *code) {
     /* Create tab label with close button */
     tab->label_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 4);
 
+    tab->thumbnail = gtk_image_new();
+    gtk_widget_set_no_show_all(tab->thumbnail, TRUE);
+    gtk_box_pack_start(GTK_BOX(tab->label_box), tab->thumbnail, FALSE, FALSE, 0);
+
     tab->label = gtk_label_new(tab->title);
     gtk_box_pack_start(GTK_BOX(tab->label_box), tab->label, FALSE, FALSE, 0);
 
@@ -245,6 +298,7 @@ bool editor_tabs_close(int tab_id) {
         g_free(tab->file_path);
         tab->file_path = NULL;
     }
+    release_buffer(tab);
 
     /* Shift remaining tabs down */
     for (int i = page_num; i < state.tab_count - 1; i++) {
@@ -295,7 +349,6 @@ const TabInfo *editor_tabs_get_info(int tab_id) {
     static TabInfo info;
     info.tab_id = tab->tab_id;
     info.title = tab->title;
-    info.code = tab->code;
     info.file_path = tab->file_path;
     info.is_modified = tab->is_modified;
     info.has_compiled = tab->has_compiled;
@@ -303,12 +356,19 @@ const TabInfo *editor_tabs_get_info(int tab_id) {
     return &info;
 }
 
-void editor_tabs_set_code(int tab_id, const char *code) {
+GtkSourceBuffer *editor_tabs_get_buffer(int tab_id) {
     Tab *tab = find_tab_by_id(tab_id);
-    if (!tab) return;
+    return tab ? tab->buffer : NULL;
+}
 
-    if (tab->code) g_free(tab->code);
-    tab->code = g_strdup(code ? code : "");
+const char *editor_tabs_get_code(int tab_id) {
+    Tab *tab = find_tab_by_id(tab_id);
+    return tab ? tab_code(tab) : NULL;
+}
+
+guint editor_tabs_get_revision(int tab_id) {
+    Tab *tab = find_tab_by_id(tab_id);
+    return tab ? tab->revision : 0;
 }
 
 void editor_tabs_set_title(int tab_id, const char *title) {
@@ -361,6 +421,28 @@ int editor_tabs_get_count(void) {
     return state.tab_count;
 }
 
+int editor_tabs_get_id_at(int index) {
+    if (index < 0 || index >= state.tab_count) return -1;
+    return state.tabs[index].tab_id;
+}
+
+void editor_tabs_set_thumbnail(int tab_id, GdkPixbuf *pixbuf) {
+    Tab *tab = find_tab_by_id(tab_id);
+    if (!tab || !tab->thumbnail) return;
+
+    if (!pixbuf) {
+        gtk_image_clear(GTK_IMAGE(tab->thumbnail));
+        gtk_widget_hide(tab->thumbnail);
+        return;
+    }
+
+    GdkPixbuf *scaled = gdk_pixbuf_scale_simple(pixbuf, TAB_THUMBNAIL_WIDTH, TAB_THUMBNAIL_HEIGHT,
+                                                GDK_INTERP_BILINEAR);
+    gtk_image_set_from_pixbuf(GTK_IMAGE(tab->thumbnail), scaled);
+    g_object_unref(scaled);
+    gtk_widget_show(tab->thumbnail);
+}
+
 void editor_tabs_set_changed_callback(tab_changed_callback_t callback, void *user_data) {
     state.changed_callback = callback;
     state.changed_callback_data = user_data;
@@ -392,6 +474,7 @@ void editor_tabs_cleanup(void) {
             g_free(state.tabs[i].file_path);
             state.tabs[i].file_path = NULL;
         }
+        release_buffer(&state.tabs[i]);
     }
 
     state.tab_count = 0;
@@ -433,9 +516,7 @@ bool editor_tabs_save_session(void) {
         }
 
         /* Save code (always save, even if file exists, in case of unsaved changes) */
-        if (tab->code) {
-            g_key_file_set_string(keyfile, group, "code", tab->code);
-        }
+        g_key_file_set_string(keyfile, group, "code", tab_code(tab));
     }
 
     /* Save tab count */
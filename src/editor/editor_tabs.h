@@ -6,6 +6,7 @@
 #define EDITOR_TABS_H
 
 #include <gtk/gtk.h>
+#include <gtksourceview/gtksource.h>
 #include <stdbool.h>
 
 /**
@@ -14,7 +15,6 @@
 typedef struct {
     int tab_id;                 /* Unique tab identifier */
     char *title;                /* Tab title (filename or "Untitled") */
-    char *code;                 /* Shader code */
     char *file_path;            /* File path (NULL if not saved) */
     bool is_modified;           /* Modified flag */
     bool has_compiled;          /* Whether shader has been compiled */
@@ -86,12 +86,35 @@ bool editor_tabs_switch_to(int tab_id);
 const TabInfo *editor_tabs_get_info(int tab_id);
 
 /**
- * Update tab code
+ * Get the buffer holding a tab's code
+ * Each tab keeps its own buffer (with its undo history and cursor); show
+ * it with editor_text_set_buffer.
  * 
  * @param tab_id Tab ID
- * @param code New code
+ * @return Buffer owned by the tab, or NULL if not found
  */
-void editor_tabs_set_code(int tab_id, const char *code);
+GtkSourceBuffer *editor_tabs_get_buffer(int tab_id);
+
+/**
+ * Get tab code
+ * The text is copied out of the tab's buffer only if it was edited since
+ * the last call, so edits themselves copy nothing.
+ * 
+ * @param tab_id Tab ID
+ * @return Code owned by the tab (valid until it is edited or closed),
+ *         or NULL if not found
+ */
+const char *editor_tabs_get_code(int tab_id);
+
+/**
+ * Get tab revision
+ * The revision changes whenever the tab's text is edited, so callers can
+ * tell whether the code changed without copying or comparing it.
+ * 
+ * @param tab_id Tab ID
+ * @return Revision of the tab's text, or 0 if not found
+ */
+guint editor_tabs_get_revision(int tab_id);
 
 /**
  * Update tab title
@@ -132,6 +155,22 @@ void editor_tabs_set_compiled(int tab_id, bool compiled);
  */
 int editor_tabs_get_count(void);
 
+/**
+ * Get tab ID by position
+ * 
+ * @param index Tab position (0 to count - 1)
+ * @return Tab ID, or -1 if out of range
+ */
+int editor_tabs_get_id_at(int index);
+
+/**
+ * Show a thumbnail image in the tab label
+ * 
+ * @param tab_id Tab ID
+ * @param pixbuf Thumbnail image (NULL hides the thumbnail)
+ */
+void editor_tabs_set_thumbnail(int tab_id, GdkPixbuf *pixbuf);
+
 /**
  * Set callback for tab changes
  * 
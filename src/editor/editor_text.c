@@ -5,6 +5,7 @@
 #include "editor_text.h"
 #include "editor_settings.h"
 #include "glsl_completion.h"
+#include "../shader_lib/shader_trace.h"
 #include <stdlib.h>
 #include <string.h>
 
@@ -17,8 +18,10 @@
 /* Module state */
 static struct {
     GtkWidget *source_view;
-    GtkSourceBuffer *source_buffer;
+    GtkSourceBuffer *source_buffer;  /* Buffer being shown (the view holds the reference) */
     GtkWidget *scrolled_window;
+    GtkSourceStyleScheme *style_scheme;  /* Applied to every buffer shown */
+    bool highlight_brackets;
     editor_text_config_t config;
     editor_text_change_callback_t change_callback;
     gpointer change_callback_data;
@@ -30,6 +33,8 @@ static struct {
     .source_view = NULL,
     .source_buffer = NULL,
     .scrolled_window = NULL,
+    .style_scheme = NULL,
+    .highlight_brackets = true,
     .config = {
         .tab_width = 4,
         .font_size = 11,
@@ -54,9 +59,9 @@ static void on_buffer_changed(GtkTextBuffer *buffer, gpointer user_data) {
     editor_state.modified = gtk_text_buffer_get_modified(buffer);
 
     if (editor_state.change_callback) {
-        char *text = editor_text_get_code();
-        editor_state.change_callback(text, editor_state.change_callback_data);
-        g_free(text);
+        uint64_t span = shader_trace_begin();
+        editor_state.change_callback(editor_state.change_callback_data);
+        shader_trace_end(span, SHADER_TRACE_UI, "text changed", NULL);
     }
 }
 
@@ -78,6 +83,26 @@ static void on_cursor_moved(GtkTextBuffer *buffer, GParamSpec *pspec, gpointer u
     editor_state.cursor_callback(line, column, editor_state.cursor_callback_data);
 }
 
+/* Settings that live on the buffer rather than the view */
+static void configure_buffer(GtkSourceBuffer *buffer) {
+    if (editor_state.style_scheme) {
+        gtk_source_buffer_set_style_scheme(buffer, editor_state.style_scheme);
+    }
+    gtk_source_buffer_set_highlight_matching_brackets(buffer, editor_state.highlight_brackets);
+}
+
+static void connect_buffer(GtkSourceBuffer *buffer) {
+    g_signal_connect(buffer, "changed",
+                     G_CALLBACK(on_buffer_changed), NULL);
+    g_signal_connect(buffer, "notify::cursor-position",
+                     G_CALLBACK(on_cursor_moved), NULL);
+}
+
+static void disconnect_buffer(GtkSourceBuffer *buffer) {
+    g_signal_handlers_disconnect_by_func(buffer, G_CALLBACK(on_buffer_changed), NULL);
+    g_signal_handlers_disconnect_by_func(buffer, G_CALLBACK(on_cursor_moved), NULL);
+}
+
 /* Public API */
 
 GtkWidget *editor_text_create(const EditorSettings *settings) {
@@ -89,25 +114,16 @@ GtkWidget *editor_text_create(const EditorSettings *settings) {
     /* Use defaults if no settings provided */
     bool use_settings = (settings != NULL);
 
-    /* Create source buffer with GLSL language */
-    GtkSourceLanguageManager *lang_manager = gtk_source_language_manager_get_default();
-    GtkSourceLanguage *glsl_lang = gtk_source_language_manager_get_language(lang_manager, "glsl");
-
-    editor_state.source_buffer = gtk_source_buffer_new_with_language(glsl_lang);
-
-    /* Enable syntax highlighting */
-    gtk_source_buffer_set_highlight_syntax(editor_state.source_buffer, TRUE);
-
     /* Set up style scheme */
     GtkSourceStyleSchemeManager *scheme_manager = gtk_source_style_scheme_manager_get_default();
     const char *theme_name = use_settings ? settings->theme : "oblivion";
-    GtkSourceStyleScheme *scheme = gtk_source_style_scheme_manager_get_scheme(scheme_manager, theme_name);
-    if (scheme) {
-        gtk_source_buffer_set_style_scheme(editor_state.source_buffer, scheme);
-    }
+    editor_state.style_scheme = gtk_source_style_scheme_manager_get_scheme(scheme_manager, theme_name);
+    editor_state.highlight_brackets = use_settings ? settings->bracket_matching : true;
 
-    /* Create source view */
+    /* Create source view, with an empty buffer until a tab's buffer is shown */
+    editor_state.source_buffer = editor_text_buffer_new(NULL);
     editor_state.source_view = gtk_source_view_new_with_buffer(editor_state.source_buffer);
+    g_object_unref(editor_state.source_buffer);
 
     /* Configure source view with settings or defaults */
     int tab_width = use_settings ? settings->tab_width : 4;
@@ -115,7 +131,6 @@ GtkWidget *editor_text_create(const EditorSettings *settings) {
     bool show_line_numbers = use_settings ? settings->show_line_numbers : true;
     bool highlight_current_line = use_settings ? settings->highlight_current_line : true;
     bool show_right_margin = use_settings ? settings->show_right_margin : true;
-    bool bracket_matching = use_settings ? settings->bracket_matching : true;
     bool auto_indent = use_settings ? settings->auto_indent : true;
     bool insert_spaces = use_settings ? settings->insert_spaces : true;
     CursorStyle cursor_style = use_settings ? settings->cursor_style : CURSOR_STYLE_BLOCK;
@@ -130,7 +145,6 @@ GtkWidget *editor_text_create(const EditorSettings *settings) {
     gtk_source_view_set_insert_spaces_instead_of_tabs(GTK_SOURCE_VIEW(editor_state.source_view), insert_spaces);
     gtk_source_view_set_show_right_margin(GTK_SOURCE_VIEW(editor_state.source_view), show_right_margin);
     gtk_source_view_set_right_margin_position(GTK_SOURCE_VIEW(editor_state.source_view), 80);
-    gtk_source_buffer_set_highlight_matching_brackets(editor_state.source_buffer, bracket_matching);
     gtk_source_view_set_smart_home_end(GTK_SOURCE_VIEW(editor_state.source_view), GTK_SOURCE_SMART_HOME_END_BEFORE);
     gtk_source_view_set_smart_backspace(GTK_SOURCE_VIEW(editor_state.source_view), TRUE);
 
@@ -152,10 +166,6 @@ GtkWidget *editor_text_create(const EditorSettings *settings) {
     gtk_text_view_set_bottom_margin(GTK_TEXT_VIEW(editor_state.source_view),
                                      scroll_past_end ? 500 : 8);
 
-    /* Note: Mark occurrences would require custom implementation with GtkSourceSearchContext */
-    /* For now, we just ensure syntax highlighting is enabled */
-    gtk_source_buffer_set_highlight_syntax(editor_state.source_buffer, TRUE);
-
     /* Set cursor style - GtkTextView doesn't support cursor style changes directly */
     /* Block cursor is achieved through overwrite mode */
     if (cursor_style == CURSOR_STYLE_BLOCK) {
@@ -200,10 +210,7 @@ GtkWidget *editor_text_create(const EditorSettings *settings) {
     }
 
     /* Connect signals */
-    g_signal_connect(editor_state.source_buffer, "changed",
-                     G_CALLBACK(on_buffer_changed), NULL);
-    g_signal_connect(editor_state.source_buffer, "notify::cursor-position",
-                     G_CALLBACK(on_cursor_moved), NULL);
+    connect_buffer(editor_state.source_buffer);
 
     editor_state.initialized = true;
     editor_state.modified = false;
@@ -251,6 +258,8 @@ void editor_text_apply_all_settings(const EditorSettings *settings) {
     GtkSourceStyleSchemeManager *scheme_manager = gtk_source_style_scheme_manager_get_default();
     GtkSourceStyleScheme *scheme = gtk_source_style_scheme_manager_get_scheme(scheme_manager, settings->theme);
     if (scheme) {
+        /* Other tabs' buffers pick it up when they are shown */
+        editor_state.style_scheme = scheme;
         gtk_source_buffer_set_style_scheme(editor_state.source_buffer, scheme);
     }
 
@@ -265,6 +274,7 @@ void editor_text_apply_all_settings(const EditorSettings *settings) {
                                               settings->right_margin_position);
 
     /* Apply bracket matching */
+    editor_state.highlight_brackets = settings->bracket_matching;
     gtk_source_buffer_set_highlight_matching_brackets(editor_state.source_buffer,
                                                       settings->bracket_matching);
 
@@ -360,6 +370,60 @@ GtkSourceBuffer *editor_text_get_buffer(void) {
     return editor_state.source_buffer;
 }
 
+GtkSourceBuffer *editor_text_buffer_new(const char *code) {
+    /* Create source buffer with GLSL language */
+    GtkSourceLanguageManager *lang_manager = gtk_source_language_manager_get_default();
+    GtkSourceLanguage *glsl_lang = gtk_source_language_manager_get_language(lang_manager, "glsl");
+
+    GtkSourceBuffer *buffer = gtk_source_buffer_new_with_language(glsl_lang);
+    gtk_source_buffer_set_highlight_syntax(buffer, TRUE);
+    configure_buffer(buffer);
+
+    if (code && code[0]) {
+        /* Loading isn't an edit: nothing to undo */
+        gtk_source_buffer_begin_not_undoable_action(buffer);
+        gtk_text_buffer_set_text(GTK_TEXT_BUFFER(buffer), code, -1);
+        gtk_source_buffer_end_not_undoable_action(buffer);
+
+        GtkTextIter start;
+        gtk_text_buffer_get_start_iter(GTK_TEXT_BUFFER(buffer), &start);
+        gtk_text_buffer_place_cursor(GTK_TEXT_BUFFER(buffer), &start);
+    }
+    gtk_text_buffer_set_modified(GTK_TEXT_BUFFER(buffer), FALSE);
+
+    return buffer;
+}
+
+void editor_text_set_buffer(GtkSourceBuffer *buffer) {
+    if (!buffer || !editor_state.source_view || buffer == editor_state.source_buffer) {
+        return;
+    }
+
+    /* Block completion so the switch doesn't pop it up */
+    GtkSourceCompletion *completion = gtk_source_view_get_completion(GTK_SOURCE_VIEW(editor_state.source_view));
+    if (completion) {
+        gtk_source_completion_block_interactive(completion);
+    }
+
+    /* The previous buffer may be freed by the switch, so let go of it first */
+    disconnect_buffer(editor_state.source_buffer);
+    configure_buffer(buffer);
+    gtk_text_view_set_buffer(GTK_TEXT_VIEW(editor_state.source_view), GTK_TEXT_BUFFER(buffer));
+    editor_state.source_buffer = buffer;
+    connect_buffer(buffer);
+
+    editor_state.modified = gtk_text_buffer_get_modified(GTK_TEXT_BUFFER(buffer));
+
+    if (completion) {
+        gtk_source_completion_unblock_interactive(completion);
+    }
+
+    /* Back to where this buffer was being edited */
+    GtkTextMark *insert = gtk_text_buffer_get_insert(GTK_TEXT_BUFFER(buffer));
+    gtk_text_view_scroll_to_mark(GTK_TEXT_VIEW(editor_state.source_view), insert, 0.25, FALSE, 0.0, 0.0);
+    on_cursor_moved(GTK_TEXT_BUFFER(buffer), NULL, NULL);
+}
+
 GtkWidget *editor_text_get_view(void) {
     return editor_state.source_view;
 }
@@ -488,6 +552,7 @@ void editor_text_destroy(void) {
     editor_state.source_view = NULL;
     editor_state.source_buffer = NULL;
     editor_state.scrolled_window = NULL;
+    editor_state.style_scheme = NULL;
     editor_state.change_callback = NULL;
     editor_state.change_callback_data = NULL;
     editor_state.cursor_callback = NULL;
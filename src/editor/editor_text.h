@@ -20,8 +20,8 @@ typedef struct {
     bool show_minimap;
 } editor_text_config_t;
 
-/* Text change callback signature */
-typedef void (*editor_text_change_callback_t)(const char *text, gpointer user_data);
+/* Text change callback signature (the text isn't copied - use editor_text_get_code) */
+typedef void (*editor_text_change_callback_t)(gpointer user_data);
 
 /* Cursor move callback signature */
 typedef void (*editor_cursor_move_callback_t)(int line, int column, gpointer user_data);
@@ -62,6 +62,26 @@ void editor_text_set_config(const editor_text_config_t *config);
  */
 GtkSourceBuffer *editor_text_get_buffer(void);
 
+/**
+ * Create a buffer set up for the editor (GLSL highlighting, theme, bracket matching)
+ * The initial code is loaded unmodified and can't be undone.
+ *
+ * @param code Initial text (NULL for empty)
+ * @return New buffer (caller owns the reference)
+ */
+GtkSourceBuffer *editor_text_buffer_new(const char *code);
+
+/**
+ * Show a buffer in the editor
+ * Switching keeps each buffer's text, highlighting, cursor and undo
+ * history, so nothing is copied or re-highlighted. The current theme and
+ * bracket matching are applied to it, and the change and cursor callbacks
+ * follow it. The view holds its own reference.
+ *
+ * @param buffer Buffer from editor_text_buffer_new
+ */
+void editor_text_set_buffer(GtkSourceBuffer *buffer);
+
 /**
  * Get the source view widget
  * 
@@ -77,7 +97,7 @@ GtkWidget *editor_text_get_view(void);
 char *editor_text_get_code(void);
 
 /**
- * Set the shader code
+ * Replace the text of the buffer being shown
  * 
  * @param code Shader source code
  */
@@ -93,7 +113,7 @@ void editor_text_get_cursor_position(int *line, int *column);
 
 /**
  * Set text change callback
- * Called when the text buffer is modified
+ * Called when the buffer being shown is modified
  * 
  * @param callback Callback function
  * @param user_data User data passed to callback
@@ -0,0 +1,650 @@
+/* Tab Thumbnails - Implementation
+ * Renders small live previews of every open tab in the background
+ *
+ * Each background tab gets its own multipass instance at thumbnail size,
+ * built without waiting for the driver and collected on later ticks.
+ * A low-rate timer renders them round-robin into a shared atlas (one row
+ * per tab) and stops for the tick once the GPU time budget is used up, so
+ * a preview frame never absorbs more than THUMBNAIL_BUDGET_MS of extra
+ * work. The active tab is not rendered twice: its row is a downscaled
+ * copy of the preview output. Rows are read back through a pixel buffer
+ * object and delivered on the following tick, so reads never wait on the
+ * GPU.
+ */
+
+#include "editor_thumbnails.h"
+#include "editor_tabs.h"
+#include "editor_preview.h"
+#include "../shader_lib/shader_multipass.h"
+#define SHADER_LOG_SUBSYSTEM SHADER_LOG_THUMBNAILS
+#include "../shader_lib/shader_log.h"
+#include "../shader_lib/shader_trace.h"
+#include "platform_compat.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define THUMBNAIL_MAX_ENTRIES 20         /* One atlas row per tab (tab limit) */
+#define THUMBNAIL_INTERVAL_MS 100        /* Queue tick: animated thumbnails run at ~10 fps */
+#define THUMBNAIL_BUDGET_MS 1.0f         /* GPU time thumbnails may add to one frame */
+#define THUMBNAIL_DEFAULT_COST_MS 0.25f  /* Assumed cost until a timer result arrives */
+#define THUMBNAIL_ROW_BYTES (THUMBNAIL_WIDTH * THUMBNAIL_HEIGHT * 4)
+
+typedef struct {
+    int tab_id;
+    int slot;                        /* Atlas row */
+    multipass_shader_t *shader;
+    guint source_revision;           /* Tab revision the shader was built from (or failed on) */
+    bool compiling;                  /* shader is still being built */
+    bool failed;                     /* Source doesn't build - keep the last image */
+    bool rendered;                   /* Row holds at least one frame */
+    bool seen;                       /* Tab still open (sync bookkeeping) */
+} thumbnail_entry_t;
+
+/* Module state */
+static struct {
+    GtkWidget *gl_area;
+    thumbnail_entry_t entries[THUMBNAIL_MAX_ENTRIES];
+    int entry_count;
+    int cursor;                      /* Round-robin start for the next tick */
+    unsigned int used_slots;         /* Bitmask of atlas rows in use */
+    int current_tab;                 /* Tab shown by the preview */
+    bool current_copied;             /* Settled preview frame already copied */
+
+    /* GL resources (preview context) */
+    bool gl_ready;
+    GLuint atlas_fbo;
+    GLuint atlas_texture;
+    GLuint scratch_fbo;
+    GLuint scratch_texture;
+    GLuint pbo;
+
+    /* Readback issued last tick */
+    bool readback_pending;
+    int readback_first;
+    int readback_last;
+    int readback_tabs[THUMBNAIL_MAX_ENTRIES];  /* Tab per row (-1 = row not updated) */
+
+    gint64 start_time;
+    guint timer_id;
+    bool enabled;
+    bool visible;
+    bool optimize_source;            /* Run passes through the source optimizer */
+    editor_thumbnails_callback_t callback;
+    gpointer callback_data;
+} thumb_state = {
+    .gl_area = NULL,
+    .entry_count = 0,
+    .cursor = 0,
+    .used_slots = 0,
+    .current_tab = -1,
+    .current_copied = false,
+    .gl_ready = false,
+    .readback_pending = false,
+    .start_time = 0,
+    .timer_id = 0,
+    .enabled = true,
+    .visible = true,
+    .optimize_source = false,
+    .callback = NULL,
+    .callback_data = NULL
+};
+
+static bool make_current(void) {
+    if (!thumb_state.gl_area || !gtk_widget_get_realized(thumb_state.gl_area)) return false;
+    gtk_gl_area_make_current(GTK_GL_AREA(thumb_state.gl_area));
+    return gtk_gl_area_get_error(GTK_GL_AREA(thumb_state.gl_area)) == NULL;
+}
+
+static bool queue_should_run(void) {
+    return thumb_state.enabled && thumb_state.visible &&
+           thumb_state.gl_area && gtk_widget_get_realized(thumb_state.gl_area) &&
+           !editor_preview_is_paused() && editor_tabs_get_count() > 0;
+}
+
+/* ============================================
+ * GL resources
+ * ============================================ */
+
+static GLuint create_target(GLuint *texture, int width, int height) {
+    GLuint fbo = 0;
+
+    glGenTextures(1, texture);
+    glBindTexture(GL_TEXTURE_2D, *texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, *texture, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        log_error("Thumbnail framebuffer incomplete (%dx%d)", width, height);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return fbo;
+}
+
+static void create_gl_resources(void) {
+    thumb_state.atlas_fbo = create_target(&thumb_state.atlas_texture, THUMBNAIL_WIDTH,
+                                          THUMBNAIL_HEIGHT * THUMBNAIL_MAX_ENTRIES);
+    thumb_state.scratch_fbo = create_target(&thumb_state.scratch_texture,
+                                            THUMBNAIL_WIDTH, THUMBNAIL_HEIGHT);
+
+    glGenBuffers(1, &thumb_state.pbo);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, thumb_state.pbo);
+    glBufferData(GL_PIXEL_PACK_BUFFER, THUMBNAIL_ROW_BYTES * THUMBNAIL_MAX_ENTRIES, NULL, GL_STREAM_READ);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    thumb_state.gl_ready = true;
+}
+
+/* Destroy thumbnail shaders and GL objects (context must be current).
+ * Entries stay, so everything is rebuilt on the next tick. */
+static void release_gl_resources(void) {
+    for (int i = 0; i < thumb_state.entry_count; i++) {
+        thumbnail_entry_t *e = &thumb_state.entries[i];
+        if (e->shader) {
+            multipass_destroy(e->shader);
+            e->shader = NULL;
+        }
+        e->compiling = false;
+        e->failed = false;
+        e->rendered = false;
+    }
+
+    if (thumb_state.gl_ready) {
+        glDeleteFramebuffers(1, &thumb_state.atlas_fbo);
+        glDeleteTextures(1, &thumb_state.atlas_texture);
+        glDeleteFramebuffers(1, &thumb_state.scratch_fbo);
+        glDeleteTextures(1, &thumb_state.scratch_texture);
+        glDeleteBuffers(1, &thumb_state.pbo);
+        thumb_state.atlas_fbo = thumb_state.atlas_texture = 0;
+        thumb_state.scratch_fbo = thumb_state.scratch_texture = 0;
+        thumb_state.pbo = 0;
+    }
+    thumb_state.gl_ready = false;
+    thumb_state.readback_pending = false;
+}
+
+/* ============================================
+ * Tab bookkeeping
+ * ============================================ */
+
+static int find_entry(int tab_id) {
+    for (int i = 0; i < thumb_state.entry_count; i++) {
+        if (thumb_state.entries[i].tab_id == tab_id) return i;
+    }
+    return -1;
+}
+
+static int find_entry_by_slot(int slot) {
+    for (int i = 0; i < thumb_state.entry_count; i++) {
+        if (thumb_state.entries[i].slot == slot) return i;
+    }
+    return -1;
+}
+
+static int add_entry(int tab_id) {
+    if (thumb_state.entry_count >= THUMBNAIL_MAX_ENTRIES) return -1;
+
+    int slot = 0;
+    while (slot < THUMBNAIL_MAX_ENTRIES && (thumb_state.used_slots & (1u << slot))) slot++;
+    if (slot == THUMBNAIL_MAX_ENTRIES) return -1;
+    thumb_state.used_slots |= 1u << slot;
+
+    thumbnail_entry_t *e = &thumb_state.entries[thumb_state.entry_count];
+    memset(e, 0, sizeof(*e));
+    e->tab_id = tab_id;
+    e->slot = slot;
+    return thumb_state.entry_count++;
+}
+
+/* Remove an entry (context must be current if it owns a shader) */
+static void remove_entry(int index) {
+    thumbnail_entry_t *e = &thumb_state.entries[index];
+    if (e->shader) {
+        multipass_destroy(e->shader);
+    }
+    thumb_state.used_slots &= ~(1u << e->slot);
+
+    thumb_state.entry_count--;
+    thumb_state.entries[index] = thumb_state.entries[thumb_state.entry_count];
+    if (thumb_state.cursor >= thumb_state.entry_count) {
+        thumb_state.cursor = 0;
+    }
+}
+
+/* Match entries to the open tabs */
+static void sync_tabs(void) {
+    for (int i = 0; i < thumb_state.entry_count; i++) {
+        thumb_state.entries[i].seen = false;
+    }
+
+    int count = editor_tabs_get_count();
+    for (int i = 0; i < count; i++) {
+        int tab_id = editor_tabs_get_id_at(i);
+        int index = find_entry(tab_id);
+        if (index < 0) index = add_entry(tab_id);
+        if (index >= 0) thumb_state.entries[index].seen = true;
+    }
+
+    for (int i = thumb_state.entry_count - 1; i >= 0; i--) {
+        if (!thumb_state.entries[i].seen) remove_entry(i);
+    }
+
+    int current = editor_tabs_get_current();
+    if (current != thumb_state.current_tab) {
+        thumb_state.current_tab = current;
+        thumb_state.current_copied = false;
+    }
+}
+
+/* Start (re)building a tab's thumbnail shader; finish_entry collects it.
+ * The queue starts at most one build per tick. */
+static void build_entry(thumbnail_entry_t *e, const char *code, guint revision) {
+    if (e->shader) {
+        multipass_destroy(e->shader);
+        e->shader = NULL;
+    }
+    e->source_revision = revision;
+    e->compiling = false;
+    e->failed = true;
+    e->rendered = false;
+
+    if (!code || !code[0]) return;
+
+    multipass_shader_t *shader = multipass_create(code);
+    if (!shader) return;
+
+    const TabInfo *info = editor_tabs_get_info(e->tab_id);
+    char *dir = (info && info->file_path) ? g_path_get_dirname(info->file_path) : NULL;
+    multipass_set_include_context(shader, dir, e->tab_id);
+    multipass_set_source_optimization(shader, thumb_state.optimize_source);
+    g_free(dir);
+
+    /* Fixed size: the atlas row is the whole output */
+    multipass_set_adaptive_resolution(shader, false, 0, 0, 0);
+    multipass_set_resolution_scale(shader, 1.0f);
+
+    if (!multipass_init_gl(shader, THUMBNAIL_WIDTH, THUMBNAIL_HEIGHT) ||
+        !multipass_compile_begin(shader)) {
+        log_info("Thumbnail for tab %d not available (shader does not compile)", e->tab_id);
+        multipass_destroy(shader);
+        return;
+    }
+
+    e->shader = shader;
+    e->compiling = true;
+    e->failed = false;
+}
+
+/* Collect a build started by build_entry. Returns true once it finished. */
+static bool finish_entry(thumbnail_entry_t *e) {
+    multipass_compile_status_t status = multipass_compile_poll(e->shader, false);
+    if (status == MULTIPASS_COMPILE_PENDING) return false;
+
+    e->compiling = false;
+    if (status == MULTIPASS_COMPILE_FAILED) {
+        log_info("Thumbnail for tab %d not available (shader does not compile)", e->tab_id);
+        multipass_destroy(e->shader);
+        e->shader = NULL;
+        e->failed = true;
+    }
+    return true;
+}
+
+/* ============================================
+ * Rendering
+ * ============================================ */
+
+static void render_entry(thumbnail_entry_t *e, float time) {
+    uint64_t span = shader_trace_begin();
+    glBindFramebuffer(GL_FRAMEBUFFER, thumb_state.scratch_fbo);
+    multipass_resize(e->shader, THUMBNAIL_WIDTH, THUMBNAIL_HEIGHT);
+    multipass_render(e->shader, time, 0.0f, 0.0f, false);
+
+    int y = e->slot * THUMBNAIL_HEIGHT;
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, thumb_state.scratch_fbo);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, thumb_state.atlas_fbo);
+    glBlitFramebuffer(0, 0, THUMBNAIL_WIDTH, THUMBNAIL_HEIGHT,
+                      0, y, THUMBNAIL_WIDTH, y + THUMBNAIL_HEIGHT,
+                      GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    e->rendered = true;
+    shader_trace_end(span, SHADER_TRACE_RENDER, "thumbnail", NULL);
+}
+
+/* Downscale what the preview shows into the current tab's row (centre crop) */
+static bool copy_preview(int slot) {
+    GtkWidget *widget = thumb_state.gl_area;
+    if (!gtk_widget_get_mapped(widget)) return false;
+
+    int width = gtk_widget_get_allocated_width(widget);
+    int height = gtk_widget_get_allocated_height(widget);
+    if (width < 1 || height < 1) return false;
+
+    int src_w = width;
+    int src_h = height;
+    if (width * THUMBNAIL_HEIGHT > height * THUMBNAIL_WIDTH) {
+        src_w = height * THUMBNAIL_WIDTH / THUMBNAIL_HEIGHT;
+    } else {
+        src_h = width * THUMBNAIL_HEIGHT / THUMBNAIL_WIDTH;
+    }
+    int x0 = (width - src_w) / 2;
+    int y0 = (height - src_h) / 2;
+
+    /* attach_buffers binds the area's own framebuffer */
+    gtk_gl_area_attach_buffers(GTK_GL_AREA(widget));
+    GLint area_fbo = 0;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &area_fbo);
+
+    int y = slot * THUMBNAIL_HEIGHT;
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, (GLuint)area_fbo);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, thumb_state.atlas_fbo);
+    glBlitFramebuffer(x0, y0, x0 + src_w, y0 + src_h,
+                      0, y, THUMBNAIL_WIDTH, y + THUMBNAIL_HEIGHT,
+                      GL_COLOR_BUFFER_BIT, GL_LINEAR);
+    return true;
+}
+
+/* Queue an asynchronous read of the updated rows */
+static void start_readback(unsigned int rows) {
+    int first = -1;
+    int last = -1;
+    for (int slot = 0; slot < THUMBNAIL_MAX_ENTRIES; slot++) {
+        int index = find_entry_by_slot(slot);
+        bool updated = (rows & (1u << slot)) && index >= 0;
+        thumb_state.readback_tabs[slot] = updated ? thumb_state.entries[index].tab_id : -1;
+        if (updated) {
+            if (first < 0) first = slot;
+            last = slot;
+        }
+    }
+    if (first < 0) return;
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, thumb_state.atlas_fbo);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, thumb_state.pbo);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, first * THUMBNAIL_HEIGHT,
+                 THUMBNAIL_WIDTH, (last - first + 1) * THUMBNAIL_HEIGHT,
+                 GL_RGBA, GL_UNSIGNED_BYTE,
+                 (void *)(intptr_t)(first * THUMBNAIL_ROW_BYTES));
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    thumb_state.readback_first = first;
+    thumb_state.readback_last = last;
+    thumb_state.readback_pending = true;
+}
+
+/* Hand last tick's rows to the tabs (the copy finished long ago) */
+static void deliver_readback(void) {
+    if (!thumb_state.readback_pending) return;
+    thumb_state.readback_pending = false;
+
+    int first = thumb_state.readback_first;
+    int rows = thumb_state.readback_last - first + 1;
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, thumb_state.pbo);
+    const guint8 *data = glMapBufferRange(GL_PIXEL_PACK_BUFFER,
+                                          first * THUMBNAIL_ROW_BYTES,
+                                          rows * THUMBNAIL_ROW_BYTES,
+                                          GL_MAP_READ_BIT);
+    if (data) {
+        for (int r = 0; r < rows; r++) {
+            int tab_id = thumb_state.readback_tabs[first + r];
+            if (tab_id < 0 || !thumb_state.callback) continue;
+
+            /* Opaque RGB, flipped to top-down rows */
+            GdkPixbuf *pixbuf = gdk_pixbuf_new(GDK_COLORSPACE_RGB, FALSE, 8,
+                                               THUMBNAIL_WIDTH, THUMBNAIL_HEIGHT);
+            guint8 *pixels = gdk_pixbuf_get_pixels(pixbuf);
+            int stride = gdk_pixbuf_get_rowstride(pixbuf);
+            const guint8 *src = data + (size_t)r * THUMBNAIL_ROW_BYTES;
+
+            for (int y = 0; y < THUMBNAIL_HEIGHT; y++) {
+                const guint8 *in = src + (size_t)(THUMBNAIL_HEIGHT - 1 - y) * THUMBNAIL_WIDTH * 4;
+                guint8 *out = pixels + (size_t)y * stride;
+                for (int x = 0; x < THUMBNAIL_WIDTH; x++) {
+                    out[x * 3 + 0] = in[x * 4 + 0];
+                    out[x * 3 + 1] = in[x * 4 + 1];
+                    out[x * 3 + 2] = in[x * 4 + 2];
+                }
+            }
+
+            thumb_state.callback(tab_id, pixbuf, thumb_state.callback_data);
+            g_object_unref(pixbuf);
+        }
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+/* One queue step. Returns true while there is more to render. */
+static bool process_queue(void) {
+    bool more = false;
+    bool built = false;
+    unsigned int updated = 0;
+    float time = (float)((g_get_monotonic_time() - thumb_state.start_time) / 1e6);
+
+    /* Background tabs whose source changed get a new shader, one per tick.
+     * The tab's revision tells whether it changed, so the code is only
+     * copied out of the buffer to rebuild. */
+    for (int i = 0; i < thumb_state.entry_count; i++) {
+        thumbnail_entry_t *e = &thumb_state.entries[i];
+        if (e->tab_id == thumb_state.current_tab) continue;
+
+        guint revision = editor_tabs_get_revision(e->tab_id);
+        bool current = revision == e->source_revision && (e->shader || e->failed);
+        if (current && e->compiling) {
+            more |= !finish_entry(e);
+            continue;
+        }
+        bool stale = e->shader && multipass_includes_stale(e->shader);
+        if (current && !stale) continue;
+
+        if (built) {
+            more = true;
+            continue;
+        }
+        if (current) {
+            /* Only an included file changed: rebuild the passes using it */
+            multipass_refresh_includes(e->shader);
+            if (multipass_has_errors(e->shader)) {
+                multipass_destroy(e->shader);
+                e->shader = NULL;
+                e->failed = true;
+            }
+            e->rendered = false;
+        } else {
+            build_entry(e, editor_tabs_get_code(e->tab_id), revision);
+            more |= e->compiling;
+        }
+        built = true;
+    }
+
+    /* Round-robin within the GPU budget. Costs are the instances' own
+     * timer results; a thumbnail that alone exceeds the budget keeps its
+     * last frame instead of animating. */
+    float remaining = THUMBNAIL_BUDGET_MS;
+    int start = thumb_state.cursor;
+    for (int n = 0; n < thumb_state.entry_count; n++) {
+        int i = (start + n) % thumb_state.entry_count;
+        thumbnail_entry_t *e = &thumb_state.entries[i];
+        if (e->tab_id == thumb_state.current_tab || !e->shader || e->compiling) continue;
+
+        bool animated = !multipass_is_static(e->shader);
+        if (e->rendered && !animated) continue;
+
+        float cost = multipass_get_gpu_time_ms(e->shader);
+        if (!e->rendered || cost <= 0.0f) cost = THUMBNAIL_DEFAULT_COST_MS;
+        if (e->rendered && cost > THUMBNAIL_BUDGET_MS) continue;
+
+        if (cost > remaining) {
+            /* Budget used up - continue from here next tick */
+            thumb_state.cursor = i;
+            more = true;
+            break;
+        }
+
+        render_entry(e, time);
+        remaining -= cost;
+        updated |= 1u << e->slot;
+        more |= animated;
+    }
+
+    /* The current tab mirrors the preview: every tick while it animates,
+     * once after it settles */
+    int current = find_entry(thumb_state.current_tab);
+    if (current >= 0) {
+        bool animating = editor_preview_is_active();
+        if ((animating || !thumb_state.current_copied) &&
+            copy_preview(thumb_state.entries[current].slot)) {
+            updated |= 1u << thumb_state.entries[current].slot;
+            thumb_state.current_copied = !animating;
+        }
+        more |= animating;
+    }
+
+    if (updated) {
+        start_readback(updated);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    return more;
+}
+
+static gboolean thumbnails_tick(gpointer user_data) {
+    (void)user_data;
+
+    if (!queue_should_run() || !make_current()) {
+        thumb_state.timer_id = 0;
+        return G_SOURCE_REMOVE;
+    }
+    if (!thumb_state.gl_ready) {
+        create_gl_resources();
+    }
+
+    deliver_readback();
+    sync_tabs();
+
+    if (!process_queue() && !thumb_state.readback_pending) {
+        /* Everything settled - sleep until woken */
+        thumb_state.timer_id = 0;
+        return G_SOURCE_REMOVE;
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+static void stop_timer(void) {
+    if (thumb_state.timer_id) {
+        g_source_remove(thumb_state.timer_id);
+        thumb_state.timer_id = 0;
+    }
+}
+
+/* GL area signals: the context (and everything in it) goes away on unrealize */
+static void on_area_realize(GtkWidget *widget, gpointer user_data) {
+    (void)widget;
+    (void)user_data;
+    editor_thumbnails_wake();
+}
+
+static void on_area_unrealize(GtkWidget *widget, gpointer user_data) {
+    (void)widget;
+    (void)user_data;
+
+    stop_timer();
+    if (make_current()) {
+        release_gl_resources();
+    }
+}
+
+/* Public API Implementation */
+
+void editor_thumbnails_init(GtkWidget *gl_area) {
+    if (!gl_area || thumb_state.gl_area) return;
+
+    thumb_state.gl_area = gl_area;
+    thumb_state.start_time = g_get_monotonic_time();
+    for (int i = 0; i < THUMBNAIL_MAX_ENTRIES; i++) {
+        thumb_state.readback_tabs[i] = -1;
+    }
+
+    g_signal_connect(gl_area, "realize", G_CALLBACK(on_area_realize), NULL);
+    g_signal_connect(gl_area, "unrealize", G_CALLBACK(on_area_unrealize), NULL);
+}
+
+void editor_thumbnails_set_source_optimization(bool enabled) {
+    thumb_state.optimize_source = enabled;
+}
+
+void editor_thumbnails_set_enabled(bool enabled) {
+    if (thumb_state.enabled == enabled) return;
+    thumb_state.enabled = enabled;
+
+    if (enabled) {
+        editor_thumbnails_wake();
+        return;
+    }
+
+    stop_timer();
+    if (make_current()) {
+        release_gl_resources();
+    }
+    while (thumb_state.entry_count > 0) {
+        int tab_id = thumb_state.entries[thumb_state.entry_count - 1].tab_id;
+        remove_entry(thumb_state.entry_count - 1);
+        if (thumb_state.callback) {
+            thumb_state.callback(tab_id, NULL, thumb_state.callback_data);
+        }
+    }
+}
+
+void editor_thumbnails_set_visible(bool visible) {
+    thumb_state.visible = visible;
+    if (visible) {
+        editor_thumbnails_wake();
+    } else {
+        stop_timer();
+    }
+}
+
+void editor_thumbnails_wake(void) {
+    /* Preview state may have changed - re-copy its settled frame */
+    thumb_state.current_copied = false;
+
+    if (thumb_state.timer_id == 0 && queue_should_run()) {
+        thumb_state.timer_id = g_timeout_add(THUMBNAIL_INTERVAL_MS, thumbnails_tick, NULL);
+    }
+}
+
+void editor_thumbnails_includes_changed(void) {
+    /* Shaders that failed may build now; the others refresh when stale */
+    for (int i = 0; i < thumb_state.entry_count; i++) {
+        thumbnail_entry_t *e = &thumb_state.entries[i];
+        if (!e->shader) e->failed = false;
+    }
+    editor_thumbnails_wake();
+}
+
+void editor_thumbnails_set_callback(editor_thumbnails_callback_t callback, gpointer user_data) {
+    thumb_state.callback = callback;
+    thumb_state.callback_data = user_data;
+}
+
+void editor_thumbnails_destroy(void) {
+    stop_timer();
+    if (make_current()) {
+        release_gl_resources();
+    }
+    thumb_state.entry_count = 0;
+    thumb_state.used_slots = 0;
+    thumb_state.callback = NULL;
+    thumb_state.callback_data = NULL;
+
+    if (thumb_state.gl_area) {
+        g_signal_handlers_disconnect_by_func(thumb_state.gl_area, G_CALLBACK(on_area_realize), NULL);
+        g_signal_handlers_disconnect_by_func(thumb_state.gl_area, G_CALLBACK(on_area_unrealize), NULL);
+        thumb_state.gl_area = NULL;
+    }
+}
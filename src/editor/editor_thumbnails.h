@@ -0,0 +1,73 @@
+/* Tab Thumbnails - Header
+ * Renders small live previews of every open tab in the background
+ */
+
+#ifndef EDITOR_THUMBNAILS_H
+#define EDITOR_THUMBNAILS_H
+
+#include <gtk/gtk.h>
+#include <stdbool.h>
+
+/* Size of one thumbnail in the atlas */
+#define THUMBNAIL_WIDTH 128
+#define THUMBNAIL_HEIGHT 72
+
+/* Thumbnail update callback (pixbuf is NULL when the thumbnail was dropped) */
+typedef void (*editor_thumbnails_callback_t)(int tab_id, GdkPixbuf *pixbuf, gpointer user_data);
+
+/**
+ * Initialize thumbnail rendering
+ * Thumbnails share the preview's GL context; their shader instances are
+ * owned here and live independently of the preview's current shader.
+ *
+ * @param gl_area The preview GtkGLArea whose context is used
+ */
+void editor_thumbnails_init(GtkWidget *gl_area);
+
+/**
+ * Enable or disable thumbnails
+ * Disabling releases all thumbnail shaders and clears the tab images.
+ *
+ * @param enabled Whether thumbnails are rendered
+ */
+void editor_thumbnails_set_enabled(bool enabled);
+
+/**
+ * Run thumbnail shaders through the source optimizer
+ * Applies to thumbnails built after the call.
+ *
+ * @param enabled Whether sources are optimized before compiling
+ */
+void editor_thumbnails_set_source_optimization(bool enabled);
+
+/**
+ * Set whether the window is visible (minimised windows render nothing)
+ *
+ * @param visible Window visibility
+ */
+void editor_thumbnails_set_visible(bool visible);
+
+/**
+ * Resume the background queue after tabs, sources or preview state changed
+ */
+void editor_thumbnails_wake(void);
+
+/**
+ * An included file changed on disk: rebuild the thumbnails that use it
+ */
+void editor_thumbnails_includes_changed(void);
+
+/**
+ * Set callback for new thumbnail images
+ *
+ * @param callback Callback function
+ * @param user_data User data to pass to callback
+ */
+void editor_thumbnails_set_callback(editor_thumbnails_callback_t callback, gpointer user_data);
+
+/**
+ * Cleanup thumbnail rendering
+ */
+void editor_thumbnails_destroy(void);
+
+#endif /* EDITOR_THUMBNAILS_H */
@@ -12,12 +12,30 @@
 #include "editor_help.h"
 #include "editor_templates.h"
 #include "editor_tabs.h"
+#include "editor_thumbnails.h"
 #include "file_operations.h"
 #include "keyboard_shortcuts.h"
+#include "../shader_lib/shader_multipass.h"
+#include "../shader_lib/shader_include.h"
+#include "../shader_lib/glsl_lexer.h"
+#include "../shader_lib/shader_trace.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+/* Auto-compile debounce: wait for a pause clearly longer than the usual gap
+ * between keystrokes, plus part of what a compile has been costing, so slow
+ * shaders aren't rebuilt for every half-typed word. The seeds give about
+ * 500 ms until edits and compiles have been measured. */
+#define AUTO_COMPILE_MIN_DELAY_MS 150
+#define AUTO_COMPILE_MAX_DELAY_MS 1500
+#define AUTO_COMPILE_TYPING_FACTOR 2.0
+#define AUTO_COMPILE_COST_FACTOR 0.75
+#define AUTO_COMPILE_MAX_GAP_MS 1500.0     /* Longer gaps are pauses, not typing */
+#define AUTO_COMPILE_SEED_GAP_MS 200.0
+#define AUTO_COMPILE_SEED_COST_MS 130.0
+#define AUTO_COMPILE_SMOOTHING 0.3         /* Weight of the newest measurement */
+
 /* Default shader template */
 static const char *default_shader =
     "// Cosmic Tunnel - NeoWall Shader Editor Demo\n"
@@ -102,7 +120,11 @@ static struct {
     bool was_paused_before_fullscreen;
     ViewMode view_mode_before_fullscreen;
     guint compile_timeout_id;
+    gint64 last_edit_us;                 /* Time of the previous edit (0 = none yet) */
+    double typing_gap_ms;                /* Smoothed gap between edits while typing */
+    double compile_cost_ms;              /* Smoothed time a compile has taken */
     guint fps_update_id;
+    guint include_watch_id;
     guint fullscreen_pause_timeout_id;
 } window_state = {
     .window = NULL,
@@ -128,17 +150,25 @@ static struct {
     .was_paused_before_fullscreen = false,
     .view_mode_before_fullscreen = VIEW_MODE_BOTH,
     .compile_timeout_id = 0,
+    .last_edit_us = 0,
+    .typing_gap_ms = AUTO_COMPILE_SEED_GAP_MS,
+    .compile_cost_ms = AUTO_COMPILE_SEED_COST_MS,
     .fps_update_id = 0,
+    .include_watch_id = 0,
     .fullscreen_pause_timeout_id = 0
 };
 
 /* Forward declarations */
-static void on_text_changed(const char *text, gpointer user_data);
+static void on_text_changed(gpointer user_data);
 static void on_cursor_moved(int line, int column, gpointer user_data);
 static void on_preview_error(const char *error, gpointer user_data);
+static void on_preview_compiled(bool success, double compile_ms, gpointer user_data);
 static void on_gl_realized(GtkGLArea *area, gpointer user_data);
 static gboolean compile_shader_delayed(gpointer user_data);
+static const char *prepare_compile(const TabInfo **info_out);
+static void show_compile_result(bool success);
 static gboolean update_fps_timer(gpointer user_data);
+static void on_preview_activity_changed(bool active, gpointer user_data);
 static void on_view_mode_changed(ViewMode mode, gpointer user_data);
 static void on_preview_double_click(gpointer user_data);
 static gboolean on_fullscreen_key_press(GtkWidget *widget, GdkEventKey *event, gpointer user_data);
@@ -148,6 +178,7 @@ static void on_error_status_clicked(gpointer user_data);
 static void on_paned_size_allocate(GtkWidget *widget, GdkRectangle *allocation, gpointer user_data);
 static void on_tab_changed(int tab_id, void *user_data);
 static bool on_tab_close_request(int tab_id, void *user_data);
+static void on_thumbnail_updated(int tab_id, GdkPixbuf *pixbuf, gpointer user_data);
 
 /* Editor settings */
 static EditorSettings editor_settings;
@@ -666,6 +697,17 @@ static void on_settings_changed(EditorSettings *settings, gpointer user_data) {
 
     /* Apply shader speed to preview */
     editor_preview_set_speed((float)settings->shader_speed);
+    editor_preview_set_reconstruction(settings->reconstruction);
+    editor_preview_set_source_optimization(settings->optimize_source);
+    editor_preview_set_specialize_resolution(settings->specialize_resolution);
+    editor_preview_set_hud(settings->show_hud);
+    editor_preview_set_frame_budget((float)settings->frame_budget_ms);
+    editor_preview_set_vram_budget_mb(settings->vram_budget_mb);
+    editor_preview_set_max_fps(settings->preview_fps);
+    editor_preview_set_cache_budget_mb(settings->shader_cache_mb);
+    shader_include_set_library_path(settings->include_library);
+    editor_thumbnails_set_enabled(settings->tab_thumbnails);
+    editor_thumbnails_set_source_optimization(settings->optimize_source);
 
     /* Update compile button visibility based on auto-compile setting */
     bool compile_visible = !settings->auto_compile;
@@ -756,17 +798,56 @@ static void on_exit_clicked(gpointer user_data) {
     editor_window_close();
 }
 
+/* ============================================
+ * Auto-compile
+ * ============================================ */
+
+static double smooth(double average, double sample) {
+    return average + AUTO_COMPILE_SMOOTHING * (sample - average);
+}
+
+/* Track the typing cadence */
+static void record_edit(void) {
+    gint64 now = g_get_monotonic_time();
+    if (window_state.last_edit_us) {
+        double gap_ms = (double)(now - window_state.last_edit_us) / 1000.0;
+        if (gap_ms < AUTO_COMPILE_MAX_GAP_MS) {
+            window_state.typing_gap_ms = smooth(window_state.typing_gap_ms, gap_ms);
+        }
+    }
+    window_state.last_edit_us = now;
+}
+
+static void record_compile_cost(double compile_ms) {
+    window_state.compile_cost_ms = smooth(window_state.compile_cost_ms, compile_ms);
+}
+
+/* Quiet time after an edit before auto-compiling */
+static guint auto_compile_delay(void) {
+    double delay = AUTO_COMPILE_TYPING_FACTOR * window_state.typing_gap_ms +
+                   AUTO_COMPILE_COST_FACTOR * window_state.compile_cost_ms;
+    if (delay < AUTO_COMPILE_MIN_DELAY_MS) delay = AUTO_COMPILE_MIN_DELAY_MS;
+    if (delay > AUTO_COMPILE_MAX_DELAY_MS) delay = AUTO_COMPILE_MAX_DELAY_MS;
+    return (guint)delay;
+}
+
+/* Check for obviously unfinished code before handing it to the driver */
+static bool precheck_code(const char *code, glsl_precheck_t *problem) {
+    glsl_token_stream_t *tokens = glsl_lex(code);
+    if (!tokens) return true;   /* Out of memory: let the compiler decide */
+    bool ok = glsl_precheck(tokens, problem);
+    glsl_token_stream_free(tokens);
+    return ok;
+}
+
 /* Internal callbacks */
-static void on_text_changed(const char *text, gpointer user_data) {
+static void on_text_changed(gpointer user_data) {
     (void)user_data;
 
-    /* Get current tab */
+    /* Get current tab (the edit went straight into its buffer) */
     int tab_id = editor_tabs_get_current();
     if (tab_id < 0) return;
 
-    /* Update tab's code */
-    editor_tabs_set_code(tab_id, text);
-
     /* Check the actual text buffer modified state */
     bool is_modified = editor_text_is_modified();
     editor_tabs_set_modified(tab_id, is_modified);
@@ -779,12 +860,16 @@ static void on_text_changed(const char *text, gpointer user_data) {
         editor_window_update_title(filename, is_modified);
     }
 
+    /* A compile of the previous text is out of date */
+    editor_preview_cancel_compile();
+    record_edit();
+
     /* Auto-compile with debounce (only if auto-compile is enabled) */
     if (editor_settings.auto_compile) {
         if (window_state.compile_timeout_id) {
             g_source_remove(window_state.compile_timeout_id);
         }
-        window_state.compile_timeout_id = g_timeout_add(500, compile_shader_delayed, NULL);
+        window_state.compile_timeout_id = g_timeout_add(auto_compile_delay(), compile_shader_delayed, NULL);
     }
 }
 
@@ -813,27 +898,179 @@ static void on_gl_realized(GtkGLArea *area, gpointer user_data) {
 
 static gboolean compile_shader_delayed(gpointer user_data) {
     (void)user_data;
-    editor_window_compile_shader();
     window_state.compile_timeout_id = 0;
+
+    const TabInfo *info = NULL;
+    const char *code = prepare_compile(&info);
+    if (!code) {
+        return G_SOURCE_REMOVE;
+    }
+
+    /* Half-typed code would only fail in the driver; wait for the next edit
+     * (F5 still compiles it as it is) */
+    glsl_precheck_t problem;
+    if (!precheck_code(code, &problem)) {
+        char text[192];
+        snprintf(text, sizeof(text), "✎ Not compiled yet - line %d: %s (F5 to compile anyway)",
+                 problem.line, problem.message);
+        editor_statusbar_set_message(text);
+        return G_SOURCE_REMOVE;
+    }
+
+    /* Built in the background; on_preview_compiled reports the result */
+    uint64_t span = shader_trace_begin();
+    bool started = editor_preview_compile_shader_async(code);
+    shader_trace_end(span, SHADER_TRACE_UI, "start compile", info ? info->title : NULL);
+    if (!started) {
+        show_compile_result(false);
+    }
+
     return G_SOURCE_REMOVE;
 }
 
-static gboolean update_fps_timer(gpointer user_data) {
+static void on_preview_compiled(bool success, double compile_ms, gpointer user_data) {
     (void)user_data;
+    record_compile_cost(compile_ms);
+    show_compile_result(success);
+}
+
+/* Status message for a shader that's ready, with its wallpaper suitability */
+static void set_ready_message(const char *message) {
+    float frame_ms = 0.0f;
+    int suitability = editor_preview_get_wallpaper_suitability(&frame_ms);
+    if (suitability < 0) {
+        editor_statusbar_set_message(message);
+        return;
+    }
+
+    char text[160];
+    snprintf(text, sizeof(text), "%s | Wallpaper: %s (est. %.1f ms @1080p)", message,
+             multipass_suitability_name(suitability), frame_ms);
+    editor_statusbar_set_message(text);
+}
+
+/* Refresh the FPS/GPU/resolution readout in the status bar */
+static void update_fps_text(void) {
     double fps = editor_preview_get_fps();
     float scale = editor_preview_get_resolution_scale();
+    float gpu_ms = editor_preview_get_gpu_time_ms();
     
-    /* Show FPS and resolution scale (as percentage) */
-    char fps_text[64];
-    if (editor_preview_is_adaptive_resolution()) {
-        snprintf(fps_text, sizeof(fps_text), "FPS: %.0f | Res: %.0f%% (auto)", fps, scale * 100.0f);
+    /* Show FPS, GPU time (when timer queries exist) and resolution scale (as percentage) */
+    char gpu_text[64] = "";
+    if (gpu_ms > 0.0f) {
+        snprintf(gpu_text, sizeof(gpu_text), " | GPU: %.1f ms", gpu_ms);
+    }
+    /* Suitability follows the estimate as GPU timings calibrate it */
+    int suitability = editor_preview_get_wallpaper_suitability(NULL);
+    if (suitability >= 0) {
+        size_t len = strlen(gpu_text);
+        snprintf(gpu_text + len, sizeof(gpu_text) - len, " | Wallpaper: %s",
+                 multipass_suitability_name(suitability));
+    }
+    char fps_text[128];
+    if (editor_preview_is_paused()) {
+        snprintf(fps_text, sizeof(fps_text), "Paused | Res: %.0f%%", scale * 100.0f);
+    } else if (editor_preview_is_on_demand()) {
+        /* Static shader: frames are only drawn when an input changes */
+        snprintf(fps_text, sizeof(fps_text), "Static (on demand)%s | Res: %.0f%%", gpu_text, scale * 100.0f);
+    } else if (editor_preview_is_adaptive_resolution()) {
+        snprintf(fps_text, sizeof(fps_text), "FPS: %.0f%s | Res: %.0f%% (auto)", fps, gpu_text, scale * 100.0f);
     } else {
-        snprintf(fps_text, sizeof(fps_text), "FPS: %.0f | Res: %.0f%%", fps, scale * 100.0f);
+        snprintf(fps_text, sizeof(fps_text), "FPS: %.0f%s | Res: %.0f%%", fps, gpu_text, scale * 100.0f);
     }
     editor_statusbar_set_fps_text(fps_text);
+}
+
+static gboolean update_fps_timer(gpointer user_data) {
+    (void)user_data;
+    update_fps_text();
     return G_SOURCE_CONTINUE;
 }
 
+/* Poll included files once a second. Only the tabs that include a changed
+ * file recompile: the current one right away (just the passes using it),
+ * background tabs when they're shown, thumbnails on their next tick. */
+static gboolean check_includes_timer(gpointer user_data) {
+    (void)user_data;
+
+    int changed[16];
+    int count = shader_include_check_changes(changed, (int)G_N_ELEMENTS(changed));
+    if (count == 0) {
+        return G_SOURCE_CONTINUE;
+    }
+    if (count > (int)G_N_ELEMENTS(changed)) count = (int)G_N_ELEMENTS(changed);
+
+    int current = editor_tabs_get_current();
+    bool current_depends = false;
+    bool others_depend = false;
+    for (int i = 0; i < count; i++) {
+        int owners[SHADER_INCLUDE_MAX_OWNERS];
+        int owner_count = shader_include_get_dependents(changed[i], owners, SHADER_INCLUDE_MAX_OWNERS);
+        for (int j = 0; j < owner_count; j++) {
+            if (owners[j] == current) {
+                current_depends = true;
+            } else {
+                others_depend = true;
+            }
+        }
+    }
+
+    if (others_depend) {
+        editor_thumbnails_includes_changed();
+    }
+    if (!current_depends) {
+        return G_SOURCE_CONTINUE;
+    }
+
+    if (!editor_preview_has_shader()) {
+        /* Failed before - the changed file may fix it */
+        editor_window_compile_shader();
+        return G_SOURCE_CONTINUE;
+    }
+
+    int recompiled = editor_preview_refresh_includes();
+    if (recompiled > 0) {
+        char message[96];
+        snprintf(message, sizeof(message), "✓ Included file changed, recompiled %d pass%s",
+                 recompiled, recompiled == 1 ? "" : "es");
+        editor_statusbar_set_message(message);
+        editor_error_panel_hide();
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+/* The status timer only runs while the preview produces frames. A whole-second
+ * timeout lets GLib batch the wakeup with other second-granularity timers. */
+static void on_preview_activity_changed(bool active, gpointer user_data) {
+    (void)user_data;
+
+    if (active && window_state.fps_update_id == 0) {
+        window_state.fps_update_id = g_timeout_add_seconds(1, update_fps_timer, NULL);
+    } else if (!active && window_state.fps_update_id) {
+        g_source_remove(window_state.fps_update_id);
+        window_state.fps_update_id = 0;
+    }
+
+    /* Show the final state (paused/static) right away */
+    update_fps_text();
+
+    /* Thumbnails follow pause state and mirror the preview's settled frame */
+    editor_thumbnails_wake();
+}
+
+/* Minimised windows don't need a preview */
+static gboolean on_window_state_event(GtkWidget *widget, GdkEventWindowState *event, gpointer user_data) {
+    (void)widget;
+    (void)user_data;
+
+    if (event->changed_mask & GDK_WINDOW_STATE_ICONIFIED) {
+        bool visible = !(event->new_window_state & GDK_WINDOW_STATE_ICONIFIED);
+        editor_preview_set_window_visible(visible);
+        editor_thumbnails_set_visible(visible);
+    }
+    return FALSE;
+}
+
 /* Tab changed callback */
 static void on_tab_changed(int tab_id, void *user_data) {
     (void)user_data;
@@ -841,10 +1078,11 @@ static void on_tab_changed(int tab_id, void *user_data) {
     const TabInfo *info = editor_tabs_get_info(tab_id);
     if (!info) return;
 
-    /* Update text editor with tab's code */
-    editor_text_set_change_callback(NULL, NULL);
-    editor_text_set_code(info->code);
-    editor_text_set_change_callback(on_text_changed, NULL);
+    /* The previous tab now needs its own thumbnail shader */
+    editor_thumbnails_wake();
+
+    /* Show the tab's own buffer: nothing is copied or re-highlighted */
+    editor_text_set_buffer(editor_tabs_get_buffer(tab_id));
 
     /* Update modified flag */
     editor_statusbar_set_modified(info->is_modified);
@@ -858,13 +1096,28 @@ static void on_tab_changed(int tab_id, void *user_data) {
     const char *filename = info->file_path ? file_operations_get_filename(info->file_path) : info->title;
     editor_window_update_title(filename, info->is_modified);
 
+    /* Reuse the tab's compiled shader if its source is unchanged */
+    const char *code = editor_tabs_get_code(tab_id);
+    if (code && editor_preview_switch_tab(tab_id, code)) {
+        editor_error_panel_hide();
+        set_ready_message("✓ Shader restored from cache");
+        editor_tabs_set_compiled(tab_id, true);
+        return;
+    }
+
     /* Auto-compile the shader for new tabs or recompile if already compiled before */
-    if (info->code && strlen(info->code) > 0) {
+    if (code && code[0] != '\0') {
         editor_window_compile_shader();
         editor_tabs_set_compiled(tab_id, true);
     }
 }
 
+/* New thumbnail image for a tab */
+static void on_thumbnail_updated(int tab_id, GdkPixbuf *pixbuf, gpointer user_data) {
+    (void)user_data;
+    editor_tabs_set_thumbnail(tab_id, pixbuf);
+}
+
 /* Tab close request callback */
 static bool on_tab_close_request(int tab_id, void *user_data) {
     (void)user_data;
@@ -903,6 +1156,11 @@ static bool on_tab_close_request(int tab_id, void *user_data) {
         }
     }
 
+    /* Release the tab's cached shader (its thumbnail goes on the next sync) */
+    editor_preview_forget_tab(tab_id);
+    shader_include_forget_owner(tab_id);
+    editor_thumbnails_wake();
+
     return true; /* Allow close */
 }
 
@@ -958,6 +1216,7 @@ GtkWidget *editor_window_create(GtkApplication *app, const editor_window_config_
     gtk_window_set_default_size(GTK_WINDOW(window_state.window), width, height);
     g_signal_connect(window_state.window, "delete-event", G_CALLBACK(on_delete_event), NULL);
     g_signal_connect(window_state.window, "destroy", G_CALLBACK(on_destroy), NULL);
+    g_signal_connect(window_state.window, "window-state-event", G_CALLBACK(on_window_state_event), NULL);
 
     /* Create main vertical box */
     window_state.main_vbox = gtk_box_new(GTK_ORIENTATION_VERTICAL, 0);
@@ -1018,6 +1277,12 @@ GtkWidget *editor_window_create(GtkApplication *app, const editor_window_config_
     /* Create preview widget (single instance) */
     window_state.preview_widget = editor_preview_create();
     editor_preview_set_error_callback(on_preview_error, NULL);
+    editor_preview_set_activity_callback(on_preview_activity_changed, NULL);
+    editor_preview_set_compile_callback(on_preview_compiled, NULL);
+
+    /* Live tab thumbnails share the preview's GL context */
+    editor_thumbnails_init(window_state.preview_widget);
+    editor_thumbnails_set_callback(on_thumbnail_updated, NULL);
 
     /* Connect to GL realize signal to compile shader when context is ready */
     g_signal_connect(window_state.preview_widget, "realize",
@@ -1106,6 +1371,17 @@ GtkWidget *editor_window_create(GtkApplication *app, const editor_window_config_
 
     /* Apply shader speed to preview */
     editor_preview_set_speed((float)editor_settings.shader_speed);
+    editor_preview_set_reconstruction(editor_settings.reconstruction);
+    editor_preview_set_source_optimization(editor_settings.optimize_source);
+    editor_preview_set_specialize_resolution(editor_settings.specialize_resolution);
+    editor_preview_set_hud(editor_settings.show_hud);
+    editor_preview_set_frame_budget((float)editor_settings.frame_budget_ms);
+    editor_preview_set_vram_budget_mb(editor_settings.vram_budget_mb);
+    editor_preview_set_max_fps(editor_settings.preview_fps);
+    editor_preview_set_cache_budget_mb(editor_settings.shader_cache_mb);
+    shader_include_set_library_path(editor_settings.include_library);
+    editor_thumbnails_set_enabled(editor_settings.tab_thumbnails);
+    editor_thumbnails_set_source_optimization(editor_settings.optimize_source);
 
     /* Connect text change callbacks before creating tabs */
     editor_text_set_change_callback(on_text_changed, NULL);
@@ -1151,8 +1427,7 @@ GtkWidget *editor_window_create(GtkApplication *app, const editor_window_config_
     };
     keyboard_shortcuts_init(window_state.window, &shortcuts_callbacks);
 
-    /* Start FPS update timer */
-    window_state.fps_update_id = g_timeout_add(100, update_fps_timer, NULL);
+    /* FPS update timer is started by on_preview_activity_changed once frames flow */
 
     window_state.is_open = true;
 
@@ -1297,19 +1572,36 @@ void editor_window_load_default_shader(void) {
     editor_tabs_new("Untitled", default_shader);
 }
 
-bool editor_window_compile_shader(void) {
-    char *code = editor_text_get_code();
+/* Get the current tab's code and point #include at its directory (NULL = nothing to compile).
+ * The code belongs to the tab and stays valid until the next edit. */
+static const char *prepare_compile(const TabInfo **info_out) {
+    int current = editor_tabs_get_current();
+    const char *code = (current >= 0) ? editor_tabs_get_code(current) : NULL;
 
     /* Safety check - ensure we have valid code to compile */
-    if (!code || strlen(code) == 0) {
-        g_free(code);
-        return false;
+    if (!code || code[0] == '\0') {
+        return NULL;
     }
 
-    bool success = editor_preview_compile_shader(code);
+    /* #include resolves next to the tab's file first */
+    const TabInfo *info = editor_tabs_get_info(current);
+    char *dir = (info && info->file_path) ? g_path_get_dirname(info->file_path) : NULL;
+    editor_preview_set_include_dir(dir);
+    g_free(dir);
+
+    *info_out = info;
+    return code;
+}
+
+/* Status bar, error panel and tab state after a compile */
+static void show_compile_result(bool success) {
+    /* Watch included files once a shader used any */
+    if (window_state.include_watch_id == 0 && shader_include_module_count() > 0) {
+        window_state.include_watch_id = g_timeout_add_seconds(1, check_includes_timer, NULL);
+    }
 
     if (success) {
-        editor_statusbar_set_message("✓ Shader compiled successfully");
+        set_ready_message("✓ Shader compiled successfully");
         /* Hide error panel on successful compilation */
         editor_error_panel_hide();
 
@@ -1322,8 +1614,23 @@ bool editor_window_compile_shader(void) {
         /* Show brief error in status bar - user can click to see details */
         editor_statusbar_set_error("❌ Compilation failed");
     }
+}
+
+bool editor_window_compile_shader(void) {
+    const TabInfo *info = NULL;
+    const char *code = prepare_compile(&info);
+    if (!code) {
+        return false;
+    }
+
+    uint64_t span = shader_trace_begin();
+    gint64 start = g_get_monotonic_time();
+    bool success = editor_preview_compile_shader(code);
+    record_compile_cost((double)(g_get_monotonic_time() - start) / 1000.0);
+    shader_trace_end(span, SHADER_TRACE_UI, "compile shader", info ? info->title : NULL);
+
+    show_compile_result(success);
 
-    g_free(code);
     return success;
 }
 
@@ -1361,8 +1668,15 @@ void editor_window_destroy(void) {
         window_state.fps_update_id = 0;
     }
 
+    if (window_state.include_watch_id) {
+        g_source_remove(window_state.include_watch_id);
+        window_state.include_watch_id = 0;
+    }
+
     /* Destroy components in order - preview first to ensure GL cleanup happens properly */
+    editor_thumbnails_destroy();
     editor_preview_destroy();
+    shader_include_clear();
     editor_text_destroy();
     editor_toolbar_destroy();
     editor_statusbar_destroy();
@@ -3,6 +3,7 @@
  */
 
 #include "file_operations.h"
+#include "../shader_lib/shader_trace.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -95,7 +96,10 @@ char *file_operations_load_file(const char *path, char **error) {
     char *contents = NULL;
     gsize length = 0;
 
-    if (!g_file_get_contents(path, &contents, &length, &gerror)) {
+    uint64_t span = shader_trace_begin();
+    bool loaded = g_file_get_contents(path, &contents, &length, &gerror);
+    shader_trace_end(span, SHADER_TRACE_IO, "load", path);
+    if (!loaded) {
         if (error) *error = g_strdup(gerror->message);
         g_error_free(gerror);
         return NULL;
@@ -112,7 +116,10 @@ bool file_operations_save_file(const char *path, const char *code, char **error)
     }
 
     GError *gerror = NULL;
-    if (!g_file_set_contents(path, code, -1, &gerror)) {
+    uint64_t span = shader_trace_begin();
+    bool saved = g_file_set_contents(path, code, -1, &gerror);
+    shader_trace_end(span, SHADER_TRACE_IO, "save", path);
+    if (!saved) {
         if (error) *error = g_strdup(gerror->message);
         g_error_free(gerror);
         return false;
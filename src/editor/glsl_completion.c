@@ -1,4 +1,5 @@
 #include "glsl_completion.h"
+#include "../shader_lib/glsl_lexer.h"
 #include <string.h>
 
 /* GLSL keywords and types */
@@ -170,6 +171,113 @@ static void populate_proposals(GLSLCompletionProvider *provider) {
     provider->proposals = g_list_reverse(provider->proposals);
 }
 
+/* Type keywords that can start a declaration */
+static bool is_type_word(glsl_word_t word) {
+    return (word >= GLSL_WORD_FLOAT && word <= GLSL_WORD_BOOL) ||
+           (word >= GLSL_WORD_MAT2 && word <= GLSL_WORD_USAMPLER2D) ||
+           word == GLSL_WORD_STRUCT;
+}
+
+/* Index of the token containing a byte offset (cursor just after it counts), or -1 */
+static int token_at_offset(const glsl_token_stream_t *tokens, size_t offset) {
+    int lo = 0;
+    int hi = tokens->count - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        const glsl_token_t *t = &tokens->tokens[mid];
+        if (offset <= t->offset) {
+            hi = mid - 1;
+        } else if (offset > t->offset + t->length) {
+            lo = mid + 1;
+        } else {
+            return mid;
+        }
+    }
+    return -1;
+}
+
+/* Check whether the cursor is inside a comment or string (no completion there).
+ * Text after the cursor isn't lexed, so one still open there counts. */
+static bool cursor_in_comment(const glsl_token_stream_t *tokens, size_t offset) {
+    int index = token_at_offset(tokens, offset);
+    if (index < 0) return false;
+
+    const glsl_token_t *t = &tokens->tokens[index];
+    const char *text = tokens->source + t->offset;
+    const char *last = text + t->length - 1;
+    size_t end = t->offset + t->length;
+
+    switch (t->type) {
+        case GLSL_TOKEN_COMMENT:
+            if (text[1] == '/') return true;                      /* Runs to the end of the line */
+            if (t->length >= 4 && last[-1] == '*' && last[0] == '/') return offset < end;
+            return true;                                           /* Unterminated block comment */
+        case GLSL_TOKEN_STRING:
+            if (t->length >= 2 && *last == '"') return offset < end;
+            return true;
+        default:
+            return false;
+    }
+}
+
+/* Add one document symbol proposal, skipping duplicates and built-ins */
+static void add_document_symbol(GList **items, GHashTable *seen, const char *name, size_t length,
+                                bool is_function, const char *info) {
+    if (glsl_lookup_word(name, length) != GLSL_WORD_NONE) return;
+
+    char *label = g_strndup(name, length);
+    if (g_hash_table_contains(seen, label)) {
+        g_free(label);
+        return;
+    }
+
+    char *text = is_function ? g_strdup_printf("%s()", label) : g_strdup(label);
+    *items = g_list_prepend(*items, create_proposal(label, text, info));
+    g_hash_table_add(seen, label);
+    g_free(text);
+}
+
+/* Functions, variables and macros declared above the cursor, from one lex
+ * of that text. The identifier under the cursor (being typed) is not offered. */
+static GList *collect_document_symbols(const glsl_token_stream_t *tokens, int cursor_token) {
+    GList *items = NULL;
+    GHashTable *seen = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+    for (int i = 0; i < tokens->count; i++) {
+        const glsl_token_t *t = &tokens->tokens[i];
+        const char *text = tokens->source + t->offset;
+
+        if (t->type == GLSL_TOKEN_PREPROCESSOR) {
+            /* #define NAME */
+            const char *p = text + 1;
+            while (*p == ' ' || *p == '\t') p++;
+            if (strncmp(p, "define", 6) != 0) continue;
+            p += 6;
+            while (*p == ' ' || *p == '\t') p++;
+            const char *name = p;
+            while (g_ascii_isalnum(*p) || *p == '_') p++;
+            if (p > name) {
+                add_document_symbol(&items, seen, name, (size_t)(p - name), false, "Macro in this shader");
+            }
+            continue;
+        }
+
+        if (t->type != GLSL_TOKEN_IDENTIFIER || t->word != GLSL_WORD_NONE || i == cursor_token) {
+            continue;
+        }
+
+        int prev = glsl_prev_code_token(tokens, i);
+        if (prev < 0 || !is_type_word(tokens->tokens[prev].word)) continue;
+
+        bool is_function = glsl_token_is_punct(tokens, glsl_next_code_token(tokens, i), "(");
+        add_document_symbol(&items, seen, text, t->length, is_function,
+                            is_function ? "Function in this shader" : "Variable in this shader");
+    }
+
+    g_hash_table_destroy(seen);
+    return g_list_reverse(items);
+}
+
 /* Forward declaration */
 static void glsl_completion_provider_finalize(GObject *object);
 
@@ -204,8 +312,37 @@ static void provider_populate(GtkSourceCompletionProvider *provider,
     gchar *word = gtk_text_iter_get_text(&start, &iter);
     gsize word_len = word ? strlen(word) : 0;
 
-    /* Filter proposals based on prefix */
+    /* Lex the text before the cursor: skip comments/strings and offer its
+     * own symbols. GLSL only sees what is declared above, so the rest of
+     * the document is neither copied nor lexed. */
+    GtkTextIter doc_start;
+    gtk_text_buffer_get_start_iter(gtk_text_iter_get_buffer(&iter), &doc_start);
+    gchar *text = gtk_text_iter_get_text(&doc_start, &iter);
+    size_t cursor = strlen(text);
+    glsl_token_stream_t *tokens = glsl_lex(text);
+
+    if (tokens && cursor_in_comment(tokens, cursor)) {
+        glsl_token_stream_free(tokens);
+        g_free(text);
+        g_free(word);
+        gtk_source_completion_context_add_proposals(context, provider, NULL, TRUE);
+        return;
+    }
+
+    GList *symbols = tokens ? collect_document_symbols(tokens, token_at_offset(tokens, cursor)) : NULL;
+    glsl_token_stream_free(tokens);
+    g_free(text);
+
+    /* Filter proposals based on prefix (document symbols first) */
     GList *filtered = NULL;
+    for (GList *item = symbols; item != NULL; item = item->next) {
+        gchar *label = NULL;
+        g_object_get(item->data, "label", &label, NULL);
+        if (label && (word_len == 0 || g_str_has_prefix(label, word))) {
+            filtered = g_list_prepend(filtered, item->data);
+        }
+        g_free(label);
+    }
     for (GList *item = glsl_provider->proposals; item != NULL; item = item->next) {
         GtkSourceCompletionItem *proposal = GTK_SOURCE_COMPLETION_ITEM(item->data);
         gchar *label = NULL;
@@ -222,6 +359,7 @@ static void provider_populate(GtkSourceCompletionProvider *provider,
 
     gtk_source_completion_context_add_proposals(context, provider, filtered, TRUE);
     g_list_free(filtered);
+    g_list_free_full(symbols, g_object_unref);
 }
 
 static gboolean provider_match(GtkSourceCompletionProvider *provider,
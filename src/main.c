@@ -14,6 +14,9 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include "shader_editor.h"
+#include "bench/shader_bench.h"
+#include "shader_lib/shader_log.h"
+#include "shader_lib/shader_trace.h"
 
 #define APP_ID "com.neowall.gleditor"
 #define APP_NAME "NeoWall Shader Editor"
@@ -30,12 +33,15 @@ static AppContext app_context = {0};
 /* Command line options */
 static gboolean opt_version = FALSE;
 static gboolean opt_verbose = FALSE;
+static gchar *opt_trace = NULL;
 
 static GOptionEntry options[] = {
     { "version", 'v', 0, G_OPTION_ARG_NONE, &opt_version,
       "Show version information", NULL },
     { "verbose", 'V', 0, G_OPTION_ARG_NONE, &opt_verbose,
       "Enable verbose output", NULL },
+    { "trace", 0, 0, G_OPTION_ARG_FILENAME, &opt_trace,
+      "Record a Chrome/Perfetto trace to FILE", "FILE" },
     { NULL }
 };
 
@@ -70,8 +76,10 @@ static void print_help(void) {
     printf("Options:\n");
     printf("  -v, --version     Show version information\n");
     printf("  -V, --verbose     Enable verbose output\n");
+    printf("  --trace FILE      Record a Chrome/Perfetto trace (or set GLEDITOR_TRACE)\n");
     printf("  -h, --help        Show this help message\n");
     printf("\n");
+    shader_bench_print_usage();
     printf("Features:\n");
     printf("  • Real-time shader compilation and preview\n");
     printf("  • GLSL syntax highlighting\n");
@@ -170,6 +178,14 @@ static gint on_command_line(GtkApplication *app,
         return 0;
     }
 
+    /* Verbose output includes the shader library's debug log */
+    if (opt_verbose) {
+        shader_log_set_level(SHADER_LOG_ALL, LOG_LEVEL_DEBUG);
+    }
+    if (opt_trace) {
+        shader_trace_start(opt_trace);
+    }
+
     /* Activate the application (show window) */
     g_application_activate(G_APPLICATION(app));
 
@@ -181,6 +197,14 @@ static gint on_command_line(GtkApplication *app,
 int main(int argc, char *argv[]) {
     int status;
 
+    /* Tracing from the first event when GLEDITOR_TRACE is set */
+    shader_trace_start(NULL);
+
+    /* Benchmark mode runs headless, without GTK */
+    if (shader_bench_requested(argc, argv)) {
+        return shader_bench_main(argc, argv);
+    }
+
     printf("Starting gleditor [Multipass-Fixed]...\n");
 
     /* Handle help flag early (before GTK initialization) */
@@ -0,0 +1,1307 @@
+/* GLSL Channel Analysis - Implementation
+ * Expression provenance over the lexer's token stream
+ */
+
+#include "glsl_channels.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* ============================================
+ * Values and provenance
+ * ============================================ */
+
+/* What a value was computed from (bit flags) */
+enum {
+    PROV_FRAGCOORD   = 1u << 0,    /* Affine in the pixel position */
+    PROV_RESOLUTION  = 1u << 1,    /* iResolution, iChannelResolution, textureSize() */
+    PROV_TIME        = 1u << 2,    /* iTime, iFrame, iDate, ... */
+    PROV_MOUSE       = 1u << 3,    /* iMouse */
+    PROV_CONSTANT    = 1u << 4,    /* Literals */
+    PROV_SMALL_SCALE = 1u << 5,    /* Divided by >= 64 or scaled by <= 1/64 */
+    PROV_TILED       = 1u << 6,    /* Wrapped to a texture-sized tile with & or % */
+    PROV_GEOMETRY    = 1u << 7,    /* Non-linear in the pixel position */
+    PROV_UNKNOWN     = 1u << 8,    /* Unresolved name or call */
+    PROV_CHANNEL0    = 1u << 9,    /* Result of a read of iChannel0 (iChannel3 = bit 12) */
+    PROV_PARAM0      = 1u << 16    /* Parameter 0 of the enclosing function (7 = bit 23) */
+};
+#define PROV_CHANNEL_MASK (0xFu << 9)
+#define PROV_PARAM_MASK (0xFFu << 16)
+#define MAX_PARAMS 8
+#define MAX_ARGS 16
+
+/* A coordinate divided by at least this much no longer follows pixels:
+ * it walks a lookup texture (noise tiles are 64-1024 texels wide) */
+#define SMALL_SCALE_DIVISOR 64.0
+
+/* Blend weights in this range on a previous read are a decay/feedback loop */
+#define DECAY_MIN 0.9
+
+/* Recursion limit for nested expressions and blocks */
+#define MAX_DEPTH 200
+
+/* Read counts saturate here (helpers calling helpers multiply them) */
+#define MAX_READ_COUNT (1 << 24)
+
+typedef struct {
+    unsigned int prov;
+    int components;        /* 1-4, 0 when unknown (matrices, structs) */
+    bool array;            /* Indexing selects an element, not a component */
+    bool has_value;        /* Constant whose components are all 'value' */
+    double value;
+    int sampler;           /* 1 + channel for iChannelN, -(1 + k) for sampler parameter k */
+    int symbol;            /* Variable the value was read from, -1 if none */
+    bool partial;          /* Swizzle, member or element of that variable */
+} value_t;
+
+static value_t value_of(unsigned int prov, int components) {
+    value_t v;
+    memset(&v, 0, sizeof(v));
+    v.prov = prov;
+    v.components = components;
+    v.symbol = -1;
+    return v;
+}
+
+static value_t value_constant(double value, int components) {
+    value_t v = value_of(PROV_CONSTANT, components);
+    v.has_value = true;
+    v.value = value;
+    return v;
+}
+
+static value_t value_merge(value_t a, value_t b) {
+    value_t v = value_of(a.prov | b.prov, a.components > b.components ? a.components : b.components);
+    return v;
+}
+
+/* The pixel position went through something non-linear */
+static unsigned int prov_geometry(unsigned int prov) {
+    if (prov & PROV_FRAGCOORD) {
+        prov = (prov & ~PROV_FRAGCOORD) | PROV_GEOMETRY;
+    }
+    return prov;
+}
+
+static double value_abs(double value) {
+    return value < 0.0 ? -value : value;
+}
+
+/* ============================================
+ * Parser state
+ * ============================================ */
+
+typedef enum {
+    SYMBOL_VARIABLE,
+    SYMBOL_FUNCTION,
+    SYMBOL_TYPE
+} symbol_kind_t;
+
+typedef struct {
+    const char *name;
+    unsigned int length;
+    symbol_kind_t kind;
+    value_t value;           /* Variable value, or function return value */
+    int pending_first;       /* Function: reads resolved at each call site */
+    int pending_count;
+    int calls;
+    int next;                /* Older symbol in the same bucket */
+} symbol_t;
+
+/* A read inside a function whose channel or coordinate depends on arguments */
+typedef struct {
+    int channel;             /* 0-3, or -(1 + k) for sampler parameter k */
+    unsigned int prov;
+    int components;
+    bool fetch;
+    int count;               /* Identical reads of the function merged into this one */
+} pending_read_t;
+
+#define SYMBOL_BUCKETS 256
+
+typedef struct {
+    const glsl_token_stream_t *stream;
+    int pos;                 /* Current code token, stream->count at the end */
+    int depth;
+    bool failed;
+
+    symbol_t *symbols;
+    int symbol_count;
+    int symbol_capacity;
+    int buckets[SYMBOL_BUCKETS];
+
+    pending_read_t *pending;
+    int pending_count;
+    int pending_capacity;
+
+    int function;            /* Symbol of the function being parsed, -1 at global scope */
+    bool defer_reads;        /* Parsing Common: reads only count when the pass calls them */
+
+    glsl_channel_usage_t *usage;
+} parser_t;
+
+/* ============================================
+ * Token access
+ * ============================================ */
+
+/* Next token that is code (comments and preprocessor lines are skipped) */
+static int next_code(const parser_t *p, int index) {
+    const glsl_token_stream_t *s = p->stream;
+    index++;
+    while (index < s->count && (s->tokens[index].type == GLSL_TOKEN_COMMENT ||
+                                s->tokens[index].type == GLSL_TOKEN_PREPROCESSOR)) {
+        index++;
+    }
+    return index;
+}
+
+static void advance(parser_t *p) {
+    if (p->pos < p->stream->count) p->pos = next_code(p, p->pos);
+}
+
+static const glsl_token_t *token_at(const parser_t *p, int index) {
+    return (index >= 0 && index < p->stream->count) ? &p->stream->tokens[index] : NULL;
+}
+
+static bool at_end(const parser_t *p) {
+    return p->pos >= p->stream->count || p->failed;
+}
+
+static bool is_punct(const parser_t *p, int index, const char *punct) {
+    return glsl_token_is_punct(p->stream, index, punct);
+}
+
+static bool accept(parser_t *p, const char *punct) {
+    if (!is_punct(p, p->pos, punct)) return false;
+    advance(p);
+    return true;
+}
+
+static glsl_word_t word_at(const parser_t *p, int index) {
+    const glsl_token_t *t = token_at(p, index);
+    return t ? t->word : GLSL_WORD_NONE;
+}
+
+static bool text_is(const parser_t *p, int index, const char *text) {
+    const glsl_token_t *t = token_at(p, index);
+    size_t length = strlen(text);
+    return t && t->length == length && memcmp(p->stream->source + t->offset, text, length) == 0;
+}
+
+/* Skip a bracketed group starting at the current token */
+static void skip_group(parser_t *p) {
+    int end = glsl_find_matching(p->stream, p->pos);
+    p->pos = end;
+    advance(p);
+}
+
+/* ============================================
+ * Symbols
+ * ============================================ */
+
+static unsigned int name_bucket(const char *name, unsigned int length) {
+    uint32_t hash = 2166136261u;
+    for (unsigned int i = 0; i < length; i++) {
+        hash = (hash ^ (unsigned char)name[i]) * 16777619u;
+    }
+    return hash & (SYMBOL_BUCKETS - 1);
+}
+
+static int symbol_find(const parser_t *p, const char *name, unsigned int length) {
+    for (int s = p->buckets[name_bucket(name, length)]; s >= 0; s = p->symbols[s].next) {
+        if (p->symbols[s].length == length && memcmp(p->symbols[s].name, name, length) == 0) {
+            return s;
+        }
+    }
+    return -1;
+}
+
+static int symbol_find_token(const parser_t *p, int index) {
+    const glsl_token_t *t = token_at(p, index);
+    if (!t || t->type != GLSL_TOKEN_IDENTIFIER) return -1;
+    return symbol_find(p, p->stream->source + t->offset, t->length);
+}
+
+/* Declare the identifier at index (shadows older symbols of that name) */
+static int symbol_add(parser_t *p, int index, symbol_kind_t kind, value_t value) {
+    const glsl_token_t *t = token_at(p, index);
+    if (!t || t->type != GLSL_TOKEN_IDENTIFIER) return -1;
+
+    if (p->symbol_count == p->symbol_capacity) {
+        int capacity = p->symbol_capacity ? p->symbol_capacity * 2 : 64;
+        symbol_t *symbols = realloc(p->symbols, (size_t)capacity * sizeof(symbol_t));
+        if (!symbols) {
+            p->failed = true;
+            return -1;
+        }
+        p->symbols = symbols;
+        p->symbol_capacity = capacity;
+    }
+
+    int s = p->symbol_count++;
+    symbol_t *symbol = &p->symbols[s];
+    memset(symbol, 0, sizeof(*symbol));
+    symbol->name = p->stream->source + t->offset;
+    symbol->length = t->length;
+    symbol->kind = kind;
+    symbol->value = value;
+    symbol->value.symbol = -1;
+
+    unsigned int bucket = name_bucket(symbol->name, symbol->length);
+    symbol->next = p->buckets[bucket];
+    p->buckets[bucket] = s;
+    return s;
+}
+
+/* Drop every symbol declared since mark (symbols are a stack, so each is
+ * the newest entry of its bucket when it is popped) */
+static void scope_pop(parser_t *p, int mark) {
+    while (p->symbol_count > mark) {
+        symbol_t *symbol = &p->symbols[--p->symbol_count];
+        p->buckets[name_bucket(symbol->name, symbol->length)] = symbol->next;
+    }
+}
+
+/* ============================================
+ * Types
+ * ============================================ */
+
+static bool is_qualifier(glsl_word_t word) {
+    switch (word) {
+        case GLSL_WORD_CONST: case GLSL_WORD_UNIFORM: case GLSL_WORD_ATTRIBUTE:
+        case GLSL_WORD_VARYING: case GLSL_WORD_BUFFER: case GLSL_WORD_SHARED:
+        case GLSL_WORD_CENTROID: case GLSL_WORD_FLAT: case GLSL_WORD_SMOOTH:
+        case GLSL_WORD_NOPERSPECTIVE: case GLSL_WORD_IN: case GLSL_WORD_OUT:
+        case GLSL_WORD_INOUT: case GLSL_WORD_INVARIANT: case GLSL_WORD_PRECISE:
+        case GLSL_WORD_LOWP: case GLSL_WORD_MEDIUMP: case GLSL_WORD_HIGHP:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static bool is_sampler_word(glsl_word_t word) {
+    return word >= GLSL_WORD_SAMPLER2D && word <= GLSL_WORD_USAMPLER2D;
+}
+
+/* Whether the token names a type; components is 1-4 for scalars and
+ * vectors, 0 for matrices, samplers, void and structs */
+static bool type_at(const parser_t *p, int index, int *components) {
+    glsl_word_t word = word_at(p, index);
+    *components = 0;
+
+    if (word >= GLSL_WORD_FLOAT && word <= GLSL_WORD_BOOL) {
+        *components = (word == GLSL_WORD_VOID) ? 0 : 1;
+        return true;
+    }
+    if (word >= GLSL_WORD_VEC2 && word <= GLSL_WORD_DVEC4) {
+        *components = 2 + (int)(word - GLSL_WORD_VEC2) % 3;
+        return true;
+    }
+    if ((word >= GLSL_WORD_MAT2 && word <= GLSL_WORD_MAT4X4) || is_sampler_word(word)) {
+        return true;
+    }
+
+    int s = symbol_find_token(p, index);
+    return s >= 0 && p->symbols[s].kind == SYMBOL_TYPE;
+}
+
+/* Skip qualifiers and layout(...) at the current token */
+static void skip_qualifiers(parser_t *p) {
+    for (;;) {
+        glsl_word_t word = word_at(p, p->pos);
+        if (word == GLSL_WORD_LAYOUT) {
+            advance(p);
+            if (is_punct(p, p->pos, "(")) skip_group(p);
+        } else if (is_qualifier(word)) {
+            advance(p);
+        } else {
+            return;
+        }
+    }
+}
+
+/* Whether a declaration starts at the current token */
+static bool starts_declaration(const parser_t *p) {
+    int i = p->pos;
+    for (;;) {
+        glsl_word_t word = word_at(p, i);
+        if (word == GLSL_WORD_STRUCT) return true;
+        if (word == GLSL_WORD_LAYOUT) {
+            i = next_code(p, i);
+            if (is_punct(p, i, "(")) i = next_code(p, glsl_find_matching(p->stream, i));
+        } else if (is_qualifier(word)) {
+            i = next_code(p, i);
+        } else {
+            break;
+        }
+    }
+
+    int components;
+    if (!type_at(p, i, &components)) return false;
+    i = next_code(p, i);
+    if (is_punct(p, i, "[")) i = next_code(p, glsl_find_matching(p->stream, i));
+
+    const glsl_token_t *t = token_at(p, i);
+    return t && t->type == GLSL_TOKEN_IDENTIFIER;
+}
+
+/* ============================================
+ * Channel reads
+ * ============================================ */
+
+static glsl_read_kind_t classify_read(unsigned int prov, int components, bool fetch) {
+    if (prov & (PROV_SMALL_SCALE | PROV_TILED)) return GLSL_READ_NOISE;
+    /* A 3D coordinate into a 2D channel is a volume/cubemap style lookup */
+    if (!fetch && components == 3) return GLSL_READ_WORLD;
+    if (prov & PROV_FRAGCOORD) return GLSL_READ_SCREEN;
+    if (prov & PROV_GEOMETRY) return GLSL_READ_WORLD;
+    if (prov & PROV_UNKNOWN) return GLSL_READ_UNKNOWN;
+    if (prov & (PROV_CHANNEL_MASK | PROV_MOUSE)) return GLSL_READ_INDIRECT;
+    if (prov & PROV_TIME) return GLSL_READ_WORLD;
+    return GLSL_READ_STATE;
+}
+
+static int add_count(int a, int b) {
+    return a > MAX_READ_COUNT - b ? MAX_READ_COUNT : a + b;
+}
+
+/* Count 'count' identical reads. Inside a function they are deferred to its
+ * call sites; identical ones are merged, so a chain of helpers that each call
+ * the next several times costs one entry per distinct read, not one per path. */
+static void record_read(parser_t *p, int channel, unsigned int prov, int components, bool fetch,
+                        int count) {
+    bool needs_arguments = channel < 0 || (prov & PROV_PARAM_MASK);
+
+    if (p->function >= 0 && (needs_arguments || p->defer_reads)) {
+        for (int i = p->symbols[p->function].pending_first; i < p->pending_count; i++) {
+            pending_read_t *read = &p->pending[i];
+            if (read->channel == channel && read->prov == prov &&
+                read->components == components && read->fetch == fetch) {
+                read->count = add_count(read->count, count);
+                return;
+            }
+        }
+
+        if (p->pending_count == p->pending_capacity) {
+            int capacity = p->pending_capacity ? p->pending_capacity * 2 : 32;
+            pending_read_t *pending = realloc(p->pending, (size_t)capacity * sizeof(pending_read_t));
+            if (!pending) {
+                p->failed = true;
+                return;
+            }
+            p->pending = pending;
+            p->pending_capacity = capacity;
+        }
+        pending_read_t *read = &p->pending[p->pending_count++];
+        read->channel = channel;
+        read->prov = prov;
+        read->components = components;
+        read->fetch = fetch;
+        read->count = count;
+        return;
+    }
+
+    if (channel < 0 || channel >= GLSL_CHANNEL_COUNT) return;
+    if (prov & PROV_PARAM_MASK) {
+        prov = (prov & ~PROV_PARAM_MASK) | PROV_UNKNOWN;
+    }
+    int *reads = &p->usage[channel].reads[classify_read(prov, components, fetch)];
+    *reads = add_count(*reads, count);
+}
+
+/* Replace parameter bits with the provenance of the call's arguments */
+static unsigned int substitute_params(unsigned int prov, const value_t *args, int arg_count) {
+    unsigned int result = prov & ~PROV_PARAM_MASK;
+    for (int k = 0; k < MAX_PARAMS; k++) {
+        if (prov & (PROV_PARAM0 << k)) {
+            result |= (k < arg_count) ? args[k].prov : PROV_UNKNOWN;
+        }
+    }
+    return result;
+}
+
+/* Re-run a function's reads with the arguments of one call */
+static void resolve_call(parser_t *p, int function, const value_t *args, int arg_count) {
+    int first = p->symbols[function].pending_first;
+    int count = p->symbols[function].pending_count;
+
+    for (int i = first; i < first + count && !p->failed; i++) {
+        pending_read_t read = p->pending[i];   /* Copy: record_read may grow the array */
+        int channel = read.channel;
+        if (channel < 0) {
+            int k = -channel - 1;
+            if (k >= arg_count || args[k].sampler == 0) continue;
+            channel = args[k].sampler > 0 ? args[k].sampler - 1 : args[k].sampler;
+        }
+        record_read(p, channel, substitute_params(read.prov, args, arg_count),
+                    read.components, read.fetch, read.count);
+    }
+}
+
+static void note_feedback(parser_t *p, unsigned int prov) {
+    for (int c = 0; c < GLSL_CHANNEL_COUNT; c++) {
+        if (prov & (PROV_CHANNEL0 << c)) p->usage[c].feedback++;
+    }
+}
+
+/* ============================================
+ * Expressions
+ * ============================================ */
+
+static value_t parse_expression(parser_t *p);
+static value_t parse_assignment(parser_t *p);
+static value_t parse_unary(parser_t *p);
+
+/* Built-in functions: result shape and whether a pixel position passed
+ * through them is still one (affine, or snapped to texels) */
+enum {
+    RESULT_WIDEST = 0,       /* genType: widest argument */
+    RESULT_SCALAR,
+    RESULT_VEC3,
+    RESULT_LAST              /* Type of the last argument (step, smoothstep) */
+};
+
+static const struct {
+    const char *name;
+    unsigned char result;
+    bool linear;
+} builtin_functions[] = {
+    { "abs", RESULT_WIDEST, true },        { "floor", RESULT_WIDEST, true },
+    { "ceil", RESULT_WIDEST, true },       { "round", RESULT_WIDEST, true },
+    { "roundEven", RESULT_WIDEST, true },  { "trunc", RESULT_WIDEST, true },
+    { "fract", RESULT_WIDEST, true },      { "mod", RESULT_WIDEST, true },
+    { "min", RESULT_WIDEST, true },        { "max", RESULT_WIDEST, true },
+    { "clamp", RESULT_WIDEST, true },      { "mix", RESULT_WIDEST, true },
+    { "sign", RESULT_WIDEST, false },      { "step", RESULT_LAST, false },
+    { "smoothstep", RESULT_LAST, false },  { "sin", RESULT_WIDEST, false },
+    { "cos", RESULT_WIDEST, false },       { "tan", RESULT_WIDEST, false },
+    { "asin", RESULT_WIDEST, false },      { "acos", RESULT_WIDEST, false },
+    { "atan", RESULT_WIDEST, false },      { "sinh", RESULT_WIDEST, false },
+    { "cosh", RESULT_WIDEST, false },      { "tanh", RESULT_WIDEST, false },
+    { "pow", RESULT_WIDEST, false },       { "exp", RESULT_WIDEST, false },
+    { "exp2", RESULT_WIDEST, false },      { "log", RESULT_WIDEST, false },
+    { "log2", RESULT_WIDEST, false },      { "sqrt", RESULT_WIDEST, false },
+    { "inversesqrt", RESULT_WIDEST, false }, { "normalize", RESULT_WIDEST, false },
+    { "reflect", RESULT_WIDEST, false },   { "refract", RESULT_WIDEST, false },
+    { "faceforward", RESULT_WIDEST, false }, { "length", RESULT_SCALAR, false },
+    { "distance", RESULT_SCALAR, false },  { "dot", RESULT_SCALAR, false },
+    { "cross", RESULT_VEC3, false },       { "radians", RESULT_WIDEST, true },
+    { "degrees", RESULT_WIDEST, true },    { "dFdx", RESULT_WIDEST, false },
+    { "dFdy", RESULT_WIDEST, false },      { "fwidth", RESULT_WIDEST, false },
+};
+
+static int find_builtin(const parser_t *p, int index) {
+    const glsl_token_t *t = token_at(p, index);
+    const char *text = p->stream->source + t->offset;
+    for (size_t i = 0; i < sizeof(builtin_functions) / sizeof(builtin_functions[0]); i++) {
+        size_t length = strlen(builtin_functions[i].name);
+        if (t->length == length && memcmp(text, builtin_functions[i].name, length) == 0) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+static bool is_texture_read(const parser_t *p, int index, bool *fetch) {
+    glsl_word_t word = word_at(p, index);
+    *fetch = (word == GLSL_WORD_TEXELFETCH);
+    if (word == GLSL_WORD_TEXTURE || word == GLSL_WORD_TEXTURELOD ||
+        word == GLSL_WORD_TEXTUREGRAD || word == GLSL_WORD_TEXELFETCH) {
+        return true;
+    }
+
+    /* texture2D, textureProj, textureOffset, texelFetchOffset, ... */
+    const glsl_token_t *t = token_at(p, index);
+    const char *text = p->stream->source + t->offset;
+    if (t->length > 10 && memcmp(text, "texelFetch", 10) == 0) {
+        *fetch = true;
+        return true;
+    }
+    return t->length > 7 && memcmp(text, "texture", 7) == 0 &&
+           word != GLSL_WORD_TEXTURESIZE && !text_is(p, index, "textureQueryLevels");
+}
+
+static value_t builtin_call(parser_t *p, int builtin, const value_t *args, int arg_count) {
+    value_t result = value_of(0, 0);
+    for (int i = 0; i < arg_count; i++) {
+        result = value_merge(result, args[i]);
+    }
+
+    switch (builtin_functions[builtin].result) {
+        case RESULT_SCALAR: result.components = 1; break;
+        case RESULT_VEC3: result.components = 3; break;
+        case RESULT_LAST:
+            if (arg_count > 0) result.components = args[arg_count - 1].components;
+            break;
+        default: break;
+    }
+    if (!builtin_functions[builtin].linear) {
+        result.prov = prov_geometry(result.prov);
+    }
+
+    const char *name = builtin_functions[builtin].name;
+    if (strcmp(name, "mod") == 0 && arg_count == 2 && args[1].has_value &&
+        value_abs(args[1].value) >= SMALL_SCALE_DIVISOR) {
+        result.prov |= PROV_TILED;
+    }
+
+    /* Temporal blend: mix(previous, current, weight) where the weight is a
+     * constant or depends only on time (1.0 / float(iFrame + 1)) and only one
+     * side is a read of the channel */
+    if (strcmp(name, "mix") == 0 && arg_count == 3 &&
+        (args[2].prov & ~(PROV_CONSTANT | PROV_TIME)) == 0) {
+        unsigned int a = args[0].prov & PROV_CHANNEL_MASK;
+        unsigned int b = args[1].prov & PROV_CHANNEL_MASK;
+        note_feedback(p, a ^ b);
+    }
+    return result;
+}
+
+/* Call at the current identifier; the next token is "(" */
+static value_t parse_call(parser_t *p) {
+    int name = p->pos;
+    advance(p);
+    advance(p);
+
+    value_t args[MAX_ARGS];
+    int arg_count = 0;
+    value_t rest = value_of(0, 0);   /* Arguments beyond MAX_ARGS */
+    if (!is_punct(p, p->pos, ")")) {
+        for (;;) {
+            value_t arg = parse_assignment(p);
+            if (arg_count < MAX_ARGS) args[arg_count++] = arg;
+            else rest = value_merge(rest, arg);
+            if (!accept(p, ",")) break;
+        }
+    }
+    accept(p, ")");
+
+    bool fetch;
+    if (is_texture_read(p, name, &fetch)) {
+        int sampler = arg_count > 0 ? args[0].sampler : 0;
+        if (sampler != 0 && arg_count > 1) {
+            record_read(p, sampler > 0 ? sampler - 1 : sampler, args[1].prov, args[1].components, fetch, 1);
+        }
+        return value_of(sampler > 0 ? (PROV_CHANNEL0 << (sampler - 1)) : PROV_UNKNOWN, 4);
+    }
+    if (word_at(p, name) == GLSL_WORD_TEXTURESIZE) {
+        return value_of(PROV_RESOLUTION, 2);
+    }
+
+    int function = symbol_find_token(p, name);
+    if (function >= 0 && p->symbols[function].kind == SYMBOL_FUNCTION) {
+        p->symbols[function].calls++;
+        resolve_call(p, function, args, arg_count);
+        const value_t *returned = &p->symbols[function].value;
+        return value_of(substitute_params(returned->prov, args, arg_count), returned->components);
+    }
+
+    int builtin = find_builtin(p, name);
+    if (builtin >= 0) {
+        return builtin_call(p, builtin, args, arg_count);
+    }
+
+    /* Macro or undeclared function: anything could happen to the arguments */
+    value_t result = rest;
+    for (int i = 0; i < arg_count; i++) result = value_merge(result, args[i]);
+    result.prov = prov_geometry(result.prov) | PROV_UNKNOWN;
+    result.components = 0;
+    return result;
+}
+
+/* Constructor at the current type token: vec2(...), float[](...) */
+static value_t parse_constructor(parser_t *p, int components) {
+    advance(p);
+    bool array = false;
+    if (is_punct(p, p->pos, "[")) {
+        skip_group(p);
+        array = true;
+    }
+    if (!is_punct(p, p->pos, "(")) return value_of(PROV_UNKNOWN, components);
+    advance(p);
+
+    value_t result = value_of(0, components);
+    bool all_equal = true;
+    bool any = false;
+    double value = 0.0;
+    if (!is_punct(p, p->pos, ")")) {
+        for (;;) {
+            value_t arg = parse_assignment(p);
+            result.prov |= arg.prov;
+            if (!arg.has_value || (any && arg.value != value)) all_equal = false;
+            value = arg.value;
+            any = true;
+            if (!accept(p, ",")) break;
+        }
+    }
+    accept(p, ")");
+
+    result.has_value = any && all_equal;
+    result.value = value;
+    result.array = array;
+    return result;
+}
+
+static value_t builtin_variable(const parser_t *p, int index) {
+    switch (word_at(p, index)) {
+        case GLSL_WORD_FRAGCOORD: return value_of(PROV_FRAGCOORD, 2);
+        case GLSL_WORD_IRESOLUTION: return value_of(PROV_RESOLUTION, 3);
+        case GLSL_WORD_ITIME:
+        case GLSL_WORD_ITIMEDELTA:
+        case GLSL_WORD_IFRAME:
+        case GLSL_WORD_IFRAMERATE: return value_of(PROV_TIME, 1);
+        case GLSL_WORD_IDATE: return value_of(PROV_TIME, 4);
+        case GLSL_WORD_IMOUSE: return value_of(PROV_MOUSE, 4);
+        case GLSL_WORD_ISAMPLERATE: return value_of(PROV_CONSTANT, 1);
+        case GLSL_WORD_ICHANNELRESOLUTION: {
+            value_t v = value_of(PROV_RESOLUTION, 3);
+            v.array = true;
+            return v;
+        }
+        case GLSL_WORD_ICHANNELTIME: {
+            value_t v = value_of(PROV_TIME, 1);
+            v.array = true;
+            return v;
+        }
+        case GLSL_WORD_ICHANNEL0:
+        case GLSL_WORD_ICHANNEL1:
+        case GLSL_WORD_ICHANNEL2:
+        case GLSL_WORD_ICHANNEL3: {
+            value_t v = value_of(0, 0);
+            v.sampler = 1 + (int)(word_at(p, index) - GLSL_WORD_ICHANNEL0);
+            return v;
+        }
+        default:
+            break;
+    }
+    if (text_is(p, index, "gl_FragCoord")) return value_of(PROV_FRAGCOORD, 4);
+    return value_of(PROV_UNKNOWN, 0);
+}
+
+static value_t parse_primary(parser_t *p) {
+    const glsl_token_t *t = token_at(p, p->pos);
+    if (!t || p->failed) return value_of(PROV_UNKNOWN, 0);
+
+    if (t->type == GLSL_TOKEN_NUMBER) {
+        value_t v = value_constant(glsl_token_number(p->stream, p->pos), 1);
+        advance(p);
+        return v;
+    }
+    if (t->word == GLSL_WORD_TRUE || t->word == GLSL_WORD_FALSE) {
+        advance(p);
+        return value_constant(t->word == GLSL_WORD_TRUE ? 1.0 : 0.0, 1);
+    }
+    if (is_punct(p, p->pos, "(")) {
+        advance(p);
+        value_t v = parse_expression(p);
+        accept(p, ")");
+        return v;
+    }
+
+    int components;
+    if (type_at(p, p->pos, &components)) {
+        return parse_constructor(p, components);
+    }
+
+    if (t->type != GLSL_TOKEN_IDENTIFIER) {
+        /* Not an operand: leave it to the caller */
+        return value_of(PROV_UNKNOWN, 0);
+    }
+
+    if (is_punct(p, next_code(p, p->pos), "(")) {
+        return parse_call(p);
+    }
+
+    int s = symbol_find_token(p, p->pos);
+    value_t v;
+    if (s >= 0 && p->symbols[s].kind == SYMBOL_VARIABLE) {
+        v = p->symbols[s].value;
+        v.symbol = s;
+        v.partial = false;
+    } else {
+        v = builtin_variable(p, p->pos);
+    }
+    advance(p);
+    return v;
+}
+
+static bool is_swizzle(const char *text, unsigned int length) {
+    if (length == 0 || length > 4) return false;
+    const char *sets[] = { "xyzw", "rgba", "stpq" };
+    for (int set = 0; set < 3; set++) {
+        unsigned int i = 0;
+        while (i < length && memchr(sets[set], text[i], 4)) i++;
+        if (i == length) return true;
+    }
+    return false;
+}
+
+static value_t parse_postfix(parser_t *p, value_t v) {
+    for (;;) {
+        if (is_punct(p, p->pos, ".")) {
+            advance(p);
+            const glsl_token_t *t = token_at(p, p->pos);
+            if (!t || t->type != GLSL_TOKEN_IDENTIFIER) break;
+            advance(p);
+            if (is_punct(p, p->pos, "(")) {
+                /* .length() of an array */
+                skip_group(p);
+                v = value_of(PROV_CONSTANT, 1);
+                continue;
+            }
+            const char *text = p->stream->source + t->offset;
+            v.components = is_swizzle(text, t->length) ? (int)t->length : 0;
+            v.array = false;
+            v.sampler = 0;
+            v.partial = true;
+        } else if (is_punct(p, p->pos, "[")) {
+            advance(p);
+            parse_expression(p);
+            accept(p, "]");
+            if (v.array) {
+                v.array = false;
+            } else {
+                v.components = v.components > 1 ? 1 : 0;
+            }
+            v.partial = true;
+        } else if (is_punct(p, p->pos, "++") || is_punct(p, p->pos, "--")) {
+            advance(p);
+            v.has_value = false;
+        } else {
+            break;
+        }
+    }
+    return v;
+}
+
+static value_t parse_unary(parser_t *p) {
+    if (++p->depth > MAX_DEPTH) {
+        p->depth--;
+        advance(p);
+        return value_of(PROV_UNKNOWN, 0);
+    }
+
+    value_t v;
+    if (is_punct(p, p->pos, "-") || is_punct(p, p->pos, "+") || is_punct(p, p->pos, "!") ||
+        is_punct(p, p->pos, "~") || is_punct(p, p->pos, "++") || is_punct(p, p->pos, "--")) {
+        bool negate = is_punct(p, p->pos, "-");
+        bool logical = is_punct(p, p->pos, "!") || is_punct(p, p->pos, "~");
+        advance(p);
+        v = parse_unary(p);
+        if (negate) v.value = -v.value;
+        if (logical) v.has_value = false;
+        v.symbol = -1;
+    } else {
+        v = parse_postfix(p, parse_primary(p));
+    }
+
+    p->depth--;
+    return v;
+}
+
+/* Binary operators, higher binds tighter; 0 = not a binary operator */
+static int binary_precedence(const parser_t *p, int index) {
+    const glsl_token_t *t = token_at(p, index);
+    if (!t || t->type != GLSL_TOKEN_PUNCT) return 0;
+    const char *op = p->stream->source + t->offset;
+
+    if (t->length == 1) {
+        switch (op[0]) {
+            case '|': return 4;
+            case '^': return 5;
+            case '&': return 6;
+            case '<': case '>': return 8;
+            case '+': case '-': return 10;
+            case '*': case '/': case '%': return 11;
+            default: return 0;
+        }
+    }
+    if (t->length != 2) return 0;
+    if (op[1] == '=') {
+        /* ==, !=, <=, >= (the rest are compound assignments) */
+        if (op[0] == '=' || op[0] == '!') return 7;
+        return (op[0] == '<' || op[0] == '>') ? 8 : 0;
+    }
+    if (op[0] != op[1]) return 0;
+    switch (op[0]) {
+        case '|': return 1;
+        case '^': return 2;
+        case '&': return 3;
+        case '<': case '>': return 9;
+        default: return 0;
+    }
+}
+
+/* Combine both operands of an operator, given by its first character
+ * (compound assignments use the same rules); select is set for logic and
+ * comparisons */
+static value_t apply_binary(parser_t *p, char op, bool select, value_t a, value_t b) {
+    value_t result = value_merge(a, b);
+
+    if (select) {
+        /* Logic and comparisons select, they do not carry a position */
+        result.prov = prov_geometry(result.prov);
+        result.components = 1;
+        return result;
+    }
+
+    if (a.has_value && b.has_value) {
+        result.has_value = true;
+        switch (op) {
+            case '+': result.value = a.value + b.value; break;
+            case '-': result.value = a.value - b.value; break;
+            case '*': result.value = a.value * b.value; break;
+            case '/': result.value = b.value != 0.0 ? a.value / b.value : 0.0; break;
+            default: result.has_value = false; break;
+        }
+        return result;
+    }
+
+    switch (op) {
+        case '*': {
+            if (a.has_value != b.has_value) {
+                const value_t *constant = a.has_value ? &a : &b;
+                const value_t *other = a.has_value ? &b : &a;
+                double scale = value_abs(constant->value);
+                if (scale > 0.0 && scale <= 1.0 / SMALL_SCALE_DIVISOR) {
+                    result.prov |= PROV_SMALL_SCALE;
+                }
+                /* prev * 0.98: a decaying feedback trail */
+                if (scale >= DECAY_MIN && scale < 1.0) {
+                    note_feedback(p, other->prov & PROV_CHANNEL_MASK);
+                }
+            } else if ((a.prov & PROV_FRAGCOORD) && (b.prov & PROV_FRAGCOORD)) {
+                result.prov = prov_geometry(result.prov);
+            }
+            break;
+        }
+        case '/':
+            if (b.has_value && value_abs(b.value) >= SMALL_SCALE_DIVISOR) {
+                result.prov |= PROV_SMALL_SCALE;
+            } else if ((a.prov & PROV_FRAGCOORD) && (b.prov & PROV_FRAGCOORD)) {
+                result.prov = prov_geometry(result.prov);
+            }
+            break;
+        case '%':
+            if (b.has_value && value_abs(b.value) >= SMALL_SCALE_DIVISOR) {
+                result.prov |= PROV_TILED;
+            }
+            break;
+        case '&':
+            if (a.has_value || b.has_value) result.prov |= PROV_TILED;
+            break;
+        default:
+            break;
+    }
+    return result;
+}
+
+static value_t parse_binary(parser_t *p, int min_precedence) {
+    value_t left = parse_unary(p);
+    for (;;) {
+        int precedence = binary_precedence(p, p->pos);
+        if (precedence == 0 || precedence < min_precedence) break;
+        char op = p->stream->source[token_at(p, p->pos)->offset];
+        advance(p);
+        value_t right = parse_binary(p, precedence + 1);
+        bool select = precedence <= 3 || precedence == 7 || precedence == 8;
+        left = apply_binary(p, op, select, left, right);
+    }
+    return left;
+}
+
+static value_t parse_conditional(parser_t *p) {
+    value_t condition = parse_binary(p, 1);
+    if (!accept(p, "?")) return condition;
+
+    value_t a = parse_assignment(p);
+    accept(p, ":");
+    value_t b = parse_assignment(p);
+    return value_merge(a, b);
+}
+
+/* =, +=, <<=, ... (but not ==, !=, <=, >=) */
+static bool is_assignment(const parser_t *p, int index) {
+    const glsl_token_t *t = token_at(p, index);
+    if (!t || t->type != GLSL_TOKEN_PUNCT) return false;
+    const char *op = p->stream->source + t->offset;
+
+    if (op[t->length - 1] != '=') return false;
+    if (t->length == 1 || t->length == 3) return true;
+    return op[0] != '=' && op[0] != '!' && op[0] != '<' && op[0] != '>';
+}
+
+static value_t parse_assignment(parser_t *p) {
+    value_t target = parse_conditional(p);
+    if (!is_assignment(p, p->pos)) return target;
+
+    const glsl_token_t *t = token_at(p, p->pos);
+    char op = p->stream->source[t->offset];
+    bool plain = (t->length == 1);
+    advance(p);
+
+    value_t value = parse_assignment(p);
+    if (!plain) {
+        value = apply_binary(p, op, false, target, value);
+    }
+
+    if (target.symbol >= 0) {
+        value_t *stored = &p->symbols[target.symbol].value;
+        if (plain && !target.partial) {
+            /* Whole variable replaced: straight-line code keeps it exact */
+            stored->prov = value.prov;
+            stored->has_value = value.has_value;
+            stored->value = value.value;
+        } else {
+            stored->prov |= value.prov;
+            stored->has_value = false;
+        }
+    }
+
+    value.symbol = -1;
+    return value;
+}
+
+static value_t parse_expression(parser_t *p) {
+    value_t v = parse_assignment(p);
+    while (accept(p, ",")) {
+        v = parse_assignment(p);
+    }
+    return v;
+}
+
+/* ============================================
+ * Declarations and statements
+ * ============================================ */
+
+static void parse_statement(parser_t *p);
+
+/* Block at the current "{" with its own scope */
+static void parse_block(parser_t *p) {
+    int mark = p->symbol_count;
+    advance(p);
+    while (!at_end(p) && !is_punct(p, p->pos, "}")) {
+        int before = p->pos;
+        parse_statement(p);
+        if (p->pos == before) advance(p);
+    }
+    accept(p, "}");
+    scope_pop(p, mark);
+}
+
+/* Function definition or prototype; the current token is the name */
+static void parse_function(parser_t *p, int return_components) {
+    int name = p->pos;
+    bool entry = word_at(p, name) == GLSL_WORD_MAINIMAGE;
+    int function = symbol_add(p, name, SYMBOL_FUNCTION, value_of(0, return_components));
+    if (function < 0) {
+        p->pos = glsl_find_matching(p->stream, next_code(p, name));
+        advance(p);
+        return;
+    }
+    advance(p);
+    advance(p);
+
+    /* Parameters live in their own scope around the body */
+    int mark = p->symbol_count;
+    int k = 0;
+    while (!at_end(p) && !is_punct(p, p->pos, ")")) {
+        int before = p->pos;
+        bool output = false;
+        for (;;) {
+            glsl_word_t word = word_at(p, p->pos);
+            if (word == GLSL_WORD_OUT || word == GLSL_WORD_INOUT) output = true;
+            if (!is_qualifier(word)) break;
+            advance(p);
+        }
+
+        int components;
+        if (type_at(p, p->pos, &components)) {
+            bool sampler = is_sampler_word(word_at(p, p->pos));
+            advance(p);
+            if (is_punct(p, p->pos, "[")) skip_group(p);
+
+            const glsl_token_t *t = token_at(p, p->pos);
+            if (t && t->type == GLSL_TOKEN_IDENTIFIER) {
+                value_t param = value_of(k < MAX_PARAMS ? (PROV_PARAM0 << k) : PROV_UNKNOWN, components);
+                if (sampler) param.sampler = -(1 + k);
+                if (entry) {
+                    /* mainImage(out vec4, in vec2): the vec2 is the pixel */
+                    param.prov = (components == 2 && !output) ? PROV_FRAGCOORD : 0;
+                }
+                symbol_add(p, p->pos, SYMBOL_VARIABLE, param);
+                advance(p);
+                if (is_punct(p, p->pos, "[")) {
+                    skip_group(p);
+                    if (!p->failed) p->symbols[p->symbol_count - 1].value.array = true;
+                }
+            }
+        }
+        k++;
+
+        if (!accept(p, ",") && !is_punct(p, p->pos, ")") && p->pos == before) advance(p);
+    }
+    accept(p, ")");
+
+    if (is_punct(p, p->pos, "{")) {
+        int saved = p->function;
+        p->function = function;
+        p->symbols[function].pending_first = p->pending_count;
+        parse_block(p);
+        p->symbols[function].pending_count = p->pending_count - p->symbols[function].pending_first;
+        p->function = saved;
+    } else {
+        accept(p, ";");
+    }
+    scope_pop(p, mark);
+}
+
+/* Declaration at the current token (qualifiers, type, declarators) */
+static void parse_declaration(parser_t *p) {
+    skip_qualifiers(p);
+    int components = 0;
+
+    if (word_at(p, p->pos) == GLSL_WORD_STRUCT) {
+        advance(p);
+        const glsl_token_t *t = token_at(p, p->pos);
+        if (t && t->type == GLSL_TOKEN_IDENTIFIER) {
+            symbol_add(p, p->pos, SYMBOL_TYPE, value_of(0, 0));
+            advance(p);
+        }
+        if (is_punct(p, p->pos, "{")) skip_group(p);
+    } else {
+        type_at(p, p->pos, &components);
+        advance(p);
+    }
+
+    bool array_type = false;
+    if (is_punct(p, p->pos, "[")) {
+        skip_group(p);
+        array_type = true;
+    }
+
+    if (p->function < 0 && is_punct(p, next_code(p, p->pos), "(")) {
+        parse_function(p, components);
+        return;
+    }
+
+    for (;;) {
+        const glsl_token_t *t = token_at(p, p->pos);
+        if (!t || t->type != GLSL_TOKEN_IDENTIFIER) break;
+        int name = p->pos;
+        advance(p);
+
+        bool array = array_type;
+        if (is_punct(p, p->pos, "[")) {
+            skip_group(p);
+            array = true;
+        }
+
+        value_t value = value_of(0, components);
+        if (accept(p, "=")) {
+            value_t init = parse_assignment(p);
+            value.prov = init.prov;
+            value.has_value = init.has_value;
+            value.value = init.value;
+            if (components == 0) value.components = init.components;
+        }
+        value.array = array;
+        symbol_add(p, name, SYMBOL_VARIABLE, value);
+
+        if (!accept(p, ",")) break;
+    }
+
+    /* Anything unexpected up to the end of the declaration */
+    while (!at_end(p) && !is_punct(p, p->pos, ";") && !is_punct(p, p->pos, "{") &&
+           !is_punct(p, p->pos, "}")) {
+        parse_assignment(p);
+        if (!at_end(p) && !is_punct(p, p->pos, ";")) advance(p);
+    }
+    accept(p, ";");
+}
+
+/* "( expression )" after if, while, switch */
+static void parse_condition(parser_t *p) {
+    if (accept(p, "(")) {
+        parse_expression(p);
+        accept(p, ")");
+    }
+}
+
+static void parse_statement(parser_t *p) {
+    if (at_end(p)) return;
+    if (++p->depth > MAX_DEPTH) {
+        p->depth--;
+        advance(p);
+        return;
+    }
+
+    glsl_word_t word = word_at(p, p->pos);
+    if (is_punct(p, p->pos, "{")) {
+        parse_block(p);
+    } else if (is_punct(p, p->pos, ";")) {
+        advance(p);
+    } else if (word == GLSL_WORD_IF || word == GLSL_WORD_WHILE || word == GLSL_WORD_SWITCH) {
+        advance(p);
+        parse_condition(p);
+        parse_statement(p);
+        if (word == GLSL_WORD_IF && word_at(p, p->pos) == GLSL_WORD_ELSE) {
+            advance(p);
+            parse_statement(p);
+        }
+    } else if (word == GLSL_WORD_FOR) {
+        int mark = p->symbol_count;
+        advance(p);
+        if (accept(p, "(")) {
+            if (starts_declaration(p)) {
+                parse_declaration(p);
+            } else {
+                parse_expression(p);
+                accept(p, ";");
+            }
+            parse_expression(p);
+            accept(p, ";");
+            parse_expression(p);
+            accept(p, ")");
+        }
+        parse_statement(p);
+        scope_pop(p, mark);
+    } else if (word == GLSL_WORD_DO) {
+        advance(p);
+        parse_statement(p);
+        if (word_at(p, p->pos) == GLSL_WORD_WHILE) {
+            advance(p);
+            parse_condition(p);
+        }
+        accept(p, ";");
+    } else if (word == GLSL_WORD_CASE || word == GLSL_WORD_DEFAULT) {
+        advance(p);
+        if (word == GLSL_WORD_CASE) parse_conditional(p);
+        accept(p, ":");
+    } else if (word == GLSL_WORD_RETURN) {
+        advance(p);
+        if (!is_punct(p, p->pos, ";")) {
+            value_t v = parse_expression(p);
+            if (p->function >= 0) p->symbols[p->function].value.prov |= v.prov;
+        }
+        accept(p, ";");
+    } else if (word == GLSL_WORD_BREAK || word == GLSL_WORD_CONTINUE || word == GLSL_WORD_DISCARD) {
+        advance(p);
+        accept(p, ";");
+    } else if (word == GLSL_WORD_PRECISION) {
+        while (!at_end(p) && !is_punct(p, p->pos, ";")) advance(p);
+        accept(p, ";");
+    } else if (starts_declaration(p)) {
+        parse_declaration(p);
+    } else {
+        parse_expression(p);
+        accept(p, ";");
+    }
+
+    p->depth--;
+}
+
+/* Global scope: declarations and function definitions */
+static void parse_stream(parser_t *p, const glsl_token_stream_t *stream) {
+    p->stream = stream;
+    p->pos = next_code(p, -1);
+
+    while (!at_end(p)) {
+        int before = p->pos;
+        if (starts_declaration(p)) {
+            parse_declaration(p);
+        } else if (is_punct(p, p->pos, "{")) {
+            skip_group(p);
+        } else {
+            advance(p);
+        }
+        if (p->pos == before) advance(p);
+    }
+}
+
+/* Channels named in #define lines can't be followed through the macro;
+ * count each as one unresolved read so the channel still gets bound */
+static void scan_macros(const glsl_token_stream_t *stream, glsl_channel_usage_t *usage) {
+    for (int i = 0; i < stream->count; i++) {
+        const glsl_token_t *t = &stream->tokens[i];
+        if (t->type != GLSL_TOKEN_PREPROCESSOR) continue;
+
+        const char *text = stream->source + t->offset;
+        for (unsigned int j = 0; j + 9 <= t->length; j++) {
+            if (memcmp(text + j, "iChannel", 8) != 0) continue;
+            int c = text[j + 8] - '0';
+            if (c < 0 || c >= GLSL_CHANNEL_COUNT) continue;
+            usage[c].referenced = true;
+            usage[c].reads[GLSL_READ_UNKNOWN]++;
+        }
+    }
+}
+
+/* ============================================
+ * Public API
+ * ============================================ */
+
+bool glsl_analyze_channels(const glsl_token_stream_t *common, const glsl_token_stream_t *pass,
+                           glsl_channel_usage_t usage[GLSL_CHANNEL_COUNT]) {
+    memset(usage, 0, sizeof(glsl_channel_usage_t) * GLSL_CHANNEL_COUNT);
+    if (!pass) return true;
+
+    parser_t p;
+    memset(&p, 0, sizeof(p));
+    for (int i = 0; i < SYMBOL_BUCKETS; i++) p.buckets[i] = -1;
+    p.function = -1;
+    p.usage = usage;
+
+    /* Common helpers only count when the pass calls them */
+    if (common) {
+        p.defer_reads = true;
+        parse_stream(&p, common);
+        p.defer_reads = false;
+    }
+    int first_pass_symbol = p.symbol_count;
+    parse_stream(&p, pass);
+
+    /* Helpers the pass never calls: their reads still say how the channel
+     * is meant to be used, with the arguments unknown */
+    for (int s = first_pass_symbol; s < p.symbol_count && !p.failed; s++) {
+        if (p.symbols[s].kind != SYMBOL_FUNCTION || p.symbols[s].calls > 0) continue;
+        value_t unknown[MAX_PARAMS];
+        for (int k = 0; k < MAX_PARAMS; k++) unknown[k] = value_of(PROV_UNKNOWN, 0);
+        resolve_call(&p, s, unknown, MAX_PARAMS);
+    }
+
+    /* Named in the pass, or read through a Common helper it calls */
+    for (int i = 0; i < pass->count; i++) {
+        glsl_word_t word = pass->tokens[i].word;
+        if (word >= GLSL_WORD_ICHANNEL0 && word <= GLSL_WORD_ICHANNEL3) {
+            usage[word - GLSL_WORD_ICHANNEL0].referenced = true;
+        }
+    }
+    for (int c = 0; c < GLSL_CHANNEL_COUNT; c++) {
+        for (int k = 0; k < GLSL_READ_KIND_COUNT; k++) {
+            if (usage[c].reads[k] > 0) usage[c].referenced = true;
+        }
+    }
+    scan_macros(pass, usage);
+
+    bool ok = !p.failed;
+    free(p.symbols);
+    free(p.pending);
+    if (!ok) {
+        memset(usage, 0, sizeof(glsl_channel_usage_t) * GLSL_CHANNEL_COUNT);
+    }
+    return ok;
+}
+
+const char *glsl_read_kind_name(glsl_read_kind_t kind) {
+    switch (kind) {
+        case GLSL_READ_SCREEN: return "screen-space";
+        case GLSL_READ_STATE: return "fixed-texel";
+        case GLSL_READ_INDIRECT: return "indirect";
+        case GLSL_READ_NOISE: return "noise-scale";
+        case GLSL_READ_WORLD: return "world-space";
+        case GLSL_READ_UNKNOWN: return "unresolved";
+        default: return "unknown";
+    }
+}
@@ -0,0 +1,63 @@
+/* GLSL Channel Analysis
+ * Resolves every texture read of iChannel0-3 to the kind of coordinate it
+ * samples with, so channel bindings follow from how a pass uses a texture
+ * instead of from naming conventions
+ *
+ * The analysis walks a lexed pass once with a small expression parser. Each
+ * expression carries a component count and provenance flags saying what it
+ * was computed from (fragCoord, iResolution, literals, other texture reads,
+ * ...). Variables keep the provenance of what was assigned to them, user
+ * functions keep the provenance of what they return, and reads inside
+ * helpers are resolved again at every call site with the caller's
+ * arguments. The whole pass is linear in the number of tokens.
+ */
+
+#ifndef GLSL_CHANNELS_H
+#define GLSL_CHANNELS_H
+
+#include "glsl_lexer.h"
+#include <stdbool.h>
+
+#define GLSL_CHANNEL_COUNT 4
+
+/* What a texture coordinate was computed from */
+typedef enum {
+    GLSL_READ_SCREEN = 0,      /* Follows the pixel position (fragCoord, uv) */
+    GLSL_READ_STATE,           /* Fixed texel (constant coordinate) */
+    GLSL_READ_INDIRECT,        /* Address taken from another read or iMouse */
+    GLSL_READ_NOISE,           /* Scaled far below pixel size or wrapped to a tile */
+    GLSL_READ_WORLD,           /* Non-linear in the pixel position (ray hits, polar) */
+    GLSL_READ_UNKNOWN,         /* Could not be resolved (macros, unknown names) */
+    GLSL_READ_KIND_COUNT
+} glsl_read_kind_t;
+
+/* How one pass uses one channel */
+typedef struct {
+    bool referenced;                      /* Channel appears in code or a macro */
+    int reads[GLSL_READ_KIND_COUNT];      /* texture*() calls by coordinate kind */
+    int feedback;                         /* Read results blended over time (mix, decay) */
+} glsl_channel_usage_t;
+
+/**
+ * Analyze how a pass samples iChannel0-3
+ * Common code is parsed first so helper functions and constants defined
+ * there are known to the pass; reads inside Common helpers count once per
+ * call from the pass.
+ *
+ * @param common Lexed Common source (may be NULL)
+ * @param pass Lexed pass source
+ * @param usage Filled with one entry per channel
+ * @return false if the analysis ran out of memory (usage is then zeroed)
+ */
+bool glsl_analyze_channels(const glsl_token_stream_t *common, const glsl_token_stream_t *pass,
+                           glsl_channel_usage_t usage[GLSL_CHANNEL_COUNT]);
+
+/**
+ * Get a short description of a read kind for logs
+ *
+ * @param kind Read kind
+ * @return Static string, e.g. "screen-space"
+ */
+const char *glsl_read_kind_name(glsl_read_kind_t kind);
+
+#endif /* GLSL_CHANNELS_H */
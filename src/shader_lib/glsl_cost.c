@@ -0,0 +1,522 @@
+/* GLSL Static Cost Estimate - Implementation
+ * Loop-weighted operation counts over the lexer's token stream
+ */
+
+#include "glsl_cost.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Loops nested deeper than this count as the innermost tracked one */
+#define MAX_LOOP_DEPTH 32
+
+/* Call chains deeper than this are cut off (the callee counts as free) */
+#define MAX_CALL_DEPTH 64
+
+/* Trip counts are clamped to keep one bad bound from dominating */
+#define MAX_TRIPS 100000.0
+
+/* Loops that break or return early run this fraction of their trips */
+#define EARLY_EXIT_FACTOR 0.5
+
+typedef enum {
+    FUNCTION_NEW = 0,
+    FUNCTION_WALKING,          /* On the call stack - recursion counts as free */
+    FUNCTION_DONE
+} function_state_t;
+
+/* One function definition */
+typedef struct {
+    const glsl_token_stream_t *stream;
+    const char *name;
+    unsigned int length;
+    int body_open;             /* '{' */
+    int body_close;            /* '}' */
+    function_state_t state;
+    glsl_cost_t cost;
+} function_t;
+
+/* A named compile-time number (#define N 64, const int N = 64) */
+typedef struct {
+    const char *name;
+    unsigned int length;
+    double value;
+} constant_t;
+
+typedef struct {
+    function_t *functions;
+    int function_count;
+    int function_capacity;
+    constant_t *constants;
+    int constant_count;
+    int constant_capacity;
+    bool oom;
+} estimate_t;
+
+/* ============================================
+ * Built-in functions
+ * ============================================ */
+
+static const char *const transcendental_names[] = {
+    "sin", "cos", "tan", "asin", "acos", "atan", "sinh", "cosh", "tanh",
+    "asinh", "acosh", "atanh", "pow", "exp", "exp2", "log", "log2",
+    "sqrt", "inversesqrt", "normalize", "length", "distance"
+};
+
+/* Texture reads the lexer doesn't know as words */
+static const char *const texture_names[] = {
+    "textureProj", "textureOffset", "textureLodOffset", "textureGradOffset",
+    "textureProjLod", "texelFetchOffset", "textureGather"
+};
+
+static bool name_in(const char *text, unsigned int length, const char *const *names, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (strlen(names[i]) == length && memcmp(names[i], text, length) == 0) return true;
+    }
+    return false;
+}
+
+/* ============================================
+ * Helpers
+ * ============================================ */
+
+static const char *token_text(const glsl_token_stream_t *stream, int index) {
+    return stream->source + stream->tokens[index].offset;
+}
+
+static bool token_is_word(const glsl_token_stream_t *stream, int index, glsl_word_t word) {
+    return index >= 0 && index < stream->count && stream->tokens[index].word == word;
+}
+
+static bool same_name(const char *a, unsigned int a_length, const char *b, unsigned int b_length) {
+    return a_length == b_length && memcmp(a, b, a_length) == 0;
+}
+
+static bool is_ident_char(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+/* Plain decimal number at *p ("64", "2.5", "100.") - advances past it */
+static bool parse_decimal(const char **p, double *value) {
+    const char *s = *p;
+    double v = 0.0;
+    bool digits = false;
+    while (*s >= '0' && *s <= '9') {
+        v = v * 10.0 + (*s++ - '0');
+        digits = true;
+    }
+    if (*s == '.') {
+        s++;
+        double scale = 0.1;
+        while (*s >= '0' && *s <= '9') {
+            v += (*s++ - '0') * scale;
+            scale *= 0.1;
+            digits = true;
+        }
+    }
+    if (!digits) return false;
+    *p = s;
+    *value = v;
+    return true;
+}
+
+static void add_constant(estimate_t *e, const char *name, unsigned int length, double value) {
+    if (e->constant_count == e->constant_capacity) {
+        int capacity = e->constant_capacity ? e->constant_capacity * 2 : 32;
+        constant_t *grown = realloc(e->constants, (size_t)capacity * sizeof(constant_t));
+        if (!grown) {
+            e->oom = true;
+            return;
+        }
+        e->constants = grown;
+        e->constant_capacity = capacity;
+    }
+    e->constants[e->constant_count++] = (constant_t){ name, length, value };
+}
+
+static bool find_constant(const estimate_t *e, const char *name, unsigned int length, double *value) {
+    /* Latest definition wins, like redefining a macro */
+    for (int i = e->constant_count - 1; i >= 0; i--) {
+        if (same_name(e->constants[i].name, e->constants[i].length, name, length)) {
+            *value = e->constants[i].value;
+            return true;
+        }
+    }
+    return false;
+}
+
+/* #define NAME number */
+static void collect_define(estimate_t *e, const glsl_token_stream_t *stream, int index) {
+    const char *p = token_text(stream, index) + 1;
+    const char *end = p + stream->tokens[index].length - 1;
+    while (p < end && (*p == ' ' || *p == '\t')) p++;
+    if (end - p < 6 || strncmp(p, "define", 6) != 0) return;
+    p += 6;
+    while (p < end && (*p == ' ' || *p == '\t')) p++;
+
+    const char *name = p;
+    while (p < end && is_ident_char(*p)) p++;
+    unsigned int length = (unsigned int)(p - name);
+    if (length == 0 || *p == '(') return;   /* Function-like macros aren't numbers */
+    while (p < end && (*p == ' ' || *p == '\t')) p++;
+
+    double value;
+    if (p < end && parse_decimal(&p, &value)) {
+        add_constant(e, name, length, value);
+    }
+}
+
+/* const <type> NAME = number; */
+static void collect_const(estimate_t *e, const glsl_token_stream_t *stream, int index) {
+    int type = glsl_next_code_token(stream, index);
+    int name = glsl_next_code_token(stream, type);
+    int assign = glsl_next_code_token(stream, name);
+    int value = glsl_next_code_token(stream, assign);
+    if (name >= stream->count || stream->tokens[name].type != GLSL_TOKEN_IDENTIFIER) return;
+    if (!glsl_token_is_punct(stream, assign, "=")) return;
+    if (value >= stream->count || stream->tokens[value].type != GLSL_TOKEN_NUMBER) return;
+    if (!glsl_token_is_punct(stream, glsl_next_code_token(stream, value), ";")) return;
+
+    add_constant(e, token_text(stream, name), stream->tokens[name].length,
+                 glsl_token_number(stream, value));
+}
+
+/* Record every function definition and numeric constant of a stream */
+static void collect(estimate_t *e, const glsl_token_stream_t *stream) {
+    int depth = 0;
+    for (int i = 0; i < stream->count && !e->oom; i++) {
+        const glsl_token_t *t = &stream->tokens[i];
+
+        if (t->type == GLSL_TOKEN_PREPROCESSOR) {
+            collect_define(e, stream, i);
+            continue;
+        }
+        if (t->word == GLSL_WORD_CONST) {
+            collect_const(e, stream, i);
+            continue;
+        }
+        if (t->type == GLSL_TOKEN_PUNCT) {
+            if (t->length == 1 && token_text(stream, i)[0] == '{') depth++;
+            if (t->length == 1 && token_text(stream, i)[0] == '}' && depth > 0) depth--;
+            continue;
+        }
+        if (depth != 0 || !glsl_is_function_definition(stream, i)) continue;
+
+        int open = glsl_next_code_token(stream, i);
+        int body = glsl_next_code_token(stream, glsl_find_matching(stream, open));
+        int body_close = glsl_find_matching(stream, body);
+
+        if (e->function_count == e->function_capacity) {
+            int capacity = e->function_capacity ? e->function_capacity * 2 : 32;
+            function_t *grown = realloc(e->functions, (size_t)capacity * sizeof(function_t));
+            if (!grown) {
+                e->oom = true;
+                return;
+            }
+            e->functions = grown;
+            e->function_capacity = capacity;
+        }
+        function_t *f = &e->functions[e->function_count++];
+        memset(f, 0, sizeof(*f));
+        f->stream = stream;
+        f->name = token_text(stream, i);
+        f->length = t->length;
+        f->body_open = body;
+        f->body_close = body_close;
+
+        /* Constants inside the body are still collected */
+        i = body;
+        depth = 1;
+    }
+}
+
+/* ============================================
+ * Loops
+ * ============================================ */
+
+/* Value of a literal or named constant */
+static bool token_value(const estimate_t *e, const glsl_token_stream_t *stream, int index, double *value) {
+    if (index < 0 || index >= stream->count) return false;
+    const glsl_token_t *t = &stream->tokens[index];
+    if (t->type == GLSL_TOKEN_NUMBER) {
+        *value = glsl_token_number(stream, index);
+        return true;
+    }
+    if (t->type == GLSL_TOKEN_IDENTIFIER) {
+        return find_constant(e, token_text(stream, index), t->length, value);
+    }
+    return false;
+}
+
+/* The single value token between from and until, if that's all there is */
+static bool single_value(const estimate_t *e, const glsl_token_stream_t *stream,
+                         int from, int until, double *value) {
+    int index = glsl_next_code_token(stream, from);
+    return glsl_next_code_token(stream, index) == until && token_value(e, stream, index, value);
+}
+
+/* Iterations of "for (init; cond; step)" with constant bounds, or
+ * GLSL_COST_UNKNOWN_TRIPS */
+static double for_trips(const estimate_t *e, const glsl_token_stream_t *stream, int open, int close) {
+    int semicolons[2];
+    int found = 0;
+    for (int i = glsl_next_code_token(stream, open); i < close && found < 2;
+         i = glsl_next_code_token(stream, i)) {
+        if (glsl_token_is_punct(stream, i, "(")) {
+            i = glsl_find_matching(stream, i);
+        } else if (glsl_token_is_punct(stream, i, ";")) {
+            semicolons[found++] = i;
+        }
+    }
+    if (found < 2) return GLSL_COST_UNKNOWN_TRIPS;
+
+    /* init: "int i = start" */
+    double start = 0.0;
+    bool have_start = false;
+    for (int i = open; i < semicolons[0]; i = glsl_next_code_token(stream, i)) {
+        if (glsl_token_is_punct(stream, i, "=")) {
+            have_start = single_value(e, stream, i, semicolons[0], &start);
+            break;
+        }
+    }
+
+    /* cond: "i < bound" */
+    double bound = 0.0;
+    const char *op = NULL;
+    static const char *const comparisons[] = { "<", "<=", ">", ">=", "!=" };
+    for (int i = semicolons[0]; i < semicolons[1] && !op; i = glsl_next_code_token(stream, i)) {
+        for (size_t c = 0; c < sizeof(comparisons) / sizeof(comparisons[0]); c++) {
+            if (glsl_token_is_punct(stream, i, comparisons[c])) {
+                if (single_value(e, stream, i, semicolons[1], &bound)) op = comparisons[c];
+                break;
+            }
+        }
+    }
+
+    /* step: "i++", "i += step" */
+    double step = 0.0;
+    for (int i = semicolons[1]; i < close; i = glsl_next_code_token(stream, i)) {
+        if (glsl_token_is_punct(stream, i, "++") || glsl_token_is_punct(stream, i, "--")) {
+            step = 1.0;
+            break;
+        }
+        if (glsl_token_is_punct(stream, i, "+=") || glsl_token_is_punct(stream, i, "-=")) {
+            if (!single_value(e, stream, i, close, &step)) step = 0.0;
+            break;
+        }
+    }
+
+    if (!have_start || !op || step <= 0.0) return GLSL_COST_UNKNOWN_TRIPS;
+
+    double span = (op[0] == '>') ? start - bound : bound - start;
+    if (op[0] == '!' && span < 0.0) span = -span;
+    double trips = span / step;
+    if (op[1] == '=' && op[0] != '!') trips += 1.0;
+
+    /* Partial last step still runs */
+    double whole = (double)(long long)trips;
+    if (whole < trips) whole += 1.0;
+    if (whole < 1.0) whole = 1.0;
+    if (whole > MAX_TRIPS) whole = MAX_TRIPS;
+    return whole;
+}
+
+/* Last token of the statement starting at index */
+static int statement_end(const glsl_token_stream_t *stream, int index) {
+    if (index >= stream->count) return stream->count;
+
+    if (glsl_token_is_punct(stream, index, "{")) {
+        return glsl_find_matching(stream, index);
+    }
+
+    glsl_word_t word = stream->tokens[index].word;
+    if (word == GLSL_WORD_FOR || word == GLSL_WORD_WHILE || word == GLSL_WORD_IF) {
+        int open = glsl_next_code_token(stream, index);
+        if (!glsl_token_is_punct(stream, open, "(")) return index;
+        int close = glsl_find_matching(stream, open);
+        int end = statement_end(stream, glsl_next_code_token(stream, close));
+        if (word == GLSL_WORD_IF) {
+            int next = glsl_next_code_token(stream, end);
+            if (token_is_word(stream, next, GLSL_WORD_ELSE)) {
+                end = statement_end(stream, glsl_next_code_token(stream, next));
+            }
+        }
+        return end;
+    }
+
+    for (int i = index; i < stream->count; i = glsl_next_code_token(stream, i)) {
+        if (glsl_token_is_punct(stream, i, "(") || glsl_token_is_punct(stream, i, "[") ||
+            glsl_token_is_punct(stream, i, "{")) {
+            i = glsl_find_matching(stream, i);
+        } else if (glsl_token_is_punct(stream, i, ";")) {
+            return i;
+        }
+    }
+    return stream->count;
+}
+
+/* Whether a loop body can leave before its last iteration */
+static bool exits_early(const glsl_token_stream_t *stream, int from, int to) {
+    for (int i = from; i <= to && i < stream->count; i++) {
+        glsl_word_t word = stream->tokens[i].word;
+        if (word == GLSL_WORD_BREAK || word == GLSL_WORD_RETURN) return true;
+    }
+    return false;
+}
+
+/* ============================================
+ * Functions
+ * ============================================ */
+
+static void walk_function(estimate_t *e, function_t *f, int call_depth);
+
+/* Most expensive overload of a called function, NULL for built-ins */
+static const glsl_cost_t *call_cost(estimate_t *e, const char *name, unsigned int length, int call_depth) {
+    const glsl_cost_t *best = NULL;
+    for (int i = 0; i < e->function_count; i++) {
+        function_t *f = &e->functions[i];
+        if (!same_name(f->name, f->length, name, length)) continue;
+        if (f->state == FUNCTION_NEW && call_depth < MAX_CALL_DEPTH) {
+            walk_function(e, f, call_depth + 1);
+        }
+        if (f->state != FUNCTION_DONE) continue;
+        if (!best || f->cost.units > best->units) best = &f->cost;
+    }
+    return best;
+}
+
+static void add_scaled(glsl_cost_t *cost, const glsl_cost_t *callee, double times, int depth) {
+    cost->arithmetic += callee->arithmetic * times;
+    cost->transcendentals += callee->transcendentals * times;
+    cost->texture_fetches += callee->texture_fetches * times;
+    if (depth + callee->loop_depth > cost->loop_depth) {
+        cost->loop_depth = depth + callee->loop_depth;
+    }
+}
+
+static bool is_arithmetic(const glsl_token_stream_t *stream, int index) {
+    const glsl_token_t *t = &stream->tokens[index];
+    if (t->type != GLSL_TOKEN_PUNCT || t->length > 2) return false;
+    char c = token_text(stream, index)[0];
+    if (c != '+' && c != '-' && c != '*' && c != '/') return false;
+    /* "+=" and friends compute too, "++" is an increment */
+    return t->length == 1 || token_text(stream, index)[1] == '=';
+}
+
+static void walk_function(estimate_t *e, function_t *f, int call_depth) {
+    const glsl_token_stream_t *stream = f->stream;
+    glsl_cost_t cost;
+    memset(&cost, 0, sizeof(cost));
+    f->state = FUNCTION_WALKING;
+
+    struct {
+        int end;
+        double times;
+    } loops[MAX_LOOP_DEPTH];
+    int depth = 0;
+
+    for (int i = glsl_next_code_token(stream, f->body_open); i < f->body_close;
+         i = glsl_next_code_token(stream, i)) {
+        while (depth > 0 && i > loops[depth - 1].end) depth--;
+        double times = depth > 0 ? loops[depth - 1].times : 1.0;
+        const glsl_token_t *t = &stream->tokens[i];
+
+        if (t->word == GLSL_WORD_FOR || t->word == GLSL_WORD_WHILE || t->word == GLSL_WORD_DO) {
+            int open = glsl_next_code_token(stream, i);
+            int end;
+            double trips = GLSL_COST_UNKNOWN_TRIPS;
+            if (t->word == GLSL_WORD_DO) {
+                /* do { } while (cond); - the tail is part of the loop */
+                end = statement_end(stream, open);
+                int tail = glsl_next_code_token(stream, end);
+                if (token_is_word(stream, tail, GLSL_WORD_WHILE)) {
+                    end = statement_end(stream, glsl_next_code_token(stream, tail));
+                }
+            } else {
+                if (!glsl_token_is_punct(stream, open, "(")) continue;
+                int close = glsl_find_matching(stream, open);
+                if (t->word == GLSL_WORD_WHILE &&
+                    glsl_token_is_punct(stream, glsl_next_code_token(stream, close), ";")) {
+                    continue;   /* Tail of a do-while, already counted */
+                }
+                end = statement_end(stream, glsl_next_code_token(stream, close));
+                if (t->word == GLSL_WORD_FOR) trips = for_trips(e, stream, open, close);
+            }
+
+            if (exits_early(stream, open, end)) {
+                trips *= EARLY_EXIT_FACTOR;
+                if (trips < 1.0) trips = 1.0;
+            }
+            if (depth < MAX_LOOP_DEPTH) {
+                loops[depth].end = end;
+                loops[depth].times = times * trips;
+                depth++;
+                if (depth > cost.loop_depth) cost.loop_depth = depth;
+            }
+            continue;
+        }
+
+        if (t->type == GLSL_TOKEN_IDENTIFIER &&
+            glsl_token_is_punct(stream, glsl_next_code_token(stream, i), "(")) {
+            const char *name = token_text(stream, i);
+            const glsl_cost_t *callee = call_cost(e, name, t->length, call_depth);
+            if (callee) {
+                add_scaled(&cost, callee, times, depth);
+            } else if (t->word == GLSL_WORD_TEXTURE || t->word == GLSL_WORD_TEXTURELOD ||
+                       t->word == GLSL_WORD_TEXTUREGRAD || t->word == GLSL_WORD_TEXELFETCH ||
+                       name_in(name, t->length, texture_names,
+                               sizeof(texture_names) / sizeof(texture_names[0]))) {
+                cost.texture_fetches += times;
+            } else if (name_in(name, t->length, transcendental_names,
+                               sizeof(transcendental_names) / sizeof(transcendental_names[0]))) {
+                cost.transcendentals += times;
+            } else {
+                /* dot, mix, clamp, fract, ... */
+                cost.arithmetic += times;
+            }
+            continue;
+        }
+
+        if (is_arithmetic(stream, i)) {
+            cost.arithmetic += times;
+        }
+    }
+
+    cost.units = cost.arithmetic +
+                 cost.transcendentals * GLSL_COST_TRANSCENDENTAL_WEIGHT +
+                 cost.texture_fetches * GLSL_COST_TEXTURE_WEIGHT;
+    f->cost = cost;
+    f->state = FUNCTION_DONE;
+}
+
+/* ============================================
+ * Public API
+ * ============================================ */
+
+bool glsl_estimate_cost(const glsl_token_stream_t *const *libraries, int library_count,
+                        const glsl_token_stream_t *pass, glsl_cost_t *cost) {
+    memset(cost, 0, sizeof(*cost));
+    if (!pass) return true;
+
+    estimate_t e;
+    memset(&e, 0, sizeof(e));
+    for (int i = 0; i < library_count; i++) {
+        if (libraries[i]) collect(&e, libraries[i]);
+    }
+    int first_pass_function = e.function_count;
+    collect(&e, pass);
+
+    if (!e.oom) {
+        for (int i = first_pass_function; i < e.function_count; i++) {
+            function_t *f = &e.functions[i];
+            if (!same_name(f->name, f->length, "mainImage", 9)) continue;
+            if (f->state == FUNCTION_NEW) walk_function(&e, f, 0);
+            *cost = e.functions[i].cost;
+            break;
+        }
+    }
+
+    bool ok = !e.oom;
+    free(e.functions);
+    free(e.constants);
+    return ok;
+}
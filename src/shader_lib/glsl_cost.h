@@ -0,0 +1,50 @@
+/* GLSL Static Cost Estimate
+ * Predicts what one pixel of a pass costs from its token stream, before
+ * anything is compiled or rendered
+ *
+ * Every function body is walked once. Work inside a loop counts once per
+ * iteration: for-loops with literal or constant bounds use their exact
+ * trip count, other loops a typical raymarch count, halved when they can
+ * exit early. Calls add the callee's cost, so a helper called from a loop
+ * is multiplied too. The result is in abstract units (one scalar
+ * arithmetic operation); callers turn units into milliseconds with a
+ * per-GPU factor.
+ */
+
+#ifndef GLSL_COST_H
+#define GLSL_COST_H
+
+#include "glsl_lexer.h"
+#include <stdbool.h>
+
+/* Relative weights of the operation classes, in arithmetic units */
+#define GLSL_COST_TRANSCENDENTAL_WEIGHT 4.0
+#define GLSL_COST_TEXTURE_WEIGHT        8.0
+
+/* Iterations assumed for loops whose bounds aren't constant */
+#define GLSL_COST_UNKNOWN_TRIPS 64
+
+/* Per-pixel cost of one pass */
+typedef struct {
+    double arithmetic;          /* Operators and cheap built-ins */
+    double transcendentals;     /* sin, exp, pow, sqrt, normalize, ... */
+    double texture_fetches;     /* texture*() and texelFetch*() calls */
+    double units;               /* Weighted total */
+    int loop_depth;             /* Deepest loop nesting reached from mainImage */
+} glsl_cost_t;
+
+/**
+ * Estimate the per-pixel cost of a pass's mainImage
+ * Functions and constants defined in the libraries (Common, included
+ * modules) are known to the pass.
+ *
+ * @param libraries Lexed sources the pass is compiled with (may be NULL)
+ * @param library_count Number of libraries
+ * @param pass Lexed pass source
+ * @param cost Filled with the estimate (zero if there is no mainImage)
+ * @return false if the estimate ran out of memory
+ */
+bool glsl_estimate_cost(const glsl_token_stream_t *const *libraries, int library_count,
+                        const glsl_token_stream_t *pass, glsl_cost_t *cost);
+
+#endif /* GLSL_COST_H */
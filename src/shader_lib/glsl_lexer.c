@@ -0,0 +1,533 @@
+/* GLSL Lexer - Implementation
+ * Single-pass tokenizer shared by the multipass parser, channel analysis,
+ * source rewriting and the editor's completion
+ */
+
+#include "glsl_lexer.h"
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* ============================================
+ * Perfect hash for keywords and known identifiers
+ * ============================================ */
+
+/* slot = (fnv1a(word) * GLSL_WORD_MULTIPLIER) >> (32 - GLSL_WORD_TABLE_BITS)
+ * The multiplier was found by trying odd values until every word in
+ * word_names landed in its own slot. After adding a word, search for a new
+ * multiplier and regenerate word_slots (slot -> word id, 0 = empty). */
+#define GLSL_WORD_TABLE_BITS 9
+#define GLSL_WORD_TABLE_SIZE (1 << GLSL_WORD_TABLE_BITS)
+#define GLSL_WORD_MULTIPLIER 19339u
+
+static const char *const word_names[GLSL_WORD_COUNT] = {
+    NULL,
+    "attribute", "const", "uniform", "varying", "buffer", "shared", "layout", "centroid",
+    "flat", "smooth", "noperspective", "break", "continue", "do", "for", "while", "switch",
+    "case", "default", "if", "else", "in", "out", "inout", "float", "double", "int", "uint",
+    "void", "bool", "true", "false", "invariant", "precise", "discard", "return", "mat2",
+    "mat3", "mat4", "mat2x2", "mat2x3", "mat2x4", "mat3x2", "mat3x3", "mat3x4", "mat4x2",
+    "mat4x3", "mat4x4", "vec2", "vec3", "vec4", "ivec2", "ivec3", "ivec4", "bvec2", "bvec3",
+    "bvec4", "uvec2", "uvec3", "uvec4", "dvec2", "dvec3", "dvec4", "lowp", "mediump", "highp",
+    "precision", "sampler2D", "sampler3D", "samplerCube", "sampler2DShadow", "sampler2DArray",
+    "isampler2D", "usampler2D", "struct", "main", "mainImage", "fragCoord", "fragColor",
+    "iTime", "iTimeDelta", "iFrame", "iFrameRate", "iMouse", "iResolution", "iDate",
+    "iSampleRate", "iChannel0", "iChannel1", "iChannel2", "iChannel3", "iChannelResolution",
+    "iChannelTime", "texture", "textureLod", "textureGrad", "texelFetch", "textureSize", "mix",
+    "smoothstep",
+};
+static const unsigned char word_slots[GLSL_WORD_TABLE_SIZE] = {
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  17,   0,   0,
+      0,   0,   0,   8,  67,  99,   0,   0,   0,   0,  74,   0,   0,  10,   0,  72,
+     34,   0,   0,  78,   0,   0,   0,   0,  25,   0,   0,   0,   0,  21,   0,   0,
+      0,   0,   0,   0,  58,   0,  68,   5,   0,   0,   0,   0,   0,   0,   0,  51,
+      0,   9,  66,  63,  37,   0,   0,  28,   0,  18,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,  90,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  94,  83,   0,   0,   0,   0,
+      0,  61,   0,   0,   0,  92,   0,   0,   0,   0,  26,   0,   0,   0,   0,  15,
+      0,   0,   0, 100,   0,  88,  57,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   6,  44,  41,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  19,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,  31,   0,   0,   0,   0,   0,   0,  46,  60,   0,   0,
+      0,   0,   0,   0,  85,  71,   0,   0,   0,  49,   0,  53,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+     30,   0,   0,   0,   0,   0,   0,  24,   0,   0,  48,   0,   0,   0,   0,   0,
+      0,   0,   0,  69,   0,   0,   0,   0,  98,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,  96,  36,   0,   0,   0,   0,   0,   0,   0,   0,   0,  55,
+      0,  16,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  23,  11,   0,  38,   0,   0,
+      0,  80,   0,  20,   0,   0,   0,   0,   0,   0,   0,  65,   0,   0,   0,   0,
+     91,   0,   0,   0,   0,   0,  29,   0,   0,  64,  59,   0,  81,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,  45,  62,   0,  93,   0,   0,   4,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  33,   0,   0,  89,   0,
+      0,  14,   0,   0,   0,   0,   0,   0,   0,   0,  75,   0,   0,   0,   0,  79,
+      0,   0,   0,   0,   0,   0,  54,  43,  42,  84,   0,   0,   0,   7,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,  12,   0,   0,   0,  27,   0,  76,   0,   0,
+      0,   0,   0,   0,   0,  47,   0,   0,   0,   0,   0,   0,  73,   0,   0,   0,
+      0,   0,  50,   0,  52,  40,   0,   0,   0,   0,  39,   0,   0,   0,   0,   3,
+      0,   0,  77,   0,   0,   0,   0,   0,  13,   0,   0,   0,   0,   0,   0,   1,
+     86,   0,   0,   0,   0,   0,   0,  32,   0,   0,   0,  97,  35,   0,   0,   2,
+      0,   0,   0,   0,   0,   0,   0,   0,  95,   0,   0,  22,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,  56,   0,   0,   0,  82,  70,   0,  87,
+};
+
+static unsigned int word_slot(const char *text, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)text[i];
+        hash *= 16777619u;
+    }
+    return (hash * GLSL_WORD_MULTIPLIER) >> (32 - GLSL_WORD_TABLE_BITS);
+}
+
+glsl_word_t glsl_lookup_word(const char *text, size_t length) {
+    if (!text || length == 0) return GLSL_WORD_NONE;
+
+    unsigned int word = word_slots[word_slot(text, length)];
+    if (word == 0) return GLSL_WORD_NONE;
+
+    const char *name = word_names[word];
+    if (strncmp(name, text, length) != 0 || name[length] != '\0') return GLSL_WORD_NONE;
+    return (glsl_word_t)word;
+}
+
+const char *glsl_word_name(glsl_word_t word) {
+    if (word <= GLSL_WORD_NONE || word >= GLSL_WORD_COUNT) return NULL;
+    return word_names[word];
+}
+
+/* ============================================
+ * Tokenizer
+ * ============================================ */
+
+static bool is_ident_start(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+static bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+static bool is_ident_char(char c) {
+    return is_ident_start(c) || is_digit(c);
+}
+
+/* Length of the operator at p (longest match: "<<=", "+=", "&&", ...) */
+static size_t punct_length(const char *p) {
+    char c = p[0];
+    char n = p[1];
+
+    switch (c) {
+        case '<':
+        case '>':
+            if (n == c) return p[2] == '=' ? 3 : 2;     /* << >> <<= >>= */
+            return n == '=' ? 2 : 1;                      /* <= >= */
+        case '+':
+        case '-':
+        case '&':
+        case '|':
+        case '^':
+            return (n == c || n == '=') ? 2 : 1;          /* ++ += -- -= && &= || |= ^^ ^= */
+        case '*':
+        case '/':
+        case '%':
+        case '=':
+        case '!':
+            return n == '=' ? 2 : 1;                      /* *= /= %= == != */
+        default:
+            return 1;
+    }
+}
+
+static bool push_token(glsl_token_stream_t *stream, glsl_token_type_t type,
+                       const char *start, const char *end, int line) {
+    if (stream->count == stream->capacity) {
+        int capacity = stream->capacity * 2;
+        glsl_token_t *grown = realloc(stream->tokens, (size_t)capacity * sizeof(glsl_token_t));
+        if (!grown) return false;
+        stream->tokens = grown;
+        stream->capacity = capacity;
+    }
+
+    glsl_token_t *token = &stream->tokens[stream->count++];
+    token->type = type;
+    token->word = GLSL_WORD_NONE;
+    token->offset = (unsigned int)(start - stream->source);
+    token->length = (unsigned int)(end - start);
+    token->line = line;
+
+    if (type == GLSL_TOKEN_IDENTIFIER) {
+        token->word = glsl_lookup_word(start, token->length);
+        if (token->word != GLSL_WORD_NONE && token->word < GLSL_WORD_FIRST_BUILTIN) {
+            token->type = GLSL_TOKEN_KEYWORD;
+        }
+    }
+    return true;
+}
+
+/* Scan a numeric literal: 12, 0x1F, 1.5, .5, 1e-3, 2.0f, 3u, 1.0lf */
+static const char *scan_number(const char *p) {
+    if (p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) {
+        p += 2;
+        while (is_digit(*p) || (*p >= 'a' && *p <= 'f') || (*p >= 'A' && *p <= 'F')) p++;
+    } else {
+        while (is_digit(*p)) p++;
+        if (*p == '.') {
+            p++;
+            while (is_digit(*p)) p++;
+        }
+        if ((*p == 'e' || *p == 'E') &&
+            (is_digit(p[1]) || ((p[1] == '+' || p[1] == '-') && is_digit(p[2])))) {
+            p += 2;
+            while (is_digit(*p)) p++;
+        }
+    }
+
+    if ((p[0] == 'l' && p[1] == 'f') || (p[0] == 'L' && p[1] == 'F')) {
+        p += 2;
+    } else if (*p == 'f' || *p == 'F' || *p == 'u' || *p == 'U') {
+        p++;
+    }
+    return p;
+}
+
+glsl_token_stream_t *glsl_lex(const char *source) {
+    if (!source) return NULL;
+
+    glsl_token_stream_t *stream = calloc(1, sizeof(glsl_token_stream_t));
+    if (!stream) return NULL;
+
+    /* Roughly one token per four bytes of typical shader code */
+    stream->source = source;
+    stream->capacity = (int)(strlen(source) / 4) + 16;
+    stream->tokens = malloc((size_t)stream->capacity * sizeof(glsl_token_t));
+    if (!stream->tokens) {
+        free(stream);
+        return NULL;
+    }
+
+    const char *p = source;
+    int line = 1;
+    bool line_start = true;    /* Only whitespace so far on this line */
+
+    while (*p) {
+        const char *start = p;
+        int start_line = line;
+        glsl_token_type_t type;
+
+        if (*p == '\n') {
+            line++;
+            line_start = true;
+            p++;
+            continue;
+        }
+        if (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\f' || *p == '\v') {
+            p++;
+            continue;
+        }
+
+        if (*p == '#' && line_start) {
+            /* Directive up to the end of the line, honouring "\" continuations */
+            while (*p && *p != '\n') {
+                if (p[0] == '\\' && p[1] == '\n') {
+                    line++;
+                    p += 2;
+                } else if (p[0] == '\\' && p[1] == '\r' && p[2] == '\n') {
+                    line++;
+                    p += 3;
+                } else {
+                    p++;
+                }
+            }
+            type = GLSL_TOKEN_PREPROCESSOR;
+        } else if (p[0] == '/' && p[1] == '/') {
+            while (*p && *p != '\n') p++;
+            type = GLSL_TOKEN_COMMENT;
+        } else if (p[0] == '/' && p[1] == '*') {
+            p += 2;
+            while (*p && !(p[0] == '*' && p[1] == '/')) {
+                if (*p == '\n') line++;
+                p++;
+            }
+            if (*p) p += 2;
+            type = GLSL_TOKEN_COMMENT;
+        } else if (*p == '"') {
+            p++;
+            while (*p && *p != '"' && *p != '\n') {
+                if (*p == '\\' && p[1] && p[1] != '\n') p++;
+                p++;
+            }
+            if (*p == '"') p++;
+            type = GLSL_TOKEN_STRING;
+        } else if (is_ident_start(*p)) {
+            while (is_ident_char(*p)) p++;
+            type = GLSL_TOKEN_IDENTIFIER;
+        } else if (is_digit(*p) || (*p == '.' && is_digit(p[1]))) {
+            p = scan_number(p);
+            type = GLSL_TOKEN_NUMBER;
+        } else {
+            p += punct_length(p);
+            type = GLSL_TOKEN_PUNCT;
+        }
+
+        line_start = false;
+        if (!push_token(stream, type, start, p, start_line)) {
+            glsl_token_stream_free(stream);
+            return NULL;
+        }
+    }
+
+    return stream;
+}
+
+void glsl_token_stream_free(glsl_token_stream_t *stream) {
+    if (!stream) return;
+    free(stream->tokens);
+    free(stream);
+}
+
+/* ============================================
+ * Stream navigation
+ * ============================================ */
+
+int glsl_next_code_token(const glsl_token_stream_t *stream, int index) {
+    int i = index + 1;
+    while (i < stream->count && stream->tokens[i].type == GLSL_TOKEN_COMMENT) i++;
+    return i < stream->count ? i : stream->count;
+}
+
+int glsl_prev_code_token(const glsl_token_stream_t *stream, int index) {
+    int i = index - 1;
+    while (i >= 0 && stream->tokens[i].type == GLSL_TOKEN_COMMENT) i--;
+    return i;
+}
+
+bool glsl_token_is_punct(const glsl_token_stream_t *stream, int index, const char *punct) {
+    if (index < 0 || index >= stream->count) return false;
+
+    const glsl_token_t *token = &stream->tokens[index];
+    if (token->type != GLSL_TOKEN_PUNCT) return false;
+
+    size_t length = strlen(punct);
+    return token->length == length &&
+           memcmp(stream->source + token->offset, punct, length) == 0;
+}
+
+int glsl_find_matching(const glsl_token_stream_t *stream, int index) {
+    if (index < 0 || index >= stream->count) return stream->count;
+
+    char open = stream->source[stream->tokens[index].offset];
+    char close;
+    switch (open) {
+        case '(': close = ')'; break;
+        case '[': close = ']'; break;
+        case '{': close = '}'; break;
+        default: return stream->count;
+    }
+
+    int depth = 0;
+    for (int i = index; i < stream->count; i++) {
+        const glsl_token_t *token = &stream->tokens[i];
+        if (token->type != GLSL_TOKEN_PUNCT || token->length != 1) continue;
+
+        char c = stream->source[token->offset];
+        if (c == open) {
+            depth++;
+        } else if (c == close && --depth == 0) {
+            return i;
+        }
+    }
+    return stream->count;
+}
+
+double glsl_token_number(const glsl_token_stream_t *stream, int index) {
+    if (index < 0 || index >= stream->count || stream->tokens[index].type != GLSL_TOKEN_NUMBER) {
+        return -1.0;
+    }
+
+    /* Parsed by hand: strtod follows LC_NUMERIC, which GTK sets from the user locale */
+    const char *p = stream->source + stream->tokens[index].offset;
+    double value = 0.0;
+
+    if (p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) {
+        for (p += 2; ; p++) {
+            int digit;
+            if (is_digit(*p)) digit = *p - '0';
+            else if (*p >= 'a' && *p <= 'f') digit = *p - 'a' + 10;
+            else if (*p >= 'A' && *p <= 'F') digit = *p - 'A' + 10;
+            else break;
+            value = value * 16.0 + digit;
+        }
+        return value;
+    }
+
+    while (is_digit(*p)) value = value * 10.0 + (*p++ - '0');
+    if (*p == '.') {
+        double scale = 0.1;
+        for (p++; is_digit(*p); p++, scale *= 0.1) value += (*p - '0') * scale;
+    }
+    if (*p == 'e' || *p == 'E') {
+        p++;
+        bool negative = (*p == '-');
+        if (*p == '+' || *p == '-') p++;
+        int exponent = 0;
+        for (; is_digit(*p); p++) {
+            if (exponent < 400) exponent = exponent * 10 + (*p - '0');
+        }
+        for (int i = 0; i < exponent; i++) value = negative ? value / 10.0 : value * 10.0;
+    }
+    return value;
+}
+
+bool glsl_is_function_definition(const glsl_token_stream_t *stream, int index) {
+    if (index < 0 || index >= stream->count) return false;
+    if (stream->tokens[index].type != GLSL_TOKEN_IDENTIFIER) return false;
+
+    /* Preceded by a return type (built-in keyword or struct name) */
+    int prev = glsl_prev_code_token(stream, index);
+    if (prev < 0) return false;
+    glsl_token_type_t prev_type = stream->tokens[prev].type;
+    if (prev_type != GLSL_TOKEN_KEYWORD && prev_type != GLSL_TOKEN_IDENTIFIER) return false;
+    glsl_word_t prev_word = stream->tokens[prev].word;
+    if (prev_word == GLSL_WORD_RETURN || prev_word == GLSL_WORD_ELSE) return false;
+
+    /* Followed by a parameter list and a body */
+    int open = glsl_next_code_token(stream, index);
+    if (!glsl_token_is_punct(stream, open, "(")) return false;
+    int close = glsl_find_matching(stream, open);
+    return glsl_token_is_punct(stream, glsl_next_code_token(stream, close), "{");
+}
+
+/* ============================================
+ * Pre-check
+ * ============================================ */
+
+/* Open brackets tracked by the pre-check; deeper nesting is not checked */
+#define PRECHECK_MAX_DEPTH 256
+
+static bool precheck_fail(glsl_precheck_t *result, int line, const char *fmt, ...)
+    __attribute__((format(printf, 3, 4)));
+
+static bool precheck_fail(glsl_precheck_t *result, int line, const char *fmt, ...) {
+    if (result) {
+        va_list args;
+        va_start(args, fmt);
+        result->line = line;
+        vsnprintf(result->message, sizeof(result->message), fmt, args);
+        va_end(args);
+    }
+    return false;
+}
+
+/* #if, #ifdef, #ifndef, #elif or #else (leading whitespace allowed) */
+static bool is_conditional_directive(const char *text) {
+    text++;
+    while (*text == ' ' || *text == '\t') text++;
+    return strncmp(text, "if", 2) == 0 || strncmp(text, "el", 2) == 0;
+}
+
+bool glsl_precheck(const glsl_token_stream_t *stream, glsl_precheck_t *result) {
+    if (!stream) return true;
+
+    bool check_brackets = true;
+    for (int i = 0; i < stream->count; i++) {
+        if (stream->tokens[i].type == GLSL_TOKEN_PREPROCESSOR &&
+            is_conditional_directive(stream->source + stream->tokens[i].offset)) {
+            check_brackets = false;
+            break;
+        }
+    }
+
+    char open[PRECHECK_MAX_DEPTH];
+    int open_line[PRECHECK_MAX_DEPTH];
+    int depth = 0;
+    int last_code = -1;
+
+    for (int i = 0; i < stream->count; i++) {
+        const glsl_token_t *token = &stream->tokens[i];
+        const char *text = stream->source + token->offset;
+
+        switch (token->type) {
+            case GLSL_TOKEN_COMMENT:
+                if (text[1] == '*' &&
+                    (token->length < 4 || memcmp(text + token->length - 2, "*/", 2) != 0)) {
+                    return precheck_fail(result, token->line, "unterminated /* comment");
+                }
+                continue;
+
+            case GLSL_TOKEN_STRING:
+                if (token->length < 2 || text[token->length - 1] != '"') {
+                    return precheck_fail(result, token->line, "unterminated string");
+                }
+                break;
+
+            case GLSL_TOKEN_NUMBER: {
+                if (token->length == 2 && (text[1] == 'x' || text[1] == 'X')) {
+                    return precheck_fail(result, token->line, "hex number without digits");
+                }
+                /* The scanner stops where a literal can't continue, so a
+                 * letter straight after it is an unfinished exponent or a typo */
+                const glsl_token_t *next = (i + 1 < stream->count) ? token + 1 : NULL;
+                if (next && next->offset == token->offset + token->length &&
+                    (next->type == GLSL_TOKEN_IDENTIFIER || next->type == GLSL_TOKEN_KEYWORD)) {
+                    return precheck_fail(result, token->line, "malformed number \"%.*s%.*s\"",
+                                         (int)token->length, text,
+                                         (int)(next->length < 16 ? next->length : 16),
+                                         stream->source + next->offset);
+                }
+                break;
+            }
+
+            case GLSL_TOKEN_PUNCT: {
+                unsigned char c = (unsigned char)text[0];
+                if (c >= 0x80) {
+                    return precheck_fail(result, token->line, "non-ASCII character outside a comment");
+                }
+                if (strchr("@$`'\\", c)) {
+                    return precheck_fail(result, token->line, "unexpected character '%c'", c);
+                }
+                if (!check_brackets || token->length != 1) break;
+
+                if (c == '(' || c == '[' || c == '{') {
+                    if (depth < PRECHECK_MAX_DEPTH) {
+                        open[depth] = (char)c;
+                        open_line[depth] = token->line;
+                    }
+                    depth++;
+                } else if (c == ')' || c == ']' || c == '}') {
+                    if (depth == 0) {
+                        return precheck_fail(result, token->line, "'%c' without a matching opening bracket", c);
+                    }
+                    depth--;
+                    if (depth < PRECHECK_MAX_DEPTH) {
+                        char expected = open[depth] == '(' ? ')' : open[depth] == '[' ? ']' : '}';
+                        if (c != expected) {
+                            return precheck_fail(result, token->line, "'%c' closes '%c' opened on line %d",
+                                                 c, open[depth], open_line[depth]);
+                        }
+                    }
+                }
+                break;
+            }
+
+            default:
+                break;
+        }
+        last_code = i;
+    }
+
+    if (depth > 0) {
+        int top = depth <= PRECHECK_MAX_DEPTH ? depth - 1 : PRECHECK_MAX_DEPTH - 1;
+        return precheck_fail(result, open_line[top], "'%c' is never closed", open[top]);
+    }
+
+    /* Code ends in a statement or a block; anything else was cut off mid-expression */
+    if (last_code >= 0 && stream->tokens[last_code].type != GLSL_TOKEN_PREPROCESSOR &&
+        !glsl_token_is_punct(stream, last_code, ";") && !glsl_token_is_punct(stream, last_code, "}")) {
+        return precheck_fail(result, stream->tokens[last_code].line, "unfinished code at end of file");
+    }
+
+    return true;
+}
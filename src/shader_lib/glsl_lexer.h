@@ -0,0 +1,270 @@
+/* GLSL Lexer
+ * Single-pass tokenizer shared by the multipass parser, channel analysis,
+ * source rewriting and the editor's completion
+ *
+ * A source is tokenized once into a flat token stream that every analysis
+ * walks instead of rescanning the text. Comments, strings and preprocessor
+ * lines are whole tokens, so nothing inside them is ever mistaken for code.
+ * Keywords and the identifiers the analyses care about (mainImage,
+ * iChannel0-3, texture, ...) are recognised with a perfect hash and carried
+ * on the token as a glsl_word_t.
+ */
+
+#ifndef GLSL_LEXER_H
+#define GLSL_LEXER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Token kinds */
+typedef enum {
+    GLSL_TOKEN_IDENTIFIER = 0,
+    GLSL_TOKEN_KEYWORD,
+    GLSL_TOKEN_NUMBER,
+    GLSL_TOKEN_STRING,
+    GLSL_TOKEN_PUNCT,          /* Operator or punctuation (longest match, e.g. "+=") */
+    GLSL_TOKEN_PREPROCESSOR,   /* Whole directive line, including continuations */
+    GLSL_TOKEN_COMMENT
+} glsl_token_type_t;
+
+/* Words recognised by the perfect hash (keywords first) */
+typedef enum {
+    GLSL_WORD_NONE = 0,
+    /* Keywords */
+    GLSL_WORD_ATTRIBUTE,
+    GLSL_WORD_CONST,
+    GLSL_WORD_UNIFORM,
+    GLSL_WORD_VARYING,
+    GLSL_WORD_BUFFER,
+    GLSL_WORD_SHARED,
+    GLSL_WORD_LAYOUT,
+    GLSL_WORD_CENTROID,
+    GLSL_WORD_FLAT,
+    GLSL_WORD_SMOOTH,
+    GLSL_WORD_NOPERSPECTIVE,
+    GLSL_WORD_BREAK,
+    GLSL_WORD_CONTINUE,
+    GLSL_WORD_DO,
+    GLSL_WORD_FOR,
+    GLSL_WORD_WHILE,
+    GLSL_WORD_SWITCH,
+    GLSL_WORD_CASE,
+    GLSL_WORD_DEFAULT,
+    GLSL_WORD_IF,
+    GLSL_WORD_ELSE,
+    GLSL_WORD_IN,
+    GLSL_WORD_OUT,
+    GLSL_WORD_INOUT,
+    GLSL_WORD_FLOAT,
+    GLSL_WORD_DOUBLE,
+    GLSL_WORD_INT,
+    GLSL_WORD_UINT,
+    GLSL_WORD_VOID,
+    GLSL_WORD_BOOL,
+    GLSL_WORD_TRUE,
+    GLSL_WORD_FALSE,
+    GLSL_WORD_INVARIANT,
+    GLSL_WORD_PRECISE,
+    GLSL_WORD_DISCARD,
+    GLSL_WORD_RETURN,
+    GLSL_WORD_MAT2,
+    GLSL_WORD_MAT3,
+    GLSL_WORD_MAT4,
+    GLSL_WORD_MAT2X2,
+    GLSL_WORD_MAT2X3,
+    GLSL_WORD_MAT2X4,
+    GLSL_WORD_MAT3X2,
+    GLSL_WORD_MAT3X3,
+    GLSL_WORD_MAT3X4,
+    GLSL_WORD_MAT4X2,
+    GLSL_WORD_MAT4X3,
+    GLSL_WORD_MAT4X4,
+    GLSL_WORD_VEC2,
+    GLSL_WORD_VEC3,
+    GLSL_WORD_VEC4,
+    GLSL_WORD_IVEC2,
+    GLSL_WORD_IVEC3,
+    GLSL_WORD_IVEC4,
+    GLSL_WORD_BVEC2,
+    GLSL_WORD_BVEC3,
+    GLSL_WORD_BVEC4,
+    GLSL_WORD_UVEC2,
+    GLSL_WORD_UVEC3,
+    GLSL_WORD_UVEC4,
+    GLSL_WORD_DVEC2,
+    GLSL_WORD_DVEC3,
+    GLSL_WORD_DVEC4,
+    GLSL_WORD_LOWP,
+    GLSL_WORD_MEDIUMP,
+    GLSL_WORD_HIGHP,
+    GLSL_WORD_PRECISION,
+    GLSL_WORD_SAMPLER2D,
+    GLSL_WORD_SAMPLER3D,
+    GLSL_WORD_SAMPLERCUBE,
+    GLSL_WORD_SAMPLER2DSHADOW,
+    GLSL_WORD_SAMPLER2DARRAY,
+    GLSL_WORD_ISAMPLER2D,
+    GLSL_WORD_USAMPLER2D,
+    GLSL_WORD_STRUCT,
+
+    /* Built-in and Shadertoy identifiers */
+    GLSL_WORD_MAIN,
+    GLSL_WORD_MAINIMAGE,
+    GLSL_WORD_FRAGCOORD,
+    GLSL_WORD_FRAGCOLOR,
+    GLSL_WORD_ITIME,
+    GLSL_WORD_ITIMEDELTA,
+    GLSL_WORD_IFRAME,
+    GLSL_WORD_IFRAMERATE,
+    GLSL_WORD_IMOUSE,
+    GLSL_WORD_IRESOLUTION,
+    GLSL_WORD_IDATE,
+    GLSL_WORD_ISAMPLERATE,
+    GLSL_WORD_ICHANNEL0,
+    GLSL_WORD_ICHANNEL1,
+    GLSL_WORD_ICHANNEL2,
+    GLSL_WORD_ICHANNEL3,
+    GLSL_WORD_ICHANNELRESOLUTION,
+    GLSL_WORD_ICHANNELTIME,
+    GLSL_WORD_TEXTURE,
+    GLSL_WORD_TEXTURELOD,
+    GLSL_WORD_TEXTUREGRAD,
+    GLSL_WORD_TEXELFETCH,
+    GLSL_WORD_TEXTURESIZE,
+    GLSL_WORD_MIX,
+    GLSL_WORD_SMOOTHSTEP,
+
+    GLSL_WORD_COUNT
+} glsl_word_t;
+
+/* First word that is an identifier rather than a reserved keyword */
+#define GLSL_WORD_FIRST_BUILTIN GLSL_WORD_MAIN
+
+/* One token: a span of the source it was lexed from */
+typedef struct {
+    glsl_token_type_t type;
+    glsl_word_t word;          /* GLSL_WORD_NONE unless a known word */
+    unsigned int offset;       /* Byte offset into the source */
+    unsigned int length;       /* Byte length */
+    int line;                  /* 1-based line of the first character */
+} glsl_token_t;
+
+/* Token stream for one source (the source is referenced, not copied) */
+typedef struct {
+    const char *source;
+    glsl_token_t *tokens;
+    int count;
+    int capacity;
+} glsl_token_stream_t;
+
+/**
+ * Tokenize a source in one linear pass
+ * The source must outlive the stream.
+ *
+ * @param source NUL-terminated GLSL source
+ * @return Token stream (free with glsl_token_stream_free), NULL on OOM
+ */
+glsl_token_stream_t *glsl_lex(const char *source);
+
+/**
+ * Free a token stream
+ *
+ * @param stream Stream to free (may be NULL)
+ */
+void glsl_token_stream_free(glsl_token_stream_t *stream);
+
+/**
+ * Look up a word in the perfect hash
+ *
+ * @param text Word text (not necessarily NUL-terminated)
+ * @param length Word length
+ * @return Word id, or GLSL_WORD_NONE
+ */
+glsl_word_t glsl_lookup_word(const char *text, size_t length);
+
+/**
+ * Get the spelling of a word
+ *
+ * @param word Word id
+ * @return Word text, or NULL for GLSL_WORD_NONE
+ */
+const char *glsl_word_name(glsl_word_t word);
+
+/**
+ * Get the index of the next token that is not a comment
+ *
+ * @param stream Token stream
+ * @param index Index to start after
+ * @return Index of the next code token, or stream->count if none
+ */
+int glsl_next_code_token(const glsl_token_stream_t *stream, int index);
+
+/**
+ * Get the index of the previous token that is not a comment
+ *
+ * @param stream Token stream
+ * @param index Index to start before
+ * @return Index of the previous code token, or -1 if none
+ */
+int glsl_prev_code_token(const glsl_token_stream_t *stream, int index);
+
+/**
+ * Find the bracket matching the one at index ("(", "[" or "{")
+ *
+ * @param stream Token stream
+ * @param index Index of an opening bracket token
+ * @return Index of the matching closing token, or stream->count if unbalanced
+ */
+int glsl_find_matching(const glsl_token_stream_t *stream, int index);
+
+/**
+ * Check whether a token is the given punctuation
+ *
+ * @param stream Token stream
+ * @param index Token index (out of range is allowed and returns false)
+ * @param punct Punctuation text, e.g. "(" or "+="
+ * @return true if the token is exactly that punctuation
+ */
+bool glsl_token_is_punct(const glsl_token_stream_t *stream, int index, const char *punct);
+
+/**
+ * Get the value of a numeric literal (locale independent)
+ *
+ * @param stream Token stream
+ * @param index Token index
+ * @return Literal value, or -1.0 if the token is not a number
+ */
+double glsl_token_number(const glsl_token_stream_t *stream, int index);
+
+/**
+ * Check whether the token at index names a function being defined,
+ * i.e. "type name ( ... ) {" (the caller tracks scope)
+ *
+ * @param stream Token stream
+ * @param index Index of the function name token
+ * @return true for a definition (prototypes and calls return false)
+ */
+bool glsl_is_function_definition(const glsl_token_stream_t *stream, int index);
+
+/* First problem found by glsl_precheck() */
+typedef struct {
+    int line;                  /* 1-based line of the problem */
+    char message[96];
+} glsl_precheck_t;
+
+/**
+ * Look for code that is obviously unfinished, without compiling it
+ * Catches what typing leaves behind mid-edit: an unterminated comment or
+ * string, unbalanced or mismatched brackets, a number cut off before its
+ * digits ("0x", "1e"), a stray character GLSL doesn't use, or a trailing
+ * operator. Bracket balance is not checked when the source has #if/#else
+ * blocks, since either branch may close what the other opened. Passing
+ * does not mean the code compiles.
+ *
+ * @param stream Token stream of the whole source
+ * @param result Where the first problem is described (may be NULL)
+ * @return true if nothing obviously wrong was found
+ */
+bool glsl_precheck(const glsl_token_stream_t *stream, glsl_precheck_t *result);
+
+#endif /* GLSL_LEXER_H */
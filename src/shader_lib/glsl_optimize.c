@@ -0,0 +1,815 @@
+/* GLSL Source Optimizer - Implementation
+ * Dead-function elimination, constant folding and minification over the
+ * lexer's token stream
+ */
+
+#include "glsl_optimize.h"
+#include <float.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Longest folded literal, e.g. "-1.17549435e-38" */
+#define FOLDED_MAX 24
+
+/* One token as the output sees it */
+typedef struct {
+    const glsl_token_t *token;
+    const char *text;            /* Source text, or folded */
+    unsigned int length;
+    bool removed;
+    char folded[FOLDED_MAX];
+} item_t;
+
+/* A function definition or prototype at file scope */
+typedef struct {
+    int name;                    /* Token index of the name */
+    int start;                   /* First token of the declaration (qualifiers, return type) */
+    int end;                     /* Closing brace of the body, or ';' of a prototype */
+    bool pinned;                 /* Never removed (conditional, or holds directives) */
+    bool reachable;
+} function_t;
+
+/* Growable output */
+typedef struct {
+    char *data;
+    size_t length;
+    size_t capacity;
+    bool failed;
+} buffer_t;
+
+/* ============================================
+ * Helpers
+ * ============================================ */
+
+static bool buffer_reserve(buffer_t *b, size_t extra) {
+    if (b->failed) return false;
+    if (b->length + extra + 1 <= b->capacity) return true;
+
+    size_t capacity = b->capacity ? b->capacity : 256;
+    while (capacity < b->length + extra + 1) capacity *= 2;
+    char *data = realloc(b->data, capacity);
+    if (!data) {
+        b->failed = true;
+        return false;
+    }
+    b->data = data;
+    b->capacity = capacity;
+    return true;
+}
+
+static void buffer_append(buffer_t *b, const char *text, size_t length) {
+    if (!buffer_reserve(b, length)) return;
+    memcpy(b->data + b->length, text, length);
+    b->length += length;
+    b->data[b->length] = '\0';
+}
+
+static void buffer_append_char(buffer_t *b, char c) {
+    buffer_append(b, &c, 1);
+}
+
+static bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+static bool is_word_char(char c) {
+    return is_digit(c) || c == '_' || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+/* Would a and b written together lex as one operator (or open a comment)? */
+static bool forms_operator(char a, char b) {
+    static const char *const pairs[] = {
+        "++", "--", "+=", "-=", "*=", "/=", "%=", "<<", ">>", "<=", ">=", "==", "!=",
+        "&&", "||", "^^", "&=", "|=", "^=", "//", "/*", NULL
+    };
+    for (int i = 0; pairs[i]; i++) {
+        if (pairs[i][0] == a && pairs[i][1] == b) return true;
+    }
+    return false;
+}
+
+static int count_newlines(const char *text, size_t length) {
+    int count = 0;
+    for (size_t i = 0; i < length; i++) {
+        if (text[i] == '\n') count++;
+    }
+    return count;
+}
+
+static bool item_is(const item_t *item, const char *punct) {
+    size_t length = strlen(punct);
+    return item && item->token->type == GLSL_TOKEN_PUNCT &&
+           item->length == length && memcmp(item->text, punct, length) == 0;
+}
+
+static bool item_is_one_of(const item_t *item, const char *const *puncts) {
+    for (int i = 0; puncts[i]; i++) {
+        if (item_is(item, puncts[i])) return true;
+    }
+    return false;
+}
+
+/* Directive keyword after '#', e.g. "line" */
+static bool directive_is(const char *text, size_t length, const char *name) {
+    const char *p = text + 1;
+    const char *end = text + length;
+    while (p < end && (*p == ' ' || *p == '\t')) p++;
+
+    size_t name_length = strlen(name);
+    return (size_t)(end - p) >= name_length && memcmp(p, name, name_length) == 0 &&
+           (p + name_length == end || !is_word_char(p[name_length]));
+}
+
+/* Line number of a "#line N [S]" directive, or -1 */
+static int line_directive_number(const char *text, size_t length) {
+    if (!directive_is(text, length, "line")) return -1;
+
+    const char *p = text + 1;
+    const char *end = text + length;
+    while (p < end && (*p == ' ' || *p == '\t')) p++;
+    p += 4;
+    while (p < end && (*p == ' ' || *p == '\t')) p++;
+    if (p == end || !is_digit(*p)) return -1;
+
+    int number = 0;
+    while (p < end && is_digit(*p) && number < 100000000) number = number * 10 + (*p++ - '0');
+    return number;
+}
+
+/* ============================================
+ * Dead Function Elimination
+ * ============================================ */
+
+/* "type name(...);" at file scope */
+static int prototype_end(const glsl_token_stream_t *s, int index) {
+    int open = glsl_next_code_token(s, index);
+    int prev = glsl_prev_code_token(s, index);
+    if (!glsl_token_is_punct(s, open, "(") || prev < 0) return -1;
+    if (s->tokens[prev].type != GLSL_TOKEN_KEYWORD && s->tokens[prev].type != GLSL_TOKEN_IDENTIFIER) {
+        return -1;
+    }
+    int end = glsl_next_code_token(s, glsl_find_matching(s, open));
+    return glsl_token_is_punct(s, end, ";") ? end : -1;
+}
+
+/* Find every function definition and prototype at file scope. Functions inside #if
+ * blocks, or holding directives besides #line, are pinned: removing them
+ * could unbalance a conditional or drop a #define that later code uses. */
+static function_t *collect_functions(const glsl_token_stream_t *s, int *count_out) {
+    int capacity = 32;
+    int count = 0;
+    function_t *functions = malloc((size_t)capacity * sizeof(function_t));
+    if (!functions) return NULL;
+
+    int conditional_depth = 0;
+    int decl_start = -1;
+
+    for (int i = 0; i < s->count; i++) {
+        const glsl_token_t *t = &s->tokens[i];
+        const char *text = s->source + t->offset;
+
+        if (t->type == GLSL_TOKEN_COMMENT) continue;
+        if (t->type == GLSL_TOKEN_PREPROCESSOR) {
+            if (directive_is(text, t->length, "if") || directive_is(text, t->length, "ifdef") ||
+                directive_is(text, t->length, "ifndef")) {
+                conditional_depth++;
+            } else if (directive_is(text, t->length, "endif") && conditional_depth > 0) {
+                conditional_depth--;
+            }
+            decl_start = -1;
+            continue;
+        }
+
+        if (decl_start < 0) decl_start = i;
+
+        if (glsl_token_is_punct(s, i, ";")) {
+            decl_start = -1;
+        } else if (glsl_token_is_punct(s, i, "{")) {
+            /* Struct body: the declaration goes on to its ';' */
+            i = glsl_find_matching(s, i);
+        } else if (t->type == GLSL_TOKEN_IDENTIFIER) {
+            int end;
+            if (glsl_is_function_definition(s, i)) {
+                int close = glsl_find_matching(s, glsl_next_code_token(s, i));
+                end = glsl_find_matching(s, glsl_next_code_token(s, close));
+                if (end >= s->count) break;
+            } else {
+                end = prototype_end(s, i);
+                if (end < 0) continue;
+            }
+
+            if (count == capacity) {
+                capacity *= 2;
+                function_t *grown = realloc(functions, (size_t)capacity * sizeof(function_t));
+                if (!grown) {
+                    free(functions);
+                    return NULL;
+                }
+                functions = grown;
+            }
+
+            function_t *f = &functions[count++];
+            f->name = i;
+            f->start = decl_start;
+            f->end = end;
+            f->pinned = conditional_depth > 0;
+            f->reachable = false;
+            for (int j = i; j < end && !f->pinned; j++) {
+                const glsl_token_t *inner = &s->tokens[j];
+                if (inner->type == GLSL_TOKEN_PREPROCESSOR &&
+                    !directive_is(s->source + inner->offset, inner->length, "line")) {
+                    f->pinned = true;
+                }
+            }
+
+            i = end;
+            decl_start = -1;
+        }
+    }
+
+    *count_out = count;
+    return functions;
+}
+
+typedef struct {
+    const glsl_token_stream_t *stream;
+    function_t *functions;
+    int count;
+    int *worklist;
+    int pending;
+} reach_t;
+
+/* Mark every overload of a name reachable */
+static void reach_name(reach_t *r, const char *name, size_t length) {
+    for (int f = 0; f < r->count; f++) {
+        function_t *fn = &r->functions[f];
+        if (fn->reachable) continue;
+
+        const glsl_token_t *t = &r->stream->tokens[fn->name];
+        if (t->length == length && memcmp(r->stream->source + t->offset, name, length) == 0) {
+            fn->reachable = true;
+            r->worklist[r->pending++] = f;
+        }
+    }
+}
+
+/* Every identifier-looking word in a directive (macro bodies call functions too) */
+static void reach_directive_words(reach_t *r, const char *text, size_t length) {
+    size_t i = 0;
+    while (i < length) {
+        if (is_word_char(text[i]) && !is_digit(text[i])) {
+            size_t start = i;
+            while (i < length && is_word_char(text[i])) i++;
+            reach_name(r, text + start, i - start);
+        } else {
+            i++;
+        }
+    }
+}
+
+static void reach_stream_identifiers(reach_t *r, const glsl_token_stream_t *s, int from, int to) {
+    for (int i = from; i < to; i++) {
+        const glsl_token_t *t = &s->tokens[i];
+        if (t->type == GLSL_TOKEN_IDENTIFIER) {
+            reach_name(r, s->source + t->offset, t->length);
+        } else if (t->type == GLSL_TOKEN_PREPROCESSOR) {
+            reach_directive_words(r, s->source + t->offset, t->length);
+        }
+    }
+}
+
+/* A macro that pastes tokens (##) can build any function name */
+static bool pastes_tokens(const glsl_token_stream_t *s) {
+    for (int i = 0; i < s->count; i++) {
+        const glsl_token_t *t = &s->tokens[i];
+        if (t->type != GLSL_TOKEN_PREPROCESSOR) continue;
+
+        const char *text = s->source + t->offset;
+        if (!directive_is(text, t->length, "define")) continue;
+        for (size_t c = 1; c < t->length; c++) {
+            if (text[c - 1] == '#' && text[c] == '#') return true;
+        }
+    }
+    return false;
+}
+
+static int remove_dead_functions(const glsl_token_stream_t *s, item_t *items,
+                                 const glsl_optimize_options_t *options) {
+    /* Callers can't be found by name then: keep everything */
+    if (pastes_tokens(s)) return 0;
+    for (int u = 0; u < options->user_count; u++) {
+        if (options->users[u] && pastes_tokens(options->users[u])) return 0;
+    }
+
+    int count = 0;
+    function_t *functions = collect_functions(s, &count);
+    if (!functions) return 0;
+    if (count == 0) {
+        free(functions);
+        return 0;
+    }
+
+    int *worklist = malloc((size_t)count * sizeof(int));
+    if (!worklist) {
+        free(functions);
+        return 0;
+    }
+    reach_t r = { .stream = s, .functions = functions, .count = count, .worklist = worklist, .pending = 0 };
+
+    for (int i = 0; i < options->root_count; i++) {
+        reach_name(&r, options->roots[i], strlen(options->roots[i]));
+    }
+    for (int u = 0; u < options->user_count; u++) {
+        if (options->users[u]) {
+            reach_stream_identifiers(&r, options->users[u], 0, options->users[u]->count);
+        }
+    }
+    for (int f = 0; f < count; f++) {
+        if (functions[f].pinned && !functions[f].reachable) {
+            functions[f].reachable = true;
+            worklist[r.pending++] = f;
+        }
+    }
+
+    /* File scope outside functions: global initializers and macros */
+    int next_function = 0;
+    int scope_start = 0;
+    for (; next_function <= count; next_function++) {
+        int scope_end = next_function < count ? functions[next_function].start : s->count;
+        reach_stream_identifiers(&r, s, scope_start, scope_end);
+        if (next_function < count) scope_start = functions[next_function].end + 1;
+    }
+
+    /* Everything a reachable function calls */
+    while (r.pending > 0) {
+        const function_t *fn = &functions[worklist[--r.pending]];
+        reach_stream_identifiers(&r, s, fn->name + 1, fn->end);
+    }
+
+    int removed = 0;
+    for (int f = 0; f < count; f++) {
+        if (functions[f].reachable) continue;
+        for (int i = functions[f].start; i <= functions[f].end; i++) {
+            items[i].removed = true;
+        }
+        removed++;
+    }
+
+    free(worklist);
+    free(functions);
+    return removed;
+}
+
+/* ============================================
+ * Constant Folding
+ * ============================================ */
+
+/* A decimal literal the folder understands */
+typedef struct {
+    bool is_float;
+    float value;
+    long long integer;
+} literal_t;
+
+static const double powers_of_ten[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/* Parse by hand (strtod follows the user's LC_NUMERIC). Floats are
+ * converted with a single rounding so the value matches the driver's;
+ * hex, octal, unsigned and double literals aren't folded. */
+static bool parse_literal(const char *text, size_t length, literal_t *out) {
+    const char *p = text;
+    const char *end = text + length;
+    bool negative = false;
+    if (p < end && *p == '-') {
+        negative = true;
+        p++;
+    }
+    if (end - p > 1 && p[0] == '0' && is_digit(p[1])) return false;   /* Octal */
+
+    uint64_t mantissa = 0;
+    int exponent = 0;
+    bool any_digit = false;
+    bool is_float = false;
+
+    for (; p < end && is_digit(*p); p++) {
+        if (mantissa > 100000000000000000ULL) return false;
+        mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+        any_digit = true;
+    }
+    if (p < end && *p == '.') {
+        is_float = true;
+        for (p++; p < end && is_digit(*p); p++) {
+            if (mantissa > 100000000000000000ULL) return false;
+            mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+            exponent--;
+            any_digit = true;
+        }
+    }
+    if (!any_digit) return false;
+
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        is_float = true;
+        p++;
+        bool negative_exponent = false;
+        if (p < end && (*p == '+' || *p == '-')) negative_exponent = (*p++ == '-');
+        int value = 0;
+        for (; p < end && is_digit(*p); p++) {
+            if (value < 1000) value = value * 10 + (*p - '0');
+        }
+        exponent += negative_exponent ? -value : value;
+    }
+    if (p < end && (*p == 'f' || *p == 'F')) {
+        is_float = true;
+        p++;
+    }
+    if (p != end) return false;
+
+    out->is_float = is_float;
+    if (!is_float) {
+        if (mantissa > 2147483647ULL) return false;
+        out->integer = negative ? -(long long)mantissa : (long long)mantissa;
+        return true;
+    }
+
+    if (exponent < -22 || exponent > 22 || mantissa > (1ULL << 53)) return false;
+    double value = (double)mantissa;
+    value = exponent < 0 ? value / powers_of_ten[-exponent] : value * powers_of_ten[exponent];
+    out->value = (float)(negative ? -value : value);
+    return isfinite(out->value);
+}
+
+/* Shortest decimal that reads back as the same float, e.g. "6." or ".25" */
+static bool format_float(float value, char *out, size_t size) {
+    if (!isfinite(value) || (value != 0.0f && fabsf(value) < FLT_MIN)) return false;
+
+    for (int precision = 1; precision <= 9; precision++) {
+        char raw[FOLDED_MAX + 8];
+        snprintf(raw, sizeof(raw), "%.*g", precision, (double)value);
+
+        /* Locale independent: whatever the decimal point is becomes '.' */
+        char text[FOLDED_MAX + 8];
+        size_t n = 0;
+        for (const char *p = raw; *p && n + 2 < sizeof(text); p++) {
+            if (is_digit(*p) || *p == '-' || *p == '+' || *p == 'e') {
+                text[n++] = *p;
+            } else if (n == 0 || text[n - 1] != '.') {
+                text[n++] = '.';
+            }
+        }
+        text[n] = '\0';
+
+        /* "1e+07" -> "1e7" */
+        char *e = strchr(text, 'e');
+        if (e) {
+            char *digits = e + 1;
+            if (*digits == '+') memmove(digits, digits + 1, strlen(digits));
+            if (*digits == '-') digits++;
+            while (digits[0] == '0' && digits[1]) memmove(digits, digits + 1, strlen(digits));
+        } else if (!strchr(text, '.')) {
+            strcat(text, ".");
+        }
+
+        /* "0.5" -> ".5" */
+        char *zero = text + (text[0] == '-' ? 1 : 0);
+        if (zero[0] == '0' && zero[1] == '.' && zero[2]) memmove(zero, zero + 1, strlen(zero));
+
+        literal_t back;
+        if (parse_literal(text, strlen(text), &back) && back.is_float && back.value == value) {
+            if (strlen(text) >= size) return false;
+            strcpy(out, text);
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Tokens a folded operand may follow or precede without changing how the
+ * expression groups: operators that bind looser than + and - */
+static const char *const looser_than_additive[] = {
+    "(", ",", "=", "+=", "-=", "*=", "/=", "%=", "<<=", ">>=", "&=", "^=", "|=",
+    "?", ":", "[", "{", ";", "<", ">", "<=", ">=", "==", "!=", "&&", "||", "^^",
+    "&", "|", "^", "<<", ">>", NULL
+};
+static const char *const closing[] = {
+    ")", "]", ",", ";", "?", ":", "<", ">", "<=", ">=", "==", "!=", "&&", "||", "^^",
+    "&", "|", "^", "<<", ">>", "+", "-", NULL
+};
+
+static bool is_return(const item_t *item) {
+    return item && item->token->type == GLSL_TOKEN_KEYWORD && item->token->word == GLSL_WORD_RETURN;
+}
+
+static bool fold_context_ok(const item_t *prev, const item_t *next, bool multiplicative) {
+    bool prev_ok = is_return(prev) || item_is_one_of(prev, looser_than_additive) ||
+                   (multiplicative && (item_is(prev, "+") || item_is(prev, "-")));
+    if (!prev_ok) return false;
+
+    return !next || item_is_one_of(next, closing) ||
+           (multiplicative && (item_is(next, "*") || item_is(next, "/") || item_is(next, "%")));
+}
+
+/* Fold "a op b" into item a. Returns false if it can't be done exactly or
+ * wouldn't make the source shorter. */
+static bool fold_binary(item_t *a, const item_t *op, const item_t *b) {
+    literal_t x, y;
+    if (!parse_literal(a->text, a->length, &x) || !parse_literal(b->text, b->length, &y)) return false;
+    if (x.is_float != y.is_float) return false;
+
+    char c = op->text[0];
+    char text[FOLDED_MAX];
+    if (x.is_float) {
+        float result;
+        switch (c) {
+            case '+': result = x.value + y.value; break;
+            case '-': result = x.value - y.value; break;
+            case '*': result = x.value * y.value; break;
+            case '/':
+                if (y.value == 0.0f) return false;
+                result = x.value / y.value;
+                break;
+            default: return false;
+        }
+        if (!format_float(result, text, sizeof(text))) return false;
+    } else {
+        long long result;
+        switch (c) {
+            case '+': result = x.integer + y.integer; break;
+            case '-': result = x.integer - y.integer; break;
+            case '*': result = x.integer * y.integer; break;
+            default: return false;   /* Integer division rounding isn't worth the risk */
+        }
+        if (result < -2147483647LL || result > 2147483647LL) return false;
+        snprintf(text, sizeof(text), "%lld", result);
+    }
+
+    if (strlen(text) > (size_t)a->length + op->length + b->length) return false;
+
+    strcpy(a->folded, text);
+    a->text = a->folded;
+    a->length = (unsigned int)strlen(text);
+    return true;
+}
+
+static int fold_constants(item_t *items, int count) {
+    int *code = malloc((size_t)(count + 1) * sizeof(int));
+    if (!code) return 0;
+
+    int folded = 0;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+
+        int n = 0;
+        for (int i = 0; i < count; i++) {
+            if (!items[i].removed && items[i].token->type != GLSL_TOKEN_COMMENT) code[n++] = i;
+        }
+
+        for (int k = 0; k + 2 < n; k++) {
+            item_t *first = &items[code[k]];
+            item_t *middle = &items[code[k + 1]];
+            item_t *last = &items[code[k + 2]];
+            const item_t *prev = k > 0 ? &items[code[k - 1]] : NULL;
+            const item_t *next = k + 3 < n ? &items[code[k + 3]] : NULL;
+
+            /* "(2.0)" -> "2." where the parentheses don't belong to a call */
+            if (item_is(first, "(") && middle->token->type == GLSL_TOKEN_NUMBER &&
+                middle->text[0] != '-' && item_is(last, ")") &&
+                (is_return(prev) || (prev && prev->token->type == GLSL_TOKEN_PUNCT &&
+                                     !item_is(prev, ")") && !item_is(prev, "]"))) &&
+                (!next || item_is_one_of(next, closing) || item_is(next, "*") ||
+                 item_is(next, "/") || item_is(next, "%"))) {
+                first->removed = true;
+                last->removed = true;
+                changed = true;
+                k += 2;
+                continue;
+            }
+
+            if (first->token->type != GLSL_TOKEN_NUMBER || last->token->type != GLSL_TOKEN_NUMBER) {
+                continue;
+            }
+            bool multiplicative = item_is(middle, "*") || item_is(middle, "/");
+            if (!multiplicative && !item_is(middle, "+") && !item_is(middle, "-")) continue;
+            if (!fold_context_ok(prev, next, multiplicative)) continue;
+
+            if (fold_binary(first, middle, last)) {
+                middle->removed = true;
+                last->removed = true;
+                folded++;
+                changed = true;
+                k += 2;
+            }
+        }
+    }
+
+    free(code);
+    return folded;
+}
+
+/* Shorter spelling of a float literal: "1.0" -> "1.", "0.50" -> ".5" */
+static void shorten_literal(item_t *item) {
+    unsigned int length = item->length;
+    if (length >= FOLDED_MAX || !memchr(item->text, '.', length)) return;
+    for (unsigned int i = 0; i < length; i++) {
+        if (!is_digit(item->text[i]) && item->text[i] != '.') return;   /* Exponents and suffixes stay */
+    }
+
+    char text[FOLDED_MAX];
+    memcpy(text, item->text, length);
+    size_t n = length;
+    const char *dot = memchr(text, '.', n);
+    while (n > 0 && text[n - 1] == '0' && &text[n - 1] > dot) n--;
+    text[n] = '\0';
+
+    const char *shorter = text;
+    while (*shorter == '0') shorter++;
+    if (strcmp(shorter, ".") == 0) shorter = "0.";
+
+    size_t shorter_length = strlen(shorter);
+    if (shorter_length >= length) return;
+    memcpy(item->folded, shorter, shorter_length + 1);
+    item->text = item->folded;
+    item->length = (unsigned int)shorter_length;
+}
+
+/* ============================================
+ * Output
+ * ============================================ */
+
+typedef struct {
+    buffer_t out;
+    int line;                    /* Logical line the output is on */
+    bool line_start;
+    const item_t *last;          /* Last token on the current line */
+    bool keep_lines;
+} writer_t;
+
+static void writer_newline(writer_t *w) {
+    buffer_append_char(&w->out, '\n');
+    w->line++;
+    w->line_start = true;
+    w->last = NULL;
+}
+
+/* Move to the start of a logical line: blank lines for short gaps, a #line
+ * directive for long ones or going back */
+static void writer_goto_line(writer_t *w, int line) {
+    if (!w->line_start) writer_newline(w);
+    if (line == w->line) return;
+
+    char directive[32];
+    int length = snprintf(directive, sizeof(directive), "#line %d\n", line);
+    /* Nothing may come before #version, so the first lines are never remapped */
+    if (line > w->line && (line - w->line <= length || w->out.length == 0)) {
+        while (w->line < line) writer_newline(w);
+        return;
+    }
+    buffer_append(&w->out, directive, (size_t)length);
+    w->line = line;
+}
+
+static bool needs_space(const item_t *prev, const item_t *item) {
+    char a = prev->text[prev->length - 1];
+    char b = item->text[0];
+    if (is_word_char(a) && is_word_char(b)) return true;
+    if (forms_operator(a, b)) return true;
+    /* "2. x" or "1 .5" would lex differently */
+    if (prev->token->type == GLSL_TOKEN_NUMBER && (b == '.' || is_word_char(b))) return true;
+    if (item->token->type == GLSL_TOKEN_NUMBER && (a == '.' || is_word_char(a))) return true;
+    return false;
+}
+
+/* Tokens only, separated where they have to be. Directives keep a line of
+ * their own; with keep_lines every token stays on its logical line. */
+static void write_minified(writer_t *w, const item_t *items, int count) {
+    int line_delta = 0;   /* Logical minus physical line of the input */
+
+    for (int i = 0; i < count; i++) {
+        const item_t *item = &items[i];
+        const glsl_token_t *t = item->token;
+        int line = t->line + line_delta;
+
+        if (t->type == GLSL_TOKEN_PREPROCESSOR) {
+            int newlines = count_newlines(item->text, item->length);
+            int number = line_directive_number(item->text, item->length);
+            if (number >= 0) {
+                /* Names the line after the directive, removed or not */
+                line_delta = number - (t->line + newlines + 1);
+            }
+            if (item->removed) continue;
+
+            if (w->keep_lines) {
+                writer_goto_line(w, line);
+            } else if (!w->line_start) {
+                writer_newline(w);
+            }
+            buffer_append(&w->out, item->text, item->length);
+            w->line += newlines;
+            writer_newline(w);
+            if (number >= 0) w->line = number;
+            continue;
+        }
+        if (item->removed || t->type == GLSL_TOKEN_COMMENT) continue;
+
+        if (w->keep_lines && line != w->line) {
+            writer_goto_line(w, line);
+        } else if (!w->line_start && needs_space(w->last, item)) {
+            buffer_append_char(&w->out, ' ');
+        }
+        buffer_append(&w->out, item->text, item->length);
+        w->line_start = false;
+        w->last = item;
+    }
+
+    if (!w->line_start) writer_newline(w);
+}
+
+/* The source as written, minus removed tokens (their line breaks stay) */
+static void write_verbatim(buffer_t *out, const char *source, const item_t *items, int count) {
+    size_t copied = 0;
+
+    for (int i = 0; i < count; i++) {
+        const item_t *item = &items[i];
+        const glsl_token_t *t = item->token;
+        if (!item->removed && item->text == source + t->offset) continue;
+
+        buffer_append(out, source + copied, t->offset - copied);
+        if (item->removed) {
+            for (int n = count_newlines(source + t->offset, t->length); n > 0; n--) {
+                buffer_append_char(out, '\n');
+            }
+        } else {
+            buffer_append(out, item->text, item->length);
+        }
+        copied = t->offset + t->length;
+    }
+
+    buffer_append(out, source + copied, strlen(source + copied));
+}
+
+/* ============================================
+ * Public API
+ * ============================================ */
+
+char *glsl_optimize(const char *source, const glsl_optimize_options_t *options,
+                    glsl_optimize_stats_t *stats) {
+    if (stats) memset(stats, 0, sizeof(*stats));
+    if (!source || !options) return NULL;
+
+    glsl_token_stream_t *stream = glsl_lex(source);
+    if (!stream) return NULL;
+
+    item_t *items = calloc((size_t)(stream->count > 0 ? stream->count : 1), sizeof(item_t));
+    if (!items) {
+        glsl_token_stream_free(stream);
+        return NULL;
+    }
+    for (int i = 0; i < stream->count; i++) {
+        items[i].token = &stream->tokens[i];
+        items[i].text = source + stream->tokens[i].offset;
+        items[i].length = stream->tokens[i].length;
+    }
+
+    int functions_removed = options->remove_dead_functions ?
+                            remove_dead_functions(stream, items, options) : 0;
+    int constants_folded = options->fold_constants ? fold_constants(items, stream->count) : 0;
+
+    buffer_t out = { 0 };
+    if (options->minify) {
+        for (int i = 0; i < stream->count; i++) {
+            if (!items[i].removed && items[i].token->type == GLSL_TOKEN_NUMBER &&
+                items[i].text != items[i].folded) {
+                shorten_literal(&items[i]);
+            }
+        }
+        writer_t w = { .out = out, .line = 1, .line_start = true, .last = NULL,
+                       .keep_lines = options->keep_lines };
+        write_minified(&w, items, stream->count);
+        out = w.out;
+    } else {
+        write_verbatim(&out, source, items, stream->count);
+    }
+
+    free(items);
+    glsl_token_stream_free(stream);
+
+    if (out.failed || !buffer_reserve(&out, 0)) {
+        free(out.data);
+        return NULL;
+    }
+    out.data[out.length] = '\0';
+
+    if (stats) {
+        stats->input_bytes = strlen(source);
+        stats->output_bytes = out.length;
+        stats->functions_removed = functions_removed;
+        stats->constants_folded = constants_folded;
+    }
+    return out.data;
+}
@@ -0,0 +1,52 @@
+/* GLSL Source Optimizer
+ * Shrinks a shader before it goes to the driver: drops functions nothing
+ * calls, folds constant arithmetic and strips comments and whitespace
+ *
+ * Works on the lexer's token stream, so it never looks inside comments,
+ * strings or directives. Every token can stay on the line it came from
+ * (long gaps become #line directives), so compile errors in optimized
+ * sources still point at the editor's lines.
+ */
+
+#ifndef GLSL_OPTIMIZE_H
+#define GLSL_OPTIMIZE_H
+
+#include "glsl_lexer.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+/* What to do and what to keep */
+typedef struct {
+    bool remove_dead_functions;                 /* Drop functions unreachable from the roots */
+    bool fold_constants;                        /* Fold literal arithmetic, e.g. 2.0*3.0 -> 6. */
+    bool minify;                                /* Drop comments and whitespace */
+    bool keep_lines;                            /* Keep tokens on their lines (#line mapping intact) */
+    const char *const *roots;                   /* Functions kept with everything they call */
+    int root_count;
+    const glsl_token_stream_t *const *users;    /* Sources linked against this one: */
+    int user_count;                             /* functions they name are roots too */
+} glsl_optimize_options_t;
+
+/* What an optimization did */
+typedef struct {
+    size_t input_bytes;
+    size_t output_bytes;
+    int functions_removed;
+    int constants_folded;
+} glsl_optimize_stats_t;
+
+/**
+ * Optimize a GLSL source
+ * Functions that are defined inside preprocessor conditionals, or named by
+ * a macro or a global initializer, are always kept. No function is removed
+ * while a #define in the source or its users pastes tokens (##).
+ *
+ * @param source NUL-terminated GLSL source
+ * @param options What to do (roots should name main, or set users)
+ * @param stats Filled with what was done (may be NULL)
+ * @return Optimized source (caller frees), NULL on OOM
+ */
+char *glsl_optimize(const char *source, const glsl_optimize_options_t *options,
+                    glsl_optimize_stats_t *stats);
+
+#endif /* GLSL_OPTIMIZE_H */
@@ -0,0 +1,306 @@
+/* Shader Include Modules - Implementation
+ * Process-wide cache of included files with a reverse-dependency map
+ */
+
+#include "shader_include.h"
+#define SHADER_LOG_SUBSYSTEM SHADER_LOG_INCLUDE
+#include "shader_log.h"
+#include "shader_trace.h"
+#include "platform_compat.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Cache slot: the public module plus what change detection needs */
+typedef struct {
+    shader_include_module_t module;
+    time_t mtime;                            /* Modification time at the last read */
+    long long size;                          /* File size at the last read */
+    int owners[SHADER_INCLUDE_MAX_OWNERS];   /* Reverse dependencies */
+    int owner_count;
+} include_slot_t;
+
+/* Module state */
+static struct {
+    include_slot_t slots[SHADER_INCLUDE_MAX_MODULES];
+    int count;
+    char library_path[PATH_MAX];
+} include_state = {
+    .count = 0,
+    .library_path = ""
+};
+
+/* ============================================
+ * Helpers
+ * ============================================ */
+
+/* 64-bit FNV-1a */
+static uint64_t hash_text(const char *text) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (const unsigned char *p = (const unsigned char *)text; *p; p++) {
+        hash ^= *p;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static bool is_absolute_path(const char *path) {
+#ifdef PLATFORM_WINDOWS
+    return path[0] == '\\' || path[0] == '/' || (path[0] && path[1] == ':');
+#else
+    return path[0] == '/';
+#endif
+}
+
+static char *dir_of(const char *path) {
+    const char *slash = strrchr(path, PATH_SEPARATOR);
+#ifdef PLATFORM_WINDOWS
+    const char *fwd = strrchr(path, '/');
+    if (fwd > slash) slash = fwd;
+#endif
+    if (!slash) {
+        char *dot = malloc(2);
+        if (dot) strcpy(dot, ".");
+        return dot;
+    }
+
+    size_t length = (slash == path) ? 1 : (size_t)(slash - path);
+    char *dir = malloc(length + 1);
+    if (!dir) return NULL;
+    memcpy(dir, path, length);
+    dir[length] = '\0';
+    return dir;
+}
+
+static char *read_file(const char *path) {
+    uint64_t span = shader_trace_begin();
+    FILE *f = fopen(path, "rb");
+    char *data = NULL;
+
+    if (f && fseek(f, 0, SEEK_END) == 0) {
+        long size = ftell(f);
+        if (size >= 0 && fseek(f, 0, SEEK_SET) == 0) {
+            data = malloc((size_t)size + 1);
+            if (data) {
+                size_t got = fread(data, 1, (size_t)size, f);
+                data[got] = '\0';
+            }
+        }
+    }
+    if (f) fclose(f);
+
+    shader_trace_end(span, SHADER_TRACE_IO, "read include", path);
+    return data;
+}
+
+static bool stat_file(const char *path, time_t *mtime, long long *size) {
+    struct stat st;
+    if (stat(path, &st) != 0 || S_ISDIR(st.st_mode)) {
+        return false;
+    }
+    *mtime = st.st_mtime;
+    *size = (long long)st.st_size;
+    return true;
+}
+
+static int find_slot(const char *path) {
+    for (int i = 0; i < include_state.count; i++) {
+        if (strcmp(include_state.slots[i].module.path, path) == 0) return i;
+    }
+    return -1;
+}
+
+/* Replace a slot's contents with a fresh read. Returns true if they changed. */
+static bool reload_slot(include_slot_t *slot, time_t mtime, long long size) {
+    shader_include_module_t *m = &slot->module;
+
+    slot->mtime = mtime;
+    slot->size = size;
+
+    char *source = read_file(m->path);
+    if (!source) return false;
+
+    uint64_t hash = hash_text(source);
+    if (m->source && hash == m->hash) {
+        /* Touched but not edited */
+        free(source);
+        return false;
+    }
+
+    glsl_token_stream_t *tokens = glsl_lex(source);
+    if (!tokens) {
+        free(source);
+        return false;
+    }
+
+    glsl_token_stream_free(m->tokens);
+    free(m->source);
+    m->source = source;
+    m->tokens = tokens;
+    m->hash = hash;
+    m->generation++;
+    return true;
+}
+
+/* Load path into a new slot */
+static const shader_include_module_t *load_slot(const char *path, time_t mtime, long long size) {
+    if (include_state.count == SHADER_INCLUDE_MAX_MODULES) {
+        log_error("Include cache full (%d files), not loading %s", SHADER_INCLUDE_MAX_MODULES, path);
+        return NULL;
+    }
+
+    include_slot_t *slot = &include_state.slots[include_state.count];
+    memset(slot, 0, sizeof(*slot));
+    slot->module.path = malloc(strlen(path) + 1);
+    if (!slot->module.path) return NULL;
+    strcpy(slot->module.path, path);
+    slot->module.dir = dir_of(path);
+
+    if (!slot->module.dir || !reload_slot(slot, mtime, size)) {
+        free(slot->module.path);
+        free(slot->module.dir);
+        memset(slot, 0, sizeof(*slot));
+        return NULL;
+    }
+
+    slot->module.id = ++include_state.count;
+    log_info("Loaded include %s (module %d, %d tokens)", path, slot->module.id,
+             slot->module.tokens->count);
+    return &slot->module;
+}
+
+/* ============================================
+ * Public API
+ * ============================================ */
+
+void shader_include_set_library_path(const char *path) {
+    if (path && path[0]) {
+        snprintf(include_state.library_path, sizeof(include_state.library_path), "%s", path);
+    } else {
+        char config_dir[PATH_MAX];
+        platform_get_config_dir(config_dir, sizeof(config_dir));
+        platform_path_join(include_state.library_path, sizeof(include_state.library_path),
+                           config_dir, "library");
+    }
+}
+
+const char *shader_include_get_library_path(void) {
+    if (!include_state.library_path[0]) {
+        shader_include_set_library_path(NULL);
+    }
+    return include_state.library_path;
+}
+
+const shader_include_module_t *shader_include_resolve(const char *name, const char *base_dir) {
+    if (!name || !name[0]) return NULL;
+
+    /* Candidate paths in lookup order */
+    char paths[2][PATH_MAX];
+    int path_count = 0;
+    if (is_absolute_path(name)) {
+        snprintf(paths[path_count++], PATH_MAX, "%s", name);
+    } else {
+        if (base_dir && base_dir[0]) {
+            platform_path_join(paths[path_count++], PATH_MAX, base_dir, name);
+        }
+        platform_path_join(paths[path_count++], PATH_MAX, shader_include_get_library_path(), name);
+    }
+
+    for (int p = 0; p < path_count; p++) {
+        const char *path = paths[p];
+        time_t mtime;
+        long long size;
+        if (!stat_file(path, &mtime, &size)) continue;
+
+        int index = find_slot(path);
+        if (index < 0) {
+            return load_slot(path, mtime, size);
+        }
+
+        include_slot_t *slot = &include_state.slots[index];
+        if (slot->mtime != mtime || slot->size != size) {
+            if (reload_slot(slot, mtime, size)) {
+                log_info("Include %s changed (generation %u)", path, slot->module.generation);
+            }
+        }
+        return &slot->module;
+    }
+    return NULL;
+}
+
+const shader_include_module_t *shader_include_get(int id) {
+    if (id < 1 || id > include_state.count) return NULL;
+    return &include_state.slots[id - 1].module;
+}
+
+int shader_include_module_count(void) {
+    return include_state.count;
+}
+
+int shader_include_check_changes(int *changed, int max_changed) {
+    int count = 0;
+
+    for (int i = 0; i < include_state.count; i++) {
+        include_slot_t *slot = &include_state.slots[i];
+
+        /* A deleted file keeps its last contents until it comes back */
+        time_t mtime;
+        long long size;
+        if (!stat_file(slot->module.path, &mtime, &size)) continue;
+        if (mtime == slot->mtime && size == slot->size) continue;
+
+        if (reload_slot(slot, mtime, size)) {
+            log_info("Include %s changed (generation %u)", slot->module.path, slot->module.generation);
+            if (changed && count < max_changed) {
+                changed[count] = slot->module.id;
+            }
+            count++;
+        }
+    }
+    return count;
+}
+
+void shader_include_add_dependent(int id, int owner) {
+    if (id < 1 || id > include_state.count || owner < 0) return;
+
+    include_slot_t *slot = &include_state.slots[id - 1];
+    for (int i = 0; i < slot->owner_count; i++) {
+        if (slot->owners[i] == owner) return;
+    }
+    if (slot->owner_count < SHADER_INCLUDE_MAX_OWNERS) {
+        slot->owners[slot->owner_count++] = owner;
+    }
+}
+
+int shader_include_get_dependents(int id, int *owners, int max_owners) {
+    if (id < 1 || id > include_state.count || !owners) return 0;
+
+    const include_slot_t *slot = &include_state.slots[id - 1];
+    int count = slot->owner_count < max_owners ? slot->owner_count : max_owners;
+    memcpy(owners, slot->owners, (size_t)count * sizeof(int));
+    return count;
+}
+
+void shader_include_forget_owner(int owner) {
+    for (int i = 0; i < include_state.count; i++) {
+        include_slot_t *slot = &include_state.slots[i];
+        for (int j = 0; j < slot->owner_count; j++) {
+            if (slot->owners[j] == owner) {
+                slot->owners[j] = slot->owners[--slot->owner_count];
+                break;
+            }
+        }
+    }
+}
+
+void shader_include_clear(void) {
+    for (int i = 0; i < include_state.count; i++) {
+        shader_include_module_t *m = &include_state.slots[i].module;
+        glsl_token_stream_free(m->tokens);
+        free(m->source);
+        free(m->path);
+        free(m->dir);
+    }
+    memset(include_state.slots, 0, sizeof(include_state.slots));
+    include_state.count = 0;
+}
@@ -0,0 +1,125 @@
+/* Shader Include Modules
+ * Resolves #include "file.glsl" for shaders and keeps every included file
+ * parsed once
+ *
+ * Included files are loaded into a process-wide module cache. Each module
+ * is read and lexed once; it is only re-read when its modification time or
+ * size changes and only counts as changed when the contents hash differs.
+ * A module keeps its slot for the life of the cache, so its id doubles as
+ * the #line source-string number compile errors refer to.
+ *
+ * Owners (editor tabs) register the modules they were compiled with, which
+ * gives a reverse-dependency map: when a library file changes, only the
+ * owners that include it need to recompile.
+ */
+
+#ifndef SHADER_INCLUDE_H
+#define SHADER_INCLUDE_H
+
+#include "glsl_lexer.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Capacity of the module cache and of the per-module owner lists */
+#define SHADER_INCLUDE_MAX_MODULES 128
+#define SHADER_INCLUDE_MAX_OWNERS  32
+
+/* Nested #include levels allowed before expansion gives up */
+#define SHADER_INCLUDE_MAX_DEPTH 16
+
+/* One included file */
+typedef struct {
+    int id;                          /* 1-based, also the #line source-string number */
+    char *path;                      /* Path the file was loaded from */
+    char *dir;                       /* Directory of path, for nested includes */
+    char *source;                    /* File contents */
+    glsl_token_stream_t *tokens;     /* source lexed once per load */
+    uint64_t hash;                   /* FNV-1a of source */
+    unsigned int generation;         /* Bumped whenever the contents change */
+} shader_include_module_t;
+
+/**
+ * Set the user library directory searched after the shader's own directory
+ *
+ * @param path Directory, or NULL for the default (<config dir>/library)
+ */
+void shader_include_set_library_path(const char *path);
+
+/**
+ * Get the user library directory
+ *
+ * @return Directory searched for includes not found next to the shader
+ */
+const char *shader_include_get_library_path(void);
+
+/**
+ * Resolve and load an included file
+ * Absolute names are used as-is; others are looked up in base_dir first,
+ * then in the library directory. A cached module is re-read only if its
+ * modification time or size changed.
+ *
+ * @param name File name as written in the #include directive
+ * @param base_dir Directory of the including file (may be NULL)
+ * @return Module, or NULL if the file can't be found or the cache is full
+ */
+const shader_include_module_t *shader_include_resolve(const char *name, const char *base_dir);
+
+/**
+ * Get a loaded module by id
+ *
+ * @param id Module id
+ * @return Module, or NULL if no module has that id
+ */
+const shader_include_module_t *shader_include_get(int id);
+
+/**
+ * Get the number of loaded modules
+ *
+ * @return Module count (0 if no shader used #include yet)
+ */
+int shader_include_module_count(void);
+
+/**
+ * Re-read modules whose files changed on disk
+ * Cheap enough to poll: one stat() per module, files are only read when
+ * their modification time or size changed.
+ *
+ * @param changed Receives the ids of modules whose contents changed (may be NULL)
+ * @param max_changed Capacity of changed
+ * @return Number of modules whose contents changed
+ */
+int shader_include_check_changes(int *changed, int max_changed);
+
+/**
+ * Record that an owner was compiled with a module
+ *
+ * @param id Module id
+ * @param owner Owner id (editor tab), ignored if negative
+ */
+void shader_include_add_dependent(int id, int owner);
+
+/**
+ * Get the owners that include a module
+ *
+ * @param id Module id
+ * @param owners Receives owner ids
+ * @param max_owners Capacity of owners
+ * @return Number of owners written
+ */
+int shader_include_get_dependents(int id, int *owners, int max_owners);
+
+/**
+ * Drop an owner from every module's dependents (tab closed)
+ *
+ * @param owner Owner id
+ */
+void shader_include_forget_owner(int owner);
+
+/**
+ * Free every module and dependency
+ * Module ids are reused afterwards, so no shader compiled with includes
+ * may outlive this call.
+ */
+void shader_include_clear(void);
+
+#endif /* SHADER_INCLUDE_H */
@@ -0,0 +1,429 @@
+/* Shader Library Logging
+ * Lock-free ring buffer drained to stderr by a background thread
+ *
+ * Any thread may log: a writer claims a slot by advancing the write
+ * position with a compare-and-swap, formats into it and publishes it with
+ * the slot's sequence number (a bounded MPMC queue with one consumer).
+ * The flusher sleeps on a condition variable while the ring is empty;
+ * writers make no system calls unless it is asleep and needs waking. When
+ * the ring is full the message is dropped and
+ * counted rather than making the caller wait. Errors are written out
+ * before log_error returns, so they survive a crash that follows.
+ */
+
+#include "shader_log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdarg.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+
+/* Slots in the ring (power of two) and text kept inline per slot */
+#define LOG_RING_SLOTS 1024
+#define LOG_SLOT_TEXT  240
+
+/* Messages written per stderr flush */
+#define LOG_BATCH_BYTES 16384
+
+typedef struct {
+    atomic_size_t sequence;      /* == position: free, position + 1: holds a message */
+    struct timespec time;
+    int subsystem;
+    int level;
+    char *long_text;             /* Heap copy of messages that don't fit text */
+    char text[LOG_SLOT_TEXT];
+} log_slot_t;
+
+static struct {
+    log_slot_t slots[LOG_RING_SLOTS];
+    atomic_size_t write_position;
+    size_t read_position;        /* Only touched by the flusher (or under flush_lock) */
+    atomic_uint dropped;
+    pthread_t thread;
+    pthread_mutex_t flush_lock;  /* Flusher thread vs shader_log_flush() */
+    pthread_mutex_t wake_lock;   /* Guards the flusher's sleep on wake */
+    pthread_cond_t wake;
+    atomic_bool sleeping;        /* Flusher waits on wake (or is about to) */
+    atomic_int state;            /* LOG_STATE_* */
+} g_log = {
+    .flush_lock = PTHREAD_MUTEX_INITIALIZER,
+    .wake_lock = PTHREAD_MUTEX_INITIALIZER,
+    .wake = PTHREAD_COND_INITIALIZER,
+};
+
+enum {
+    LOG_STATE_IDLE = 0,          /* Nothing logged yet */
+    LOG_STATE_STARTING,
+    LOG_STATE_RUNNING,           /* Flusher thread draining the ring */
+    LOG_STATE_SYNCHRONOUS        /* No thread (failed to start, or exiting): write directly */
+};
+
+atomic_int shader_log_levels[SHADER_LOG_SUBSYSTEM_COUNT] = {
+    [0 ... SHADER_LOG_SUBSYSTEM_COUNT - 1] = SHADER_LOG_UNSET
+};
+
+static const char *const subsystem_names[SHADER_LOG_SUBSYSTEM_COUNT] = {
+    [SHADER_LOG_GENERAL]    = "ShaderLib",
+    [SHADER_LOG_MULTIPASS]  = "multipass",
+    [SHADER_LOG_INCLUDE]    = "include",
+    [SHADER_LOG_PREVIEW]    = "preview",
+    [SHADER_LOG_THUMBNAILS] = "thumbnails",
+};
+
+static const char *const level_names[] = { "ERROR", "WARN", "INFO", "DEBUG" };
+
+/* ============================================
+ * Levels
+ * ============================================ */
+
+static int parse_level(const char *name, size_t len) {
+    static const struct { const char *name; int level; } names[] = {
+        { "off", -1 }, { "none", -1 }, { "error", LOG_LEVEL_ERROR },
+        { "warn", LOG_LEVEL_WARN }, { "warning", LOG_LEVEL_WARN },
+        { "info", LOG_LEVEL_INFO }, { "debug", LOG_LEVEL_DEBUG },
+    };
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        if (strlen(names[i].name) == len && strncasecmp(name, names[i].name, len) == 0) {
+            return names[i].level;
+        }
+    }
+    if (len == 1 && name[0] >= '0' && name[0] <= '3') return name[0] - '0';
+    return -2;
+}
+
+static void configure_from_environment(void);
+
+static void set_level(int subsystem, int level) {
+    if (level < -1) level = -1;
+    if (subsystem == SHADER_LOG_ALL) {
+        for (int i = 0; i < SHADER_LOG_SUBSYSTEM_COUNT; i++) {
+            atomic_store(&shader_log_levels[i], level);
+        }
+    } else if (subsystem >= 0 && subsystem < SHADER_LOG_SUBSYSTEM_COUNT) {
+        atomic_store(&shader_log_levels[subsystem], level);
+    }
+}
+
+void shader_log_set_level(int subsystem, int level) {
+    configure_from_environment();
+    set_level(subsystem, level);
+}
+
+static bool apply_spec(const char *spec) {
+    bool ok = true;
+
+    while (spec && *spec) {
+        const char *end = strchr(spec, ',');
+        size_t len = end ? (size_t)(end - spec) : strlen(spec);
+        const char *equals = memchr(spec, '=', len);
+
+        if (len > 0 && !equals) {
+            int level = parse_level(spec, len);
+            if (level < -1) ok = false;
+            else set_level(SHADER_LOG_ALL, level);
+        } else if (equals) {
+            size_t name_len = (size_t)(equals - spec);
+            int level = parse_level(equals + 1, len - name_len - 1);
+            int subsystem = -1;
+            for (int i = 0; i < SHADER_LOG_SUBSYSTEM_COUNT; i++) {
+                if (strlen(subsystem_names[i]) == name_len &&
+                    strncasecmp(spec, subsystem_names[i], name_len) == 0) {
+                    subsystem = i;
+                }
+            }
+            if (level < -1 || subsystem < 0) ok = false;
+            else set_level(subsystem, level);
+        }
+
+        spec = end ? end + 1 : NULL;
+    }
+
+    return ok;
+}
+
+bool shader_log_configure(const char *spec) {
+    configure_from_environment();
+    return apply_spec(spec);
+}
+
+static void apply_environment(void) {
+    for (int i = 0; i < SHADER_LOG_SUBSYSTEM_COUNT; i++) {
+        atomic_store(&shader_log_levels[i], SHADER_LOG_DEFAULT_LEVEL);
+    }
+
+    const char *spec = getenv("GLEDITOR_LOG");
+    if (spec && !apply_spec(spec)) {
+        fprintf(stderr, "[ShaderLib] GLEDITOR_LOG: could not parse all of \"%s\"\n", spec);
+    }
+}
+
+/* Defaults, then GLEDITOR_LOG - once, before the first message or the
+ * first explicit setting, which then overrides both. Threads arriving
+ * meanwhile wait until the levels are set. */
+static void configure_from_environment(void) {
+    static pthread_once_t configured = PTHREAD_ONCE_INIT;
+    pthread_once(&configured, apply_environment);
+}
+
+int shader_log_configure_level(int subsystem) {
+    configure_from_environment();
+    return atomic_load(&shader_log_levels[subsystem]);
+}
+
+/* ============================================
+ * Output
+ * ============================================ */
+
+/* Append one formatted line to buf, returning the new length */
+static size_t format_line(char *buf, size_t size, size_t len, const struct timespec *time,
+                          int subsystem, int level, const char *text) {
+    struct tm tm_info;
+    time_t seconds = time->tv_sec;
+    localtime_r(&seconds, &tm_info);
+
+    char stamp[32];
+    strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &tm_info);
+
+    int n = snprintf(buf + len, size - len, "[%s.%03ld] [%s] [%s] %s\n", stamp,
+                     time->tv_nsec / 1000000L, subsystem_names[subsystem],
+                     level_names[level], text);
+    if (n < 0) return len;
+    return ((size_t)n < size - len) ? len + (size_t)n : size;
+}
+
+static void write_line(const struct timespec *time, int subsystem, int level, const char *text) {
+    char line[LOG_SLOT_TEXT + 96];
+    size_t len = format_line(line, sizeof(line), 0, time, subsystem, level, text);
+    if (len >= sizeof(line)) {
+        /* Long message: header and text separately */
+        len = format_line(line, sizeof(line), 0, time, subsystem, level, "");
+        fwrite(line, 1, len - 1, stderr);
+        fputs(text, stderr);
+        fputc('\n', stderr);
+    } else {
+        fwrite(line, 1, len, stderr);
+    }
+}
+
+/* Write every published message; the caller holds flush_lock.
+ * Returns false if there was nothing to write. */
+static bool drain(void) {
+    char batch[LOG_BATCH_BYTES];
+    size_t len = 0;
+    bool wrote = false;
+
+    for (;;) {
+        log_slot_t *slot = &g_log.slots[g_log.read_position & (LOG_RING_SLOTS - 1)];
+        size_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        if (sequence != g_log.read_position + 1) break;
+
+        const char *text = slot->long_text ? slot->long_text : slot->text;
+        size_t before = len;
+        len = format_line(batch, sizeof(batch), len, &slot->time, slot->subsystem,
+                          slot->level, text);
+        if (len >= sizeof(batch)) {
+            /* Didn't fit: write what's batched, then this one on its own */
+            fwrite(batch, 1, before, stderr);
+            write_line(&slot->time, slot->subsystem, slot->level, text);
+            len = 0;
+        }
+        wrote = true;
+
+        free(slot->long_text);
+        slot->long_text = NULL;
+        atomic_store_explicit(&slot->sequence, g_log.read_position + LOG_RING_SLOTS,
+                              memory_order_release);
+        g_log.read_position++;
+    }
+
+    if (len > 0) fwrite(batch, 1, len, stderr);
+
+    unsigned int dropped = atomic_exchange(&g_log.dropped, 0);
+    if (dropped > 0) {
+        fprintf(stderr, "[ShaderLib] %u log messages dropped (ring full)\n", dropped);
+        wrote = true;
+    }
+    if (wrote) fflush(stderr);
+    return wrote;
+}
+
+/* Whether the flusher has nothing to write */
+static bool ring_empty(void) {
+    pthread_mutex_lock(&g_log.flush_lock);
+    log_slot_t *slot = &g_log.slots[g_log.read_position & (LOG_RING_SLOTS - 1)];
+    bool empty = atomic_load(&slot->sequence) != g_log.read_position + 1 &&
+                 atomic_load(&g_log.dropped) == 0;
+    pthread_mutex_unlock(&g_log.flush_lock);
+    return empty;
+}
+
+/* Wake the flusher if it sleeps (after publishing a message) */
+static void wake_flusher(void) {
+    /* Pairs with the fence in flusher_main: either it sees the message or
+     * this sees it sleeping */
+    atomic_thread_fence(memory_order_seq_cst);
+    if (!atomic_load_explicit(&g_log.sleeping, memory_order_relaxed)) return;
+
+    pthread_mutex_lock(&g_log.wake_lock);
+    pthread_cond_signal(&g_log.wake);
+    pthread_mutex_unlock(&g_log.wake_lock);
+}
+
+static void *flusher_main(void *arg) {
+    (void)arg;
+
+    while (atomic_load(&g_log.state) == LOG_STATE_RUNNING) {
+        pthread_mutex_lock(&g_log.flush_lock);
+        drain();
+        pthread_mutex_unlock(&g_log.flush_lock);
+
+        /* Announce the sleep before the last look at the ring, so a writer
+         * publishing meanwhile knows to signal */
+        pthread_mutex_lock(&g_log.wake_lock);
+        atomic_store_explicit(&g_log.sleeping, true, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
+        while (atomic_load(&g_log.state) == LOG_STATE_RUNNING && ring_empty()) {
+            pthread_cond_wait(&g_log.wake, &g_log.wake_lock);
+        }
+        atomic_store_explicit(&g_log.sleeping, false, memory_order_relaxed);
+        pthread_mutex_unlock(&g_log.wake_lock);
+    }
+    return NULL;
+}
+
+/* Stop the flusher at exit; anything logged later is written directly */
+static void shutdown_flusher(void) {
+    int running = LOG_STATE_RUNNING;
+    if (!atomic_compare_exchange_strong(&g_log.state, &running, LOG_STATE_SYNCHRONOUS)) {
+        return;
+    }
+    pthread_mutex_lock(&g_log.wake_lock);
+    pthread_cond_signal(&g_log.wake);
+    pthread_mutex_unlock(&g_log.wake_lock);
+    pthread_join(g_log.thread, NULL);
+
+    pthread_mutex_lock(&g_log.flush_lock);
+    drain();
+    pthread_mutex_unlock(&g_log.flush_lock);
+}
+
+static void start_flusher(void) {
+    int idle = LOG_STATE_IDLE;
+    if (!atomic_compare_exchange_strong(&g_log.state, &idle, LOG_STATE_STARTING)) {
+        /* Another thread is starting it; the ring isn't usable until it's done */
+        while (atomic_load(&g_log.state) == LOG_STATE_STARTING) {
+            sched_yield();
+        }
+        return;
+    }
+
+    for (size_t i = 0; i < LOG_RING_SLOTS; i++) {
+        atomic_init(&g_log.slots[i].sequence, i);
+    }
+
+    atomic_store(&g_log.state, LOG_STATE_RUNNING);
+    if (pthread_create(&g_log.thread, NULL, flusher_main, NULL) != 0) {
+        atomic_store(&g_log.state, LOG_STATE_SYNCHRONOUS);
+        return;
+    }
+    atexit(shutdown_flusher);
+}
+
+void shader_log_flush(void) {
+    int state = atomic_load(&g_log.state);
+    if (state != LOG_STATE_RUNNING && state != LOG_STATE_SYNCHRONOUS) return;
+
+    pthread_mutex_lock(&g_log.flush_lock);
+    drain();
+    pthread_mutex_unlock(&g_log.flush_lock);
+}
+
+/* ============================================
+ * Writing
+ * ============================================ */
+
+void shader_log_write(int subsystem, int level, const char *fmt, ...) {
+    if (subsystem < 0 || subsystem >= SHADER_LOG_SUBSYSTEM_COUNT) subsystem = SHADER_LOG_GENERAL;
+    if (level < LOG_LEVEL_ERROR) level = LOG_LEVEL_ERROR;
+    if (level > LOG_LEVEL_DEBUG) level = LOG_LEVEL_DEBUG;
+
+    if (atomic_load_explicit(&g_log.state, memory_order_acquire) == LOG_STATE_IDLE) {
+        start_flusher();
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    va_list args;
+    if (atomic_load_explicit(&g_log.state, memory_order_acquire) == LOG_STATE_SYNCHRONOUS) {
+        va_start(args, fmt);
+        int n = vsnprintf(NULL, 0, fmt, args);
+        va_end(args);
+        char *text = (n >= 0) ? malloc((size_t)n + 1) : NULL;
+        if (!text) return;
+        va_start(args, fmt);
+        vsnprintf(text, (size_t)n + 1, fmt, args);
+        va_end(args);
+
+        pthread_mutex_lock(&g_log.flush_lock);
+        drain();
+        write_line(&now, subsystem, level, text);
+        fflush(stderr);
+        pthread_mutex_unlock(&g_log.flush_lock);
+        free(text);
+        return;
+    }
+
+    /* Claim the next free slot */
+    log_slot_t *slot;
+    size_t position = atomic_load_explicit(&g_log.write_position, memory_order_relaxed);
+    for (;;) {
+        slot = &g_log.slots[position & (LOG_RING_SLOTS - 1)];
+        size_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        if (sequence == position) {
+            if (atomic_compare_exchange_weak_explicit(&g_log.write_position, &position,
+                                                      position + 1, memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                break;
+            }
+        } else if (sequence < position) {
+            /* Still holds a message from the previous lap: ring full */
+            atomic_fetch_add_explicit(&g_log.dropped, 1, memory_order_relaxed);
+            wake_flusher();
+            return;
+        } else {
+            position = atomic_load_explicit(&g_log.write_position, memory_order_relaxed);
+        }
+    }
+
+    slot->time = now;
+    slot->subsystem = subsystem;
+    slot->level = level;
+    slot->long_text = NULL;
+
+    va_start(args, fmt);
+    int n = vsnprintf(slot->text, sizeof(slot->text), fmt, args);
+    va_end(args);
+    if (n >= (int)sizeof(slot->text)) {
+        char *text = malloc((size_t)n + 1);
+        if (text) {
+            va_start(args, fmt);
+            vsnprintf(text, (size_t)n + 1, fmt, args);
+            va_end(args);
+            slot->long_text = text;
+        }
+    } else if (n < 0) {
+        slot->text[0] = '\0';
+    }
+
+    atomic_store_explicit(&slot->sequence, position + 1, memory_order_release);
+
+    wake_flusher();
+
+    if (level == LOG_LEVEL_ERROR) {
+        shader_log_flush();
+    }
+}
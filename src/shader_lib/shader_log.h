@@ -1,14 +1,22 @@
 /* Shader Library Logging Shim
  * Provides logging macros that work without the full daemon logging system
+ *
+ * Messages go through a lock-free ring buffer; a background thread adds
+ * the timestamp text and writes them to stderr, so the caller only pays
+ * for formatting the message. The level is checked before any argument is
+ * evaluated, so suppressed messages cost one load and compare.
+ *
+ * The level can be chosen per subsystem at runtime, with
+ * shader_log_set_level() or the GLEDITOR_LOG environment variable:
+ *   GLEDITOR_LOG=debug                  everything
+ *   GLEDITOR_LOG=warn,include=debug     warnings, plus #include resolution
  */
 
 #ifndef SHADER_LIB_LOG_H
 #define SHADER_LIB_LOG_H
 
-#include <stdio.h>
-#include <stdarg.h>
-#include <time.h>
-#include <sys/time.h>
+#include <stdbool.h>
+#include <stdatomic.h>
 
 /* Log levels */
 #define LOG_LEVEL_ERROR 0
@@ -16,45 +24,97 @@
 #define LOG_LEVEL_INFO  2
 #define LOG_LEVEL_DEBUG 3
 
-/* Default log level (can be overridden at compile time with -DSHADER_LIB_LOG_LEVEL=N)
- * Set to INFO by default for better performance (DEBUG causes significant overhead) */
+/* Most verbose level compiled in (can be overridden at compile time with
+ * -DSHADER_LIB_LOG_LEVEL=N); messages above it are removed entirely */
 #ifndef SHADER_LIB_LOG_LEVEL
-#define SHADER_LIB_LOG_LEVEL LOG_LEVEL_INFO
+#define SHADER_LIB_LOG_LEVEL LOG_LEVEL_DEBUG
 #endif
 
-/* Get current timestamp for logging */
-static inline void shader_log_timestamp(char *buf, size_t size) {
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    time_t now = tv.tv_sec;
-    struct tm *tm_info = localtime(&now);
-    strftime(buf, size, "%Y-%m-%d %H:%M:%S", tm_info);
-}
+/* Level used until GLEDITOR_LOG or shader_log_set_level() choose one */
+#define SHADER_LOG_DEFAULT_LEVEL LOG_LEVEL_INFO
+
+/* Subsystems with their own level */
+typedef enum {
+    SHADER_LOG_GENERAL = 0,
+    SHADER_LOG_MULTIPASS,        /* Pass compiles, rendering, adaptive resolution */
+    SHADER_LOG_INCLUDE,          /* #include resolution and reloads */
+    SHADER_LOG_PREVIEW,          /* Editor preview */
+    SHADER_LOG_THUMBNAILS,       /* Tab thumbnails */
+    SHADER_LOG_SUBSYSTEM_COUNT
+} shader_log_subsystem_t;
+
+/* Pass to shader_log_set_level() to set every subsystem */
+#define SHADER_LOG_ALL (-1)
+
+/* Each source file picks its subsystem before including this header */
+#ifndef SHADER_LOG_SUBSYSTEM
+#define SHADER_LOG_SUBSYSTEM SHADER_LOG_GENERAL
+#endif
+
+/* Current level of each subsystem (-1 = off, SHADER_LOG_UNSET until
+ * configured from the environment) */
+#define SHADER_LOG_UNSET (-2)
+extern atomic_int shader_log_levels[SHADER_LOG_SUBSYSTEM_COUNT];
 
-/* Core logging function */
-static inline void shader_log(int level, const char *prefix, const char *fmt, ...) {
-    if (level > SHADER_LIB_LOG_LEVEL) {
-        return;
-    }
+/* Read GLEDITOR_LOG on first use and return the subsystem's level */
+int shader_log_configure_level(int subsystem);
 
-    char timestamp[32];
-    shader_log_timestamp(timestamp, sizeof(timestamp));
+/* Check whether a message would be written */
+static inline bool shader_log_enabled(int subsystem, int level) {
+    if (level > SHADER_LIB_LOG_LEVEL) return false;
+    int current = atomic_load_explicit(&shader_log_levels[subsystem], memory_order_relaxed);
+    if (current == SHADER_LOG_UNSET) current = shader_log_configure_level(subsystem);
+    return level <= current;
+}
 
-    fprintf(stderr, "[%s] [ShaderLib] [%s] ", timestamp, prefix);
+/**
+ * Queue a message (use the log_* macros, which check the level first)
+ *
+ * @param subsystem Subsystem the message belongs to
+ * @param level LOG_LEVEL_* of the message
+ * @param fmt printf-style format
+ */
+void shader_log_write(int subsystem, int level, const char *fmt, ...)
+    __attribute__((format(printf, 3, 4)));
+
+/**
+ * Set the level of a subsystem
+ *
+ * @param subsystem Subsystem, or SHADER_LOG_ALL
+ * @param level LOG_LEVEL_* to show up to (-1 silences everything)
+ */
+void shader_log_set_level(int subsystem, int level);
+
+/**
+ * Apply a level specification such as "info" or "warn,multipass=debug"
+ * A bare level applies to every subsystem; later entries override it.
+ *
+ * @param spec Comma-separated levels
+ * @return false if any entry was not understood (the others still apply)
+ */
+bool shader_log_configure(const char *spec);
 
-    va_list args;
-    va_start(args, fmt);
-    vfprintf(stderr, fmt, args);
-    va_end(args);
+/**
+ * Write out every queued message before returning
+ * Runs automatically at exit.
+ */
+void shader_log_flush(void);
 
-    fprintf(stderr, "\n");
-}
+/* Core logging macro - arguments are only evaluated when the level is enabled */
+#define shader_log(level, ...) do { \
+    if (shader_log_enabled(SHADER_LOG_SUBSYSTEM, (level))) { \
+        shader_log_write(SHADER_LOG_SUBSYSTEM, (level), __VA_ARGS__); \
+    } \
+} while(0)
 
 /* Logging macros compatible with daemon's log_* functions */
-#define log_error(...) shader_log(LOG_LEVEL_ERROR, "ERROR", __VA_ARGS__)
-#define log_warn(...)  shader_log(LOG_LEVEL_WARN,  "WARN",  __VA_ARGS__)
-#define log_info(...)  shader_log(LOG_LEVEL_INFO,  "INFO",  __VA_ARGS__)
-#define log_debug(...) shader_log(LOG_LEVEL_DEBUG, "DEBUG", __VA_ARGS__)
+#define log_error(...) shader_log(LOG_LEVEL_ERROR, __VA_ARGS__)
+#define log_warn(...)  shader_log(LOG_LEVEL_WARN,  __VA_ARGS__)
+#define log_info(...)  shader_log(LOG_LEVEL_INFO,  __VA_ARGS__)
+#define log_debug(...) shader_log(LOG_LEVEL_DEBUG, __VA_ARGS__)
+
+/* True when log_debug output is enabled - guard loops that only produce debug output */
+#define log_debug_enabled() shader_log_enabled(SHADER_LOG_SUBSYSTEM, LOG_LEVEL_DEBUG)
 
 /*
  * log_debug_once - logs only the first N times (default 3)
@@ -66,7 +126,7 @@ static inline void shader_log(int level, const char *prefix, const char *fmt, ..
 
 #define log_debug_once(counter, ...) do { \
     if ((counter) < LOG_DEBUG_ONCE_MAX) { \
-        shader_log(LOG_LEVEL_DEBUG, "DEBUG", __VA_ARGS__); \
+        log_debug(__VA_ARGS__); \
         (counter)++; \
     } \
 } while(0)
@@ -79,8 +139,8 @@ static inline void shader_log(int level, const char *prefix, const char *fmt, ..
 
 #define log_debug_frame(frame_count, ...) do { \
     if ((frame_count) < LOG_DEBUG_FRAME_MAX) { \
-        shader_log(LOG_LEVEL_DEBUG, "DEBUG", __VA_ARGS__); \
+        log_debug(__VA_ARGS__); \
     } \
 } while(0)
 
-#endif /* SHADER_LIB_LOG_H */
\ No newline at end of file
+#endif /* SHADER_LIB_LOG_H */
@@ -6,7 +6,14 @@
  */
 
 #include "shader_multipass.h"
+#include "glsl_channels.h"
+#include "glsl_cost.h"
+#include "glsl_lexer.h"
+#include "glsl_optimize.h"
+#include "shader_include.h"
+#define SHADER_LOG_SUBSYSTEM SHADER_LOG_MULTIPASS
 #include "shader_log.h"
+#include "shader_trace.h"
 #include "platform_compat.h"
 #include <stdio.h>
 #include <stdlib.h>
@@ -56,7 +63,7 @@ const char *multipass_get_error_log(void) {
  * ============================================ */
 
 static void print_shader_with_line_numbers(const char *source, const char *type) {
-    if (!source) return;
+    if (!source || !log_debug_enabled()) return;
     
     log_debug("========== %s SHADER SOURCE (with line numbers) ==========", type);
     
@@ -65,6 +72,10 @@ static void print_shader_with_line_numbers(const char *source, const char *type)
     int line_num = 1;
     
     while (*line_start) {
+        /* Number lines the way the driver reports them (#line maps to editor lines) */
+        int directive_line;
+        bool directive = sscanf(line_start, "#line %d", &directive_line) == 1;
+
         line_end = strchr(line_start, '\n');
         if (line_end) {
             log_debug("%4d: %.*s", line_num, (int)(line_end - line_start), line_start);
@@ -73,13 +84,16 @@ static void print_shader_with_line_numbers(const char *source, const char *type)
             log_debug("%4d: %s", line_num, line_start);
             break;
         }
-        line_num++;
+        line_num = directive ? directive_line : line_num + 1;
     }
     
     log_debug("========== END %s SHADER SOURCE ==========", type);
 }
 
-static GLuint compile_shader(GLenum type, const char *source) {
+/* Hand a shader to the compiler without asking for the result: the status
+ * query is what makes the driver finish, so a batch issues every compile
+ * (and link) before it queries any of them */
+static GLuint compile_shader_begin(GLenum type, const char *source) {
     const char *type_str = (type == GL_VERTEX_SHADER) ? "vertex" : "fragment";
     
     print_shader_with_line_numbers(source, type_str);
@@ -93,7 +107,14 @@ static GLuint compile_shader(GLenum type, const char *source) {
     
     glShaderSource(shader, 1, &source, NULL);
     glCompileShader(shader);
-    
+    return shader;
+}
+
+/* Wait for a compile started with compile_shader_begin. Returns the shader,
+ * or 0 (and deletes it) if it failed to compile. */
+static GLuint compile_shader_end(GLuint shader, GLenum type) {
+    const char *type_str = (type == GL_VERTEX_SHADER) ? "vertex" : "fragment";
+
     GLint compiled;
     glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
     if (!compiled) {
@@ -120,39 +141,32 @@ static GLuint compile_shader(GLenum type, const char *source) {
     return shader;
 }
 
-static bool shader_create_program_from_sources(const char *vertex_src,
-                                                const char *fragment_src,
-                                                GLuint *program) {
-    if (!program) {
-        log_error("Invalid program pointer");
-        return false;
-    }
-    
-    clear_error_log();
-    
-    GLuint vertex_shader = compile_shader(GL_VERTEX_SHADER, vertex_src);
-    if (vertex_shader == 0) {
-        return false;
-    }
-    
-    GLuint fragment_shader = compile_shader(GL_FRAGMENT_SHADER, fragment_src);
-    if (fragment_shader == 0) {
-        glDeleteShader(vertex_shader);
-        return false;
-    }
-    
+static GLuint compile_shader(GLenum type, const char *source) {
+    GLuint shader = compile_shader_begin(type, source);
+    return shader ? compile_shader_end(shader, type) : 0;
+}
+
+/* Link shader objects into a new program without waiting for the result.
+ * The objects stay with the caller: the shared ones go into several
+ * programs. */
+static GLuint link_program_begin(const GLuint *objects, int count) {
     GLuint prog = glCreateProgram();
     if (prog == 0) {
         log_error("Failed to create shader program");
-        glDeleteShader(vertex_shader);
-        glDeleteShader(fragment_shader);
-        return false;
+        append_to_error_log("ERROR: Failed to create shader program\n");
+        return 0;
+    }
+
+    for (int i = 0; i < count; i++) {
+        glAttachShader(prog, objects[i]);
     }
-    
-    glAttachShader(prog, vertex_shader);
-    glAttachShader(prog, fragment_shader);
     glLinkProgram(prog);
-    
+    return prog;
+}
+
+/* Wait for a link started with link_program_begin. The program is deleted
+ * if it failed to link. */
+static bool link_program_end(GLuint prog, GLuint *program) {
     GLint linked;
     glGetProgramiv(prog, GL_LINK_STATUS, &linked);
     if (!linked) {
@@ -171,19 +185,40 @@ static bool shader_create_program_from_sources(const char *vertex_src,
         }
         
         glDeleteProgram(prog);
-        glDeleteShader(vertex_shader);
-        glDeleteShader(fragment_shader);
         return false;
     }
-    
-    glDeleteShader(vertex_shader);
-    glDeleteShader(fragment_shader);
+
+    /* A linked program keeps working without its objects */
+    GLuint attached[4];
+    GLsizei attached_count = 0;
+    glGetAttachedShaders(prog, 4, &attached_count, attached);
+    for (GLsizei i = 0; i < attached_count; i++) {
+        glDetachShader(prog, attached[i]);
+    }
     
     *program = prog;
     log_debug("Shader program created successfully (ID: %u)", prog);
     return true;
 }
 
+static bool link_program(const GLuint *objects, int count, GLuint *program) {
+    GLuint prog = link_program_begin(objects, count);
+    return prog && link_program_end(prog, program);
+}
+
+/* Compile a fragment source and link it with an already compiled vertex shader */
+static bool create_program(GLuint vertex_shader, const char *fragment_src, GLuint *program) {
+    GLuint fragment_shader = compile_shader(GL_FRAGMENT_SHADER, fragment_src);
+    if (fragment_shader == 0) {
+        return false;
+    }
+
+    GLuint objects[2] = { vertex_shader, fragment_shader };
+    bool linked = link_program(objects, 2, program);
+    glDeleteShader(fragment_shader);
+    return linked;
+}
+
 
 
 /* ============================================
@@ -198,90 +233,9 @@ static const char *skip_whitespace(const char *p) {
 }
 */
 
-/* Check if character is valid identifier char (currently unused but kept for future use) */
-/*
+/* Check if character is valid identifier char */
 static bool is_ident_char(char c) {
-    return isalnum(c) || c == '_';
-}
-*/
-
-/* Find next occurrence of pattern, respecting comments */
-static const char *find_pattern(const char *source, const char *pattern) {
-    const char *p = source;
-    size_t pat_len = strlen(pattern);
-
-    while (*p) {
-        /* Skip single-line comments */
-        if (p[0] == '/' && p[1] == '/') {
-            while (*p && *p != '\n') p++;
-            if (*p) p++;
-            continue;
-        }
-
-        /* Skip multi-line comments */
-        if (p[0] == '/' && p[1] == '*') {
-            p += 2;
-            while (*p && !(p[0] == '*' && p[1] == '/')) p++;
-            if (*p) p += 2;
-            continue;
-        }
-
-        /* Check for pattern */
-        if (strncmp(p, pattern, pat_len) == 0) {
-            return p;
-        }
-
-        p++;
-    }
-
-    return NULL;
-}
-
-/* Find the end of a function body (matching closing brace) */
-static const char *find_function_end(const char *start) {
-    const char *p = start;
-    int brace_depth = 0;
-    bool in_function = false;
-
-    while (*p) {
-        /* Skip comments */
-        if (p[0] == '/' && p[1] == '/') {
-            while (*p && *p != '\n') p++;
-            if (*p) p++;
-            continue;
-        }
-        if (p[0] == '/' && p[1] == '*') {
-            p += 2;
-            while (*p && !(p[0] == '*' && p[1] == '/')) p++;
-            if (*p) p += 2;
-            continue;
-        }
-
-        /* Skip strings */
-        if (*p == '"') {
-            p++;
-            while (*p && *p != '"') {
-                if (*p == '\\' && p[1]) p++;
-                p++;
-            }
-            if (*p) p++;
-            continue;
-        }
-
-        if (*p == '{') {
-            brace_depth++;
-            in_function = true;
-        } else if (*p == '}') {
-            brace_depth--;
-            if (in_function && brace_depth == 0) {
-                return p + 1;
-            }
-        }
-
-        p++;
-    }
-
-    return p;
+    return isalnum((unsigned char)c) || c == '_';
 }
 
 /* Extract a substring */
@@ -308,6 +262,63 @@ static char *str_dup(const char *s) {
     return result;
 }
 
+/* Growable string for assembling shader sources: appends are amortized
+ * O(1), so building a source is linear in its length */
+typedef struct {
+    char *data;
+    size_t length;
+    size_t capacity;
+    bool failed;               /* An allocation failed; contents are incomplete */
+} string_builder_t;
+
+static void sb_init(string_builder_t *sb, size_t capacity) {
+    sb->length = 0;
+    sb->capacity = capacity + 1;
+    sb->data = malloc(sb->capacity);
+    sb->failed = (sb->data == NULL);
+    if (sb->data) sb->data[0] = '\0';
+}
+
+static void sb_append(string_builder_t *sb, const char *text, size_t length) {
+    if (sb->failed || length == 0) return;
+
+    if (sb->length + length + 1 > sb->capacity) {
+        size_t capacity = sb->capacity * 2;
+        if (capacity < sb->length + length + 1) capacity = sb->length + length + 1;
+        char *data = realloc(sb->data, capacity);
+        if (!data) {
+            sb->failed = true;
+            return;
+        }
+        sb->data = data;
+        sb->capacity = capacity;
+    }
+
+    memcpy(sb->data + sb->length, text, length);
+    sb->length += length;
+    sb->data[sb->length] = '\0';
+}
+
+static void sb_append_str(string_builder_t *sb, const char *text) {
+    sb_append(sb, text, strlen(text));
+}
+
+/* "#line N": the driver reports the next line as line N (GLSL 3.30+/ES 3.00) */
+static void sb_append_line_directive(string_builder_t *sb, int line) {
+    char directive[32];
+    int length = snprintf(directive, sizeof(directive), "#line %d\n", line);
+    sb_append(sb, directive, (size_t)length);
+}
+
+/* Take the built string (NULL if any allocation failed) */
+static char *sb_finish(string_builder_t *sb) {
+    if (sb->failed) {
+        free(sb->data);
+        sb->data = NULL;
+    }
+    return sb->data;
+}
+
 /* ============================================
  * Pass Type Utilities
  * ============================================ */
@@ -367,7 +378,8 @@ multipass_channel_t multipass_default_channel(channel_source_t source) {
         .texture_id = 0,
         .vflip = false,
         .filter = GL_LINEAR,
-        .wrap = GL_CLAMP_TO_EDGE
+        .wrap = GL_CLAMP_TO_EDGE,
+        .confidence = 100
     };
     return channel;
 }
@@ -376,82 +388,146 @@ multipass_channel_t multipass_default_channel(channel_source_t source) {
  * Shader Parsing Functions
  * ============================================ */
 
-int multipass_count_main_functions(const char *source) {
-    if (!source) return 0;
+static bool stream_has_word(const glsl_token_stream_t *tokens, glsl_word_t word) {
+    for (int i = 0; i < tokens->count; i++) {
+        if (tokens->tokens[i].word == word) return true;
+    }
+    return false;
+}
 
-    int count = 0;
-    const char *p = source;
+/* Byte pointer to the start of the line containing a token */
+static const char *token_line_start(const glsl_token_stream_t *tokens, int index) {
+    const char *source = tokens->source;
+    const char *p = source + tokens->tokens[index].offset;
+    while (p > source && *(p - 1) != '\n') p--;
+    return p;
+}
 
-    while ((p = find_pattern(p, "mainImage")) != NULL) {
-        /* Check if it's actually a function definition */
-        const char *before = p;
-        if (before > source) {
-            before--;
-            while (before > source && isspace(*before)) before--;
+/* Find file-scope definitions of a function (mainImage or main): token index
+ * of each return type and of the closing brace of each body. Returns the
+ * total number found; at most max are stored. */
+static int find_definitions(const glsl_token_stream_t *tokens, glsl_word_t name,
+                            int *starts, int *ends, int max) {
+    int found = 0;
+    int depth = 0;
+
+    for (int i = 0; i < tokens->count; i++) {
+        const glsl_token_t *t = &tokens->tokens[i];
+
+        if (t->type == GLSL_TOKEN_PUNCT && t->length == 1) {
+            char c = tokens->source[t->offset];
+            if (c == '{') depth++;
+            else if (c == '}' && depth > 0) depth--;
+            continue;
         }
 
-        /* Skip past "mainImage" */
-        p += 9;
-
-        /* Skip whitespace */
-        while (*p && isspace(*p)) p++;
+        if (depth != 0 || t->word != name || !glsl_is_function_definition(tokens, i)) {
+            continue;
+        }
 
-        /* Must be followed by '(' */
-        if (*p == '(') {
-            count++;
+        int body = glsl_next_code_token(tokens, glsl_find_matching(tokens, glsl_next_code_token(tokens, i)));
+        int end = glsl_find_matching(tokens, body);
+        if (found < max) {
+            starts[found] = glsl_prev_code_token(tokens, i);
+            ends[found] = end;
         }
+        found++;
+
+        /* Resume after the body (depth is back to zero there) */
+        i = end;
     }
 
-    return count;
+    return found;
 }
 
-bool multipass_detect(const char *source) {
-    if (!source) return false;
-
-    /*
-     * All shaders go through the multipass system now.
-     * Single-pass shaders are treated as Image-only multipass.
-     * This simplifies the codebase by removing the legacy single-pass path.
-     */
-    int main_count = multipass_count_main_functions(source);
-    if (main_count >= 1) {
-        return true;
+/* Everything before the first mainImage (or main) definition */
+static char *extract_common(const glsl_token_stream_t *tokens) {
+    int start;
+    int end;
+    if (find_definitions(tokens, GLSL_WORD_MAINIMAGE, &start, &end, 1) == 0 &&
+        find_definitions(tokens, GLSL_WORD_MAIN, &start, &end, 1) == 0) {
+        return NULL;
     }
 
-    /* Check for mainImage function */
-    if (find_pattern(source, "void mainImage") ||
-        find_pattern(source, "void main(")) {
-        return true;
+    /* Go back to the start of the line (might have qualifiers, etc.) */
+    const char *func_start = token_line_start(tokens, start);
+    if (func_start > tokens->source) {
+        return extract_substring(tokens->source, func_start);
     }
+    return NULL;
+}
 
+/* Check whether a span of text contains a string */
+static bool span_contains(const char *text, size_t length, const char *needle) {
+    size_t needle_len = strlen(needle);
+    for (size_t i = 0; i + needle_len <= length; i++) {
+        if (memcmp(text + i, needle, needle_len) == 0) return true;
+    }
     return false;
 }
 
-char *multipass_extract_common(const char *source) {
-    if (!source) return NULL;
-
-    /* Find start of first mainImage function */
-    const char *first_main = find_pattern(source, "void mainImage");
-    if (!first_main) {
-        first_main = find_pattern(source, "void main(");
+/* Pass marker in a comment that starts its own line within the five lines
+ * above a mainImage definition (closest first) */
+static multipass_type_t find_pass_marker(const glsl_token_stream_t *tokens, int def_index) {
+    int def_line = tokens->tokens[def_index].line;
+
+    for (int i = def_index - 1; i >= 0; i--) {
+        const glsl_token_t *t = &tokens->tokens[i];
+        if (t->line < def_line - 5) break;
+        if (t->type != GLSL_TOKEN_COMMENT) continue;
+
+        const char *text = tokens->source + t->offset;
+        const char *p = token_line_start(tokens, i);
+        while (p < text && isspace((unsigned char)*p)) p++;
+        if (p != text) continue;
+
+        size_t len = t->length;
+        if (span_contains(text, len, "Buffer A") || span_contains(text, len, "BufferA"))
+            return PASS_TYPE_BUFFER_A;
+        if (span_contains(text, len, "Buffer B") || span_contains(text, len, "BufferB"))
+            return PASS_TYPE_BUFFER_B;
+        if (span_contains(text, len, "Buffer C") || span_contains(text, len, "BufferC"))
+            return PASS_TYPE_BUFFER_C;
+        if (span_contains(text, len, "Buffer D") || span_contains(text, len, "BufferD"))
+            return PASS_TYPE_BUFFER_D;
+        if (span_contains(text, len, "// Image") || span_contains(text, len, "/* Image"))
+            return PASS_TYPE_IMAGE;
     }
 
-    if (!first_main) {
-        return NULL;
-    }
+    return PASS_TYPE_NONE;
+}
 
-    /* Go back to find the start of function (might have return type, etc.) */
-    const char *func_start = first_main;
-    while (func_start > source && *(func_start - 1) != '\n') {
-        func_start--;
-    }
+int multipass_count_main_functions(const char *source) {
+    glsl_token_stream_t *tokens = glsl_lex(source);
+    if (!tokens) return 0;
 
-    /* Everything before the first function is common code */
-    if (func_start > source) {
-        return extract_substring(source, func_start);
-    }
+    int count = find_definitions(tokens, GLSL_WORD_MAINIMAGE, NULL, NULL, 0);
+    glsl_token_stream_free(tokens);
+    return count;
+}
 
-    return NULL;
+bool multipass_detect(const char *source) {
+    /*
+     * All shaders go through the multipass system now.
+     * Single-pass shaders are treated as Image-only multipass.
+     * This simplifies the codebase by removing the legacy single-pass path.
+     */
+    glsl_token_stream_t *tokens = glsl_lex(source);
+    if (!tokens) return false;
+
+    bool found = find_definitions(tokens, GLSL_WORD_MAINIMAGE, NULL, NULL, 0) > 0 ||
+                 find_definitions(tokens, GLSL_WORD_MAIN, NULL, NULL, 0) > 0;
+    glsl_token_stream_free(tokens);
+    return found;
+}
+
+char *multipass_extract_common(const char *source) {
+    glsl_token_stream_t *tokens = glsl_lex(source);
+    if (!tokens) return NULL;
+
+    char *common = extract_common(tokens);
+    glsl_token_stream_free(tokens);
+    return common;
 }
 
 multipass_parse_result_t *multipass_parse_shader(const char *source) {
@@ -463,14 +539,31 @@ multipass_parse_result_t *multipass_parse_shader(const char *source) {
         return result;
     }
 
-    int main_count = multipass_count_main_functions(source);
+    /* One token stream serves counting, common extraction and pass splitting */
+    glsl_token_stream_t *tokens = glsl_lex(source);
+    if (!tokens) {
+        result->error_message = str_dup("Out of memory");
+        return result;
+    }
+
+    /* Find all mainImage definitions and their function boundaries */
+    int def_starts[MULTIPASS_MAX_PASSES];   /* Return type token of each mainImage */
+    int def_ends[MULTIPASS_MAX_PASSES];     /* Closing brace token of each body */
+    int main_count = find_definitions(tokens, GLSL_WORD_MAINIMAGE, def_starts, def_ends,
+                                      MULTIPASS_MAX_PASSES);
 
     if (main_count <= 1) {
         /* Single pass shader */
+        string_builder_t pass_source;
+        sb_init(&pass_source, strlen(source) + 16);
+        sb_append_line_directive(&pass_source, 1);
+        sb_append_str(&pass_source, source);
+
         result->is_multipass = false;
         result->pass_count = 1;
-        result->pass_sources[0] = str_dup(source);
+        result->pass_sources[0] = sb_finish(&pass_source);
         result->pass_types[0] = PASS_TYPE_IMAGE;
+        glsl_token_stream_free(tokens);
         return result;
     }
 
@@ -478,7 +571,7 @@ multipass_parse_result_t *multipass_parse_shader(const char *source) {
     log_info("Detected multipass shader with %d mainImage functions", main_count);
 
     /* Extract common code (everything before first mainImage) */
-    result->common_source = multipass_extract_common(source);
+    result->common_source = extract_common(tokens);
 
     /*
      * MULTIPASS EXTRACTION STRATEGY:
@@ -493,31 +586,17 @@ multipass_parse_result_t *multipass_parse_shader(const char *source) {
      * - Pass 1: helperFunc + mainImage2
      * - Pass 2: helperFunc + helperFunc2 + mainImage3
      */
-
-    /* First, find all mainImage positions and their function boundaries */
-    const char *main_starts[MULTIPASS_MAX_PASSES];  /* Start of "void mainImage" */
+    int found_count = main_count < MULTIPASS_MAX_PASSES ? main_count : MULTIPASS_MAX_PASSES;
     const char *main_ends[MULTIPASS_MAX_PASSES];    /* End of mainImage function body */
     const char *line_starts[MULTIPASS_MAX_PASSES];  /* Start of line containing mainImage */
-    int found_count = 0;
-    
-    (void)main_starts; /* Currently unused but kept for future use */
-
-    const char *p = source;
-    while (found_count < MULTIPASS_MAX_PASSES) {
-        const char *main_start = find_pattern(p, "void mainImage");
-        if (!main_start) break;
-
-        /* Find start of the line */
-        const char *line_start = main_start;
-        while (line_start > source && *(line_start - 1) != '\n') {
-            line_start--;
-        }
-
-        main_starts[found_count] = main_start;
-        line_starts[found_count] = line_start;
-        main_ends[found_count] = find_function_end(main_start);
-        found_count++;
-        p = main_ends[found_count - 1];
+    int end_lines[MULTIPASS_MAX_PASSES];            /* Editor line of each main_ends */
+
+    for (int i = 0; i < found_count; i++) {
+        line_starts[i] = token_line_start(tokens, def_starts[i]);
+        main_ends[i] = def_ends[i] < tokens->count ?
+                       source + tokens->tokens[def_ends[i]].offset + 1 :
+                       source + strlen(source);
+        end_lines[i] = def_ends[i] < tokens->count ? tokens->tokens[def_ends[i]].line : 1;
     }
 
     /* Now extract each pass with proper helper function inclusion */
@@ -525,41 +604,8 @@ multipass_parse_result_t *multipass_parse_shader(const char *source) {
         const char *line_start = line_starts[pass_index];
         const char *func_end = main_ends[pass_index];
 
-        /* Check for pass marker in preceding lines */
-        multipass_type_t detected_type = PASS_TYPE_NONE;
-        const char *check = line_start;
-        int lines_back = 0;
-        while (check > source && lines_back < 5) {
-            /* Go to previous line */
-            check--;
-            while (check > source && *(check - 1) != '\n') check--;
-
-            /* Check this line for markers - be more specific to avoid false positives */
-            /* Only check comment lines */
-            const char *line_content = check;
-            while (*line_content && isspace(*line_content)) line_content++;
-
-            if (line_content[0] == '/' && (line_content[1] == '/' || line_content[1] == '*')) {
-                if (strstr(check, "Buffer A") || strstr(check, "BufferA")) {
-                    detected_type = PASS_TYPE_BUFFER_A;
-                    break;
-                } else if (strstr(check, "Buffer B") || strstr(check, "BufferB")) {
-                    detected_type = PASS_TYPE_BUFFER_B;
-                    break;
-                } else if (strstr(check, "Buffer C") || strstr(check, "BufferC")) {
-                    detected_type = PASS_TYPE_BUFFER_C;
-                    break;
-                } else if (strstr(check, "Buffer D") || strstr(check, "BufferD")) {
-                    detected_type = PASS_TYPE_BUFFER_D;
-                    break;
-                } else if (strstr(check, "// Image") || strstr(check, "/* Image")) {
-                    detected_type = PASS_TYPE_IMAGE;
-                    break;
-                }
-            }
-
-            lines_back++;
-        }
+        /* Check for pass marker comments in preceding lines */
+        multipass_type_t detected_type = find_pass_marker(tokens, def_starts[pass_index]);
 
         /*
          * Default assignment based on order if no marker found:
@@ -588,72 +634,36 @@ multipass_parse_result_t *multipass_parse_shader(const char *source) {
          * between the FIRST mainImage end and THIS mainImage start.
          * This ensures functions like makeBloom() (defined between pass 0 and 1)
          * are available to pass 2 as well.
+         *
+         * Every piece is preceded by a #line directive with its line in the
+         * editor, so compile errors point at the line the user sees.
          */
-        if (pass_index > 0) {
-            /* Get ALL helper code from end of FIRST mainImage to start of THIS mainImage */
-            const char *helpers_start = main_ends[0];  /* After first mainImage */
-            const char *helpers_end = line_start;
-
-            /* We need to EXCLUDE other mainImage functions from the helpers */
-            /* Build a string with only the helper functions */
-            size_t max_helpers_len = (helpers_end > helpers_start) ? (helpers_end - helpers_start) : 0;
-            char *helpers_only = NULL;
-            size_t helpers_only_len = 0;
-
-            if (max_helpers_len > 0) {
-                helpers_only = malloc(max_helpers_len + 1);
-                if (helpers_only) {
-                    helpers_only[0] = '\0';
-                    helpers_only_len = 0;
-
-                    /* Copy code between each mainImage, skipping the mainImage functions themselves */
-                    for (int prev = 0; prev < pass_index; prev++) {
-                        const char *seg_start = main_ends[prev];
-                        const char *seg_end = line_starts[prev + 1];
-
-                        if (seg_end > seg_start) {
-                            size_t seg_len = seg_end - seg_start;
-                            memcpy(helpers_only + helpers_only_len, seg_start, seg_len);
-                            helpers_only_len += seg_len;
-                        }
-                    }
-                    helpers_only[helpers_only_len] = '\0';
-                }
-            }
-
-            /* Calculate sizes for final combined source */
-            size_t main_len = func_end - line_start;
-            size_t total_len = helpers_only_len + main_len + 16;
-
-            char *combined = malloc(total_len);
-            if (combined) {
-                combined[0] = '\0';
+        string_builder_t pass_source;
+        sb_init(&pass_source, (size_t)(func_end - line_start) + 32);
 
-                /* Add accumulated helper functions */
-                if (helpers_only && helpers_only_len > 0) {
-                    strcat(combined, helpers_only);
-                }
-
-                /* Add this mainImage function */
-                strncat(combined, line_start, main_len);
+        /* Code between each earlier mainImage, skipping the mainImage functions themselves */
+        for (int prev = 0; prev < pass_index; prev++) {
+            const char *seg_start = main_ends[prev];
+            const char *seg_end = line_starts[prev + 1];
 
-                result->pass_sources[pass_index] = combined;
-            } else {
-                result->pass_sources[pass_index] = extract_substring(line_start, func_end);
+            if (seg_end > seg_start) {
+                sb_append_line_directive(&pass_source, end_lines[prev]);
+                sb_append(&pass_source, seg_start, (size_t)(seg_end - seg_start));
             }
-
-            free(helpers_only);
-        } else {
-            /* First pass - just extract the mainImage function */
-            result->pass_sources[pass_index] = extract_substring(line_start, func_end);
         }
 
+        /* This mainImage function */
+        sb_append_line_directive(&pass_source, tokens->tokens[def_starts[pass_index]].line);
+        sb_append(&pass_source, line_start, (size_t)(func_end - line_start));
+
+        result->pass_sources[pass_index] = sb_finish(&pass_source);
         result->pass_types[pass_index] = detected_type;
 
         log_info("Extracted pass %d: %s", pass_index, multipass_type_name(detected_type));
     }
 
     result->pass_count = found_count;
+    glsl_token_stream_free(tokens);
 
     return result;
 }
@@ -706,15 +716,168 @@ static const char *multipass_wrapper_prefix =
     "// Output\n"
     "out vec4 fragColor;\n"
     "\n"
+    "// Internal: fragCoord remapping for output reconstruction (identity unless enabled)\n"
+    "uniform vec4 _mpFragXform;\n"
+    "uniform int _mpCheckerPhase;\n"
+    "\n"
     "// Note: tanh is built-in for GLSL ES 3.0+, no polyfill needed\n"
     "\n";
 
+/* main() maps the render-target pixel back to an output-space fragCoord:
+ * checkerboard expands the half-width target to every other pixel (phase
+ * alternating per row and frame), temporal applies scale + jitter. */
 static const char *multipass_wrapper_suffix =
     "\n"
     "void main() {\n"
-    "    mainImage(fragColor, gl_FragCoord.xy);\n"
+    "    vec2 fc = gl_FragCoord.xy;\n"
+    "    if (_mpCheckerPhase >= 0) {\n"
+    "        fc.x = floor(fc.x) * 2.0 + float((int(fc.y) + _mpCheckerPhase) & 1) + 0.5;\n"
+    "    }\n"
+    "    mainImage(fragColor, fc * _mpFragXform.xy + _mpFragXform.zw);\n"
     "}\n";
 
+/* GLSL float literal. printf follows LC_NUMERIC, which GTK sets from the
+ * environment, so a decimal comma is turned back into a point. */
+static void format_glsl_float(char *buf, size_t size, float value) {
+    if (!isfinite(value)) value = 0.0f;
+    snprintf(buf, size, "%.9g", (double)value);
+
+    bool is_float = false;
+    for (char *c = buf; *c; c++) {
+        if (*c == ',') *c = '.';
+        if (*c == '.' || *c == 'e') is_float = true;
+    }
+    if (!is_float && strlen(buf) + 3 <= size) {
+        strcat(buf, ".0");
+    }
+}
+
+/* "const vecN name = vecN(...);" in place of the uniform declaration */
+static void append_constant(string_builder_t *out, const char *name, const float *values, int count) {
+    char text[256];
+    int length = snprintf(text, sizeof(text), "const vec%d %s = vec%d(", count, name, count);
+    for (int i = 0; i < count; i++) {
+        char literal[32];
+        format_glsl_float(literal, sizeof(literal), values[i]);
+        length += snprintf(text + length, sizeof(text) - (size_t)length, "%s%s",
+                           i ? ", " : "", literal);
+    }
+    snprintf(text + length, sizeof(text) - (size_t)length, ");\n");
+    sb_append_str(out, text);
+}
+
+/* The wrapper prefix with the inputs in constants declared as constants */
+static void append_wrapper_prefix(string_builder_t *out, const multipass_constants_t *constants) {
+    if (!constants || !constants->inputs) {
+        sb_append_str(out, multipass_wrapper_prefix);
+        return;
+    }
+
+    const char *line = multipass_wrapper_prefix;
+    while (*line) {
+        const char *newline = strchr(line, '\n');
+        size_t length = newline ? (size_t)(newline - line) + 1 : strlen(line);
+
+        if ((constants->inputs & MULTIPASS_INPUT_RESOLUTION) &&
+            strncmp(line, "uniform vec3 iResolution;", 25) == 0) {
+            append_constant(out, "iResolution", constants->resolution, 3);
+        } else if ((constants->inputs & MULTIPASS_INPUT_MOUSE) &&
+                   strncmp(line, "uniform vec4 iMouse;", 20) == 0) {
+            append_constant(out, "iMouse", constants->mouse, 4);
+        } else if ((constants->inputs & MULTIPASS_INPUT_DATE) &&
+                   strncmp(line, "uniform vec4 iDate;", 19) == 0) {
+            append_constant(out, "iDate", constants->date, 4);
+        } else {
+            sb_append(out, line, length);
+        }
+        line += length;
+    }
+}
+
+/* #include expansion state for one pass compile */
+typedef struct {
+    multipass_include_set_t *set;    /* Collects the modules the program is built from */
+    int depth;                       /* Nesting level of the source being appended */
+    bool uses_texture_lod;           /* An included module calls textureLod */
+} include_expansion_t;
+
+/* Skip a directive's '#' and the blanks around its name. Returns the name's
+ * end if it matches word, NULL otherwise. */
+static const char *directive_name(const char *text, const char *end, const char *word) {
+    const char *p = text + 1;
+    while (p < end && (*p == ' ' || *p == '\t')) p++;
+
+    size_t length = strlen(word);
+    if ((size_t)(end - p) < length || strncmp(p, word, length) != 0) return NULL;
+    p += length;
+    if (p < end && is_ident_char(*p)) return NULL;
+    return p;
+}
+
+/* File name of an #include "name" or #include <name> directive */
+static bool include_file_name(const char *p, const char *end, char *name, size_t name_size) {
+    while (p < end && (*p == ' ' || *p == '\t')) p++;
+    if (p == end || (*p != '"' && *p != '<')) return false;
+
+    char close = (*p == '"') ? '"' : '>';
+    const char *start = ++p;
+    while (p < end && *p != close) p++;
+    if (p == end || p == start || (size_t)(p - start) >= name_size) return false;
+
+    memcpy(name, start, (size_t)(p - start));
+    name[p - start] = '\0';
+    return true;
+}
+
+static void append_compatible_source(string_builder_t *out, const char *source,
+                                     const glsl_token_stream_t *tokens, const char *dir,
+                                     int string_number, include_expansion_t *includes);
+
+/* Replace an #include directive with the module's text. The module runs as
+ * its own #line source string; numbering of the including source resumes
+ * on the next line. Each module goes into a program once. */
+static void append_include(string_builder_t *out, const char *name, const char *dir,
+                           int line, int string_number, include_expansion_t *includes) {
+    char text[PATH_MAX + 64];
+
+    if (includes->depth >= SHADER_INCLUDE_MAX_DEPTH) {
+        snprintf(text, sizeof(text), "#error #include nested too deeply: %s", name);
+        sb_append_str(out, text);
+        return;
+    }
+
+    const shader_include_module_t *module = shader_include_resolve(name, dir);
+    if (!module) {
+        snprintf(text, sizeof(text), "#error include file not found: %s", name);
+        sb_append_str(out, text);
+        return;
+    }
+
+    multipass_include_set_t *set = includes->set;
+    for (int i = 0; i < set->count; i++) {
+        if (set->ids[i] == module->id) return;
+    }
+    if (set->count == MULTIPASS_MAX_INCLUDES) {
+        snprintf(text, sizeof(text), "#error more than %d include files", MULTIPASS_MAX_INCLUDES);
+        sb_append_str(out, text);
+        return;
+    }
+    set->ids[set->count] = module->id;
+    set->generations[set->count] = module->generation;
+    set->count++;
+    includes->uses_texture_lod |= stream_has_word(module->tokens, GLSL_WORD_TEXTURELOD);
+
+    snprintf(text, sizeof(text), "#line 1 %d\n", module->id);
+    sb_append_str(out, text);
+
+    includes->depth++;
+    append_compatible_source(out, module->source, module->tokens, module->dir, module->id, includes);
+    includes->depth--;
+
+    snprintf(text, sizeof(text), "\n#line %d %d", line + 1, string_number);
+    sb_append_str(out, text);
+}
+
 /**
  * Fix common Shadertoy compatibility issues in shader source.
  * 
@@ -722,175 +885,167 @@ static const char *multipass_wrapper_suffix =
  * - iChannelResolution[n] used as vec2 (add .xy swizzle)
  * - texture(sampler, vec3) -> texture(sampler, (vec3).xy) for 2D textures
  * - Other implicit vec3->vec2 casts
+ * - #include "file" (expanded in place, see append_include)
  * 
- * Returns a newly allocated string that must be freed.
+ * Appends the fixed source to out. Rewrites never add or remove newlines,
+ * so #line mappings stay valid. tokens may be NULL, the source is then
+ * lexed here.
  */
-static char *fix_shadertoy_compatibility(const char *source) {
-    if (!source) return NULL;
-    
+static void append_compatible_source(string_builder_t *out, const char *source,
+                                     const glsl_token_stream_t *tokens, const char *dir,
+                                     int string_number, include_expansion_t *includes) {
+    if (!source) return;
+
     size_t src_len = strlen(source);
-    /* Allocate extra space for potential .xy additions */
-    size_t alloc_size = src_len * 3 + 1;
-    char *result = malloc(alloc_size);
-    if (!result) return NULL;
-    
-    const char *src = source;
-    char *dst = result;
-    
-    while (*src) {
-        /* Check for iChannelResolution[n] pattern */
-        if (strncmp(src, "iChannelResolution[", 19) == 0) {
-            /* Copy "iChannelResolution[" */
-            memcpy(dst, src, 19);
-            dst += 19;
-            src += 19;
-            
-            /* Copy the index (digit) */
-            while (*src && *src != ']') {
-                *dst++ = *src++;
-            }
-            
-            /* Copy the closing bracket */
-            if (*src == ']') {
-                *dst++ = *src++;
-            }
-            
-            /* Check if already followed by a swizzle or component access */
-            if (*src != '.' && *src != '[') {
-                /* Add .xy swizzle for vec3->vec2 compatibility */
-                memcpy(dst, ".xy", 3);
-                dst += 3;
+    glsl_token_stream_t *lexed = NULL;
+    if (!tokens) {
+        tokens = lexed = glsl_lex(source);
+        if (!tokens) {
+            sb_append(out, source, src_len);
+            return;
+        }
+    }
+
+    size_t copied = 0;   /* Source bytes already appended to out */
+    int line_offset = 0; /* Added to token lines by the source's own #line directives */
+
+    for (int i = 0; i < tokens->count; i++) {
+        const glsl_token_t *t = &tokens->tokens[i];
+
+        if (t->type == GLSL_TOKEN_PREPROCESSOR) {
+            const char *text = source + t->offset;
+            const char *end = text + t->length;
+            const char *args;
+
+            if ((args = directive_name(text, end, "line")) != NULL) {
+                /* The line after "#line N" is line N */
+                line_offset = atoi(args) - (t->line + 1);
+            } else if ((args = directive_name(text, end, "include")) != NULL) {
+                char name[256];
+                sb_append(out, source + copied, t->offset - copied);
+                copied = t->offset + t->length;
+                if (include_file_name(args, end, name, sizeof(name))) {
+                    append_include(out, name, dir, t->line + line_offset, string_number, includes);
+                } else {
+                    sb_append_str(out, "#error malformed #include");
+                }
             }
             continue;
         }
-        
-        /* Check for texture(iChannel, expr) where expr might be vec3 */
-        /* Pattern: "texture(iChannel" followed by digit, comma, then expression */
-        if (strncmp(src, "texture(iChannel", 16) == 0) {
-            /* Copy "texture(iChannel" */
-            memcpy(dst, src, 16);
-            dst += 16;
-            src += 16;
-            
-            /* Copy the channel number */
-            while (*src && *src >= '0' && *src <= '9') {
-                *dst++ = *src++;
-            }
-            
-            /* Skip whitespace and comma */
-            while (*src && (*src == ' ' || *src == '\t')) {
-                *dst++ = *src++;
-            }
-            if (*src == ',') {
-                *dst++ = *src++;
-            }
-            while (*src && (*src == ' ' || *src == '\t')) {
-                *dst++ = *src++;
+
+        /* iChannelResolution[n] used as vec2: add .xy unless already swizzled/indexed */
+        if (t->word == GLSL_WORD_ICHANNELRESOLUTION) {
+            int open = glsl_next_code_token(tokens, i);
+            if (!glsl_token_is_punct(tokens, open, "[")) continue;
+            int close = glsl_find_matching(tokens, open);
+            if (close >= tokens->count) continue;
+
+            int next = glsl_next_code_token(tokens, close);
+            if (!glsl_token_is_punct(tokens, next, ".") && !glsl_token_is_punct(tokens, next, "[")) {
+                size_t at = tokens->tokens[close].offset + 1;
+                sb_append(out, source + copied, at - copied);
+                sb_append(out, ".xy", 3);
+                copied = at;
             }
-            
-            /* Now we're at the coordinate expression */
-            /* Check if it starts with something that's likely a vec3 */
-            /* Common patterns: variable name, function call, or expression */
-            
-            /* We need to find the end of this expression (the closing paren or next comma) */
-            /* and wrap it with parentheses + .xy if it doesn't already have .xy */
-            
-            /* Count parentheses to find the expression end */
-            int paren_depth = 1; /* We're inside texture( */
-            const char *expr_start = src;
-            const char *expr_end = src;
+            i = close;
+            continue;
+        }
+
+        /* texture(iChannelN, expr) where expr might be vec3: use (expr).xy */
+        if (t->word == GLSL_WORD_TEXTURE) {
+            int open = glsl_next_code_token(tokens, i);
+            if (!glsl_token_is_punct(tokens, open, "(")) continue;
+            int channel = glsl_next_code_token(tokens, open);
+            if (channel >= tokens->count ||
+                tokens->tokens[channel].word < GLSL_WORD_ICHANNEL0 ||
+                tokens->tokens[channel].word > GLSL_WORD_ICHANNEL3) continue;
+            int comma = glsl_next_code_token(tokens, channel);
+            if (!glsl_token_is_punct(tokens, comma, ",")) continue;
+
+            /* Coordinate expression: up to the next top-level ',' or the closing ')' */
+            int first = glsl_next_code_token(tokens, comma);
+            int last = -1;
             bool has_swizzle = false;
-            
-            while (*expr_end && paren_depth > 0) {
-                if (*expr_end == '(') paren_depth++;
-                else if (*expr_end == ')') paren_depth--;
-                else if (*expr_end == ',' && paren_depth == 1) break; /* Next argument */
-                
-                /* Check for .xy, .xz, .yz etc swizzle at end of expression */
-                if (*expr_end == '.' && paren_depth == 1) {
-                    const char *after_dot = expr_end + 1;
-                    if ((*after_dot == 'x' || *after_dot == 'y' || *after_dot == 'z' || 
-                         *after_dot == 'r' || *after_dot == 'g' || *after_dot == 'b' ||
-                         *after_dot == 's' || *after_dot == 't' || *after_dot == 'p')) {
-                        has_swizzle = true;
+            int depth = 0;
+            int j;
+            for (j = first; j < tokens->count; j++) {
+                const glsl_token_t *e = &tokens->tokens[j];
+                if (e->type == GLSL_TOKEN_COMMENT) continue;
+                if (e->type == GLSL_TOKEN_PUNCT && e->length == 1) {
+                    char c = source[e->offset];
+                    if (c == '(' || c == '[') {
+                        depth++;
+                    } else if (c == ')' || c == ']') {
+                        if (depth == 0) break;
+                        depth--;
+                    } else if (c == ',' && depth == 0) {
+                        break;
+                    } else if (c == '.' && depth == 0) {
+                        /* Already swizzled, e.g. p.xy or p.st */
+                        int k = glsl_next_code_token(tokens, j);
+                        if (k < tokens->count && tokens->tokens[k].type == GLSL_TOKEN_IDENTIFIER &&
+                            strchr("xyzrgbstp", source[tokens->tokens[k].offset])) {
+                            has_swizzle = true;
+                        }
                     }
                 }
-                expr_end++;
+                last = j;
             }
-            
-            /* Back up to the actual end of the expression */
-            if (paren_depth == 0) expr_end--;
-            while (expr_end > expr_start && (*(expr_end-1) == ' ' || *(expr_end-1) == '\t')) {
-                expr_end--;
+
+            if (last >= first && !has_swizzle) {
+                size_t expr_start = tokens->tokens[first].offset;
+                size_t expr_end = tokens->tokens[last].offset + tokens->tokens[last].length;
+
+                sb_append(out, source + copied, expr_start - copied);
+                sb_append(out, "(", 1);
+                sb_append(out, source + expr_start, expr_end - expr_start);
+                sb_append(out, ").xy", 4);
+                copied = expr_end;
             }
-            
-            /* Copy the expression */
-            size_t expr_len = expr_end - expr_start;
-            if (!has_swizzle && expr_len > 0) {
-                /* Wrap with parentheses and add .xy */
-                *dst++ = '(';
-                memcpy(dst, expr_start, expr_len);
-                dst += expr_len;
-                memcpy(dst, ").xy", 4);
-                dst += 4;
-            } else {
-                /* Already has swizzle, copy as-is */
-                memcpy(dst, expr_start, expr_len);
-                dst += expr_len;
-            }
-            
-            src = expr_end;
+            i = last >= first ? last : comma;
             continue;
         }
-        
-        /* Copy character as-is */
-        *dst++ = *src++;
     }
-    
-    *dst = '\0';
-    return result;
+
+    sb_append(out, source + copied, src_len - copied);
+    glsl_token_stream_free(lexed);
 }
 
-/* Wrap a pass source with Shadertoy compatibility layer */
-static char *wrap_pass_source(const char *common, const char *pass_source) {
+/* Wrap a pass source with Shadertoy compatibility layer. Common starts on
+ * the editor's first line; pass sources carry their own #line directives.
+ * Both are replayed from their tokens with #include expanded. With
+ * shared_common, Common is compiled separately and the pass only gets its
+ * declarations. Inputs in constants (may be NULL) become constants. */
+static char *wrap_pass_source(const multipass_shader_t *shader, const char *pass_source,
+                              include_expansion_t *includes, bool shared_common,
+                              const multipass_constants_t *constants) {
     size_t prefix_len = strlen(multipass_wrapper_prefix);
-    size_t common_len = common ? strlen(common) : 0;
+    const char *common_text = shared_common ? shader->common_interface : shader->common_source;
+    size_t common_len = common_text ? strlen(common_text) : 0;
     size_t pass_len = pass_source ? strlen(pass_source) : 0;
     size_t suffix_len = strlen(multipass_wrapper_suffix);
 
-    /* Extra space for .xy additions (worst case: every iChannelResolution gets .xy) */
-    size_t total = prefix_len + (common_len * 2) + (pass_len * 2) + suffix_len + 64;
-    char *wrapped = malloc(total);
-    if (!wrapped) return NULL;
-
-    wrapped[0] = '\0';
-    strcat(wrapped, multipass_wrapper_prefix);
-    
-    /* Apply compatibility fixes to common code */
-    if (common) {
-        char *fixed_common = fix_shadertoy_compatibility(common);
-        if (fixed_common) {
-            strcat(wrapped, fixed_common);
-            free(fixed_common);
-        } else {
-            strcat(wrapped, common);
-        }
+    /* Room for the compatibility rewrites on top of the exact size */
+    string_builder_t wrapped;
+    sb_init(&wrapped, prefix_len + common_len + common_len / 8 + pass_len + pass_len / 8 + suffix_len + 32);
+
+    append_wrapper_prefix(&wrapped, constants);
+    if (shared_common) {
+        /* Already compatible and expanded */
+        sb_append_line_directive(&wrapped, 1);
+        sb_append(&wrapped, common_text, common_len);
+    } else if (shader->common_source) {
+        sb_append_line_directive(&wrapped, 1);
+        append_compatible_source(&wrapped, shader->common_source, shader->common_tokens,
+                                 shader->include_dir, 0, includes);
     }
-    strcat(wrapped, "\n");
-    
+    sb_append(&wrapped, "\n", 1);
+
     /* Apply compatibility fixes to pass source */
-    if (pass_source) {
-        char *fixed_pass = fix_shadertoy_compatibility(pass_source);
-        if (fixed_pass) {
-            strcat(wrapped, fixed_pass);
-            free(fixed_pass);
-        } else {
-            strcat(wrapped, pass_source);
-        }
-    }
-    strcat(wrapped, multipass_wrapper_suffix);
+    append_compatible_source(&wrapped, pass_source, NULL, shader->include_dir, 0, includes);
+    sb_append(&wrapped, multipass_wrapper_suffix, suffix_len);
 
-    return wrapped;
+    return sb_finish(&wrapped);
 }
 
 /* Vertex shader for fullscreen quad - use desktop GLSL 330 for performance */
@@ -901,16 +1056,624 @@ static const char *fullscreen_vertex_shader =
     "    gl_Position = vec4(position, 0.0, 1.0);\n"
     "}\n";
 
+/* ============================================
+ * Shared shader objects
+ * ============================================ */
+
+/* Shrink a complete shader source for the driver. Lines are kept so the
+ * error log still points into the editor. The roots are main() or, for the
+ * Common object, every function the passes name. Returns source itself if
+ * there's nothing to gain or no memory. */
+static char *optimize_source(char *source, const glsl_token_stream_t *const *users,
+                             int user_count, const char *what) {
+    static const char *const roots[] = { "main" };
+    glsl_optimize_options_t options = {
+        .remove_dead_functions = true,
+        .fold_constants = true,
+        .minify = true,
+        .keep_lines = true,
+        .roots = users ? NULL : roots,
+        .root_count = users ? 0 : 1,
+        .users = users,
+        .user_count = user_count
+    };
+
+    glsl_optimize_stats_t stats;
+    char *optimized = glsl_optimize(source, &options, &stats);
+    if (!optimized) return source;
+
+    log_debug("Optimized %s: %zu -> %zu bytes, %d functions removed, %d constants folded",
+              what, stats.input_bytes, stats.output_bytes,
+              stats.functions_removed, stats.constants_folded);
+    free(source);
+    return optimized;
+}
+
+/* The fullscreen vertex shader is the same for every program of a shader:
+ * compiled on first use, attached to every pass and resolve program */
+static GLuint shared_vertex_shader(multipass_shader_t *shader) {
+    if (!shader->vertex_shader) {
+        shader->vertex_shader = compile_shader(GL_VERTEX_SHADER, fullscreen_vertex_shader);
+    }
+    return shader->vertex_shader;
+}
+
+/* Desktop GL links several shader objects per stage into one program;
+ * GLSL ES wants exactly one */
+static bool separate_objects_available(void) {
+    const char *version = (const char *)glGetString(GL_VERSION);
+    return version && strncmp(version, "OpenGL ES", 9) != 0;
+}
+
+/* Append the line breaks of source[from, to) */
+static void append_newlines(string_builder_t *out, const char *source, size_t from, size_t to) {
+    for (size_t p = from; p < to; p++) {
+        if (source[p] == '\n') sb_append(out, "\n", 1);
+    }
+}
+
+/* Common as the passes see it when it's compiled separately: every function
+ * body becomes ';', so definitions turn into prototypes. Structs, globals,
+ * macros and directives stay, and so do the line breaks, so #line mappings
+ * and the pass's own line numbers don't move. */
+static char *common_prototypes(const char *source) {
+    glsl_token_stream_t *tokens = glsl_lex(source);
+    if (!tokens) return NULL;
+
+    size_t length = strlen(source);
+    string_builder_t out;
+    sb_init(&out, length / 2 + 64);
+    size_t copied = 0;
+
+    for (int i = 0; i < tokens->count; i++) {
+        /* Struct bodies and initializer lists at file scope stay as they are */
+        if (glsl_token_is_punct(tokens, i, "{")) {
+            i = glsl_find_matching(tokens, i);
+            continue;
+        }
+        if (!glsl_is_function_definition(tokens, i)) continue;
+
+        int close = glsl_find_matching(tokens, glsl_next_code_token(tokens, i));
+        int body = glsl_next_code_token(tokens, close);
+        int end = glsl_find_matching(tokens, body);
+        if (end >= tokens->count) break;   /* Unterminated: the compiler reports it */
+
+        size_t body_start = tokens->tokens[body].offset;
+        size_t body_end = tokens->tokens[end].offset + 1;
+        sb_append(&out, source + copied, body_start - copied);
+        sb_append(&out, ";", 1);
+
+        /* Directives inside the body still apply to what follows */
+        size_t p = body_start;
+        for (int j = body; j < end; j++) {
+            const glsl_token_t *t = &tokens->tokens[j];
+            if (t->type != GLSL_TOKEN_PREPROCESSOR) continue;
+            append_newlines(&out, source, p, t->offset);
+            sb_append(&out, source + t->offset, t->length);
+            p = t->offset + t->length;
+        }
+        append_newlines(&out, source, p, body_end);
+
+        copied = body_end;
+        i = end;
+    }
+
+    sb_append(&out, source + copied, length - copied);
+    glsl_token_stream_free(tokens);
+    return sb_finish(&out);
+}
+
+/* Common's functions that no pass names go. A pass that reaches one some
+ * other way (an #include of its own) fails to link and embeds Common; the
+ * declarations passes compile against come from the full Common. */
+static char *optimize_common_object(const multipass_shader_t *shader, char *source) {
+    glsl_token_stream_t *users[MULTIPASS_MAX_PASSES];
+    int user_count = 0;
+    for (int i = 0; i < shader->pass_count; i++) {
+        if (!shader->passes[i].source) continue;
+        glsl_token_stream_t *tokens = glsl_lex(shader->passes[i].source);
+        if (!tokens) {
+            /* Without every user nothing can be dropped safely */
+            for (int j = 0; j < user_count; j++) glsl_token_stream_free(users[j]);
+            return source;
+        }
+        users[user_count++] = tokens;
+    }
+
+    source = optimize_source(source, (const glsl_token_stream_t *const *)users, user_count, "Common");
+    for (int i = 0; i < user_count; i++) {
+        glsl_token_stream_free(users[i]);
+    }
+    return source;
+}
+
+static void release_common_object(multipass_shader_t *shader) {
+    if (shader->common_object) {
+        glDeleteShader(shader->common_object);
+        shader->common_object = 0;
+    }
+    free(shader->common_interface);
+    shader->common_interface = NULL;
+    shader->common_includes.count = 0;
+    shader->common_uses_texture_lod = false;
+    shader->common_object_failed = false;
+}
+
+/* Compile Common (with its includes) once into its own fragment shader
+ * object that every pass program links. Returns false if the passes have
+ * to embed Common instead: no Common, GLSL ES, or Common doesn't compile
+ * on its own (the embedded compile then reports the errors per pass). */
+static bool ensure_common_object(multipass_shader_t *shader) {
+    if (shader->common_object) return true;
+    if (!shader->common_source || shader->common_object_failed) return false;
+
+    shader->common_object_failed = true;   /* Until it's built */
+    if (!separate_objects_available()) return false;
+
+    include_expansion_t includes = { .set = &shader->common_includes, .depth = 0, .uses_texture_lod = false };
+    shader->common_includes.count = 0;
+
+    size_t prefix_len = strlen(multipass_wrapper_prefix);
+    size_t common_len = strlen(shader->common_source);
+    string_builder_t common;
+    sb_init(&common, common_len + common_len / 8 + 64);
+    append_compatible_source(&common, shader->common_source, shader->common_tokens,
+                             shader->include_dir, 0, &includes);
+    char *expanded = sb_finish(&common);
+    if (!expanded) return false;
+
+    /* Includes count even if Common fails: fixing them has to retry */
+    for (int i = 0; i < shader->common_includes.count; i++) {
+        shader_include_add_dependent(shader->common_includes.ids[i], shader->include_owner);
+    }
+
+    string_builder_t object;
+    sb_init(&object, prefix_len + strlen(expanded) + 16);
+    sb_append(&object, multipass_wrapper_prefix, prefix_len);
+    sb_append_line_directive(&object, 1);
+    sb_append_str(&object, expanded);
+    char *object_source = sb_finish(&object);
+    if (object_source && shader->optimize_source) {
+        object_source = optimize_common_object(shader, object_source);
+    }
+
+    GLuint compiled = object_source ? compile_shader(GL_FRAGMENT_SHADER, object_source) : 0;
+    free(object_source);
+    char *interface = compiled ? common_prototypes(expanded) : NULL;
+    free(expanded);
+
+    if (!interface) {
+        if (compiled) glDeleteShader(compiled);
+        clear_error_log();   /* Each pass reports the errors with Common embedded */
+        log_info("Common doesn't compile on its own, passes embed it");
+        return false;
+    }
+
+    shader->common_object = compiled;
+    shader->common_interface = interface;
+    shader->common_uses_texture_lod = includes.uses_texture_lod;
+    shader->common_object_failed = false;
+    log_info("Compiled Common once as a shared shader object");
+    return true;
+}
+
+/* A pass program on its way through the driver */
+typedef struct {
+    int index;                  /* Pass index */
+    GLuint fragment;            /* Pass fragment shader, status not queried yet */
+    GLuint program;             /* Program, link status not queried yet */
+    bool shared_common;         /* Linked against shader->common_object */
+    const char *name;           /* Pass name, for tracing */
+} pass_build_t;
+
+/* Start building one pass program: the shared vertex shader, the pass's
+ * fragment shader and, with shared_common, the Common object. Compiles and
+ * links without waiting; pass_build_end collects the result. A specialized
+ * variant (constants not NULL) is built from the modules the pass already
+ * recorded, so its includes aren't recorded again. */
+static bool pass_build_begin(multipass_shader_t *shader, pass_build_t *build, bool shared_common,
+                             const multipass_constants_t *constants) {
+    multipass_pass_t *pass = &shader->passes[build->index];
+    multipass_include_set_t variant_includes;
+    include_expansion_t includes = {
+        .set = constants ? &variant_includes : &pass->includes,
+        .depth = 0,
+        .uses_texture_lod = false
+    };
+    if (shared_common) {
+        /* Common's modules are already in the program */
+        *includes.set = shader->common_includes;
+        includes.uses_texture_lod = shader->common_uses_texture_lod;
+    } else {
+        includes.set->count = 0;
+    }
+    build->shared_common = shared_common;
+    build->fragment = 0;
+    build->program = 0;
+    build->name = pass->name;
+
+    uint64_t span = shader_trace_begin();
+    char *wrapped = wrap_pass_source(shader, pass->source, &includes, shared_common, constants);
+    shader_trace_end(span, SHADER_TRACE_COMPILE, "wrap", pass->name);
+    if (!wrapped) {
+        append_to_error_log("Failed to allocate memory for shader wrapping\n");
+        return false;
+    }
+    if (includes.uses_texture_lod) {
+        pass->uses_texture_lod = true;
+    }
+    if (shader->optimize_source) {
+        span = shader_trace_begin();
+        wrapped = optimize_source(wrapped, NULL, 0, pass->name);
+        shader_trace_end(span, SHADER_TRACE_COMPILE, "optimize", pass->name);
+    }
+
+    /* Compile and link are only submitted here; the driver's time shows up
+     * in pass_build_end's span */
+    span = shader_trace_begin();
+    build->fragment = compile_shader_begin(GL_FRAGMENT_SHADER, wrapped);
+    free(wrapped);
+    if (!build->fragment) return false;
+
+    GLuint objects[3];
+    int count = 0;
+    objects[count++] = shader->vertex_shader;
+    if (shared_common) objects[count++] = shader->common_object;
+    objects[count++] = build->fragment;
+
+    /* Linking a shader that failed to compile just fails the link; the
+     * compile error is what pass_build_end reports */
+    build->program = link_program_begin(objects, count);
+    shader_trace_end(span, SHADER_TRACE_COMPILE, "submit", pass->name);
+    if (!build->program) {
+        glDeleteShader(build->fragment);
+        build->fragment = 0;
+        return false;
+    }
+    return true;
+}
+
+/* Wait for a build started with pass_build_begin. *link_failed tells the
+ * objects compiled but didn't link. */
+static bool pass_build_end(pass_build_t *build, GLuint *program, bool *link_failed) {
+    *link_failed = false;
+
+    uint64_t span = shader_trace_begin();
+    GLuint fragment = compile_shader_end(build->fragment, GL_FRAGMENT_SHADER);
+    bool linked = false;
+    if (fragment) {
+        linked = link_program_end(build->program, program);
+        *link_failed = !linked;
+        glDeleteShader(fragment);
+    } else {
+        glDeleteProgram(build->program);
+    }
+    shader_trace_end(span, SHADER_TRACE_COMPILE, "compile+link", build->name);
+
+    build->fragment = 0;
+    build->program = 0;
+    return linked;
+}
+
+/* Link status can be polled without blocking (KHR_parallel_shader_compile) */
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+static bool parallel_compile_available(void) {
+#ifdef GL_NUM_EXTENSIONS
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; i++) {
+        const char *name = (const char *)glGetStringi(GL_EXTENSIONS, (GLuint)i);
+        if (name && (strcmp(name, "GL_KHR_parallel_shader_compile") == 0 ||
+                     strcmp(name, "GL_ARB_parallel_shader_compile") == 0)) {
+            return true;
+        }
+    }
+#endif
+    return false;
+}
+
+/*
+ * Reconstruction resolve shader - runs at output resolution after the Image pass.
+ *
+ * Checkerboard (mode 1): pixels shaded this frame are fetched directly from the
+ * half-width target; the others come from history, clamped to the min/max of
+ * their four fresh cross neighbours (all four are shaded in the current phase).
+ *
+ * Temporal (mode 2): bilinear sample of the jittered low-res target, history
+ * clamped to the 3x3 neighbourhood of the current sample, exponential blend.
+ * Shadertoy shaders have no motion vectors, so clamping alone limits ghosting.
+ */
+static const char *reconstruct_fragment_shader =
+    "#version 330 core\n"
+    "uniform sampler2D uCurrent;\n"
+    "uniform sampler2D uHistory;\n"
+    "uniform int uMode;\n"
+    "uniform int uPhase;\n"
+    "uniform int uHistoryValid;\n"
+    "uniform vec2 uJitter;\n"
+    "uniform vec2 uOutputSize;\n"
+    "out vec4 fragColor;\n"
+    "\n"
+    "vec4 fetch_checker(ivec2 p) {\n"
+    "    ivec2 size = textureSize(uCurrent, 0);\n"
+    "    return texelFetch(uCurrent, clamp(ivec2(p.x >> 1, p.y), ivec2(0), size - 1), 0);\n"
+    "}\n"
+    "\n"
+    "void main() {\n"
+    "    ivec2 p = ivec2(gl_FragCoord.xy);\n"
+    "    vec4 history = texelFetch(uHistory, p, 0);\n"
+    "    if (uMode == 1) {\n"
+    "        if (((p.x ^ (p.y + uPhase)) & 1) == 0) {\n"
+    "            fragColor = fetch_checker(p);\n"
+    "            return;\n"
+    "        }\n"
+    "        vec4 l = fetch_checker(p + ivec2(-1, 0));\n"
+    "        vec4 r = fetch_checker(p + ivec2( 1, 0));\n"
+    "        vec4 d = fetch_checker(p + ivec2( 0,-1));\n"
+    "        vec4 u = fetch_checker(p + ivec2( 0, 1));\n"
+    "        vec4 lo = min(min(l, r), min(d, u));\n"
+    "        vec4 hi = max(max(l, r), max(d, u));\n"
+    "        fragColor = (uHistoryValid != 0) ? clamp(history, lo, hi) : (l + r + d + u) * 0.25;\n"
+    "    } else {\n"
+    "        vec2 rsize = vec2(textureSize(uCurrent, 0));\n"
+    "        vec2 ruv = gl_FragCoord.xy / uOutputSize - uJitter / rsize;\n"
+    "        vec4 current = texture(uCurrent, ruv);\n"
+    "        ivec2 rp = ivec2(ruv * rsize);\n"
+    "        ivec2 rmax = ivec2(rsize) - 1;\n"
+    "        vec4 lo = current;\n"
+    "        vec4 hi = current;\n"
+    "        for (int y = -1; y <= 1; y++) {\n"
+    "            for (int x = -1; x <= 1; x++) {\n"
+    "                vec4 s = texelFetch(uCurrent, clamp(rp + ivec2(x, y), ivec2(0), rmax), 0);\n"
+    "                lo = min(lo, s);\n"
+    "                hi = max(hi, s);\n"
+    "            }\n"
+    "        }\n"
+    "        fragColor = (uHistoryValid != 0) ? mix(clamp(history, lo, hi), current, 0.1) : current;\n"
+    "    }\n"
+    "}\n";
+
+/*
+ * Spatial upscaler - single-pass port of the FSR 1.0 EASU kernel with an
+ * RCAS-style sharpen folded in.
+ *
+ * EASU: 12-tap neighbourhood around the source position, edge direction and
+ * length from the luma gradients of the four bilinear quadrants, then an
+ * anisotropic approximated-Lanczos2 filter stretched along the edge and
+ * clamped to the 2x2 min/max to avoid ringing.
+ *
+ * Sharpen: RCAS lobe computed against the source-space cross neighbourhood,
+ * limited so the result never leaves the local min/max (no halos).
+ */
+static const char *spatial_fragment_shader =
+    "#version 330 core\n"
+    "uniform sampler2D uSource;\n"
+    "uniform vec2 uOutputSize;\n"
+    "uniform float uSharpness;\n"
+    "out vec4 fragColor;\n"
+    "\n"
+    "vec3 tap(ivec2 p) {\n"
+    "    return texelFetch(uSource, clamp(p, ivec2(0), textureSize(uSource, 0) - 1), 0).rgb;\n"
+    "}\n"
+    "\n"
+    "float luma(vec3 c) { return c.g + 0.5 * (c.r + c.b); }\n"
+    "\n"
+    "void easu_set(inout vec2 dir, inout float len, float w,\n"
+    "              float la, float lb, float lc, float ld, float le) {\n"
+    "    float lenx = max(abs(ld - lc), abs(lc - lb));\n"
+    "    lenx = lenx > 0.0 ? 1.0 / lenx : 0.0;\n"
+    "    float dirx = ld - lb;\n"
+    "    lenx = clamp(abs(dirx) * lenx, 0.0, 1.0);\n"
+    "    dir.x += dirx * w;\n"
+    "    len += lenx * lenx * w;\n"
+    "    float leny = max(abs(le - lc), abs(lc - la));\n"
+    "    leny = leny > 0.0 ? 1.0 / leny : 0.0;\n"
+    "    float diry = le - la;\n"
+    "    leny = clamp(abs(diry) * leny, 0.0, 1.0);\n"
+    "    dir.y += diry * w;\n"
+    "    len += leny * leny * w;\n"
+    "}\n"
+    "\n"
+    "void easu_tap(inout vec3 ac, inout float aw, vec2 off, vec2 dir, vec2 len2,\n"
+    "              float lob, float clp, vec3 c) {\n"
+    "    vec2 v = vec2(dot(off, dir), dot(off, vec2(-dir.y, dir.x))) * len2;\n"
+    "    float d2 = min(dot(v, v), clp);\n"
+    "    float wb = 2.0 / 5.0 * d2 - 1.0;\n"
+    "    float wa = lob * d2 - 1.0;\n"
+    "    wb *= wb;\n"
+    "    wa *= wa;\n"
+    "    wb = 25.0 / 16.0 * wb - (25.0 / 16.0 - 1.0);\n"
+    "    float w = wb * wa;\n"
+    "    ac += c * w;\n"
+    "    aw += w;\n"
+    "}\n"
+    "\n"
+    "void main() {\n"
+    "    vec2 rsize = vec2(textureSize(uSource, 0));\n"
+    "    vec2 pp = gl_FragCoord.xy * (rsize / uOutputSize) - 0.5;\n"
+    "    vec2 fp = floor(pp);\n"
+    "    pp -= fp;\n"
+    "    ivec2 i0 = ivec2(fp);\n"
+    "\n"
+    "    /*    b c\n"
+    "     *  e f g h\n"
+    "     *  i j k l\n"
+    "     *    n o    */\n"
+    "    vec3 b = tap(i0 + ivec2( 0,-1)), c = tap(i0 + ivec2( 1,-1));\n"
+    "    vec3 e = tap(i0 + ivec2(-1, 0)), f = tap(i0 + ivec2( 0, 0));\n"
+    "    vec3 g = tap(i0 + ivec2( 1, 0)), h = tap(i0 + ivec2( 2, 0));\n"
+    "    vec3 i = tap(i0 + ivec2(-1, 1)), j = tap(i0 + ivec2( 0, 1));\n"
+    "    vec3 k = tap(i0 + ivec2( 1, 1)), l = tap(i0 + ivec2( 2, 1));\n"
+    "    vec3 n = tap(i0 + ivec2( 0, 2)), o = tap(i0 + ivec2( 1, 2));\n"
+    "\n"
+    "    float bl = luma(b), cl = luma(c), el = luma(e), fl = luma(f);\n"
+    "    float gl = luma(g), hl = luma(h), il = luma(i), jl = luma(j);\n"
+    "    float kl = luma(k), ll = luma(l), nl = luma(n), ol = luma(o);\n"
+    "\n"
+    "    vec2 dir = vec2(0.0);\n"
+    "    float len = 0.0;\n"
+    "    easu_set(dir, len, (1.0 - pp.x) * (1.0 - pp.y), bl, el, fl, gl, jl);\n"
+    "    easu_set(dir, len, pp.x * (1.0 - pp.y),         cl, fl, gl, hl, kl);\n"
+    "    easu_set(dir, len, (1.0 - pp.x) * pp.y,         fl, il, jl, kl, nl);\n"
+    "    easu_set(dir, len, pp.x * pp.y,                 gl, jl, kl, ll, ol);\n"
+    "\n"
+    "    float dirr = dot(dir, dir);\n"
+    "    bool zro = dirr < 1.0 / 32768.0;\n"
+    "    dir = zro ? vec2(1.0, 0.0) : dir * inversesqrt(dirr);\n"
+    "    len = len * 0.5;\n"
+    "    len *= len;\n"
+    "    float stretch = dot(dir, dir) / max(abs(dir.x), abs(dir.y));\n"
+    "    vec2 len2 = vec2(1.0 + (stretch - 1.0) * len, 1.0 - 0.5 * len);\n"
+    "    float lob = 0.5 + ((1.0 / 4.0 - 0.04) - 0.5) * len;\n"
+    "    float clp = 1.0 / lob;\n"
+    "\n"
+    "    vec3 ac = vec3(0.0);\n"
+    "    float aw = 0.0;\n"
+    "    easu_tap(ac, aw, vec2( 0.0,-1.0) - pp, dir, len2, lob, clp, b);\n"
+    "    easu_tap(ac, aw, vec2( 1.0,-1.0) - pp, dir, len2, lob, clp, c);\n"
+    "    easu_tap(ac, aw, vec2(-1.0, 1.0) - pp, dir, len2, lob, clp, i);\n"
+    "    easu_tap(ac, aw, vec2( 0.0, 1.0) - pp, dir, len2, lob, clp, j);\n"
+    "    easu_tap(ac, aw, vec2( 0.0, 0.0) - pp, dir, len2, lob, clp, f);\n"
+    "    easu_tap(ac, aw, vec2(-1.0, 0.0) - pp, dir, len2, lob, clp, e);\n"
+    "    easu_tap(ac, aw, vec2( 1.0, 1.0) - pp, dir, len2, lob, clp, k);\n"
+    "    easu_tap(ac, aw, vec2( 2.0, 1.0) - pp, dir, len2, lob, clp, l);\n"
+    "    easu_tap(ac, aw, vec2( 2.0, 0.0) - pp, dir, len2, lob, clp, h);\n"
+    "    easu_tap(ac, aw, vec2( 1.0, 0.0) - pp, dir, len2, lob, clp, g);\n"
+    "    easu_tap(ac, aw, vec2( 1.0, 2.0) - pp, dir, len2, lob, clp, o);\n"
+    "    easu_tap(ac, aw, vec2( 0.0, 2.0) - pp, dir, len2, lob, clp, n);\n"
+    "\n"
+    "    vec3 mn = min(min(f, g), min(j, k));\n"
+    "    vec3 mx = max(max(f, g), max(j, k));\n"
+    "    vec3 color = clamp(ac / aw, mn, mx);\n"
+    "\n"
+    "    /* RCAS: sharpen against the source-space cross ring, limited to stay in range */\n"
+    "    vec2 uv = gl_FragCoord.xy / uOutputSize;\n"
+    "    vec2 texel = 1.0 / rsize;\n"
+    "    vec3 rl = texture(uSource, uv - vec2(texel.x, 0.0)).rgb;\n"
+    "    vec3 rr = texture(uSource, uv + vec2(texel.x, 0.0)).rgb;\n"
+    "    vec3 rd = texture(uSource, uv - vec2(0.0, texel.y)).rgb;\n"
+    "    vec3 ru = texture(uSource, uv + vec2(0.0, texel.y)).rgb;\n"
+    "    vec3 mn4 = min(min(rl, rr), min(rd, ru));\n"
+    "    vec3 mx4 = max(max(rl, rr), max(rd, ru));\n"
+    "    vec3 hit_min = min(mn4, color) / (4.0 * mx4 + 1e-5);\n"
+    "    vec3 hit_max = (1.0 - max(mx4, color)) / (4.0 * mn4 - 4.0 - 1e-5);\n"
+    "    vec3 lobe3 = max(-hit_min, hit_max);\n"
+    "    float lobe = max(-0.1875, min(max(lobe3.r, max(lobe3.g, lobe3.b)), 0.0)) * uSharpness;\n"
+    "    color = (lobe * (rl + rr + rd + ru) + color) / (4.0 * lobe + 1.0);\n"
+    "\n"
+    "    fragColor = vec4(color, 1.0);\n"
+    "}\n";
+
+/* RCAS sharpness (FSR default of 0.2 stops: exp2(-0.2)) */
+#define RECONSTRUCT_SPATIAL_SHARPNESS 0.87f
+
+/* Temporal mode shades the Image pass at ~half the pixel count (1/sqrt(2) per axis) */
+#define RECONSTRUCT_TEMPORAL_SCALE 0.7071f
+
+/* Frames for the 0.1 history blend to converge on a still image (0.9^32 ~ 3%) */
+#define RECONSTRUCT_TEMPORAL_SETTLE_FRAMES 32
+
 /* ============================================
  * Multipass Shader Creation
  * ============================================ */
 
+/* ============================================
+ * Token-based source analysis
+ * ============================================ */
+
+/* Buffer a channel maps to by Shadertoy convention when the reads alone
+ * can't tell: a buffer's iChannel0 is its own previous frame, the others
+ * read the buffers before it */
+static channel_source_t conventional_buffer_source(int c) {
+    return (c == 0) ? CHANNEL_SOURCE_SELF : (channel_source_t)(CHANNEL_SOURCE_BUFFER_A + c - 1);
+}
+
+/* Bind one channel of a buffer pass from how the pass samples it */
+static void bind_buffer_channel(multipass_channel_t *channel, int c, const glsl_channel_usage_t *usage,
+                                char *reason, size_t reason_size) {
+    int noise = usage->reads[GLSL_READ_NOISE] + usage->reads[GLSL_READ_WORLD];
+    int screen = usage->reads[GLSL_READ_SCREEN] + usage->reads[GLSL_READ_STATE] +
+                 usage->reads[GLSL_READ_INDIRECT];
+    int unknown = usage->reads[GLSL_READ_UNKNOWN];
+    int total = noise + screen + unknown;
+
+    if (!usage->referenced) {
+        /* Not used at all - noise is harmless */
+        channel->source = CHANNEL_SOURCE_NOISE;
+        channel->confidence = 100;
+        snprintf(reason, reason_size, "not used");
+    } else if (total == 0) {
+        channel->source = conventional_buffer_source(c);
+        channel->confidence = 25;
+        snprintf(reason, reason_size, "never sampled, convention");
+    } else if (unknown >= noise + screen) {
+        channel->source = conventional_buffer_source(c);
+        channel->confidence = 30;
+        snprintf(reason, reason_size, "%d of %d reads unresolved, convention", unknown, total);
+    } else if (noise > screen) {
+        /* Coordinates scaled far below pixel size or derived from ray hits:
+         * a lookup texture, never a buffer read at the pixel */
+        channel->source = CHANNEL_SOURCE_NOISE;
+        channel->confidence = 100 * noise / total;
+        snprintf(reason, reason_size, "%d of %d reads %s", noise, total,
+                 usage->reads[GLSL_READ_NOISE] >= usage->reads[GLSL_READ_WORLD] ?
+                 glsl_read_kind_name(GLSL_READ_NOISE) : glsl_read_kind_name(GLSL_READ_WORLD));
+    } else if (c == 0 || usage->feedback > 0) {
+        /* Read at the pixel or at fixed texels: a buffer. Blending the result
+         * into the output over time makes it this pass's own previous frame. */
+        channel->source = CHANNEL_SOURCE_SELF;
+        channel->confidence = 100 * screen / total;
+        if (usage->feedback > 0) {
+            snprintf(reason, reason_size, "%d of %d buffer reads, blended over time", screen, total);
+        } else {
+            if (channel->confidence > 80) channel->confidence = 80;
+            snprintf(reason, reason_size, "%d of %d buffer reads, convention", screen, total);
+        }
+    } else {
+        channel->source = conventional_buffer_source(c);
+        channel->confidence = 100 * screen / total;
+        if (channel->confidence > 70) channel->confidence = 70;
+        snprintf(reason, reason_size, "%d of %d buffer reads, convention", screen, total);
+    }
+}
+
+/* Bind one channel of the Image pass: buffers in order (iChannel0 = Buffer A),
+ * unless every read is a noise-scale lookup */
+static void bind_image_channel(multipass_channel_t *channel, int c, const glsl_channel_usage_t *usage,
+                               char *reason, size_t reason_size) {
+    int total = 0;
+    for (int k = 0; k < GLSL_READ_KIND_COUNT; k++) total += usage->reads[k];
+
+    channel->source = (channel_source_t)(CHANNEL_SOURCE_BUFFER_A + c);
+    if (!usage->referenced) {
+        channel->confidence = 100;
+        snprintf(reason, reason_size, "not used");
+    } else if (total > 0 && usage->reads[GLSL_READ_NOISE] == total) {
+        channel->source = CHANNEL_SOURCE_NOISE;
+        channel->confidence = 100;
+        snprintf(reason, reason_size, "%d of %d reads %s", total, total,
+                 glsl_read_kind_name(GLSL_READ_NOISE));
+    } else {
+        int screen = usage->reads[GLSL_READ_SCREEN] + usage->reads[GLSL_READ_STATE] +
+                     usage->reads[GLSL_READ_INDIRECT];
+        channel->confidence = (total > 0) ? 50 + 40 * screen / total : 50;
+        snprintf(reason, reason_size, "%d of %d buffer reads, buffer order", screen, total);
+    }
+}
+
 multipass_shader_t *multipass_create(const char *source) {
+    uint64_t span = shader_trace_begin();
     multipass_parse_result_t *parsed = multipass_parse_shader(source);
+    shader_trace_end(span, SHADER_TRACE_COMPILE, "parse", NULL);
     if (!parsed) return NULL;
 
+    span = shader_trace_begin();
     multipass_shader_t *shader = multipass_create_from_parsed(parsed);
     multipass_free_parse_result(parsed);
+    shader_trace_end(span, SHADER_TRACE_COMPILE, "analyze", NULL);
 
     return shader;
 }
@@ -932,27 +1695,25 @@ multipass_shader_t *multipass_create_from_parsed(const multipass_parse_result_t
     shader->max_resolution_scale = 1.0f;
     shader->scaled_width = 0;
     shader->scaled_height = 0;
+    shader->vram_max_scale = 2.0f;     /* No VRAM budget yet */
     
     /* Adaptive resolution defaults */
     shader->adaptive_resolution = true;  /* Enable by default */
-    shader->target_fps = 60.0f;          /* Target 60 FPS exactly */
-    shader->current_fps = 60.0f;
-    shader->fps_history_index = 0;
-    shader->last_fps_update_time = 0.0;
-    shader->frames_since_fps_update = 0;
-    shader->last_scale_adjust_time = 0.0;
-    shader->initial_calibration_done = false;
-    shader->calibration_frames = 0;
-    shader->calibration_start_time = 0.0;
-    shader->stable_frames = 0;
-    shader->last_adjustment_direction = 0;
-    shader->oscillation_count = 0;
-    shader->locked_scale = 0.0f;
-    shader->scale_locked = false;
-    for (int i = 0; i < 16; i++) {
-        shader->fps_history[i] = 60.0f;
-        shader->frame_times[i] = 1.0f / 60.0f;
-    }
+    shader->frame_budget_ms = MULTIPASS_DEFAULT_FRAME_BUDGET_MS;
+    shader->frame_interval_ms = 0.0f;
+    shader->cost_model_valid = false;
+    shader->sample_ready = false;
+    shader->last_frame_wall_time = 0.0;
+    shader->current_fps = 0.0f;
+    
+    /* Assume animated until compilation tells us otherwise */
+    shader->input_mask = MULTIPASS_INPUT_ANIMATED;
+    shader->include_owner = -1;
+
+    /* Common is lexed once; every pass's channel analysis sees its helpers
+     * and every pass compile replays the same tokens */
+    glsl_token_stream_t *common_tokens = shader->common_source ? glsl_lex(shader->common_source) : NULL;
+    shader->common_tokens = common_tokens;
 
     for (int i = 0; i < parse_result->pass_count; i++) {
         multipass_pass_t *pass = &shader->passes[i];
@@ -961,184 +1722,41 @@ multipass_shader_t *multipass_create_from_parsed(const multipass_parse_result_t
         pass->name = str_dup(multipass_type_name(pass->type));
         pass->source = str_dup(parse_result->pass_sources[i]);
         pass->is_compiled = false;
+        pass->texture_format = GL_RGBA16F;
+
+        /* One token stream per pass for every source analysis below */
+        glsl_token_stream_t *tokens = glsl_lex(pass->source);
+        pass->uses_texture_lod = tokens && stream_has_word(tokens, GLSL_WORD_TEXTURELOD);
 
         /*
-         * VERY SMART CHANNEL BINDING with confidence scoring
-         *
-         * Analyzes shader source with multiple heuristics to determine optimal bindings.
-         * Uses a scoring system to handle ambiguous cases correctly.
-         * 
-         * Heuristics:
-         * 1. Noise texture: /1024, /512, /256, *0.001, .x only (single channel read)
-         * 2. Self-feedback: uv, fragCoord/iResolution, temporal mixing patterns
-         * 3. Buffer read: texture(iChannelN, uv) where N matches buffer index pattern
-         * 4. Shadertoy conventions: iChannel0 often = self for buffers
+         * Channel binding from how each texture read's coordinate was computed:
+         * reads that follow the pixel (fragCoord, uv) sample a buffer, reads
+         * scaled far below pixel size or taken at ray hits sample noise, and a
+         * read blended into the output over time is the pass's own previous
+         * frame. Conventions only decide what the reads can't.
          */
-        
+        glsl_channel_usage_t usage[GLSL_CHANNEL_COUNT];
+        if (!tokens || !glsl_analyze_channels(common_tokens, tokens, usage)) {
+            memset(usage, 0, sizeof(usage));
+        }
+
         if (pass->type == PASS_TYPE_IMAGE) {
             shader->image_pass_index = i;
-            /* Image pass reads from buffers in order */
-            pass->channels[0].source = CHANNEL_SOURCE_BUFFER_A;
-            pass->channels[1].source = CHANNEL_SOURCE_BUFFER_B;
-            pass->channels[2].source = CHANNEL_SOURCE_BUFFER_C;
-            pass->channels[3].source = CHANNEL_SOURCE_BUFFER_D;
         } else {
             shader->has_buffers = true;
-            
-            const char *src = pass->source;
-            
-            for (int c = 0; c < MULTIPASS_MAX_CHANNELS; c++) {
-                /* Confidence scores: positive = noise, negative = buffer/self */
-                int noise_score = 0;
-                int buffer_score = 0;
-                int self_score = 0;
-                bool channel_used = false;
-                
-                if (src) {
-                    char channel_name[16];
-                    snprintf(channel_name, sizeof(channel_name), "iChannel%d", c);
-                    
-                    const char *usage = src;
-                    while ((usage = strstr(usage, channel_name)) != NULL) {
-                        channel_used = true;
-                        
-                        /* Scan context around this usage (before and after) */
-                        const char *line_start = usage;
-                        while (line_start > src && *(line_start-1) != '\n') line_start--;
-                        
-                        const char *line_end = usage;
-                        while (*line_end && *line_end != '\n' && *line_end != ';') line_end++;
-                        
-                        /* Check for noise texture patterns */
-                        /* Pattern: division by large power of 2 (texture atlas/noise) */
-                        if (strstr(usage, "/1024") || strstr(usage, "/ 1024") ||
-                            strstr(usage, "/512") || strstr(usage, "/ 512") ||
-                            strstr(usage, "/256") || strstr(usage, "/ 256")) {
-                            noise_score += 100;  /* Very strong noise indicator */
-                        }
-                        
-                        /* Pattern: multiplication by very small number */
-                        const char *p = usage;
-                        while (p < usage + 60 && *p) {
-                            if ((strncmp(p, "*0.00", 5) == 0 || strncmp(p, "* 0.00", 6) == 0) &&
-                                !strstr(line_start, "mix") && !strstr(line_start, "smoothstep")) {
-                                noise_score += 80;
-                                break;
-                            }
-                            p++;
-                        }
-                        
-                        /* Pattern: .x, .y, .z, .r only access (noise often single channel) */
-                        p = usage + strlen(channel_name);
-                        while (*p == ' ' || *p == ',') p++;
-                        if (*p == ')') {
-                            p++;
-                            while (*p == ' ') p++;
-                            if (*p == '.' && (p[1] == 'x' || p[1] == 'r') && 
-                                (p[2] == ';' || p[2] == ')' || p[2] == ',' || p[2] == ' ' ||
-                                 p[2] == '*' || p[2] == '+' || p[2] == '-' || p[2] == '/')) {
-                                noise_score += 30;  /* Moderate noise indicator */
-                            }
-                        }
-                        
-                        /* Check for buffer/screen-space read patterns */
-                        /* Pattern: fragCoord or iResolution nearby */
-                        p = line_start;
-                        while (p < line_end) {
-                            if (strncmp(p, "fragCoord", 9) == 0 ||
-                                strncmp(p, "iResolution", 11) == 0) {
-                                buffer_score += 50;
-                                break;
-                            }
-                            p++;
-                        }
-                        
-                        /* Pattern: simple uv variable (very common for feedback) */
-                        p = usage;
-                        while (p < usage + 40 && *p) {
-                            if (p[0] == 'u' && p[1] == 'v' && 
-                                (p[2] == ')' || p[2] == '.' || p[2] == ',' || p[2] == ' ' || p[2] == '*' || p[2] == '+')) {
-                                buffer_score += 40;
-                                break;
-                            }
-                            /* Also check for common coordinate variable names */
-                            if (strncmp(p, "coord", 5) == 0 || strncmp(p, "pos", 3) == 0 ||
-                                strncmp(p, "st)", 3) == 0 || strncmp(p, "st,", 3) == 0) {
-                                buffer_score += 30;
-                                break;
-                            }
-                            p++;
-                        }
-                        
-                        /* Pattern: temporal mixing (strong self-feedback indicator) */
-                        if (strstr(line_start, "mix") && strstr(line_start, channel_name)) {
-                            self_score += 60;
-                        }
-                        if (strstr(line_start, "+=") || strstr(line_start, "*=")) {
-                            self_score += 20;  /* Accumulation pattern */
-                        }
-                        
-                        usage++;
-                    }
-                }
-                
-                /* Determine channel source based on scores and conventions */
-                if (!channel_used) {
-                    /* Channel not used at all - default to noise (harmless) */
-                    pass->channels[c].source = CHANNEL_SOURCE_NOISE;
-                } else if (noise_score > buffer_score && noise_score > self_score && noise_score >= 50) {
-                    /* Clear noise texture usage */
-                    pass->channels[c].source = CHANNEL_SOURCE_NOISE;
-                    log_info("  %s iChannel%d: noise (score: noise=%d, buffer=%d, self=%d)", 
-                             pass->name, c, noise_score, buffer_score, self_score);
-                } else if (buffer_score > 0 || self_score > 0) {
-                    /* Screen-space read detected - determine if self or other buffer */
-                    
-                    /*
-                     * Shadertoy convention: For buffer passes, iChannel0 is usually self-feedback
-                     * UNLESS there's strong evidence of noise texture usage.
-                     * This is the most common pattern in Shadertoy.
-                     */
-                    if (c == 0 && noise_score < 50) {
-                        /* iChannel0 in buffer pass = almost always self-feedback */
-                        pass->channels[c].source = CHANNEL_SOURCE_SELF;
-                        log_info("  %s iChannel%d: self (convention + scores: noise=%d, buffer=%d, self=%d)", 
-                                 pass->name, c, noise_score, buffer_score, self_score);
-                    } else if (self_score > buffer_score) {
-                        /* Temporal/accumulation pattern detected */
-                        pass->channels[c].source = CHANNEL_SOURCE_SELF;
-                        log_info("  %s iChannel%d: self (score: noise=%d, buffer=%d, self=%d)", 
-                                 pass->name, c, noise_score, buffer_score, self_score);
-                    } else {
-                        /* Reading from another buffer */
-                        /* Map channel index to buffer: ch1->BufA, ch2->BufB, etc. for non-zero channels */
-                        if (c == 0) {
-                            pass->channels[c].source = CHANNEL_SOURCE_SELF;
-                        } else if (c == 1) {
-                            pass->channels[c].source = CHANNEL_SOURCE_BUFFER_A;
-                        } else if (c == 2) {
-                            pass->channels[c].source = CHANNEL_SOURCE_BUFFER_B;
-                        } else {
-                            pass->channels[c].source = CHANNEL_SOURCE_BUFFER_C;
-                        }
-                        log_info("  %s iChannel%d: buffer (score: noise=%d, buffer=%d, self=%d)", 
-                                 pass->name, c, noise_score, buffer_score, self_score);
-                    }
-                } else {
-                    /* Channel used but pattern unclear - use Shadertoy conventions */
-                    if (c == 0) {
-                        /* iChannel0 = self for buffer passes (most common convention) */
-                        pass->channels[c].source = CHANNEL_SOURCE_SELF;
-                    } else if (c == 1) {
-                        pass->channels[c].source = CHANNEL_SOURCE_BUFFER_A;
-                    } else if (c == 2) {
-                        pass->channels[c].source = CHANNEL_SOURCE_BUFFER_B;
-                    } else {
-                        pass->channels[c].source = CHANNEL_SOURCE_BUFFER_C;
-                    }
-                    log_info("  %s iChannel%d: convention default (channel used, pattern unclear)", 
-                             pass->name, c);
-                }
+        }
+
+        for (int c = 0; c < MULTIPASS_MAX_CHANNELS; c++) {
+            char reason[96];
+            if (pass->type == PASS_TYPE_IMAGE) {
+                bind_image_channel(&pass->channels[c], c, &usage[c], reason, sizeof(reason));
+            } else {
+                bind_buffer_channel(&pass->channels[c], c, &usage[c], reason, sizeof(reason));
+            }
+            if (usage[c].referenced) {
+                log_info("  %s iChannel%d: %s (confidence %d%%: %s)", pass->name, c,
+                         multipass_channel_source_name(pass->channels[c].source),
+                         pass->channels[c].confidence, reason);
             }
         }
 
@@ -1149,6 +1767,8 @@ multipass_shader_t *multipass_create_from_parsed(const multipass_parse_result_t
                  src_names[pass->channels[1].source],
                  src_names[pass->channels[2].source],
                  src_names[pass->channels[3].source]);
+
+        glsl_token_stream_free(tokens);
     }
 
     log_info("Created multipass shader with %d passes (has_buffers=%d, image_index=%d)",
@@ -1157,81 +1777,345 @@ multipass_shader_t *multipass_create_from_parsed(const multipass_parse_result_t
     return shader;
 }
 
-bool multipass_init_gl(multipass_shader_t *shader, int width, int height) {
-    if (!shader) return false;
+/* ============================================
+ * GPU Timing
+ * ============================================ */
 
-    if (shader->is_initialized) {
-        log_debug("Multipass GL already initialized");
-        return true;
+/* Collected frame whose timings calibrate the static cost estimate (a few
+ * frames in, once shader caches and clocks have warmed up) */
+#define COST_CALIBRATION_SAMPLE 8
+
+/* Clock slack when checking a GPU time against the wall time it fits in */
+#define TIMER_PLAUSIBLE_SLACK_MS 1.0
+
+static void calibrate_cost(multipass_shader_t *shader, const float *sample_ms);
+
+/* GL_TIME_ELAPSED is core since desktop GL 3.3 but missing from GLES3 headers */
+#ifndef GL_TIME_ELAPSED
+#define GL_TIME_ELAPSED 0x88BF
+#endif
+
+/* Timer queries need desktop GL 3.3+ (ES only has them via EXT_disjoint_timer_query) */
+static bool gpu_timers_available(void) {
+    const char *version = (const char *)glGetString(GL_VERSION);
+    if (!version || strncmp(version, "OpenGL ES", 9) == 0) {
+        return false;
     }
 
-    log_info("Initializing multipass GL resources (%dx%d)", width, height);
+    int major = 0, minor = 0;
+    if (sscanf(version, "%d.%d", &major, &minor) != 2) {
+        return false;
+    }
+    return major > 3 || (major == 3 && minor >= 3);
+}
 
-    /* Get the default framebuffer ID (GTK may use non-zero FBO) */
-    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &shader->default_framebuffer);
-    log_info("Default framebuffer ID: %d", shader->default_framebuffer);
+static void gpu_timers_init(multipass_shader_t *shader) {
+    shader->gpu_timers_supported = gpu_timers_available();
+    if (!shader->gpu_timers_supported) {
+        log_info("GPU timer queries unavailable - adaptive resolution uses frame intervals");
+        return;
+    }
 
-    /* Create VAO and VBO for fullscreen quad */
-    static const float vertices[] = {
-        -1.0f, -1.0f,
-         1.0f, -1.0f,
-        -1.0f,  1.0f,
-         1.0f,  1.0f,
-    };
+    glGenQueries(MULTIPASS_TIMER_FRAMES * MULTIPASS_TIMER_SLOTS, &shader->timer_queries[0][0]);
+    memset(shader->timer_issued, 0, sizeof(shader->timer_issued));
+    shader->timer_frame = 0;
 
-#if defined(HAVE_GLES3) || defined(USE_EPOXY)
-    glGenVertexArrays(1, &shader->vao);
-    glBindVertexArray(shader->vao);
-#endif
+    if (glGetError() != GL_NO_ERROR) {
+        glDeleteQueries(MULTIPASS_TIMER_FRAMES * MULTIPASS_TIMER_SLOTS, &shader->timer_queries[0][0]);
+        memset(shader->timer_queries, 0, sizeof(shader->timer_queries));
+        shader->gpu_timers_supported = false;
+        log_warn("GPU timer query creation failed - falling back to frame intervals");
+    }
+}
 
-    glGenBuffers(1, &shader->vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, shader->vbo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+/* Name of a timer slot in traces */
+static const char *timer_slot_name(const multipass_shader_t *shader, int slot) {
+    return (slot < shader->pass_count) ? shader->passes[slot].name : "Reconstruct";
+}
 
-    /* Generate high-quality noise texture (1024x1024 for Shadertoy compatibility)
-     * Many shaders expect texture(iChannel0, p/1024.0) to sample noise */
-    glGenTextures(1, &shader->noise_texture);
-    glBindTexture(GL_TEXTURE_2D, shader->noise_texture);
+/* The timer pair also brackets the slot's CPU-side submission for tracing */
+static void gpu_timer_begin(multipass_shader_t *shader, int slot) {
+    shader->timer_trace_ns[shader->timer_frame][slot] = shader_trace_begin();
+    if (!shader->gpu_timers_supported) return;
+    glBeginQuery(GL_TIME_ELAPSED, shader->timer_queries[shader->timer_frame][slot]);
+}
 
-    #define NOISE_SIZE 1024
-    unsigned char *noise_data = malloc(NOISE_SIZE * NOISE_SIZE * 4);
-    if (noise_data) {
-        /* Use a simple but decent PRNG for reproducible noise */
-        unsigned int seed = 12345;
-        for (int y = 0; y < NOISE_SIZE; y++) {
-            for (int x = 0; x < NOISE_SIZE; x++) {
-                int idx = (y * NOISE_SIZE + x) * 4;
-                /* LCG-based pseudo-random with mixing for each channel */
-                seed = seed * 1664525u + 1013904223u;
-                noise_data[idx + 0] = (seed >> 24) & 0xFF;
-                seed = seed * 1664525u + 1013904223u;
-                noise_data[idx + 1] = (seed >> 24) & 0xFF;
-                seed = seed * 1664525u + 1013904223u;
-                noise_data[idx + 2] = (seed >> 24) & 0xFF;
-                seed = seed * 1664525u + 1013904223u;
-                noise_data[idx + 3] = (seed >> 24) & 0xFF;
-            }
+static void gpu_timer_end(multipass_shader_t *shader, int slot, bool scaled) {
+    shader_trace_end(shader->timer_trace_ns[shader->timer_frame][slot], SHADER_TRACE_RENDER,
+                     "submit", timer_slot_name(shader, slot));
+    if (!shader->gpu_timers_supported) return;
+    glEndQuery(GL_TIME_ELAPSED);
+    shader->timer_issued[shader->timer_frame][slot] = true;
+    if (scaled) {
+        shader->timer_scaled_mask[shader->timer_frame] |= 1u << slot;
+    }
+}
+
+/*
+ * Collect the oldest frame in the ring (recorded MULTIPASS_TIMER_FRAMES-1
+ * frames ago) before its queries are reused. Never blocks: if the GPU is
+ * still behind, the sample is simply dropped.
+ */
+static void gpu_timers_collect(multipass_shader_t *shader) {
+    if (!shader->gpu_timers_supported) return;
+
+    int f = shader->timer_frame;
+    float fixed_ms = 0.0f;
+    float scaled_ms = 0.0f;
+    bool any = false;
+    bool complete = true;
+
+    for (int slot = 0; slot < MULTIPASS_TIMER_SLOTS; slot++) {
+        if (!shader->timer_issued[f][slot]) continue;
+
+        GLuint available = 0;
+        glGetQueryObjectuiv(shader->timer_queries[f][slot], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+            complete = false;
+            break;
         }
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, NOISE_SIZE, NOISE_SIZE, 0, GL_RGBA, GL_UNSIGNED_BYTE, noise_data);
-        free(noise_data);
     }
-    #undef NOISE_SIZE
-    /* Use NEAREST for crisp noise values, LINEAR can cause blurring */
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+    float sample[MULTIPASS_TIMER_SLOTS] = {0};
+    double frame_ms = 0.0;
+
+    for (int slot = 0; complete && slot < MULTIPASS_TIMER_SLOTS; slot++) {
+        if (!shader->timer_issued[f][slot]) continue;
+
+#if defined(USE_EPOXY)
+        GLuint64 ns = 0;
+        glGetQueryObjectui64v(shader->timer_queries[f][slot], GL_QUERY_RESULT, &ns);
+#else
+        /* ES headers only declare the 32-bit getter, which saturates */
+        GLuint ns = 0;
+        glGetQueryObjectuiv(shader->timer_queries[f][slot], GL_QUERY_RESULT, &ns);
+        if (ns == 0xFFFFFFFFu) complete = false;
+#endif
+        sample[slot] = (float)((double)ns / 1000000.0);
+        frame_ms += sample[slot];
+    }
+
+    /* The GPU can't have spent longer on the frame than has passed since it
+     * was submitted; drivers report garbage for some (often the first) queries */
+    double since_submit_ms = (platform_get_time() - shader->timer_submit_time[f]) * 1000.0;
+    if (complete && frame_ms > since_submit_ms + TIMER_PLAUSIBLE_SLACK_MS) {
+        log_debug("Dropping implausible GPU sample: %.1f ms within %.1f ms", frame_ms, since_submit_ms);
+        complete = false;
+    }
+
+    for (int slot = 0; complete && slot < MULTIPASS_TIMER_SLOTS; slot++) {
+        if (!shader->timer_issued[f][slot]) continue;
+
+        float ms = sample[slot];
+        any = true;
+        shader_trace_gpu(shader->timer_trace_ns[f][slot], ms, timer_slot_name(shader, slot));
+
+        if (shader->timer_scaled_mask[f] & (1u << slot)) {
+            scaled_ms += ms;
+        } else {
+            fixed_ms += ms;
+        }
+
+        /* Per-pass smoothing for display / diagnostics */
+        if (slot < shader->pass_count) {
+            multipass_pass_t *pass = &shader->passes[slot];
+            pass->gpu_time_ms = (pass->gpu_time_ms > 0.0f) ?
+                                pass->gpu_time_ms * 0.9f + ms * 0.1f : ms;
+        } else {
+            shader->reconstruct_gpu_ms = (shader->reconstruct_gpu_ms > 0.0f) ?
+                                         shader->reconstruct_gpu_ms * 0.9f + ms * 0.1f : ms;
+        }
+    }
+
+    memset(shader->timer_issued[f], 0, sizeof(shader->timer_issued[f]));
+    shader->timer_scaled_mask[f] = 0;
+
+    if (!any) return;
+
+    float total = fixed_ms + scaled_ms;
+    shader->gpu_frame_ms = (shader->gpu_frame_ms > 0.0f) ?
+                           shader->gpu_frame_ms * 0.9f + total * 0.1f : total;
+
+    memcpy(shader->gpu_sample_ms, sample, sizeof(sample));
+    shader->gpu_sample_total_ms = total;
+    shader->gpu_sample_seq++;
+    shader->gpu_sample_frame = shader->timer_frame_number[f];
+
+    shader->sample_fixed_ms = fixed_ms;
+    shader->sample_scaled_ms = scaled_ms;
+    shader->sample_scale = shader->timer_scale[f];
+    shader->sample_ready = true;
+
+    if (shader->gpu_sample_seq == COST_CALIBRATION_SAMPLE) {
+        calibrate_cost(shader, sample);
+    }
+}
+
+/* ============================================
+ * GPU Memory Accounting
+ * ============================================ */
+
+static size_t texel_bytes(GLenum format) {
+    return (format == GL_RGBA16F) ? 8 : 4;
+}
+
+static GLenum texel_type(GLenum format) {
+    return (format == GL_RGBA16F) ? GL_HALF_FLOAT : GL_UNSIGNED_BYTE;
+}
+
+/* Storage of one texture, every level of the chain down to 1x1 when mipmapped */
+static size_t texture_bytes(GLenum format, int width, int height, bool mipmaps) {
+    if (width <= 0 || height <= 0) return 0;
+
+    size_t texels = (size_t)width * (size_t)height;
+    while (mipmaps && (width > 1 || height > 1)) {
+        width = (width > 1) ? width / 2 : 1;
+        height = (height > 1) ? height / 2 : 1;
+        texels += (size_t)width * (size_t)height;
+    }
+    return texels * texel_bytes(format);
+}
+
+static void account_pass(multipass_pass_t *pass) {
+    pass->vram_bytes = pass->fbo ? 2 * texture_bytes(pass->texture_format, pass->width,
+                                                     pass->height, pass->mip_chain_allocated) : 0;
+}
+
+static void account_reconstruct(multipass_shader_t *shader) {
+    const multipass_reconstruct_t *r = &shader->reconstruct;
+    size_t bytes = 0;
+
+    if (r->image_texture) {
+        bytes += texture_bytes(GL_RGBA8, r->render_width, r->render_height, false);
+    }
+    if (r->history_textures[0]) {
+        bytes += 2 * texture_bytes(GL_RGBA8, r->output_width, r->output_height, false);
+    }
+    shader->reconstruct_vram_bytes = bytes;
+}
+
+/* Buffer scale after the VRAM budget's cap */
+static float effective_scale(const multipass_shader_t *shader) {
+    return (shader->resolution_scale < shader->vram_max_scale) ?
+           shader->resolution_scale : shader->vram_max_scale;
+}
+
+/*
+ * (Re)specify both ping-pong textures of a buffer pass at its size and
+ * format, with a mip chain if it needs one. Respecifying level 0 leaves
+ * the old levels allocated, so a texture that had a chain is replaced
+ * (fresh names - the FBO attachment is set every frame).
+ */
+static void pass_alloc_textures(multipass_pass_t *pass) {
+    if (pass->textures[0] && pass->mip_chain_allocated) {
+        glDeleteTextures(2, pass->textures);
+        pass->textures[0] = 0;
+        pass->textures[1] = 0;
+    }
+    if (!pass->textures[0]) {
+        glGenTextures(2, pass->textures);
+    }
+
+    for (int t = 0; t < 2; t++) {
+        glBindTexture(GL_TEXTURE_2D, pass->textures[t]);
+        glTexImage2D(GL_TEXTURE_2D, 0, pass->texture_format, pass->width, pass->height, 0,
+                     GL_RGBA, texel_type(pass->texture_format), NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                        pass->needs_mipmaps ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        if (pass->needs_mipmaps) {
+            glGenerateMipmap(GL_TEXTURE_2D);
+        }
+    }
+
+    pass->mip_chain_allocated = pass->needs_mipmaps;
+    pass->needs_clear = true;
+    account_pass(pass);
+}
+
+bool multipass_init_gl(multipass_shader_t *shader, int width, int height) {
+    if (!shader) return false;
+
+    if (shader->is_initialized) {
+        log_debug("Multipass GL already initialized");
+        return true;
+    }
+
+    log_info("Initializing multipass GL resources (%dx%d)", width, height);
+
+    /* Get the default framebuffer ID (GTK may use non-zero FBO) */
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &shader->default_framebuffer);
+    log_info("Default framebuffer ID: %d", shader->default_framebuffer);
+
+    /* Create VAO and VBO for fullscreen quad */
+    static const float vertices[] = {
+        -1.0f, -1.0f,
+         1.0f, -1.0f,
+        -1.0f,  1.0f,
+         1.0f,  1.0f,
+    };
+
+#if defined(HAVE_GLES3) || defined(USE_EPOXY)
+    glGenVertexArrays(1, &shader->vao);
+    glBindVertexArray(shader->vao);
+#endif
+
+    glGenBuffers(1, &shader->vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, shader->vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    shader->shared_vram_bytes = sizeof(vertices);
+
+    /* Generate high-quality noise texture (1024x1024 for Shadertoy compatibility)
+     * Many shaders expect texture(iChannel0, p/1024.0) to sample noise */
+    glGenTextures(1, &shader->noise_texture);
+    glBindTexture(GL_TEXTURE_2D, shader->noise_texture);
+
+    #define NOISE_SIZE 1024
+    unsigned char *noise_data = malloc(NOISE_SIZE * NOISE_SIZE * 4);
+    if (noise_data) {
+        /* Use a simple but decent PRNG for reproducible noise */
+        unsigned int seed = 12345;
+        for (int y = 0; y < NOISE_SIZE; y++) {
+            for (int x = 0; x < NOISE_SIZE; x++) {
+                int idx = (y * NOISE_SIZE + x) * 4;
+                /* LCG-based pseudo-random with mixing for each channel */
+                seed = seed * 1664525u + 1013904223u;
+                noise_data[idx + 0] = (seed >> 24) & 0xFF;
+                seed = seed * 1664525u + 1013904223u;
+                noise_data[idx + 1] = (seed >> 24) & 0xFF;
+                seed = seed * 1664525u + 1013904223u;
+                noise_data[idx + 2] = (seed >> 24) & 0xFF;
+                seed = seed * 1664525u + 1013904223u;
+                noise_data[idx + 3] = (seed >> 24) & 0xFF;
+            }
+        }
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, NOISE_SIZE, NOISE_SIZE, 0, GL_RGBA, GL_UNSIGNED_BYTE, noise_data);
+        free(noise_data);
+        shader->shared_vram_bytes += texture_bytes(GL_RGBA8, NOISE_SIZE, NOISE_SIZE, false);
+    }
+    #undef NOISE_SIZE
+    /* Use NEAREST for crisp noise values, LINEAR can cause blurring */
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+    /* GPU timer queries for the adaptive resolution controller */
+    gpu_timers_init(shader);
 
     /* Calculate scaled resolution for buffer passes */
-    int scaled_w = (int)(width * shader->resolution_scale);
-    int scaled_h = (int)(height * shader->resolution_scale);
+    float scale = effective_scale(shader);
+    int scaled_w = (int)(width * scale);
+    int scaled_h = (int)(height * scale);
     if (scaled_w < 1) scaled_w = 1;
     if (scaled_h < 1) scaled_h = 1;
     shader->scaled_width = scaled_w;
     shader->scaled_height = scaled_h;
     
     log_info("Resolution scale: %.2f (buffers: %dx%d, output: %dx%d)",
-             shader->resolution_scale, scaled_w, scaled_h, width, height);
+             scale, scaled_w, scaled_h, width, height);
 
     /* Initialize each pass */
     for (int i = 0; i < shader->pass_count; i++) {
@@ -1251,27 +2135,15 @@ bool multipass_init_gl(multipass_shader_t *shader, int width, int height) {
         /* Create FBO and textures for buffer passes */
         if (pass->type >= PASS_TYPE_BUFFER_A && pass->type <= PASS_TYPE_BUFFER_D) {
             glGenFramebuffers(1, &pass->fbo);
-            glGenTextures(2, pass->textures);
 
-            for (int t = 0; t < 2; t++) {
-                glBindTexture(GL_TEXTURE_2D, pass->textures[t]);
-                /* Use GL_RGBA16F for good precision with half the bandwidth
-                 * 16-bit floats are faster for memory-bound shaders
-                 * Use scaled resolution for buffer passes */
-                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, pass->width, pass->height, 0,
-                            GL_RGBA, GL_HALF_FLOAT, NULL);
-                /* 
-                 * Start with GL_LINEAR - we'll upgrade to GL_LINEAR_MIPMAP_LINEAR
-                 * in multipass_compile_all() if any shader uses textureLod on this buffer.
-                 * This avoids mipmap generation overhead for buffers that don't need it.
-                 */
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-            }
+            /* GL_RGBA16F for good precision with half the bandwidth of
+             * RGBA32F, at the scaled resolution. No mip chain yet - it is
+             * added in multipass_compile_all() if any shader uses textureLod
+             * on this buffer, so buffers that don't need one don't pay for it. */
+            pass_alloc_textures(pass);
 
-            log_info("Created FBO and textures for %s", pass->name);
+            log_info("Created FBO and textures for %s (%.1f MB)", pass->name,
+                     pass->vram_bytes / (1024.0 * 1024.0));
         }
     }
 
@@ -1282,11 +2154,8 @@ bool multipass_init_gl(multipass_shader_t *shader, int width, int height) {
 }
 
 /* Cache uniform locations after compilation to avoid glGetUniformLocation per frame */
-static void cache_uniform_locations(multipass_pass_t *pass) {
-    if (!pass || !pass->program) return;
-    
-    GLuint prog = pass->program;
-    uniform_locations_t *u = &pass->uniforms;
+static void cache_uniform_locations(GLuint prog, uniform_locations_t *u, const char *name) {
+    if (!prog) return;
     
     u->iTime = glGetUniformLocation(prog, "iTime");
     u->iTimeDelta = glGetUniformLocation(prog, "iTimeDelta");
@@ -1303,10 +2172,119 @@ static void cache_uniform_locations(multipass_pass_t *pass) {
     u->iChannel[2] = glGetUniformLocation(prog, "iChannel2");
     u->iChannel[3] = glGetUniformLocation(prog, "iChannel3");
     
+    u->fragXform = glGetUniformLocation(prog, "_mpFragXform");
+    u->checkerPhase = glGetUniformLocation(prog, "_mpCheckerPhase");
+    
     u->cached = true;
     
     log_debug("Cached uniform locations for %s: iTime=%d, iResolution=%d, iFrame=%d",
-              pass->name, u->iTime, u->iResolution, u->iFrame);
+              name, u->iTime, u->iResolution, u->iFrame);
+}
+
+/* Map an active uniform name to the multipass_input_t it reads.
+ * iTimeDelta/iFrameRate/iSampleRate are constants here, so they don't count. */
+static unsigned int uniform_input_flag(const char *name) {
+    if (strcmp(name, "iTime") == 0) return MULTIPASS_INPUT_TIME;
+    if (strcmp(name, "iFrame") == 0) return MULTIPASS_INPUT_FRAME;
+    if (strcmp(name, "iMouse") == 0) return MULTIPASS_INPUT_MOUSE;
+    if (strcmp(name, "iDate") == 0) return MULTIPASS_INPUT_DATE;
+    if (strcmp(name, "iResolution") == 0) return MULTIPASS_INPUT_RESOLUTION;
+    if (strcmp(name, "iChannelResolution") == 0 ||
+        strcmp(name, "iChannelResolution[0]") == 0) return MULTIPASS_INPUT_RESOLUTION;
+    return 0;
+}
+
+/* Record which inputs and channels the linked program really uses.
+ * The driver drops uniforms that don't reach the output, so this is
+ * stricter than searching the source text. */
+static void reflect_uniform_inputs(multipass_pass_t *pass) {
+    pass->uniform_inputs = 0;
+    pass->active_channels = 0;
+    if (!pass->program) return;
+    
+    GLint count = 0;
+    glGetProgramiv(pass->program, GL_ACTIVE_UNIFORMS, &count);
+    
+    for (GLint i = 0; i < count; i++) {
+        char name[64];
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(pass->program, (GLuint)i, sizeof(name), &length, &size, &type, name);
+        if (length <= 0) continue;
+        
+        if (strncmp(name, "iChannel", 8) == 0 && name[8] >= '0' && name[8] <= '3' && name[9] == '\0') {
+            pass->active_channels |= 1u << (name[8] - '0');
+            continue;
+        }
+        pass->uniform_inputs |= uniform_input_flag(name);
+    }
+}
+
+/*
+ * Propagate inputs along the channel graph. A pass depends on everything
+ * its sampled buffers depend on; sampling itself or a buffer rendered
+ * later in the frame reads last frame's contents, which makes it feedback.
+ */
+static void resolve_input_graph(multipass_shader_t *shader) {
+    for (int p = 0; p < shader->pass_count; p++) {
+        shader->passes[p].input_mask = shader->passes[p].uniform_inputs;
+    }
+    
+    /* At most one step per pass until the masks stop growing */
+    for (int iter = 0; iter < MULTIPASS_MAX_PASSES; iter++) {
+        bool changed = false;
+        
+        for (int p = 0; p < shader->pass_count; p++) {
+            multipass_pass_t *pass = &shader->passes[p];
+            unsigned int mask = pass->input_mask;
+            
+            for (int c = 0; c < MULTIPASS_MAX_CHANNELS; c++) {
+                if (!(pass->active_channels & (1u << c))) continue;
+                
+                if (pass->channels[c].source == CHANNEL_SOURCE_SELF) {
+                    mask |= MULTIPASS_INPUT_FEEDBACK;
+                    continue;
+                }
+                int src = pass->channel_buffer_index[c];
+                if (src < 0) continue;
+                
+                mask |= shader->passes[src].input_mask;
+                if (src >= p) {
+                    mask |= MULTIPASS_INPUT_FEEDBACK;
+                }
+            }
+            
+            if (mask != pass->input_mask) {
+                pass->input_mask = mask;
+                changed = true;
+            }
+        }
+        if (!changed) break;
+    }
+    
+    shader->input_mask = (shader->image_pass_index >= 0) ?
+                         shader->passes[shader->image_pass_index].input_mask : 0;
+    
+    /* Buffers that don't animate only need rendering when their inputs change */
+    for (int p = 0; p < shader->pass_count; p++) {
+        multipass_pass_t *pass = &shader->passes[p];
+        pass->invariant = pass->fbo && pass->is_compiled &&
+                          (pass->input_mask & MULTIPASS_INPUT_ANIMATED) == 0;
+        pass->output_valid = false;
+        if (pass->invariant) {
+            log_info("%s is time-invariant, rendering it on input changes only", pass->name);
+        }
+    }
+    
+    log_info("Shader inputs:%s%s%s%s%s%s%s",
+             (shader->input_mask & MULTIPASS_INPUT_TIME) ? " time" : "",
+             (shader->input_mask & MULTIPASS_INPUT_FRAME) ? " frame" : "",
+             (shader->input_mask & MULTIPASS_INPUT_MOUSE) ? " mouse" : "",
+             (shader->input_mask & MULTIPASS_INPUT_DATE) ? " date" : "",
+             (shader->input_mask & MULTIPASS_INPUT_RESOLUTION) ? " resolution" : "",
+             (shader->input_mask & MULTIPASS_INPUT_FEEDBACK) ? " feedback" : "",
+             multipass_is_static(shader) ? " (static)" : "");
 }
 
 /* Cache buffer pass indices for each channel to avoid linear search every frame */
@@ -1337,21 +2315,41 @@ static void cache_channel_buffer_indices(multipass_shader_t *shader) {
     log_debug("Cached channel buffer indices for %d passes", shader->pass_count);
 }
 
-/* Check if shader source uses textureLod (needs mipmaps) */
-static bool shader_uses_textureLod(const char *source) {
-    return source && strstr(source, "textureLod") != NULL;
-}
+/* Name the #line source strings of included files after a compile error */
+static void append_include_legend(multipass_pass_t *pass) {
+    if (pass->includes.count == 0) return;
+
+    string_builder_t error;
+    sb_init(&error, strlen(pass->compile_error) + 256);
+    sb_append_str(&error, pass->compile_error);
+    sb_append_str(&error, "\nSource strings (error prefix \"N:line\"):\n  0: shader\n");
+    for (int i = 0; i < pass->includes.count; i++) {
+        const shader_include_module_t *module = shader_include_get(pass->includes.ids[i]);
+        if (!module) continue;
+        char line[PATH_MAX + 32];
+        snprintf(line, sizeof(line), "  %d: %s\n", module->id, module->path);
+        sb_append_str(&error, line);
+    }
 
-bool multipass_compile_pass(multipass_shader_t *shader, int pass_index) {
-    if (!shader || pass_index < 0 || pass_index >= shader->pass_count) {
-        return false;
+    char *text = sb_finish(&error);
+    if (text) {
+        free(pass->compile_error);
+        pass->compile_error = text;
     }
+}
 
+static void release_variants(multipass_pass_t *pass);
+
+/* Drop a pass's program before it's rebuilt */
+static void reset_pass(multipass_shader_t *shader, int pass_index) {
     multipass_pass_t *pass = &shader->passes[pass_index];
 
     log_info("Compiling pass %d: %s", pass_index, pass->name);
 
-    /* Clean up previous compilation */
+    /* Clean up previous compilation (and any cached output of the old program) */
+    pass->invariant = false;
+    pass->output_valid = false;
+    release_variants(pass);
     if (pass->program) {
         glDeleteProgram(pass->program);
         pass->program = 0;
@@ -1360,25 +2358,21 @@ bool multipass_compile_pass(multipass_shader_t *shader, int pass_index) {
         free(pass->compile_error);
         pass->compile_error = NULL;
     }
+}
 
-    /* Wrap pass source with compatibility layer */
-    char *wrapped = wrap_pass_source(shader->common_source, pass->source);
-    if (!wrapped) {
-        pass->compile_error = str_dup("Failed to allocate memory for shader wrapping");
-        pass->is_compiled = false;
-        return false;
+/* Take over a built program, or the error log if the build failed */
+static bool complete_pass(multipass_shader_t *shader, multipass_pass_t *pass,
+                          bool success, GLuint program) {
+    /* Editing an included file recompiles this pass, whether or not it built */
+    for (int i = 0; i < pass->includes.count; i++) {
+        shader_include_add_dependent(pass->includes.ids[i], shader->include_owner);
     }
 
-    /* Compile shaders */
-    GLuint program;
-    bool success = shader_create_program_from_sources(fullscreen_vertex_shader, wrapped, &program);
-
-    free(wrapped);
-
     if (!success) {
         const char *error_log = multipass_get_error_log();
         pass->compile_error = str_dup(error_log ? error_log : "Unknown compilation error");
         pass->is_compiled = false;
+        append_include_legend(pass);
         log_error("Failed to compile pass %s: %s", pass->name, pass->compile_error);
         return false;
     }
@@ -1387,10 +2381,11 @@ bool multipass_compile_pass(multipass_shader_t *shader, int pass_index) {
     pass->is_compiled = true;
     
     /* Cache uniform locations for performance */
-    cache_uniform_locations(pass);
+    cache_uniform_locations(pass->program, &pass->uniforms, pass->name);
+    reflect_uniform_inputs(pass);
     
     /* Check if this shader uses textureLod (needs mipmaps) */
-    pass->needs_mipmaps = shader_uses_textureLod(pass->source);
+    pass->needs_mipmaps = pass->uses_texture_lod;
     if (pass->needs_mipmaps) {
         log_debug("Pass %s uses textureLod, will generate mipmaps", pass->name);
     }
@@ -1400,71 +2395,1075 @@ bool multipass_compile_pass(multipass_shader_t *shader, int pass_index) {
     return true;
 }
 
-bool multipass_compile_all(multipass_shader_t *shader) {
-    if (!shader) return false;
+/* Collect one build. Code that doesn't survive the Common split (e.g.
+ * functions defined by macros, which then exist in both objects) fails to
+ * link; that pass is rebuilt with Common embedded. */
+static bool collect_pass_build(multipass_shader_t *shader, pass_build_t *build) {
+    multipass_pass_t *pass = &shader->passes[build->index];
+
+    clear_error_log();
+    GLuint program = 0;
+    bool link_failed = false;
+    bool success = pass_build_end(build, &program, &link_failed);
+
+    if (!success && build->shared_common && link_failed) {
+        log_info("Pass %s doesn't link against the shared Common, embedding it", pass->name);
+        /* The other passes would fail the same way */
+        release_common_object(shader);
+        shader->common_object_failed = true;
+        clear_error_log();
+        if (pass_build_begin(shader, build, false, NULL)) {
+            success = pass_build_end(build, &program, &link_failed);
+        }
+    }
+
+    return complete_pass(shader, pass, success, program);
+}
+
+/* Issue the compile and link of a queued pass */
+static void submit_pass(multipass_shader_t *shader, int index) {
+    multipass_pass_t *pass = &shader->passes[index];
+    pass_build_t build = { .index = index };
+    pass->build_queued = false;
+
+    clear_error_log();
+    if (pass_build_begin(shader, &build, pass->build_shared_common, NULL)) {
+        pass->build_fragment = build.fragment;
+        pass->build_program = build.program;
+        pass->build_shared_common = build.shared_common;
+        pass->build_pending = true;
+    } else {
+        complete_pass(shader, pass, false, 0);
+        shader->builds_pending--;
+        shader->builds_failed++;
+    }
+}
+
+/* Delete the builds of a batch that won't be collected */
+static void cancel_builds(multipass_shader_t *shader) {
+    for (int i = 0; i < shader->pass_count; i++) {
+        multipass_pass_t *pass = &shader->passes[i];
+        pass->build_queued = false;
+        if (!pass->build_pending) continue;
+        glDeleteShader(pass->build_fragment);
+        glDeleteProgram(pass->build_program);
+        pass->build_fragment = 0;
+        pass->build_program = 0;
+        pass->build_pending = false;
+    }
+    shader->builds_pending = 0;
+}
+
+/*
+ * Start compiling several passes as one batch. A status query makes the
+ * driver finish that shader or program before it returns, so querying
+ * after every call serializes the whole build. Every compile and link is
+ * issued here and collect_builds gathers the results afterwards, which
+ * lets a threaded compiler build the passes side by side. With
+ * KHR_parallel_shader_compile the finished programs are collected first
+ * instead of waiting in pass order.
+ *
+ * Without that extension a submitted build can only be waited for, so a
+ * deferred batch (multipass_compile_begin) queues the passes instead and
+ * collect_builds submits them one per poll, keeping each poll short.
+ *
+ * The vertex shader and Common are compiled once per shader and linked
+ * into every pass program, so a pass compile only parses Common's
+ * declarations. Common's status is needed before the passes are wrapped,
+ * so it is built up front.
+ */
+static void submit_builds(multipass_shader_t *shader, const int *indices, int count, bool defer) {
+    cancel_builds(shader);
+    shader->builds_failed = 0;
+
+    for (int i = 0; i < count; i++) {
+        reset_pass(shader, indices[i]);
+    }
+
+    clear_error_log();
+    if (!shared_vertex_shader(shader)) {
+        for (int i = 0; i < count; i++) {
+            complete_pass(shader, &shader->passes[indices[i]], false, 0);
+        }
+        shader->builds_failed = count;
+        return;
+    }
+    uint64_t span = shader_trace_begin();
+    bool shared_common = ensure_common_object(shader);
+    shader_trace_end(span, SHADER_TRACE_COMPILE, "common object", NULL);
+
+    /* Issue every compile and link before asking for any result */
+    shader->builds_poll = parallel_compile_available();
+    for (int i = 0; i < count; i++) {
+        multipass_pass_t *pass = &shader->passes[indices[i]];
+        pass->build_shared_common = shared_common;
+        pass->build_queued = true;
+        shader->builds_pending++;
+        if (!defer || shader->builds_poll) {
+            submit_pass(shader, indices[i]);
+        }
+    }
+}
+
+/* Collect builds issued by submit_builds. Without wait only finished
+ * builds are taken when completion can be polled, otherwise one build is
+ * submitted if none is in flight and waited for. Returns the number still
+ * pending. */
+static int collect_builds(multipass_shader_t *shader, bool wait) {
+    bool in_flight = false;
+    for (int i = 0; i < shader->pass_count; i++) {
+        in_flight |= shader->passes[i].build_pending;
+    }
+    for (int i = 0; i < shader->pass_count; i++) {
+        if (!shader->passes[i].build_queued) continue;
+        if (!wait && in_flight) break;
+        submit_pass(shader, i);
+        in_flight = true;
+    }
+
+    while (shader->builds_pending > 0) {
+        int first = -1;
+        int next = -1;
+        for (int i = 0; i < shader->pass_count; i++) {
+            multipass_pass_t *pass = &shader->passes[i];
+            if (!pass->build_pending) continue;
+            if (first < 0) first = i;
+            if (!shader->builds_poll) break;
+
+            GLint done = GL_FALSE;
+            glGetProgramiv(pass->build_program, GL_COMPLETION_STATUS_KHR, &done);
+            if (done) {
+                next = i;
+                break;
+            }
+        }
+        if (next < 0 && (wait || !shader->builds_poll)) {
+            next = first;   /* Waited on: none is done yet */
+        }
+        if (next < 0) break;
+
+        multipass_pass_t *pass = &shader->passes[next];
+        pass_build_t build = {
+            .index = next,
+            .fragment = pass->build_fragment,
+            .program = pass->build_program,
+            .shared_common = pass->build_shared_common,
+            .name = pass->name
+        };
+        pass->build_fragment = 0;
+        pass->build_program = 0;
+        pass->build_pending = false;
+        shader->builds_pending--;
+
+        if (!collect_pass_build(shader, &build)) {
+            shader->builds_failed++;
+        }
+        if (!wait && !shader->builds_poll) break;
+    }
+
+    return shader->builds_pending;
+}
+
+/* Compile several passes and wait for them. Returns the number that failed. */
+static int compile_passes(multipass_shader_t *shader, const int *indices, int count) {
+    submit_builds(shader, indices, count, false);
+    collect_builds(shader, true);
+    return shader->builds_failed;
+}
+
+bool multipass_compile_pass(multipass_shader_t *shader, int pass_index) {
+    if (!shader || pass_index < 0 || pass_index >= shader->pass_count) {
+        return false;
+    }
+
+    return compile_passes(shader, &pass_index, 1) == 0;
+}
+
+static void estimate_cost(multipass_shader_t *shader);
+
+/* Work that depends on every pass's program, after any of them changed */
+static void finish_compile(multipass_shader_t *shader) {
+    /* Cache buffer pass indices for fast texture binding */
+    cache_channel_buffer_indices(shader);
+    
+    /* Work out what the output depends on (render-on-demand for static shaders) */
+    resolve_input_graph(shader);
+    
+    /* 
+     * Determine which buffer passes need mipmaps based on whether
+     * any pass that READS from them uses textureLod.
+     * This is more accurate than checking the buffer's own source.
+     */
+    for (int buf = 0; buf < shader->pass_count; buf++) {
+        multipass_pass_t *buf_pass = &shader->passes[buf];
+        if (buf_pass->type < PASS_TYPE_BUFFER_A || buf_pass->type > PASS_TYPE_BUFFER_D) {
+            continue;  /* Only check buffer passes */
+        }
+        
+        bool had_mipmaps = buf_pass->mip_chain_allocated;
+        buf_pass->needs_mipmaps = false;
+        buf_pass->mipmaps_dropped = false;
+        
+        /* Check all passes that might read from this buffer */
+        for (int reader = 0; reader < shader->pass_count; reader++) {
+            multipass_pass_t *reader_pass = &shader->passes[reader];
+            if (!reader_pass->source) continue;
+            
+            /* Check if this reader uses textureLod */
+            if (!reader_pass->uses_texture_lod) continue;
+            
+            /* Check if this reader reads from our buffer */
+            for (int c = 0; c < MULTIPASS_MAX_CHANNELS; c++) {
+                channel_source_t src = reader_pass->channels[c].source;
+                if (src == CHANNEL_SOURCE_BUFFER_A + (buf_pass->type - PASS_TYPE_BUFFER_A)) {
+                    buf_pass->needs_mipmaps = true;
+                    log_debug("Buffer %s needs mipmaps: read by %s via iChannel%d",
+                              buf_pass->name, reader_pass->name, c);
+                    break;
+                }
+            }
+            if (buf_pass->needs_mipmaps) break;
+        }
+
+        /* Add the mip chain (and filter), or drop one no reader wants any more */
+        if (buf_pass->fbo && buf_pass->width > 0 && buf_pass->needs_mipmaps != had_mipmaps) {
+            pass_alloc_textures(buf_pass);
+        }
+    }
+
+    /* Mip chains may have changed what the VRAM budget allows */
+    shader->vram_planned = false;
+
+    /* Predict the cost from the sources (and the starting scale, before the first frame) */
+    estimate_cost(shader);
+}
+
+bool multipass_compile_all(multipass_shader_t *shader) {
+    if (!multipass_compile_begin(shader)) return false;
+    return multipass_compile_poll(shader, true) == MULTIPASS_COMPILE_SUCCEEDED;
+}
+
+bool multipass_compile_begin(multipass_shader_t *shader) {
+    if (!shader) return false;
+
+    int indices[MULTIPASS_MAX_PASSES];
+    for (int i = 0; i < shader->pass_count; i++) {
+        indices[i] = i;
+    }
+    submit_builds(shader, indices, shader->pass_count, true);
+    shader->compile_in_flight = true;
+    return true;
+}
+
+multipass_compile_status_t multipass_compile_poll(multipass_shader_t *shader, bool wait) {
+    if (!shader) return MULTIPASS_COMPILE_FAILED;
+
+    if (shader->compile_in_flight) {
+        if (collect_builds(shader, wait) > 0) return MULTIPASS_COMPILE_PENDING;
+        shader->compile_in_flight = false;
+        finish_compile(shader);
+    }
+    return shader->builds_failed == 0 ? MULTIPASS_COMPILE_SUCCEEDED : MULTIPASS_COMPILE_FAILED;
+}
+
+void multipass_set_include_context(multipass_shader_t *shader, const char *base_dir, int owner) {
+    if (!shader) return;
+
+    free(shader->include_dir);
+    shader->include_dir = base_dir ? str_dup(base_dir) : NULL;
+    shader->include_owner = owner;
+}
+
+void multipass_set_source_optimization(multipass_shader_t *shader, bool enabled) {
+    if (!shader) return;
+    shader->optimize_source = enabled;
+}
+
+static bool include_set_stale(const multipass_include_set_t *set) {
+    for (int i = 0; i < set->count; i++) {
+        const shader_include_module_t *module = shader_include_get(set->ids[i]);
+        if (!module || module->generation != set->generations[i]) return true;
+    }
+    return false;
+}
+
+bool multipass_includes_stale(const multipass_shader_t *shader) {
+    if (!shader) return false;
+
+    for (int i = 0; i < shader->pass_count; i++) {
+        if (include_set_stale(&shader->passes[i].includes)) return true;
+    }
+    return false;
+}
+
+int multipass_refresh_includes(multipass_shader_t *shader) {
+    if (!shader) return 0;
+
+    /* Every pass links Common, so they all see its modules as stale too */
+    if (include_set_stale(&shader->common_includes)) {
+        release_common_object(shader);
+    }
+
+    int stale[MULTIPASS_MAX_PASSES];
+    int recompiled = 0;
+    for (int i = 0; i < shader->pass_count; i++) {
+        if (include_set_stale(&shader->passes[i].includes)) {
+            stale[recompiled++] = i;
+        }
+    }
+
+    if (recompiled > 0) {
+        compile_passes(shader, stale, recompiled);
+        finish_compile(shader);
+        log_info("Recompiled %d of %d passes after an included file changed",
+                 recompiled, shader->pass_count);
+    }
+    return recompiled;
+}
+
+/* ============================================
+ * Specialized variants
+ * ============================================ */
+
+/* iMouse as Shadertoy defines it: click position only while pressed */
+static void mouse_value(float mouse_x, float mouse_y, bool mouse_click, float value[4]) {
+    value[0] = mouse_x;
+    value[1] = mouse_y;
+    value[2] = mouse_click ? mouse_x : 0.0f;
+    value[3] = mouse_click ? mouse_y : 0.0f;
+}
+
+/* iDate: year, month, day, seconds since midnight */
+static bool date_value(float value[4]) {
+    time_t t = time(NULL);
+    struct tm *tm_info = localtime(&t);
+    if (!tm_info) return false;
+
+    value[0] = (float)(tm_info->tm_year + 1900);
+    value[1] = (float)(tm_info->tm_mon + 1);
+    value[2] = (float)tm_info->tm_mday;
+    value[3] = (float)(tm_info->tm_hour * 3600 + tm_info->tm_min * 60 + tm_info->tm_sec);
+    return true;
+}
+
+static void release_variant(multipass_variant_t *variant) {
+    if (variant->program) glDeleteProgram(variant->program);
+    if (variant->build_program) glDeleteProgram(variant->build_program);
+    if (variant->build_fragment) glDeleteShader(variant->build_fragment);
+    memset(variant, 0, sizeof(*variant));
+}
+
+static void release_variants(multipass_pass_t *pass) {
+    for (int v = 0; v < MULTIPASS_MAX_VARIANTS; v++) {
+        if (pass->variants[v].used) release_variant(&pass->variants[v]);
+    }
+    pass->active_variant = NULL;
+}
+
+/* Specialized inputs a pass reads. iResolution only while the scale is
+ * fixed: the adaptive controller would keep asking for new variants. */
+static unsigned int pass_specialized_inputs(const multipass_shader_t *shader,
+                                            const multipass_pass_t *pass) {
+    unsigned int inputs = shader->specialize_inputs & pass->uniform_inputs;
+    if (shader->adaptive_resolution) {
+        inputs &= ~MULTIPASS_INPUT_RESOLUTION;
+    }
+    return inputs;
+}
+
+/* The constants a pass would be specialized for this frame. False when it
+ * reads none of the specialized inputs or its size hasn't settled yet. */
+static bool pass_constants(const multipass_shader_t *shader, const multipass_pass_t *pass,
+                           multipass_constants_t *constants) {
+    memset(constants, 0, sizeof(*constants));
+    constants->inputs = pass_specialized_inputs(shader, pass);
+
+    /* Mouse and date are only baked once their value is captured */
+    constants->inputs &= MULTIPASS_INPUT_RESOLUTION | shader->frozen_inputs;
+    if (!constants->inputs) return false;
+
+    if (constants->inputs & MULTIPASS_INPUT_RESOLUTION) {
+        if (pass->settled_frames < MULTIPASS_SPECIALIZE_SETTLE_FRAMES) return false;
+        constants->resolution[0] = (float)pass->width;
+        constants->resolution[1] = (float)pass->height;
+        constants->resolution[2] = (float)pass->width / (float)pass->height;
+    }
+    if (constants->inputs & MULTIPASS_INPUT_MOUSE) {
+        memcpy(constants->mouse, shader->frozen_mouse, sizeof(constants->mouse));
+    }
+    if (constants->inputs & MULTIPASS_INPUT_DATE) {
+        memcpy(constants->date, shader->frozen_date, sizeof(constants->date));
+    }
+    return true;
+}
+
+/* Slot of the variant built for constants, -1 if there is none */
+static int find_variant(const multipass_pass_t *pass, const multipass_constants_t *constants) {
+    for (int v = 0; v < MULTIPASS_MAX_VARIANTS; v++) {
+        const multipass_variant_t *variant = &pass->variants[v];
+        if (variant->used && memcmp(&variant->constants, constants, sizeof(*constants)) == 0) {
+            return v;
+        }
+    }
+    return -1;
+}
+
+/* Take over a variant's finished build */
+static void finish_variant(const multipass_pass_t *pass, multipass_variant_t *variant) {
+    pass_build_t build = {
+        .fragment = variant->build_fragment,
+        .program = variant->build_program
+    };
+    variant->build_fragment = 0;
+    variant->build_program = 0;
+
+    GLuint program = 0;
+    bool link_failed = false;
+    clear_error_log();
+    if (pass_build_end(&build, &program, &link_failed)) {
+        variant->program = program;
+        cache_uniform_locations(program, &variant->uniforms, pass->name);
+        log_info("Specialized %s ready (program=%u)", pass->name, program);
+    } else {
+        /* Not the user's error: the generic program renders it fine */
+        variant->failed = true;
+        log_info("Specialized %s didn't build, keeping the generic program", pass->name);
+    }
+    clear_error_log();
+}
+
+/* Take a free slot or the least recently used one for a new variant */
+static multipass_variant_t *claim_variant(multipass_pass_t *pass,
+                                          const multipass_constants_t *constants) {
+    multipass_variant_t *variant = &pass->variants[0];
+    for (int v = 0; v < MULTIPASS_MAX_VARIANTS; v++) {
+        if (!pass->variants[v].used) {
+            variant = &pass->variants[v];
+            break;
+        }
+        if (pass->variants[v].last_used < variant->last_used) {
+            variant = &pass->variants[v];
+        }
+    }
+    release_variant(variant);
+    variant->used = true;
+    variant->constants = *constants;
+    return variant;
+}
+
+/* Start building a claimed variant. Without KHR_parallel_shader_compile
+ * the build is waited for right away. */
+static void build_variant(multipass_shader_t *shader, int pass_index, multipass_variant_t *variant) {
+    multipass_pass_t *pass = &shader->passes[pass_index];
+    const multipass_constants_t *constants = &variant->constants;
+
+    log_info("Specializing %s for%s%s%s", pass->name,
+             (constants->inputs & MULTIPASS_INPUT_RESOLUTION) ? " resolution" : "",
+             (constants->inputs & MULTIPASS_INPUT_MOUSE) ? " mouse" : "",
+             (constants->inputs & MULTIPASS_INPUT_DATE) ? " date" : "");
+
+    /* Common is embedded: a shared Common object would still read the uniforms */
+    pass_build_t build = { .index = pass_index };
+    clear_error_log();
+    if (!pass_build_begin(shader, &build, false, constants)) {
+        variant->failed = true;
+        clear_error_log();
+        return;
+    }
+    variant->build_fragment = build.fragment;
+    variant->build_program = build.program;
+
+    if (!parallel_compile_available()) {
+        finish_variant(pass, variant);
+    }
+}
+
+/* Pick the program a pass renders with this frame */
+static void select_variant(multipass_shader_t *shader, int pass_index) {
+    multipass_pass_t *pass = &shader->passes[pass_index];
+    pass->active_variant = NULL;
+
+    if (pass->width != pass->settled_width || pass->height != pass->settled_height) {
+        pass->settled_width = pass->width;
+        pass->settled_height = pass->height;
+        pass->settled_frames = 0;
+    } else if (pass->settled_frames < MULTIPASS_SPECIALIZE_SETTLE_FRAMES) {
+        pass->settled_frames++;
+    }
+
+    multipass_constants_t constants;
+    if (!pass_constants(shader, pass, &constants)) return;
+
+    int slot = find_variant(pass, &constants);
+    multipass_variant_t *variant = (slot >= 0) ? &pass->variants[slot] : NULL;
+    if (!variant) {
+        /* Never wait for a compile here: without background compiles the
+         * build is left to multipass_build_variants */
+        variant = claim_variant(pass, &constants);
+        if (parallel_compile_available()) {
+            build_variant(shader, pass_index, variant);
+        } else {
+            variant->queued = true;
+        }
+    }
+    variant->last_used = shader->frame_count;
+
+    /* Still compiling in the background: the generic program renders meanwhile */
+    if (variant->build_program) {
+        GLint done = GL_FALSE;
+        glGetProgramiv(variant->build_program, GL_COMPLETION_STATUS_KHR, &done);
+        if (!done) return;
+        finish_variant(pass, variant);
+    }
+
+    if (variant->program) {
+        pass->active_variant = variant;
+    }
+}
+
+static GLuint pass_program(const multipass_pass_t *pass) {
+    return pass->active_variant ? pass->active_variant->program : pass->program;
+}
+
+void multipass_set_specialization(multipass_shader_t *shader, unsigned int inputs) {
+    if (!shader) return;
+
+    inputs &= MULTIPASS_INPUT_SPECIALIZABLE;
+    if (inputs == shader->specialize_inputs) return;
+
+    /* Buffers rendered with the frozen mouse catch up with the real one */
+    if ((shader->frozen_inputs & MULTIPASS_INPUT_MOUSE) && !(inputs & MULTIPASS_INPUT_MOUSE)) {
+        for (int i = 0; i < shader->pass_count; i++) {
+            if (shader->passes[i].input_mask & MULTIPASS_INPUT_MOUSE) {
+                shader->passes[i].output_valid = false;
+            }
+        }
+    }
+
+    /* Re-enabled inputs are captured again in the next frame */
+    shader->specialize_inputs = inputs;
+    shader->frozen_inputs &= inputs;
+
+    log_info("Specialization:%s%s%s%s",
+             (inputs & MULTIPASS_INPUT_RESOLUTION) ? " resolution" : "",
+             (inputs & MULTIPASS_INPUT_MOUSE) ? " mouse" : "",
+             (inputs & MULTIPASS_INPUT_DATE) ? " date" : "",
+             inputs ? "" : " off");
+}
+
+bool multipass_specialization_pending(const multipass_shader_t *shader) {
+    if (!shader) return false;
+
+    for (int i = 0; i < shader->pass_count; i++) {
+        const multipass_pass_t *pass = &shader->passes[i];
+        if (!pass->is_compiled || pass->invariant) continue;
+        unsigned int inputs = pass_specialized_inputs(shader, pass);
+        if (!inputs) continue;
+
+        /* Size not settled or mouse/date not captured yet */
+        multipass_constants_t constants;
+        if (!pass_constants(shader, pass, &constants) || constants.inputs != inputs) return true;
+
+        int slot = find_variant(pass, &constants);
+        if (slot < 0 || pass->variants[slot].build_program || pass->variants[slot].queued) return true;
+    }
+    return false;
+}
+
+bool multipass_build_variants(multipass_shader_t *shader) {
+    if (!shader) return false;
+
+    bool built = false;
+    for (int i = 0; i < shader->pass_count; i++) {
+        multipass_pass_t *pass = &shader->passes[i];
+        for (int v = 0; v < MULTIPASS_MAX_VARIANTS; v++) {
+            multipass_variant_t *variant = &pass->variants[v];
+            if (!variant->used || !variant->queued) continue;
+            if (built) return true;
+
+            variant->queued = false;
+            build_variant(shader, i, variant);
+            built = true;
+        }
+    }
+    return false;
+}
+
+/* ============================================
+ * Output Reconstruction
+ * ============================================ */
+
+/* Radical inverse - Halton low-discrepancy sequence for sub-pixel jitter */
+static float halton(int index, int base) {
+    float f = 1.0f;
+    float r = 0.0f;
+    while (index > 0) {
+        f /= (float)base;
+        r += f * (float)(index % base);
+        index /= base;
+    }
+    return r;
+}
+
+static bool reconstruct_active(const multipass_shader_t *shader) {
+    return shader->reconstruct.active;
+}
+
+/* Drop offscreen targets only - resolve programs stay compiled */
+static void reconstruct_release_targets(multipass_shader_t *shader) {
+    multipass_reconstruct_t *r = &shader->reconstruct;
+
+    if (r->image_fbo) glDeleteFramebuffers(1, &r->image_fbo);
+    if (r->history_fbo) glDeleteFramebuffers(1, &r->history_fbo);
+    if (r->image_texture) glDeleteTextures(1, &r->image_texture);
+    if (r->history_textures[0]) glDeleteTextures(2, r->history_textures);
+
+    r->active = false;
+    r->image_fbo = 0;
+    r->history_fbo = 0;
+    r->image_texture = 0;
+    r->history_textures[0] = 0;
+    r->history_textures[1] = 0;
+    r->render_width = 0;
+    r->render_height = 0;
+    r->output_width = 0;
+    r->output_height = 0;
+    r->history_valid = false;
+    shader->reconstruct_vram_bytes = 0;
+}
+
+static void reconstruct_release(multipass_shader_t *shader) {
+    multipass_reconstruct_t *r = &shader->reconstruct;
+
+    if (r->program) glDeleteProgram(r->program);
+    if (r->spatial_program) glDeleteProgram(r->spatial_program);
+    r->program = 0;
+    r->spatial_program = 0;
+
+    reconstruct_release_targets(shader);
+}
+
+static void reconstruct_alloc_texture(GLuint tex, int width, int height, GLint filter) {
+    glBindTexture(GL_TEXTURE_2D, tex);
+    /* RGBA8 matches what the Image pass would write to the screen (clamped) */
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0,
+                 GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
+
+/* Compile the resolve program needed by the current mode (once) */
+static bool reconstruct_ensure_program(multipass_shader_t *shader) {
+    multipass_reconstruct_t *r = &shader->reconstruct;
+    GLuint vertex_shader = shared_vertex_shader(shader);
+    if (!vertex_shader) return false;
+
+    if (r->mode == MULTIPASS_RECONSTRUCT_SPATIAL) {
+        if (r->spatial_program) return true;
+        if (!create_program(vertex_shader, spatial_fragment_shader, &r->spatial_program)) {
+            return false;
+        }
+        r->u_spatial_source = glGetUniformLocation(r->spatial_program, "uSource");
+        r->u_spatial_output_size = glGetUniformLocation(r->spatial_program, "uOutputSize");
+        r->u_spatial_sharpness = glGetUniformLocation(r->spatial_program, "uSharpness");
+        return true;
+    }
+
+    if (r->program) return true;
+    if (!create_program(vertex_shader, reconstruct_fragment_shader, &r->program)) {
+        return false;
+    }
+    r->u_current = glGetUniformLocation(r->program, "uCurrent");
+    r->u_history = glGetUniformLocation(r->program, "uHistory");
+    r->u_mode = glGetUniformLocation(r->program, "uMode");
+    r->u_phase = glGetUniformLocation(r->program, "uPhase");
+    r->u_history_valid = glGetUniformLocation(r->program, "uHistoryValid");
+    r->u_jitter = glGetUniformLocation(r->program, "uJitter");
+    r->u_output_size = glGetUniformLocation(r->program, "uOutputSize");
+    return true;
+}
+
+/*
+ * Make sure the resolve program and render targets exist and match the
+ * Image pass size, then pick this frame's jitter.
+ * Returns false if the Image pass should render natively this frame.
+ */
+static bool reconstruct_prepare(multipass_shader_t *shader) {
+    multipass_reconstruct_t *r = &shader->reconstruct;
+
+    r->active = false;
+
+    if (r->mode == MULTIPASS_RECONSTRUCT_NONE || shader->image_pass_index < 0) {
+        /* Mode was switched off - drop targets now that a context is current */
+        if (r->image_fbo) reconstruct_release(shader);
+        return false;
+    }
+
+    if (!reconstruct_ensure_program(shader)) {
+        log_error("Reconstruction resolve shader failed to compile, disabling");
+        r->mode = MULTIPASS_RECONSTRUCT_NONE;
+        return false;
+    }
+
+    const multipass_pass_t *image = &shader->passes[shader->image_pass_index];
+    int out_w = image->width;
+    int out_h = image->height;
+    int render_w, render_h;
+
+    if (r->mode == MULTIPASS_RECONSTRUCT_CHECKERBOARD) {
+        render_w = (out_w + 1) / 2;
+        render_h = out_h;
+    } else if (r->mode == MULTIPASS_RECONSTRUCT_SPATIAL) {
+        /* Follow the buffer scaling path (multipass_resize / adaptive controller) */
+        render_w = shader->scaled_width;
+        render_h = shader->scaled_height;
+        if (render_w >= out_w && render_h >= out_h) {
+            return false;  /* Full resolution - nothing to upscale */
+        }
+    } else {
+        render_w = (int)(out_w * RECONSTRUCT_TEMPORAL_SCALE);
+        render_h = (int)(out_h * RECONSTRUCT_TEMPORAL_SCALE);
+    }
+    if (render_w < 1) render_w = 1;
+    if (render_h < 1) render_h = 1;
+
+    if (!r->image_fbo) {
+        glGenFramebuffers(1, &r->image_fbo);
+        glGenTextures(1, &r->image_texture);
+    }
+
+    if (r->render_width != render_w || r->render_height != render_h) {
+        reconstruct_alloc_texture(r->image_texture, render_w, render_h, GL_LINEAR);
+        glBindFramebuffer(GL_FRAMEBUFFER, r->image_fbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                               GL_TEXTURE_2D, r->image_texture, 0);
+        r->render_width = render_w;
+        r->render_height = render_h;
+        r->history_valid = false;
+        account_reconstruct(shader);
+    }
+
+    /* History is only needed by the temporal/checkerboard resolve */
+    if (r->mode != MULTIPASS_RECONSTRUCT_SPATIAL) {
+        if (!r->history_fbo) {
+            glGenFramebuffers(1, &r->history_fbo);
+            glGenTextures(2, r->history_textures);
+            r->output_width = 0;
+        }
+        if (r->output_width != out_w || r->output_height != out_h) {
+            for (int t = 0; t < 2; t++) {
+                reconstruct_alloc_texture(r->history_textures[t], out_w, out_h, GL_NEAREST);
+            }
+            r->history_valid = false;
+            log_info("Reconstruction targets: render %dx%d -> output %dx%d",
+                     render_w, render_h, out_w, out_h);
+        }
+    }
+    if (r->output_width != out_w || r->output_height != out_h) {
+        r->output_width = out_w;
+        r->output_height = out_h;
+        account_reconstruct(shader);
+    }
+
+    if (r->mode == MULTIPASS_RECONSTRUCT_TEMPORAL) {
+        int index = (shader->frame_count & 7) + 1;
+        r->jitter_x = halton(index, 2) - 0.5f;
+        r->jitter_y = halton(index, 3) - 0.5f;
+    } else {
+        r->jitter_x = 0.0f;
+        r->jitter_y = 0.0f;
+    }
+
+    r->active = true;
+    return true;
+}
+
+/* Single-pass edge-adaptive upscale + sharpen straight to the screen */
+static void reconstruct_upscale(multipass_shader_t *shader) {
+    multipass_reconstruct_t *r = &shader->reconstruct;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, shader->default_framebuffer);
+    glViewport(0, 0, r->output_width, r->output_height);
+
+    glUseProgram(r->spatial_program);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, r->image_texture);
+
+    if (r->u_spatial_source >= 0) glUniform1i(r->u_spatial_source, 0);
+    if (r->u_spatial_output_size >= 0) {
+        glUniform2f(r->u_spatial_output_size, (float)r->output_width, (float)r->output_height);
+    }
+    if (r->u_spatial_sharpness >= 0) {
+        glUniform1f(r->u_spatial_sharpness, RECONSTRUCT_SPATIAL_SHARPNESS);
+    }
+
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+}
+
+/* Resolve the low-res Image target into history, then blit it to the screen */
+static void reconstruct_resolve(multipass_shader_t *shader) {
+    multipass_reconstruct_t *r = &shader->reconstruct;
+
+    if (r->mode == MULTIPASS_RECONSTRUCT_SPATIAL) {
+        reconstruct_upscale(shader);
+        return;
+    }
+
+    int read_idx = r->history_index;
+    int write_idx = 1 - read_idx;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, r->history_fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                           GL_TEXTURE_2D, r->history_textures[write_idx], 0);
+    glViewport(0, 0, r->output_width, r->output_height);
+
+    glUseProgram(r->program);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, r->image_texture);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, r->history_textures[read_idx]);
+
+    if (r->u_current >= 0) glUniform1i(r->u_current, 0);
+    if (r->u_history >= 0) glUniform1i(r->u_history, 1);
+    if (r->u_mode >= 0) glUniform1i(r->u_mode, (int)r->mode);
+    if (r->u_phase >= 0) glUniform1i(r->u_phase, shader->frame_count & 1);
+    if (r->u_history_valid >= 0) glUniform1i(r->u_history_valid, r->history_valid ? 1 : 0);
+    if (r->u_jitter >= 0) glUniform2f(r->u_jitter, r->jitter_x, r->jitter_y);
+    if (r->u_output_size >= 0) {
+        glUniform2f(r->u_output_size, (float)r->output_width, (float)r->output_height);
+    }
+
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+    /* Present: copy the resolved frame to the default framebuffer */
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, r->history_fbo);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, shader->default_framebuffer);
+    glBlitFramebuffer(0, 0, r->output_width, r->output_height,
+                      0, 0, r->output_width, r->output_height,
+                      GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, shader->default_framebuffer);
+
+    r->history_index = write_idx;
+    r->history_valid = true;
+}
+
+void multipass_set_reconstruction(multipass_shader_t *shader,
+                                  multipass_reconstruct_mode_t mode) {
+    if (!shader) return;
+
+    if (shader->reconstruct.mode != mode) {
+        shader->reconstruct.mode = mode;
+        /* The previous mode's targets (history included) don't fit the new
+         * one; the next render allocates what this mode needs */
+        reconstruct_release_targets(shader);
+        shader->vram_planned = false;
+        log_info("Output reconstruction: %s",
+                 mode == MULTIPASS_RECONSTRUCT_CHECKERBOARD ? "checkerboard" :
+                 mode == MULTIPASS_RECONSTRUCT_TEMPORAL ? "temporal" :
+                 mode == MULTIPASS_RECONSTRUCT_SPATIAL ? "spatial upscale" : "off");
+    }
+}
+
+multipass_reconstruct_mode_t multipass_get_reconstruction(const multipass_shader_t *shader) {
+    return shader ? shader->reconstruct.mode : MULTIPASS_RECONSTRUCT_NONE;
+}
+
+/* ============================================
+ * VRAM Budget
+ * ============================================ */
+
+static float adaptive_min_scale(const multipass_shader_t *shader);
+
+/* Lowest scale the LOWER_SCALE and NO_MIPMAPS stages may cap to, relative to the requested scale */
+#define VRAM_STAGE_SCALE_FLOOR 0.5f
+
+/* Bytes the shader would hold at an output size, buffer scale, mip setting and buffer format */
+static size_t vram_predict(const multipass_shader_t *shader, int width, int height,
+                           float scale, bool mipmaps, GLenum format) {
+    int scaled_w = (int)(width * scale);
+    int scaled_h = (int)(height * scale);
+    if (scaled_w < 1) scaled_w = 1;
+    if (scaled_h < 1) scaled_h = 1;
+
+    size_t bytes = shader->shared_vram_bytes;
+    for (int i = 0; i < shader->pass_count; i++) {
+        const multipass_pass_t *pass = &shader->passes[i];
+        if (!pass->fbo) continue;
+        bool chain = mipmaps && (pass->needs_mipmaps || pass->mipmaps_dropped);
+        bytes += 2 * texture_bytes(format, scaled_w, scaled_h, chain);
+    }
+
+    /* Reconstruction targets, sized as reconstruct_prepare() will size them */
+    if (shader->image_pass_index >= 0) {
+        switch (shader->reconstruct.mode) {
+        case MULTIPASS_RECONSTRUCT_CHECKERBOARD:
+            bytes += texture_bytes(GL_RGBA8, (width + 1) / 2, height, false) +
+                     2 * texture_bytes(GL_RGBA8, width, height, false);
+            break;
+        case MULTIPASS_RECONSTRUCT_TEMPORAL:
+            bytes += texture_bytes(GL_RGBA8, (int)(width * RECONSTRUCT_TEMPORAL_SCALE),
+                                   (int)(height * RECONSTRUCT_TEMPORAL_SCALE), false) +
+                     2 * texture_bytes(GL_RGBA8, width, height, false);
+            break;
+        case MULTIPASS_RECONSTRUCT_SPATIAL:
+            if (scaled_w < width || scaled_h < height) {
+                bytes += texture_bytes(GL_RGBA8, scaled_w, scaled_h, false);
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    return bytes;
+}
+
+/* Largest scale in [low, high] that fits the budget (low if none does) */
+static float vram_fit_scale(const multipass_shader_t *shader, int width, int height,
+                            float low, float high, bool mipmaps, GLenum format) {
+    if (vram_predict(shader, width, height, high, mipmaps, format) <= shader->vram_budget) {
+        return high;
+    }
+    /* Bytes grow with scale^2, so a short bisection is plenty */
+    for (int i = 0; i < 16; i++) {
+        float mid = 0.5f * (low + high);
+        if (vram_predict(shader, width, height, mid, mipmaps, format) <= shader->vram_budget) {
+            low = mid;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+/*
+ * Pick the mildest degradation stage whose render targets fit the budget
+ * at this output size, and mark the buffers whose storage has to change
+ * so multipass_resize reallocates them.
+ */
+static void vram_apply_budget(multipass_shader_t *shader, int width, int height) {
+    if (shader->vram_planned &&
+        shader->vram_plan_width == width && shader->vram_plan_height == height) {
+        return;
+    }
+    shader->vram_planned = true;
+    shader->vram_plan_width = width;
+    shader->vram_plan_height = height;
+
+    /* The controller may go up to its maximum; a manual scale is what was set */
+    float requested = shader->adaptive_resolution ? shader->max_resolution_scale :
+                                                    shader->resolution_scale;
+    float floor_scale = adaptive_min_scale(shader);
+    if (floor_scale > requested) floor_scale = requested;
+    float stage_floor = requested * VRAM_STAGE_SCALE_FLOOR;
+    if (stage_floor < floor_scale) stage_floor = floor_scale;
+
+    bool wants_mipmaps = false;
+    for (int i = 0; i < shader->pass_count; i++) {
+        const multipass_pass_t *pass = &shader->passes[i];
+        if (pass->fbo && (pass->needs_mipmaps || pass->mipmaps_dropped)) wants_mipmaps = true;
+    }
+
+    multipass_vram_stage_t stage = MULTIPASS_VRAM_FULL;
+    float max_scale = 2.0f;
+    bool over = false;
+
+    if (shader->vram_budget > 0 &&
+        vram_predict(shader, width, height, requested, true, GL_RGBA16F) > shader->vram_budget) {
+        if (vram_predict(shader, width, height, stage_floor, true, GL_RGBA16F) <= shader->vram_budget) {
+            stage = MULTIPASS_VRAM_LOWER_SCALE;
+            max_scale = vram_fit_scale(shader, width, height, stage_floor, requested,
+                                       true, GL_RGBA16F);
+        } else if (wants_mipmaps &&
+                   vram_predict(shader, width, height, stage_floor, false, GL_RGBA16F) <=
+                   shader->vram_budget) {
+            stage = MULTIPASS_VRAM_NO_MIPMAPS;
+            max_scale = vram_fit_scale(shader, width, height, stage_floor, requested,
+                                       false, GL_RGBA16F);
+        } else {
+            stage = MULTIPASS_VRAM_CHEAP_FORMATS;
+            max_scale = vram_fit_scale(shader, width, height, floor_scale, requested,
+                                       false, GL_RGBA8);
+            over = vram_predict(shader, width, height, max_scale, false, GL_RGBA8) >
+                   shader->vram_budget;
+        }
+    }
 
-    bool all_success = true;
+    if (stage != shader->vram_stage || over != shader->vram_over_budget) {
+        if (over) {
+            log_warn("VRAM budget %.1f MB: still %.1f MB with every degradation at %dx%d",
+                     shader->vram_budget / (1024.0 * 1024.0),
+                     vram_predict(shader, width, height, max_scale, false, GL_RGBA8) /
+                     (1024.0 * 1024.0), width, height);
+        } else if (shader->vram_budget > 0) {
+            log_info("VRAM budget %.1f MB at %dx%d: %s, buffer scale up to %.0f%%",
+                     shader->vram_budget / (1024.0 * 1024.0), width, height,
+                     multipass_vram_stage_name(stage),
+                     (max_scale < requested ? max_scale : requested) * 100.0f);
+        }
+    }
+    shader->vram_stage = stage;
+    shader->vram_over_budget = over;
+    shader->vram_max_scale = max_scale;
+
+    /* The controller keeps its own scale under the cap, so its cost model
+     * sees the scale that was actually rendered */
+    if (shader->adaptive_resolution) {
+        if (shader->resolution_scale > max_scale) shader->resolution_scale = max_scale;
+        if (shader->target_resolution_scale > max_scale) shader->target_resolution_scale = max_scale;
+    }
 
     for (int i = 0; i < shader->pass_count; i++) {
-        if (!multipass_compile_pass(shader, i)) {
-            all_success = false;
+        multipass_pass_t *pass = &shader->passes[i];
+        if (!pass->fbo) continue;
+
+        bool wants = pass->needs_mipmaps || pass->mipmaps_dropped;
+        bool keep = wants && stage < MULTIPASS_VRAM_NO_MIPMAPS;
+        GLenum format = (stage >= MULTIPASS_VRAM_CHEAP_FORMATS) ? GL_RGBA8 : GL_RGBA16F;
+
+        if (keep != pass->needs_mipmaps || format != pass->texture_format) {
+            pass->needs_mipmaps = keep;
+            pass->mipmaps_dropped = wants && !keep;
+            pass->texture_format = format;
+            /* Zero size makes multipass_resize reallocate it */
+            pass->width = 0;
+            pass->height = 0;
         }
     }
-    
-    /* Cache buffer pass indices for fast texture binding */
-    cache_channel_buffer_indices(shader);
-    
-    /* 
-     * Determine which buffer passes need mipmaps based on whether
-     * any pass that READS from them uses textureLod.
-     * This is more accurate than checking the buffer's own source.
-     */
-    for (int buf = 0; buf < shader->pass_count; buf++) {
-        multipass_pass_t *buf_pass = &shader->passes[buf];
-        if (buf_pass->type < PASS_TYPE_BUFFER_A || buf_pass->type > PASS_TYPE_BUFFER_D) {
-            continue;  /* Only check buffer passes */
-        }
-        
-        buf_pass->needs_mipmaps = false;
-        
-        /* Check all passes that might read from this buffer */
-        for (int reader = 0; reader < shader->pass_count; reader++) {
-            multipass_pass_t *reader_pass = &shader->passes[reader];
-            if (!reader_pass->source) continue;
-            
-            /* Check if this reader uses textureLod */
-            if (!shader_uses_textureLod(reader_pass->source)) continue;
-            
-            /* Check if this reader reads from our buffer */
-            for (int c = 0; c < MULTIPASS_MAX_CHANNELS; c++) {
-                channel_source_t src = reader_pass->channels[c].source;
-                if (src == CHANNEL_SOURCE_BUFFER_A + (buf_pass->type - PASS_TYPE_BUFFER_A)) {
-                    buf_pass->needs_mipmaps = true;
-                    log_debug("Buffer %s needs mipmaps: read by %s via iChannel%d",
-                              buf_pass->name, reader_pass->name, c);
-                    
-                    /* Upgrade texture filter to support mipmaps */
-                    for (int t = 0; t < 2; t++) {
-                        glBindTexture(GL_TEXTURE_2D, buf_pass->textures[t]);
-                        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-                        glGenerateMipmap(GL_TEXTURE_2D);
-                    }
-                    break;
-                }
-            }
-            if (buf_pass->needs_mipmaps) break;
-        }
+
+    /* Force the size check below to run */
+    shader->scaled_width = 0;
+    shader->scaled_height = 0;
+}
+
+const char *multipass_vram_stage_name(multipass_vram_stage_t stage) {
+    switch (stage) {
+    case MULTIPASS_VRAM_FULL:          return "full quality";
+    case MULTIPASS_VRAM_LOWER_SCALE:   return "lower scale";
+    case MULTIPASS_VRAM_NO_MIPMAPS:    return "no mipmaps";
+    case MULTIPASS_VRAM_CHEAP_FORMATS: return "RGBA8 buffers";
     }
+    return "unknown";
+}
+
+void multipass_set_vram_budget(multipass_shader_t *shader, size_t bytes) {
+    if (!shader || shader->vram_budget == bytes) return;
 
-    return all_success;
+    shader->vram_budget = bytes;
+    shader->vram_planned = false;
 }
 
 void multipass_resize(multipass_shader_t *shader, int width, int height) {
     if (!shader || !shader->is_initialized) return;
 
+    /* Degrade (or restore) to fit the VRAM budget when the size or settings changed */
+    vram_apply_budget(shader, width, height);
+
     /* Calculate scaled resolution for buffer passes */
-    int scaled_w = (int)(width * shader->resolution_scale);
-    int scaled_h = (int)(height * shader->resolution_scale);
+    float scale = effective_scale(shader);
+    int scaled_w = (int)(width * scale);
+    int scaled_h = (int)(height * scale);
     if (scaled_w < 1) scaled_w = 1;
     if (scaled_h < 1) scaled_h = 1;
 
@@ -1483,7 +3482,10 @@ void multipass_resize(multipass_shader_t *shader, int width, int height) {
     for (int i = 0; i < shader->pass_count; i++) {
         multipass_pass_t *pass = &shader->passes[i];
 
-        /* Buffer passes use scaled resolution, Image pass uses full resolution */
+        /* Buffer passes use scaled resolution, Image pass uses full resolution
+         * (with spatial reconstruction the Image pass still reports the full
+         * size as iResolution but shades at scaled_width x scaled_height -
+         * the offscreen target follows scaled_* in reconstruct_prepare) */
         int target_w, target_h;
         if (pass->type >= PASS_TYPE_BUFFER_A && pass->type <= PASS_TYPE_BUFFER_D) {
             target_w = scaled_w;
@@ -1500,31 +3502,54 @@ void multipass_resize(multipass_shader_t *shader, int width, int height) {
         pass->width = target_w;
         pass->height = target_h;
 
-        /* Resize buffer textures */
-        if (pass->type >= PASS_TYPE_BUFFER_A && pass->type <= PASS_TYPE_BUFFER_D) {
-            for (int t = 0; t < 2; t++) {
-                glBindTexture(GL_TEXTURE_2D, pass->textures[t]);
-                /* Use GL_RGBA16F for HDR bloom support - matches init */
-                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, target_w, target_h, 0,
-                            GL_RGBA, GL_HALF_FLOAT, NULL);
-                /* Only regenerate mipmaps if this buffer needs them */
-                if (pass->needs_mipmaps) {
-                    glGenerateMipmap(GL_TEXTURE_2D);
-                }
-            }
-            pass->needs_clear = true;
+        /* Resize buffer textures (format and mip chain as init / the VRAM budget chose) */
+        if (pass->fbo) {
+            pass_alloc_textures(pass);
+        }
+    }
+}
+
+void multipass_release_render_targets(multipass_shader_t *shader) {
+    if (!shader || !shader->is_initialized) return;
+
+    for (int i = 0; i < shader->pass_count; i++) {
+        multipass_pass_t *pass = &shader->passes[i];
+
+        /* Shrink buffer storage to a single texel (a mip chain is dropped
+         * with it); the FBO stays valid. The texel isn't counted. */
+        if (pass->fbo) {
+            pass->width = 1;
+            pass->height = 1;
+            pass_alloc_textures(pass);
+            pass->vram_bytes = 0;
+            pass->ping_pong_index = 0;
+            pass->output_valid = false;
         }
+
+        /* Zero size makes the next multipass_resize reallocate everything */
+        pass->width = 0;
+        pass->height = 0;
     }
+
+    shader->scaled_width = 0;
+    shader->scaled_height = 0;
+    reconstruct_release_targets(shader);
+
+    log_debug("Released render targets (programs kept)");
 }
 
 void multipass_destroy(multipass_shader_t *shader) {
     if (!shader) return;
 
+    /* Drop a compile still in flight */
+    cancel_builds(shader);
+
     /* Delete passes */
     for (int i = 0; i < shader->pass_count; i++) {
         multipass_pass_t *pass = &shader->passes[i];
 
         if (pass->program) glDeleteProgram(pass->program);
+        release_variants(pass);
         if (pass->fbo) glDeleteFramebuffers(1, &pass->fbo);
         if (pass->textures[0]) glDeleteTextures(2, pass->textures);
 
@@ -1540,8 +3565,17 @@ void multipass_destroy(multipass_shader_t *shader) {
 #endif
     if (shader->noise_texture) glDeleteTextures(1, &shader->noise_texture);
     if (shader->keyboard_texture) glDeleteTextures(1, &shader->keyboard_texture);
+    if (shader->gpu_timers_supported) {
+        glDeleteQueries(MULTIPASS_TIMER_FRAMES * MULTIPASS_TIMER_SLOTS, &shader->timer_queries[0][0]);
+    }
+    reconstruct_release(shader);
+
+    if (shader->vertex_shader) glDeleteShader(shader->vertex_shader);
+    release_common_object(shader);
 
     free(shader->common_source);
+    glsl_token_stream_free(shader->common_tokens);
+    free(shader->include_dir);
     free(shader);
 }
 
@@ -1559,10 +3593,11 @@ void multipass_set_uniforms(multipass_shader_t *shader,
     multipass_pass_t *pass = &shader->passes[pass_index];
     if (!pass->program) return;
 
-    glUseProgram(pass->program);
+    glUseProgram(pass_program(pass));
 
-    /* Use cached uniform locations for performance */
-    const uniform_locations_t *u = &pass->uniforms;
+    /* Use cached uniform locations for performance (baked inputs have none) */
+    const uniform_locations_t *u = pass->active_variant ? &pass->active_variant->uniforms
+                                                        : &pass->uniforms;
 
     /* Time uniforms */
     if (u->iTime >= 0) glUniform1f(u->iTime, shader_time);
@@ -1577,27 +3612,24 @@ void multipass_set_uniforms(multipass_shader_t *shader,
         glUniform3f(u->iResolution, w, h, w / h);
     }
 
-    /* Mouse */
+    /* Mouse - frozen while specialized, also before the variant is ready */
     if (u->iMouse >= 0) {
-        float click_x = mouse_click ? mouse_x : 0.0f;
-        float click_y = mouse_click ? mouse_y : 0.0f;
-        glUniform4f(u->iMouse, mouse_x, mouse_y, click_x, click_y);
+        float mouse[4];
+        if (shader->frozen_inputs & MULTIPASS_INPUT_MOUSE) {
+            memcpy(mouse, shader->frozen_mouse, sizeof(mouse));
+        } else {
+            mouse_value(mouse_x, mouse_y, mouse_click, mouse);
+        }
+        glUniform4fv(u->iMouse, 1, mouse);
     }
 
     /* Date - only update if uniform is used (avoid syscall overhead) */
     if (u->iDate >= 0) {
-        /* Cache date info - only update once per second would be even better,
-         * but for now just use the cached location */
-        time_t t = time(NULL);
-        struct tm *tm_info = localtime(&t);
-        if (tm_info) {
-            float year = (float)(tm_info->tm_year + 1900);
-            float month = (float)(tm_info->tm_mon + 1);
-            float day = (float)tm_info->tm_mday;
-            float seconds = (float)(tm_info->tm_hour * 3600 +
-                                    tm_info->tm_min * 60 +
-                                    tm_info->tm_sec);
-            glUniform4f(u->iDate, year, month, day, seconds);
+        float date[4];
+        if (shader->frozen_inputs & MULTIPASS_INPUT_DATE) {
+            glUniform4fv(u->iDate, 1, shader->frozen_date);
+        } else if (date_value(date)) {
+            glUniform4fv(u->iDate, 1, date);
         }
     }
 
@@ -1613,6 +3645,23 @@ void multipass_set_uniforms(multipass_shader_t *shader,
         };
         glUniform3fv(u->iChannelResolution, 4, resolutions);
     }
+
+    /* fragCoord remapping - identity unless this is a reconstructed Image pass */
+    float xform[4] = {1.0f, 1.0f, 0.0f, 0.0f};
+    int checker_phase = -1;
+    if (pass_index == shader->image_pass_index && reconstruct_active(shader)) {
+        const multipass_reconstruct_t *r = &shader->reconstruct;
+        if (r->mode == MULTIPASS_RECONSTRUCT_CHECKERBOARD) {
+            checker_phase = shader->frame_count & 1;
+        } else {
+            xform[0] = (float)pass->width / (float)r->render_width;
+            xform[1] = (float)pass->height / (float)r->render_height;
+            xform[2] = r->jitter_x * xform[0];
+            xform[3] = r->jitter_y * xform[1];
+        }
+    }
+    if (u->fragXform >= 0) glUniform4fv(u->fragXform, 1, xform);
+    if (u->checkerPhase >= 0) glUniform1i(u->checkerPhase, checker_phase);
 }
 
 void multipass_bind_textures(multipass_shader_t *shader, int pass_index) {
@@ -1623,8 +3672,9 @@ void multipass_bind_textures(multipass_shader_t *shader, int pass_index) {
 
     log_debug_frame(shader->frame_count, "Binding textures for pass %d (%s):", pass_index, pass->name);
 
-    /* Use cached uniform locations */
-    const uniform_locations_t *u = &pass->uniforms;
+    /* Cached uniform locations of the program in use (a variant has its own) */
+    const uniform_locations_t *u = pass->active_variant ? &pass->active_variant->uniforms
+                                                        : &pass->uniforms;
 
     for (int c = 0; c < MULTIPASS_MAX_CHANNELS; c++) {
         /* Skip if this channel uniform doesn't exist in the shader */
@@ -1735,16 +3785,23 @@ void multipass_render_pass(multipass_shader_t *shader,
             glClear(GL_COLOR_BUFFER_BIT);
             pass->needs_clear = false;
         }
+    } else if (pass_index == shader->image_pass_index && reconstruct_active(shader)) {
+        /* Reconstruction: Image pass shades into the reduced offscreen target */
+        glBindFramebuffer(GL_FRAMEBUFFER, shader->reconstruct.image_fbo);
+        glViewport(0, 0, shader->reconstruct.render_width, shader->reconstruct.render_height);
     } else {
         /* Image pass renders to screen - use the stored default framebuffer
          * (GTK GL contexts may use non-zero FBO as default) */
         glBindFramebuffer(GL_FRAMEBUFFER, shader->default_framebuffer);
     }
 
-    glViewport(0, 0, pass->width, pass->height);
+    if (pass->fbo || !reconstruct_active(shader)) {
+        glViewport(0, 0, pass->width, pass->height);
+    }
 
-    /* Use program and set uniforms */
-    glUseProgram(pass->program);
+    /* Use program (or its specialized variant) and set uniforms */
+    select_variant(shader, pass_index);
+    glUseProgram(pass_program(pass));
     multipass_set_uniforms(shader, pass_index, time, mouse_x, mouse_y, mouse_click);
     multipass_bind_textures(shader, pass_index);
 
@@ -1780,21 +3837,17 @@ void multipass_render(multipass_shader_t *shader,
                       float mouse_x, float mouse_y,
                       bool mouse_click) {
     if (!shader || !shader->is_initialized) return;
-
-    /* Update adaptive resolution using wall-clock time (not shader time)
-     * This ensures proper FPS measurement even when shader time is paused/scaled */
-    double wall_time;
-#ifdef _WIN32
-    LARGE_INTEGER freq, counter;
-    QueryPerformanceFrequency(&freq);
-    QueryPerformanceCounter(&counter);
-    wall_time = (double)counter.QuadPart / (double)freq.QuadPart;
-#else
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    wall_time = (double)tv.tv_sec + (double)tv.tv_usec / 1000000.0;
-#endif
-    multipass_update_adaptive_resolution(shader, wall_time);
+    uint64_t span = shader_trace_begin();
+
+    /* Fold in GPU times from a few frames ago, then let the controller pick
+     * this frame's scale. Wall-clock time is only used for the FPS display
+     * and as the fallback sample when timer queries are unavailable. */
+    double now = platform_get_time();
+    gpu_timers_collect(shader);
+    multipass_update_adaptive_resolution(shader, now);
+    shader->timer_scale[shader->timer_frame] = effective_scale(shader);
+    shader->timer_frame_number[shader->timer_frame] = shader->frame_count;
+    shader->timer_submit_time[shader->timer_frame] = now;
 
     /* Query the CURRENT framebuffer binding every frame
      * GTK's GtkGLArea can change its FBO on resize, so we must always query */
@@ -1830,18 +3883,64 @@ void multipass_render(multipass_shader_t *shader,
      * 3. Render Image pass last to the screen
      */
 
+    /* Freshly specialized mouse/date keep the value they have this frame */
+    unsigned int capture = shader->specialize_inputs & ~shader->frozen_inputs &
+                           (MULTIPASS_INPUT_MOUSE | MULTIPASS_INPUT_DATE);
+    if (capture & MULTIPASS_INPUT_MOUSE) {
+        mouse_value(mouse_x, mouse_y, mouse_click, shader->frozen_mouse);
+    }
+    if ((capture & MULTIPASS_INPUT_DATE) && !date_value(shader->frozen_date)) {
+        capture &= ~MULTIPASS_INPUT_DATE;
+    }
+    shader->frozen_inputs |= capture;
+
+    /* Inputs that changed since the previous frame - invariant buffers depending on them re-render */
+    unsigned int changed_inputs = 0;
+    bool mouse_moved = mouse_x != shader->last_mouse_x || mouse_y != shader->last_mouse_y ||
+                       mouse_click != shader->last_mouse_click;
+    if (shader->frame_count == 0 || (capture & MULTIPASS_INPUT_MOUSE) ||
+        (mouse_moved && !(shader->frozen_inputs & MULTIPASS_INPUT_MOUSE))) {
+        changed_inputs |= MULTIPASS_INPUT_MOUSE;
+    }
+    shader->last_mouse_x = mouse_x;
+    shader->last_mouse_y = mouse_y;
+    shader->last_mouse_click = mouse_click;
+
     /* Render buffer passes first (in order A, B, C, D) */
     for (int type = PASS_TYPE_BUFFER_A; type <= PASS_TYPE_BUFFER_D; type++) {
         for (int i = 0; i < shader->pass_count; i++) {
-            if ((int)shader->passes[i].type == type) {
-                log_debug_frame(shader->frame_count, "Executing buffer pass: %s", shader->passes[i].name);
-                multipass_render_pass(shader, i, time, mouse_x, mouse_y, mouse_click);
+            multipass_pass_t *pass = &shader->passes[i];
+            if ((int)pass->type != type) continue;
+            
+            /* Reuse the cached result; needs_clear means the texture was (re)allocated */
+            if (pass->invariant && pass->output_valid && !pass->needs_clear &&
+                !(pass->input_mask & changed_inputs)) {
+                log_debug_frame(shader->frame_count, "Skipping invariant buffer pass: %s", pass->name);
+                continue;
             }
+            
+            log_debug_frame(shader->frame_count, "Executing buffer pass: %s", pass->name);
+            gpu_timer_begin(shader, i);
+            multipass_render_pass(shader, i, time, mouse_x, mouse_y, mouse_click);
+            gpu_timer_end(shader, i, true);
+            pass->output_valid = true;
         }
     }
 
-    /* Render Image pass last (directly to screen) */
-    if (shader->image_pass_index >= 0) {
+    /* Render Image pass last: through the reconstruction stage if enabled... */
+    if (shader->image_pass_index >= 0 && reconstruct_prepare(shader)) {
+        log_debug_frame(shader->frame_count, "Executing Image pass (index=%d) with reconstruction",
+                        shader->image_pass_index);
+        gpu_timer_begin(shader, shader->image_pass_index);
+        multipass_render_pass(shader, shader->image_pass_index, time,
+                              mouse_x, mouse_y, mouse_click);
+        gpu_timer_end(shader, shader->image_pass_index,
+                      shader->reconstruct.mode == MULTIPASS_RECONSTRUCT_SPATIAL);
+        gpu_timer_begin(shader, MULTIPASS_MAX_PASSES);
+        reconstruct_resolve(shader);
+        gpu_timer_end(shader, MULTIPASS_MAX_PASSES, false);
+    } else if (shader->image_pass_index >= 0) {
+        /* ...or directly to screen */
         log_debug_frame(shader->frame_count, "Executing Image pass (index=%d)", shader->image_pass_index);
 
         /* Ensure we're rendering to the default framebuffer (screen) */
@@ -1855,8 +3954,12 @@ void multipass_render(multipass_shader_t *shader,
         glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT);
 
+        gpu_timer_begin(shader, shader->image_pass_index);
         multipass_render_pass(shader, shader->image_pass_index, time,
                               mouse_x, mouse_y, mouse_click);
+        /* Spatial mode skips the upscaler at full scale but still follows it */
+        gpu_timer_end(shader, shader->image_pass_index,
+                      shader->reconstruct.mode == MULTIPASS_RECONSTRUCT_SPATIAL);
     } else {
         log_error("No Image pass found! (image_pass_index=%d, pass_count=%d)",
                   shader->image_pass_index, shader->pass_count);
@@ -1866,7 +3969,8 @@ void multipass_render(multipass_shader_t *shader,
     glDisableVertexAttribArray(0);
 
     shader->frame_count++;
-    shader->frames_since_fps_update++;
+    shader->timer_frame = (shader->timer_frame + 1) % MULTIPASS_TIMER_FRAMES;
+    shader_trace_end(span, SHADER_TRACE_RENDER, "frame", NULL);
 }
 
 void multipass_set_resolution_scale(multipass_shader_t *shader, float scale) {
@@ -1881,35 +3985,42 @@ void multipass_set_resolution_scale(multipass_shader_t *shader, float scale) {
         /* Force resize on next frame by invalidating cached size */
         shader->scaled_width = 0;
         shader->scaled_height = 0;
+        shader->vram_planned = false;
         log_info("Resolution scale changed to %.2f", scale);
     }
 }
 
 float multipass_get_resolution_scale(const multipass_shader_t *shader) {
-    return shader ? shader->resolution_scale : 1.0f;
+    return shader ? effective_scale(shader) : 1.0f;
 }
 
 void multipass_set_adaptive_resolution(multipass_shader_t *shader, 
                                         bool enabled,
-                                        float target_fps,
+                                        float budget_ms,
                                         float min_scale,
                                         float max_scale) {
     if (!shader) return;
     
     shader->adaptive_resolution = enabled;
-    shader->target_fps = (target_fps > 0) ? target_fps : 55.0f;
+    shader->frame_budget_ms = (budget_ms > 0.0f) ? budget_ms : MULTIPASS_DEFAULT_FRAME_BUDGET_MS;
     shader->min_resolution_scale = (min_scale > 0.1f) ? min_scale : 0.1f;
-    shader->max_resolution_scale = (max_scale <= 2.0f) ? max_scale : 2.0f;
+    shader->max_resolution_scale = (max_scale > 0.0f && max_scale <= 2.0f) ? max_scale : 2.0f;
     
     if (shader->min_resolution_scale > shader->max_resolution_scale) {
         shader->min_resolution_scale = shader->max_resolution_scale;
     }
+    shader->vram_planned = false;
     
-    log_info("Adaptive resolution: %s, target=%.0f FPS, scale range=[%.2f, %.2f]",
-             enabled ? "ON" : "OFF", shader->target_fps,
+    log_info("Adaptive resolution: %s, budget=%.1f ms, scale range=[%.2f, %.2f]",
+             enabled ? "ON" : "OFF", shader->frame_budget_ms,
              shader->min_resolution_scale, shader->max_resolution_scale);
 }
 
+void multipass_set_frame_interval(multipass_shader_t *shader, float interval_ms) {
+    if (!shader) return;
+    shader->frame_interval_ms = (interval_ms > 0.0f) ? interval_ms : 0.0f;
+}
+
 bool multipass_is_adaptive_resolution(const multipass_shader_t *shader) {
     return shader ? shader->adaptive_resolution : false;
 }
@@ -1918,279 +4029,183 @@ float multipass_get_current_fps(const multipass_shader_t *shader) {
     return shader ? shader->current_fps : 0.0f;
 }
 
+bool multipass_has_gpu_timers(const multipass_shader_t *shader) {
+    return shader ? shader->gpu_timers_supported : false;
+}
+
+float multipass_get_gpu_time_ms(const multipass_shader_t *shader) {
+    return (shader && shader->gpu_timers_supported) ? shader->gpu_frame_ms : 0.0f;
+}
+
+float multipass_get_pass_gpu_time_ms(const multipass_shader_t *shader, int pass_index) {
+    if (!shader || pass_index < 0 || pass_index >= shader->pass_count) return 0.0f;
+    return shader->passes[pass_index].gpu_time_ms;
+}
+
+unsigned int multipass_get_gpu_sample(const multipass_shader_t *shader,
+                                      float *total_ms, float *slot_ms, int *frame) {
+    if (!shader || !shader->gpu_timers_supported) return 0;
+
+    if (total_ms) *total_ms = shader->gpu_sample_total_ms;
+    if (slot_ms) memcpy(slot_ms, shader->gpu_sample_ms, sizeof(shader->gpu_sample_ms));
+    if (frame) *frame = shader->gpu_sample_frame;
+    return shader->gpu_sample_seq;
+}
+
+bool multipass_collect_gpu_sample(multipass_shader_t *shader) {
+    if (!shader || !shader->gpu_timers_supported) return false;
+
+    /* Step through the ring oldest first, as rendering would */
+    for (int i = 0; i < MULTIPASS_TIMER_FRAMES; i++) {
+        bool issued = false;
+        for (int slot = 0; slot < MULTIPASS_TIMER_SLOTS; slot++) {
+            issued |= shader->timer_issued[shader->timer_frame][slot];
+        }
+        if (issued) gpu_timers_collect(shader);
+        shader->timer_frame = (shader->timer_frame + 1) % MULTIPASS_TIMER_FRAMES;
+        if (issued) return true;
+    }
+    return false;
+}
+
+/* Highest scale the controller may pick - its maximum, or less under a VRAM budget */
+static float scale_ceiling(const multipass_shader_t *shader) {
+    return (shader->vram_max_scale < shader->max_resolution_scale) ?
+           shader->vram_max_scale : shader->max_resolution_scale;
+}
+
+/* Lowest scale the controller may pick - the spatial upscaler caps the reconstruction ratio */
+static float adaptive_min_scale(const multipass_shader_t *shader) {
+    float min_scale = shader->min_resolution_scale;
+    if (shader->reconstruct.mode == MULTIPASS_RECONSTRUCT_SPATIAL &&
+        min_scale < MULTIPASS_SPATIAL_MIN_SCALE) {
+        min_scale = MULTIPASS_SPATIAL_MIN_SCALE;
+        if (min_scale > shader->max_resolution_scale) {
+            min_scale = shader->max_resolution_scale;
+        }
+    }
+    return min_scale;
+}
+
+/* Only a fraction of the budget is planned for, leaving room for timing noise */
+#define ADAPTIVE_BUDGET_HEADROOM 0.9f
+/* Predicted scale must differ by this much (relative) before the target moves */
+#define ADAPTIVE_SCALE_DEADBAND 0.03f
+/* Without timer queries, a frame interval this much longer than the
+ * presentation interval means the frame didn't fit (half a vblank late) */
+#define ADAPTIVE_LATE_FRAME_FACTOR 1.5
+
 void multipass_update_adaptive_resolution(multipass_shader_t *shader, double current_time) {
-    if (!shader || !shader->adaptive_resolution) return;
+    if (!shader) return;
     
-    /* Initialize timing on first call */
-    if (shader->last_fps_update_time == 0.0) {
-        shader->last_fps_update_time = current_time;
-        shader->last_scale_adjust_time = current_time;
-        shader->calibration_start_time = current_time;
-        shader->calibration_frames = 0;
-        shader->initial_calibration_done = false;
-        shader->scale_locked = false;
-        shader->stable_frames = 0;
-        shader->oscillation_count = 0;
-        return;
+    /* Presentation rate, for display only */
+    double interval = current_time - shader->last_frame_wall_time;
+    bool have_interval = shader->last_frame_wall_time > 0.0 && interval > 0.0 && interval < 1.0;
+    if (have_interval) {
+        float fps = (float)(1.0 / interval);
+        shader->current_fps = (shader->current_fps > 0.0f) ?
+                              shader->current_fps * 0.9f + fps * 0.1f : fps;
     }
+    shader->last_frame_wall_time = current_time;
     
-    /* Track frame time for this frame */
-    double frame_time = current_time - shader->last_fps_update_time;
-    if (frame_time > 0.001 && frame_time < 1.0) {
-        shader->frame_times[shader->fps_history_index] = (float)frame_time;
-    }
+    if (!shader->adaptive_resolution) return;
     
-    /*
-     * ========================================================================
-     * PHASE 1: FAST INITIAL CALIBRATION (first 0.3 seconds)
-     * Measure actual GPU performance and jump directly to optimal scale
-     * ========================================================================
-     */
-    if (!shader->initial_calibration_done) {
-        shader->calibration_frames++;
-        double calibration_elapsed = current_time - shader->calibration_start_time;
-        
-        if (calibration_elapsed >= 0.3 && shader->calibration_frames >= 8) {
-            float measured_fps = (float)shader->calibration_frames / (float)calibration_elapsed;
-            
-            if (measured_fps < shader->target_fps * 0.95f) {
-                /* 
-                 * Calculate optimal scale using quadratic relationship:
-                 * render_time ∝ pixels = width * height = scale²
-                 * So: optimal_scale = current_scale * sqrt(measured_fps / target_fps)
-                 * Apply 0.9 safety factor to avoid oscillation
-                 */
-                float fps_ratio = measured_fps / shader->target_fps;
-                float optimal_scale = sqrtf(fps_ratio) * shader->resolution_scale * 0.9f;
-                
-                /* Clamp and apply */
-                if (optimal_scale < shader->min_resolution_scale) {
-                    optimal_scale = shader->min_resolution_scale;
-                }
-                if (optimal_scale > shader->max_resolution_scale) {
-                    optimal_scale = shader->max_resolution_scale;
-                }
-                
-                shader->target_resolution_scale = optimal_scale;
-                shader->resolution_scale = optimal_scale;
-                shader->scaled_width = 0;
-                shader->scaled_height = 0;
-                
-                log_info("Calibration: %.1f FPS @ 100%% -> jumping to %.0f%% scale",
-                         measured_fps, optimal_scale * 100.0f);
-            } else {
-                log_info("Calibration: %.1f FPS @ 100%% -> full resolution OK", measured_fps);
-            }
-            
-            /* Initialize history with measured values */
-            for (int i = 0; i < 16; i++) {
-                shader->fps_history[i] = measured_fps;
-                shader->frame_times[i] = 1.0f / measured_fps;
-            }
-            shader->current_fps = measured_fps;
-            shader->initial_calibration_done = true;
-            shader->last_fps_update_time = current_time;
-            shader->last_scale_adjust_time = current_time;
-        }
-        return;
+    /* Without timer queries the frame interval stands in for GPU time. It
+     * includes vsync and frame cap waits, so a frame on schedule says
+     * nothing about its cost: only frames clearly later than the
+     * presentation interval count (as all-scaled cost), and only to lower
+     * the scale. */
+    bool fallback = !shader->gpu_timers_supported;
+    float present_ms = (shader->frame_interval_ms > 0.0f) ? shader->frame_interval_ms
+                                                          : MULTIPASS_DEFAULT_FRAME_INTERVAL_MS;
+    if (fallback && have_interval && interval * 1000.0 > present_ms * ADAPTIVE_LATE_FRAME_FACTOR) {
+        shader->sample_fixed_ms = 0.0f;
+        shader->sample_scaled_ms = (float)(interval * 1000.0);
+        shader->sample_scale = shader->resolution_scale;
+        shader->sample_ready = true;
     }
     
-    /*
-     * ========================================================================
-     * PHASE 2: CONTINUOUS FPS MONITORING
-     * Use frame time analysis for accurate, responsive measurements
-     * ========================================================================
-     */
-    double time_since_fps_update = current_time - shader->last_fps_update_time;
-    if (time_since_fps_update >= 0.1 && shader->frames_since_fps_update > 0) {
-        float instant_fps = (float)shader->frames_since_fps_update / (float)time_since_fps_update;
-        
-        /* Update rolling history (16 samples for stability) */
-        shader->fps_history[shader->fps_history_index] = instant_fps;
-        shader->fps_history_index = (shader->fps_history_index + 1) % 16;
+    if (shader->sample_ready) {
+        shader->sample_ready = false;
         
-        /* Calculate weighted average: recent samples weighted more */
-        float weighted_sum = 0.0f;
-        float weight_sum = 0.0f;
-        for (int i = 0; i < 16; i++) {
-            int age = (shader->fps_history_index - 1 - i + 16) % 16;
-            float weight = 1.0f + (15 - age) * 0.1f;  /* Newer = higher weight */
-            weighted_sum += shader->fps_history[i] * weight;
-            weight_sum += weight;
-        }
-        shader->current_fps = weighted_sum / weight_sum;
-        
-        /* Also compute FPS variance to detect instability */
-        float variance = 0.0f;
-        for (int i = 0; i < 16; i++) {
-            float diff = shader->fps_history[i] - shader->current_fps;
-            variance += diff * diff;
-        }
-        variance /= 16.0f;
-        float fps_stddev = sqrtf(variance);
+        /*
+         * Cost model: frame_ms = fixed + k * scale^2 * output_pixels
+         * "fixed" covers passes rendered at output size (Image without
+         * spatial upscaling, reconstruction), k is the cost per full-res
+         * pixel of the passes that follow the scale.
+         */
+        const multipass_pass_t *image = (shader->image_pass_index >= 0) ?
+                                        &shader->passes[shader->image_pass_index] : NULL;
+        float out_pixels = image ? (float)image->width * (float)image->height : 1.0f;
+        if (out_pixels < 1.0f) out_pixels = 1.0f;
+        float s2 = shader->sample_scale * shader->sample_scale;
+        if (s2 < 0.0001f) s2 = 0.0001f;
+        float k = shader->sample_scaled_ms / (s2 * out_pixels);
         
-        /* Track stability: if FPS is stable near target, lock the scale */
-        float fps_error = fabsf(shader->current_fps - shader->target_fps);
-        if (fps_error < 3.0f && fps_stddev < 5.0f) {
-            shader->stable_frames++;
-            if (shader->stable_frames > 30 && !shader->scale_locked) {
-                shader->scale_locked = true;
-                shader->locked_scale = shader->resolution_scale;
-                log_info("Adaptive: LOCKED at %.0f%% (stable FPS=%.1f±%.1f)",
-                         shader->resolution_scale * 100.0f, shader->current_fps, fps_stddev);
-            }
+        if (!shader->cost_model_valid) {
+            shader->cost_fixed_ms = shader->sample_fixed_ms;
+            shader->cost_per_pixel_ms = k;
+            shader->cost_model_valid = true;
         } else {
-            shader->stable_frames = 0;
-            if (shader->scale_locked && fps_error > 8.0f) {
-                /* Unlock if FPS drifts significantly */
-                shader->scale_locked = false;
-                log_info("Adaptive: UNLOCKED (FPS=%.1f, need adjustment)", shader->current_fps);
-            }
+            shader->cost_fixed_ms = shader->cost_fixed_ms * 0.8f + shader->sample_fixed_ms * 0.2f;
+            shader->cost_per_pixel_ms = shader->cost_per_pixel_ms * 0.8f + k * 0.2f;
         }
         
-        shader->frames_since_fps_update = 0;
-        shader->last_fps_update_time = current_time;
-    }
-    
-    /*
-     * ========================================================================
-     * PHASE 3: SMART SCALE ADJUSTMENT
-     * PID-inspired control with oscillation detection and stability locking
-     * ========================================================================
-     */
-    if (shader->scale_locked) {
-        /* When locked, only adjust if FPS drops significantly below target */
-        if (shader->current_fps < shader->target_fps - 10.0f) {
-            shader->scale_locked = false;
-            log_info("Adaptive: Force unlock due to FPS drop (%.1f)", shader->current_fps);
-        } else {
-            /* Maintain locked scale */
-            shader->target_resolution_scale = shader->locked_scale;
-            goto apply_scale;
-        }
-    }
-    
-    double time_since_adjust = current_time - shader->last_scale_adjust_time;
-    
-    /* Adjust every 0.2 seconds for responsive control */
-    if (time_since_adjust >= 0.2) {
-        float fps_error = shader->current_fps - shader->target_fps;
-        float current_scale = shader->resolution_scale;
-        float new_scale = current_scale;
-        int adjustment_direction = 0;
+        /* Late frames only show what doesn't fit the presentation interval */
+        float budget = fallback ? present_ms : shader->frame_budget_ms * ADAPTIVE_BUDGET_HEADROOM;
+        float predicted_ms = shader->cost_fixed_ms +
+                             shader->cost_per_pixel_ms * s2 * out_pixels;
         
-        /*
-         * DEADBAND: ±2 FPS around target = no adjustment needed
-         * This prevents micro-oscillations when at optimal scale
-         */
-        if (fps_error < -2.0f) {
-            /*
-             * FPS TOO LOW - need to reduce resolution
-             * Use proportional control: bigger error = bigger reduction
-             * Formula: adjustment = k * sqrt(|error| / target)
-             * sqrt() makes it less aggressive for small errors
-             */
-            float error_ratio = -fps_error / shader->target_fps;
-            float adjustment = sqrtf(error_ratio) * 0.12f;
-            
-            /* Clamp: min 2% reduction, max 15% reduction per step */
-            if (adjustment < 0.02f) adjustment = 0.02f;
-            if (adjustment > 0.15f) adjustment = 0.15f;
-            
-            new_scale = current_scale * (1.0f - adjustment);
-            adjustment_direction = -1;
-            
-        } else if (fps_error > 3.0f && current_scale < shader->max_resolution_scale - 0.01f) {
-            /*
-             * FPS HIGH - can try increasing resolution
-             * Be more conservative going up to avoid oscillation
-             * Use theoretical maximum: scale_max = current * sqrt(fps / target)
-             */
-            float fps_ratio = shader->current_fps / shader->target_fps;
-            float theoretical_max = current_scale * sqrtf(fps_ratio);
-            
-            /* Move only 15% towards theoretical max */
-            float target = current_scale + (theoretical_max - current_scale) * 0.15f;
-            float adjustment = (target / current_scale) - 1.0f;
-            
-            /* Clamp: min 1% increase, max 5% increase per step */
-            if (adjustment < 0.01f) adjustment = 0.01f;
-            if (adjustment > 0.05f) adjustment = 0.05f;
-            
-            new_scale = current_scale * (1.0f + adjustment);
-            adjustment_direction = 1;
-        }
+        float min_scale = adaptive_min_scale(shader);
+        float max_scale = scale_ceiling(shader);
+        float available = budget - shader->cost_fixed_ms;
+        float scaled_cost = shader->cost_per_pixel_ms * out_pixels;
+        float predicted;
         
-        /*
-         * OSCILLATION DETECTION
-         * If we keep switching directions, we're at the optimal point - lock it
-         */
-        if (adjustment_direction != 0) {
-            if (shader->last_adjustment_direction != 0 && 
-                shader->last_adjustment_direction != adjustment_direction) {
-                shader->oscillation_count++;
-                if (shader->oscillation_count >= 3) {
-                    /* Oscillating - lock at current scale */
-                    shader->scale_locked = true;
-                    shader->locked_scale = current_scale;
-                    shader->oscillation_count = 0;
-                    log_info("Adaptive: LOCKED at %.0f%% (oscillation detected)", 
-                             current_scale * 100.0f);
-                    goto apply_scale;
-                }
-            } else {
-                shader->oscillation_count = 0;
-            }
-            shader->last_adjustment_direction = adjustment_direction;
+        if (min_scale > max_scale) min_scale = max_scale;
+        if (scaled_cost <= 0.0f) {
+            predicted = max_scale;
+        } else if (available <= 0.0f) {
+            predicted = min_scale;
+        } else {
+            predicted = sqrtf(available / scaled_cost);
         }
         
-        /* Clamp to allowed range */
-        if (new_scale < shader->min_resolution_scale) {
-            new_scale = shader->min_resolution_scale;
-        }
-        if (new_scale > shader->max_resolution_scale) {
-            new_scale = shader->max_resolution_scale;
+        if (predicted < min_scale) predicted = min_scale;
+        if (predicted > max_scale) predicted = max_scale;
+        if (fallback && predicted > shader->target_resolution_scale) {
+            predicted = shader->target_resolution_scale;
         }
         
-        /* Only apply if change is significant (>0.5%) */
-        if (fabsf(new_scale - shader->target_resolution_scale) > 0.005f) {
-            shader->target_resolution_scale = new_scale;
-            log_info("Adaptive: FPS=%.1f -> scale %.0f%% to %.0f%%",
-                     shader->current_fps, current_scale * 100.0f, new_scale * 100.0f);
+        if (fabsf(predicted - shader->target_resolution_scale) >
+            shader->target_resolution_scale * ADAPTIVE_SCALE_DEADBAND) {
+            log_debug("Adaptive: %.2f ms (fixed %.2f) @ %.0f%% -> %.0f%% for %.1f ms budget",
+                      predicted_ms, shader->cost_fixed_ms, shader->sample_scale * 100.0f,
+                      predicted * 100.0f, budget);
+            shader->target_resolution_scale = predicted;
         }
-        
-        shader->last_scale_adjust_time = current_time;
     }
     
-apply_scale:
     /*
-     * ========================================================================
-     * PHASE 4: SMOOTH SCALE INTERPOLATION
+     * Smooth scale interpolation
      * Prevents jarring visual changes by smoothly transitioning
-     * ========================================================================
      */
-    {
-        float scale_diff = shader->target_resolution_scale - shader->resolution_scale;
-        float abs_diff = fabsf(scale_diff);
+    float scale_diff = shader->target_resolution_scale - shader->resolution_scale;
+    float abs_diff = fabsf(scale_diff);
+    
+    if (abs_diff > 0.002f) {
+        /* Fast when far from target, slow on the final approach */
+        float lerp_speed = (abs_diff > 0.1f) ? 0.4f : 0.15f;
+        shader->resolution_scale += scale_diff * lerp_speed;
         
-        if (abs_diff > 0.002f) {
-            /* 
-             * Adaptive interpolation speed:
-             * - Fast (40%) when far from target (getting to usable state quickly)
-             * - Slow (15%) when close (smooth final approach)
-             */
-            float lerp_speed = (abs_diff > 0.1f) ? 0.4f : 0.15f;
-            shader->resolution_scale += scale_diff * lerp_speed;
-            
-            /* Force resize */
-            shader->scaled_width = 0;
-            shader->scaled_height = 0;
-        } else if (abs_diff > 0.0005f) {
-            /* Snap when very close */
-            shader->resolution_scale = shader->target_resolution_scale;
-            shader->scaled_width = 0;
-            shader->scaled_height = 0;
-        }
+        /* Force resize */
+        shader->scaled_width = 0;
+        shader->scaled_height = 0;
+    } else if (abs_diff > 0.0005f) {
+        /* Snap when very close */
+        shader->resolution_scale = shader->target_resolution_scale;
+        shader->scaled_width = 0;
+        shader->scaled_height = 0;
     }
 }
 
@@ -2203,6 +4218,187 @@ void multipass_reset(multipass_shader_t *shader) {
         shader->passes[i].ping_pong_index = 0;
         shader->passes[i].needs_clear = true;
     }
+    shader->reconstruct.history_valid = false;
+}
+
+/* ============================================
+ * Static cost estimate
+ * ============================================ */
+
+/* Milliseconds per cost unit. Starts at a mid-range desktop GPU figure and
+ * follows what timer queries measure; shared by every shader, so later
+ * shaders start from a calibrated estimate. */
+#define COST_DEFAULT_MS_PER_UNIT 1.0e-9
+static double g_cost_ms_per_unit = COST_DEFAULT_MS_PER_UNIT;
+static bool g_cost_calibrated = false;
+
+/* Reference output for the suitability figure */
+#define COST_REFERENCE_PIXELS (1920.0 * 1080.0)
+
+/* Smaller renders don't calibrate: fixed per-pass overhead dominates their
+ * timings (thumbnails, small bench runs) and would inflate the figure */
+#define COST_CALIBRATION_MIN_PIXELS (960.0 * 540.0)
+
+/* Frame times scored 100 and 0: a wallpaper at 1 ms is unnoticeable, one at
+ * 32 ms can't keep up with a 30 Hz display on its own */
+#define COST_SUITABLE_MS 1.0
+#define COST_UNSUITABLE_MS 32.0
+
+/* Passes rendered every frame and whether their size follows resolution_scale */
+static bool pass_is_scaled(const multipass_shader_t *shader, const multipass_pass_t *pass) {
+    if (pass->type != PASS_TYPE_IMAGE) return true;
+    return shader->reconstruct.mode == MULTIPASS_RECONSTRUCT_SPATIAL;
+}
+
+/* Frame time and suitability from the unit counts and the current calibration */
+static void update_cost_figures(multipass_shader_t *shader) {
+    multipass_cost_estimate_t *estimate = &shader->cost_estimate;
+
+    double units = 0.0;
+    for (int i = 0; i < shader->pass_count; i++) {
+        if (shader->passes[i].invariant) continue;
+        units += estimate->pass_units[i];
+    }
+
+    double ms = units * COST_REFERENCE_PIXELS * g_cost_ms_per_unit;
+    estimate->frame_ms_1080p = (float)ms;
+    estimate->calibrated = g_cost_calibrated;
+
+    /* Static shaders only render when an input changes */
+    if ((shader->input_mask & MULTIPASS_INPUT_ANIMATED) == 0 || ms <= COST_SUITABLE_MS) {
+        estimate->suitability = 100;
+    } else {
+        double score = 100.0 * (1.0 - log2(ms / COST_SUITABLE_MS) /
+                                      log2(COST_UNSUITABLE_MS / COST_SUITABLE_MS));
+        estimate->suitability = (score < 0.0) ? 0 : (int)(score + 0.5);
+    }
+}
+
+/*
+ * Scale the adaptive controller starts from, instead of rendering the
+ * first frames at full size and waiting for timer queries: the same
+ * fixed + k * scale^2 model the controller uses, with both terms
+ * predicted from the estimate.
+ */
+static void choose_start_scale(multipass_shader_t *shader) {
+    const multipass_cost_estimate_t *estimate = &shader->cost_estimate;
+    const multipass_pass_t *image = (shader->image_pass_index >= 0) ?
+                                    &shader->passes[shader->image_pass_index] : NULL;
+    double pixels = (image && image->width > 0 && image->height > 0) ?
+                    (double)image->width * image->height : COST_REFERENCE_PIXELS;
+
+    double fixed_ms = 0.0;
+    double scaled_ms = 0.0;
+    for (int i = 0; i < shader->pass_count; i++) {
+        const multipass_pass_t *pass = &shader->passes[i];
+        if (pass->invariant) continue;
+
+        double ms = estimate->pass_units[i] * pixels * g_cost_ms_per_unit;
+        if (pass_is_scaled(shader, pass)) {
+            scaled_ms += ms;
+        } else {
+            fixed_ms += ms;
+        }
+    }
+    if (scaled_ms <= 0.0) return;
+
+    float min_scale = adaptive_min_scale(shader);
+    double available = shader->frame_budget_ms * ADAPTIVE_BUDGET_HEADROOM - fixed_ms;
+    float scale = (available <= 0.0) ? min_scale : (float)sqrt(available / scaled_ms);
+    if (scale < min_scale) scale = min_scale;
+    if (scale > scale_ceiling(shader)) scale = scale_ceiling(shader);
+    if (scale > 1.0f) scale = 1.0f;
+
+    log_info("Cost estimate: %.2f ms fixed + %.2f ms scaled per frame, starting at %.0f%% scale",
+             fixed_ms, scaled_ms, scale * 100.0f);
+
+    shader->resolution_scale = scale;
+    shader->target_resolution_scale = scale;
+    shader->scaled_width = 0;
+    shader->scaled_height = 0;
+}
+
+static void estimate_cost(multipass_shader_t *shader) {
+    multipass_cost_estimate_t *estimate = &shader->cost_estimate;
+    memset(estimate, 0, sizeof(*estimate));
+
+    for (int i = 0; i < shader->pass_count; i++) {
+        multipass_pass_t *pass = &shader->passes[i];
+        if (!pass->is_compiled || !pass->source) continue;
+
+        /* The pass sees Common and every module it was built with */
+        const glsl_token_stream_t *libraries[1 + MULTIPASS_MAX_INCLUDES];
+        int library_count = 0;
+        if (shader->common_tokens) {
+            libraries[library_count++] = shader->common_tokens;
+        }
+        for (int m = 0; m < pass->includes.count; m++) {
+            const shader_include_module_t *module = shader_include_get(pass->includes.ids[m]);
+            if (module && module->tokens) {
+                libraries[library_count++] = module->tokens;
+            }
+        }
+
+        glsl_token_stream_t *tokens = glsl_lex(pass->source);
+        glsl_cost_t cost;
+        if (tokens && glsl_estimate_cost(libraries, library_count, tokens, &cost)) {
+            estimate->pass_units[i] = (float)cost.units;
+            log_debug("  %s: %.0f units/pixel (%.0f arithmetic, %.0f transcendental, "
+                      "%.0f texture, loop depth %d)", pass->name, cost.units, cost.arithmetic,
+                      cost.transcendentals, cost.texture_fetches, cost.loop_depth);
+        }
+        glsl_token_stream_free(tokens);
+    }
+
+    estimate->valid = true;
+    update_cost_figures(shader);
+    log_info("Cost estimate: %.1f ms at 1080p, wallpaper suitability %d (%s)",
+             estimate->frame_ms_1080p, estimate->suitability,
+             multipass_suitability_name(estimate->suitability));
+
+    if (shader->frame_count == 0 && shader->adaptive_resolution) {
+        choose_start_scale(shader);
+    }
+}
+
+/* Convert units to milliseconds with what the GPU measured for this shader */
+static void calibrate_cost(multipass_shader_t *shader, const float *sample_ms) {
+    const multipass_cost_estimate_t *estimate = &shader->cost_estimate;
+    if (!estimate->valid) return;
+
+    double measured_ms = 0.0;
+    double units = 0.0;
+    double largest = 0.0;
+    for (int i = 0; i < shader->pass_count; i++) {
+        const multipass_pass_t *pass = &shader->passes[i];
+        if (sample_ms[i] <= 0.0f || estimate->pass_units[i] <= 0.0f) continue;
+
+        double pixels = (double)pass->width * pass->height;
+        if (pass->type == PASS_TYPE_IMAGE && shader->reconstruct.active) {
+            pixels = (double)shader->reconstruct.render_width * shader->reconstruct.render_height;
+            if (shader->reconstruct.mode == MULTIPASS_RECONSTRUCT_CHECKERBOARD) {
+                pixels *= 0.5;
+            }
+        }
+        measured_ms += sample_ms[i];
+        units += estimate->pass_units[i] * pixels;
+        if (pixels > largest) largest = pixels;
+    }
+    if (units <= 0.0 || measured_ms <= 0.0) return;
+    if (largest < COST_CALIBRATION_MIN_PIXELS) {
+        log_debug("Cost calibration skipped: %.0f pixels rendered", largest);
+        return;
+    }
+
+    /* Shaders differ in how well the units fit, so blend in log space
+     * rather than letting the latest one win */
+    double ms_per_unit = measured_ms / units;
+    g_cost_ms_per_unit = g_cost_calibrated ? sqrt(g_cost_ms_per_unit * ms_per_unit) : ms_per_unit;
+    g_cost_calibrated = true;
+
+    update_cost_figures(shader);
+    log_debug("Cost calibration: %.3g ms per unit (this shader %.3g), %.1f ms at 1080p",
+              g_cost_ms_per_unit, ms_per_unit, shader->cost_estimate.frame_ms_1080p);
 }
 
 /* ============================================
@@ -2269,6 +4465,66 @@ bool multipass_is_ready(const multipass_shader_t *shader) {
     return true;
 }
 
+size_t multipass_estimate_vram(const multipass_shader_t *shader) {
+    if (!shader) return 0;
+
+    size_t bytes = shader->reconstruct_vram_bytes;
+    for (int i = 0; i < shader->pass_count; i++) {
+        bytes += shader->passes[i].vram_bytes;
+    }
+    return bytes;
+}
+
+void multipass_get_vram_usage(const multipass_shader_t *shader, multipass_vram_usage_t *usage) {
+    if (!usage) return;
+    memset(usage, 0, sizeof(*usage));
+    if (!shader) return;
+
+    for (int i = 0; i < shader->pass_count; i++) {
+        usage->pass_bytes[i] = shader->passes[i].vram_bytes;
+    }
+    usage->reconstruct_bytes = shader->reconstruct_vram_bytes;
+    usage->shared_bytes = shader->shared_vram_bytes;
+    usage->total_bytes = multipass_estimate_vram(shader) + shader->shared_vram_bytes;
+    usage->budget_bytes = shader->vram_budget;
+    usage->stage = shader->vram_stage;
+    usage->over_budget = shader->vram_over_budget;
+}
+
+unsigned int multipass_get_input_mask(const multipass_shader_t *shader) {
+    return shader ? shader->input_mask : MULTIPASS_INPUT_ANIMATED;
+}
+
+bool multipass_is_static(const multipass_shader_t *shader) {
+    if (!shader || !shader->is_initialized) return false;
+    return (shader->input_mask & MULTIPASS_INPUT_ANIMATED) == 0;
+}
+
+const multipass_cost_estimate_t *multipass_get_cost_estimate(const multipass_shader_t *shader) {
+    static const multipass_cost_estimate_t none = {0};
+    return shader ? &shader->cost_estimate : &none;
+}
+
+const char *multipass_suitability_name(int suitability) {
+    if (suitability >= 80) return "Excellent";
+    if (suitability >= 60) return "Good";
+    if (suitability >= 35) return "Fair";
+    return "Heavy";
+}
+
+int multipass_get_settle_frames(const multipass_shader_t *shader) {
+    if (!shader) return 1;
+    
+    switch (shader->reconstruct.mode) {
+        case MULTIPASS_RECONSTRUCT_CHECKERBOARD:
+            return 2;   /* One frame per checkerboard phase */
+        case MULTIPASS_RECONSTRUCT_TEMPORAL:
+            return RECONSTRUCT_TEMPORAL_SETTLE_FRAMES;
+        default:
+            return 1;
+    }
+}
+
 multipass_pass_t *multipass_get_pass_by_type(multipass_shader_t *shader,
                                               multipass_type_t type) {
     if (!shader) return NULL;
@@ -2312,6 +4568,7 @@ GLuint multipass_get_buffer_texture(const multipass_shader_t *shader,
  * ============================================ */
 
 void multipass_debug_dump(const multipass_shader_t *shader) {
+    if (!log_debug_enabled()) return;
     if (!shader) {
         log_debug("Multipass shader: NULL");
         return;
@@ -13,13 +13,28 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include "platform_compat.h"
+#include "glsl_lexer.h"
 
 /* Maximum number of passes supported (BufferA-D + Image) */
 #define MULTIPASS_MAX_BUFFERS 4
 #define MULTIPASS_MAX_PASSES  5
 #define MULTIPASS_MAX_CHANNELS 4
 
+/* Distinct #include files one pass can be built from (Common's included) */
+#define MULTIPASS_MAX_INCLUDES 32
+
+/* GPU timer queries: results are read back this many frames later to avoid stalls */
+#define MULTIPASS_TIMER_FRAMES 4
+#define MULTIPASS_TIMER_SLOTS  (MULTIPASS_MAX_PASSES + 1)   /* Every pass + reconstruction */
+
+/* Default adaptive resolution frame budget (GPU milliseconds per frame) */
+#define MULTIPASS_DEFAULT_FRAME_BUDGET_MS 12.0f
+
+/* Presentation interval assumed until the caller sets one (60 Hz) */
+#define MULTIPASS_DEFAULT_FRAME_INTERVAL_MS (1000.0f / 60.0f)
+
 /* Pass types matching Shadertoy */
 typedef enum {
     PASS_TYPE_NONE = 0,
@@ -45,6 +60,30 @@ typedef enum {
     CHANNEL_SOURCE_SELF        /* Self-reference (previous frame) */
 } channel_source_t;
 
+/* Inputs a pass's output can depend on (bit flags, see multipass_get_input_mask) */
+typedef enum {
+    MULTIPASS_INPUT_TIME       = 1 << 0,   /* iTime */
+    MULTIPASS_INPUT_FRAME      = 1 << 1,   /* iFrame */
+    MULTIPASS_INPUT_MOUSE      = 1 << 2,   /* iMouse */
+    MULTIPASS_INPUT_DATE       = 1 << 3,   /* iDate */
+    MULTIPASS_INPUT_RESOLUTION = 1 << 4,   /* iResolution, iChannelResolution */
+    MULTIPASS_INPUT_FEEDBACK   = 1 << 5    /* Reads a buffer's previous frame */
+} multipass_input_t;
+
+/* Inputs that change from one frame to the next without any user action */
+#define MULTIPASS_INPUT_ANIMATED (MULTIPASS_INPUT_TIME | MULTIPASS_INPUT_FRAME | \
+                                  MULTIPASS_INPUT_DATE | MULTIPASS_INPUT_FEEDBACK)
+
+/* Inputs a specialized program variant can take as constants */
+#define MULTIPASS_INPUT_SPECIALIZABLE (MULTIPASS_INPUT_RESOLUTION | MULTIPASS_INPUT_MOUSE | \
+                                       MULTIPASS_INPUT_DATE)
+
+/* Specialized variants kept per pass (least recently used is replaced) */
+#define MULTIPASS_MAX_VARIANTS 4
+
+/* Frames a pass's size must stay the same before iResolution is baked in */
+#define MULTIPASS_SPECIALIZE_SETTLE_FRAMES 8
+
 /* Channel configuration */
 typedef struct {
     channel_source_t source;
@@ -52,6 +91,7 @@ typedef struct {
     bool vflip;                /* Vertical flip */
     int filter;                /* GL_LINEAR or GL_NEAREST */
     int wrap;                  /* GL_REPEAT, GL_CLAMP_TO_EDGE, etc. */
+    int confidence;            /* 0-100: how certain the source analysis is of 'source' */
 } multipass_channel_t;
 
 /* Cached uniform locations for performance (avoid glGetUniformLocation every frame) */
@@ -66,9 +106,108 @@ typedef struct {
     GLint iSampleRate;
     GLint iChannelResolution;
     GLint iChannel[MULTIPASS_MAX_CHANNELS];
+    GLint fragXform;            /* Internal: fragCoord scale/offset for reconstruction */
+    GLint checkerPhase;         /* Internal: checkerboard row phase (-1 = off) */
     bool cached;                /* True if locations have been cached */
 } uniform_locations_t;
 
+/* Final output reconstruction applied after the Image pass */
+typedef enum {
+    MULTIPASS_RECONSTRUCT_NONE = 0,          /* Image pass renders straight to screen */
+    MULTIPASS_RECONSTRUCT_CHECKERBOARD,      /* Half the pixels per frame, alternating checkerboard */
+    MULTIPASS_RECONSTRUCT_TEMPORAL,          /* Reduced resolution + sub-pixel jitter, history accumulation */
+    MULTIPASS_RECONSTRUCT_SPATIAL            /* Image pass at resolution_scale, edge-adaptive upscale + sharpen */
+} multipass_reconstruct_mode_t;
+
+/* Lowest scale the spatial upscaler is allowed to reconstruct from (2x per axis) */
+#define MULTIPASS_SPATIAL_MIN_SCALE 0.5f
+
+/* Offscreen Image target, history buffers and resolve program for reconstruction */
+typedef struct {
+    multipass_reconstruct_mode_t mode;
+    bool active;                             /* Image pass goes through image_fbo this frame */
+    GLuint program;                          /* Temporal/checkerboard resolve shader (lazily compiled) */
+    GLuint spatial_program;                  /* EASU+RCAS upscale shader (lazily compiled) */
+    GLuint image_fbo;                        /* Image pass target at render resolution */
+    GLuint image_texture;
+    GLuint history_fbo;                      /* Resolve target, also used as blit source */
+    GLuint history_textures[2];              /* Ping-pong reconstructed output at full resolution */
+    int history_index;                       /* Texture holding the previous resolved frame */
+    bool history_valid;                      /* False after resize/reset/mode change */
+    int render_width;                        /* Image pass shading resolution */
+    int render_height;
+    int output_width;                        /* Final (screen) resolution */
+    int output_height;
+    float jitter_x;                          /* Current sub-pixel jitter (render pixels) */
+    float jitter_y;
+    GLint u_current;                         /* Cached resolve uniform locations */
+    GLint u_history;
+    GLint u_mode;
+    GLint u_phase;
+    GLint u_history_valid;
+    GLint u_jitter;
+    GLint u_output_size;
+    GLint u_spatial_source;
+    GLint u_spatial_output_size;
+    GLint u_spatial_sharpness;
+} multipass_reconstruct_t;
+
+/* Input values baked into a specialized variant (its cache key) */
+typedef struct {
+    unsigned int inputs;                     /* multipass_input_t bits compiled as constants */
+    float resolution[3];                     /* iResolution, if MULTIPASS_INPUT_RESOLUTION */
+    float mouse[4];                          /* iMouse, if MULTIPASS_INPUT_MOUSE */
+    float date[4];                           /* iDate, if MULTIPASS_INPUT_DATE */
+} multipass_constants_t;
+
+/* A pass program compiled with some inputs as constants */
+typedef struct {
+    multipass_constants_t constants;
+    GLuint program;                          /* Linked variant (0 = not ready) */
+    uniform_locations_t uniforms;            /* Locations in program */
+    GLuint build_fragment;                   /* Compile and link still in flight */
+    GLuint build_program;
+    bool used;                               /* Slot holds a variant */
+    bool queued;                             /* Waiting for multipass_build_variants */
+    bool failed;                             /* Didn't build - the generic program stays */
+    int last_used;                           /* Frame it was last selected, for replacement */
+} multipass_variant_t;
+
+/* How far a shader was degraded to fit its VRAM budget (each stage keeps the previous ones) */
+typedef enum {
+    MULTIPASS_VRAM_FULL = 0,                 /* Everything as the shader asks */
+    MULTIPASS_VRAM_LOWER_SCALE,              /* Buffer resolution scale capped */
+    MULTIPASS_VRAM_NO_MIPMAPS,               /* Buffer mip chains dropped (textureLod reads level 0) */
+    MULTIPASS_VRAM_CHEAP_FORMATS             /* Buffers stored as RGBA8 instead of RGBA16F */
+} multipass_vram_stage_t;
+
+/* GPU memory held by a shader, from the sizes and formats actually allocated */
+typedef struct {
+    size_t pass_bytes[MULTIPASS_MAX_PASSES]; /* Ping-pong textures of each pass, mip chains included */
+    size_t reconstruct_bytes;                /* Reconstruction targets */
+    size_t shared_bytes;                     /* Noise texture and quad vertex buffer */
+    size_t total_bytes;
+    size_t budget_bytes;                     /* 0 = unlimited */
+    multipass_vram_stage_t stage;
+    bool over_budget;                        /* Still over after every stage */
+} multipass_vram_usage_t;
+
+/* Cost predicted from the sources before the first frame (glsl_cost) */
+typedef struct {
+    bool valid;                              /* Estimated since the last compile */
+    bool calibrated;                         /* Units were converted with a measured GPU factor */
+    float pass_units[MULTIPASS_MAX_PASSES];  /* Cost units per pixel of each pass */
+    float frame_ms_1080p;                    /* Predicted GPU time of a 1920x1080 frame at full scale */
+    int suitability;                         /* Wallpaper suitability, 0 (heavy) to 100 (light) */
+} multipass_cost_estimate_t;
+
+/* Include modules a program was built from, with the version of each */
+typedef struct {
+    int ids[MULTIPASS_MAX_INCLUDES];
+    unsigned int generations[MULTIPASS_MAX_INCLUDES];
+    int count;
+} multipass_include_set_t;
+
 /* Single pass configuration */
 typedef struct {
     multipass_type_t type;
@@ -86,12 +225,53 @@ typedef struct {
     char *compile_error;                     /* Compilation error message */
     uniform_locations_t uniforms;            /* Cached uniform locations */
     bool needs_mipmaps;                      /* True if shader uses textureLod */
+    bool mipmaps_dropped;                    /* needs_mipmaps turned off by the VRAM budget */
+    bool mip_chain_allocated;                /* Textures currently hold mip levels */
+    GLenum texture_format;                   /* Internal format of the ping-pong textures */
+    size_t vram_bytes;                       /* Allocated for both textures and their mip chains */
+    bool uses_texture_lod;                   /* Source calls textureLod (from the token stream) */
     int channel_buffer_index[MULTIPASS_MAX_CHANNELS]; /* Cached buffer pass indices for channels (-1 if not a buffer) */
+    float gpu_time_ms;                       /* Smoothed GPU time of this pass (0 if timers unavailable) */
+    unsigned int uniform_inputs;             /* multipass_input_t bits of active uniforms (reflection) */
+    unsigned int active_channels;            /* Bit c set if iChannel<c> is an active uniform */
+    unsigned int input_mask;                 /* uniform_inputs plus everything upstream in the channel graph */
+    bool invariant;                          /* Buffer whose output doesn't animate - rendered once, then reused */
+    bool output_valid;                       /* Invariant buffer holds an up-to-date result */
+    multipass_include_set_t includes;        /* Include modules the program was built from (Common's too) */
+    multipass_variant_t variants[MULTIPASS_MAX_VARIANTS]; /* Specialized programs by constant set */
+    multipass_variant_t *active_variant;     /* Variant rendering this frame (NULL = program) */
+    int settled_width;                       /* Size of the latest frames and how many */
+    int settled_height;                      /* frames in a row it stayed the same */
+    int settled_frames;
+    GLuint build_fragment;                   /* Compile and link in flight (multipass_compile_begin) */
+    GLuint build_program;
+    bool build_shared_common;                /* The build links against common_object */
+    bool build_pending;                      /* build_* hold a build not collected yet */
+    bool build_queued;                       /* Not submitted yet (no background compiles) */
 } multipass_pass_t;
 
+/* Progress of a compile started with multipass_compile_begin */
+typedef enum {
+    MULTIPASS_COMPILE_PENDING = 0,           /* Some passes are still being built */
+    MULTIPASS_COMPILE_SUCCEEDED,             /* Every pass built */
+    MULTIPASS_COMPILE_FAILED                 /* At least one pass failed (see compile_error) */
+} multipass_compile_status_t;
+
 /* Complete multipass shader configuration */
 typedef struct {
     char *common_source;                     /* Common code shared by all passes */
+    glsl_token_stream_t *common_tokens;      /* common_source lexed once, replayed by every pass compile */
+    char *include_dir;                       /* Directory #include is resolved against first (may be NULL) */
+    int include_owner;                       /* Owner registered as dependent of the includes (-1 = none) */
+
+    /* Shader objects shared by every pass program (desktop GL links several per stage) */
+    GLuint vertex_shader;                    /* Fullscreen quad vertex shader, compiled once */
+    GLuint common_object;                    /* Common compiled once as its own fragment shader (0 = none) */
+    char *common_interface;                  /* Common with function bodies reduced to prototypes */
+    multipass_include_set_t common_includes; /* Include modules common_object was built from */
+    bool common_uses_texture_lod;            /* Common's includes call textureLod */
+    bool common_object_failed;               /* Not usable on its own - passes embed Common instead */
+    bool optimize_source;                    /* Run glsl_optimize on every source before compiling */
     multipass_pass_t passes[MULTIPASS_MAX_PASSES];
     int pass_count;                          /* Number of active passes */
     int image_pass_index;                    /* Index of the Image pass (-1 if none) */
@@ -105,6 +285,19 @@ typedef struct {
     GLuint noise_texture;                    /* Default noise texture */
     GLuint keyboard_texture;                 /* Keyboard state texture */
     GLint default_framebuffer;               /* Default framebuffer ID (may not be 0 in GTK) */
+    unsigned int input_mask;                 /* Inputs the final image depends on (Image pass input_mask) */
+    float last_mouse_x;                      /* Mouse of the previous frame, to re-render mouse-driven */
+    float last_mouse_y;                      /* invariant buffers only when it moves */
+    bool last_mouse_click;
+
+    /* Specialization - frozen inputs compiled into program variants */
+    unsigned int specialize_inputs;          /* MULTIPASS_INPUT_SPECIALIZABLE bits to bake in */
+    unsigned int frozen_inputs;              /* Of those, mouse/date whose value was captured */
+    float frozen_mouse[4];                   /* iMouse at the first frame after freezing */
+    float frozen_date[4];                    /* iDate at the first frame after freezing */
+    
+    /* Output reconstruction (checkerboard / temporal) */
+    multipass_reconstruct_t reconstruct;
     
     /* Performance settings */
     float resolution_scale;                  /* Buffer resolution scale (1.0 = full, 0.5 = half) */
@@ -114,28 +307,54 @@ typedef struct {
     int scaled_width;                        /* Cached scaled width */
     int scaled_height;                       /* Cached scaled height */
     
-    /* Adaptive resolution scaling */
-    bool adaptive_resolution;                /* Enable automatic resolution adjustment */
-    float target_fps;                        /* Target FPS (default 60) */
-    float current_fps;                       /* Current measured FPS */
-    float fps_history[16];                   /* Rolling FPS history for smoothing */
-    float frame_times[16];                   /* Frame time history for analysis */
-    int fps_history_index;                   /* Current index in history */
-    double last_fps_update_time;             /* Time of last FPS measurement */
-    int frames_since_fps_update;             /* Frame counter for FPS calculation */
-    double last_scale_adjust_time;           /* Time of last scale adjustment */
-    
-    /* Stability tracking */
-    int stable_frames;                       /* Consecutive frames near target FPS */
-    int last_adjustment_direction;           /* -1 = down, 0 = none, 1 = up */
-    int oscillation_count;                   /* Count of direction changes */
-    float locked_scale;                      /* Scale value when locked */
-    bool scale_locked;                       /* True when scale is locked (stable) */
+    /* GPU timing - per-pass GL_TIME_ELAPSED queries in a small ring */
+    bool gpu_timers_supported;               /* Timer queries usable on this context */
+    GLuint timer_queries[MULTIPASS_TIMER_FRAMES][MULTIPASS_TIMER_SLOTS];
+    bool timer_issued[MULTIPASS_TIMER_FRAMES][MULTIPASS_TIMER_SLOTS];
+    unsigned int timer_scaled_mask[MULTIPASS_TIMER_FRAMES]; /* Slots whose size followed the scale */
+    float timer_scale[MULTIPASS_TIMER_FRAMES];             /* resolution_scale the frame used */
+    int timer_frame_number[MULTIPASS_TIMER_FRAMES];        /* frame_count of the frame recorded */
+    double timer_submit_time[MULTIPASS_TIMER_FRAMES];      /* Wall-clock time the frame was submitted */
+    uint64_t timer_trace_ns[MULTIPASS_TIMER_FRAMES][MULTIPASS_TIMER_SLOTS]; /* Submit time per slot (0 = not tracing) */
+    int timer_frame;                         /* Ring index of the frame being recorded */
+    float gpu_frame_ms;                      /* Smoothed total GPU time per frame */
+    float reconstruct_gpu_ms;                /* Smoothed reconstruction/upscale GPU time */
+    float gpu_sample_ms[MULTIPASS_TIMER_SLOTS]; /* Last collected frame, unsmoothed (0 = slot skipped) */
+    float gpu_sample_total_ms;               /* Last collected frame total, unsmoothed */
+    unsigned int gpu_sample_seq;             /* Collected frames so far */
+    int gpu_sample_frame;                    /* frame_count of the last collected frame */
     
-    /* Initial calibration */
-    bool initial_calibration_done;           /* True after initial FPS measurement */
-    int calibration_frames;                  /* Frames counted during calibration */
-    double calibration_start_time;           /* Start time of calibration period */
+    /* Adaptive resolution scaling - cost model: frame_ms = fixed + k * scale^2 * pixels */
+    bool adaptive_resolution;                /* Enable automatic resolution adjustment */
+    float frame_budget_ms;                   /* GPU time budget per frame */
+    float frame_interval_ms;                 /* Presentation interval (refresh or cap), 0 = unknown */
+    float cost_fixed_ms;                     /* Smoothed cost of passes that don't scale */
+    float cost_per_pixel_ms;                 /* Smoothed cost per full-resolution pixel of scaled passes */
+    bool cost_model_valid;                   /* At least one sample folded in */
+    bool sample_ready;                       /* New timing sample waiting for the controller */
+    float sample_fixed_ms;                   /* Latest sample: non-scaled passes */
+    float sample_scaled_ms;                  /* Latest sample: scaled passes */
+    float sample_scale;                      /* Latest sample: scale it was rendered at */
+    double last_frame_wall_time;             /* Wall-clock time of the previous frame */
+    float current_fps;                       /* Smoothed presentation rate (display only) */
+    multipass_cost_estimate_t cost_estimate; /* Static estimate, seeds the starting scale */
+
+    /* VRAM accounting - updated wherever storage is (re)specified */
+    size_t shared_vram_bytes;                /* Noise texture and quad vertex buffer */
+    size_t reconstruct_vram_bytes;           /* Reconstruction targets */
+    size_t vram_budget;                      /* Bytes the shader may hold (0 = unlimited) */
+    multipass_vram_stage_t vram_stage;       /* Degradation the budget required */
+    float vram_max_scale;                    /* Highest buffer scale that fits (stage >= LOWER_SCALE) */
+    bool vram_over_budget;                   /* Doesn't fit even fully degraded */
+    bool vram_planned;                       /* Stage chosen for the current sizes and settings */
+    int vram_plan_width;                     /* Output size the stage was chosen for */
+    int vram_plan_height;
+
+    /* Compile started with multipass_compile_begin */
+    bool compile_in_flight;                  /* Builds issued, finish not run yet */
+    int builds_pending;                      /* Passes of the batch still queued or to be collected */
+    int builds_failed;                       /* Passes of the batch that failed so far */
+    bool builds_poll;                        /* Completion can be queried without blocking */
     
     bool is_initialized;                     /* OpenGL resources initialized */
 } multipass_shader_t;
@@ -185,9 +404,11 @@ bool multipass_detect(const char *source);
 
 /**
  * Count number of mainImage functions in source
+ * Only file-scope definitions count; prototypes, calls and mentions in
+ * comments or strings are ignored.
  * 
  * @param source Shader source code
- * @return Number of mainImage functions found
+ * @return Number of mainImage definitions found
  */
 int multipass_count_main_functions(const char *source);
 
@@ -244,12 +465,118 @@ bool multipass_compile_pass(multipass_shader_t *shader, int pass_index);
 
 /**
  * Compile all passes
+ * Every pass is compiled and linked before any result is queried, so a
+ * driver with a threaded shader compiler builds the passes in parallel.
  * 
  * @param shader Multipass shader
  * @return true if all passes compiled successfully
  */
 bool multipass_compile_all(multipass_shader_t *shader);
 
+/**
+ * Start compiling all passes without waiting for the driver
+ * The vertex shader and Common are built before this returns; the pass
+ * programs are only submitted. Collect them with multipass_compile_poll,
+ * or drop them by destroying the shader. Don't render the shader until
+ * the compile has finished.
+ *
+ * @param shader Multipass shader (after multipass_init_gl)
+ * @return false if shader is NULL
+ */
+bool multipass_compile_begin(multipass_shader_t *shader);
+
+/**
+ * Collect the passes of a compile started with multipass_compile_begin
+ * With KHR_parallel_shader_compile only finished programs are collected,
+ * so a poll without wait doesn't block. Without it, each poll submits and
+ * waits for one pass. Requires the shader's GL context to be current.
+ *
+ * @param shader Multipass shader
+ * @param wait Collect every pass before returning
+ * @return PENDING until every pass is collected, then the result
+ */
+multipass_compile_status_t multipass_compile_poll(multipass_shader_t *shader, bool wait);
+
+/**
+ * Set where #include directives are resolved and who depends on them
+ * Call before compiling. Includes are looked up in base_dir, then in the
+ * library directory (see shader_include.h); every module a compile used is
+ * registered with owner as a dependent.
+ *
+ * @param shader Multipass shader
+ * @param base_dir Directory of the shader file (NULL for unsaved shaders)
+ * @param owner Dependent id, e.g. an editor tab (-1 = don't register)
+ */
+void multipass_set_include_context(multipass_shader_t *shader, const char *base_dir, int owner);
+
+/**
+ * Optimize sources before they go to the driver
+ * Call before compiling. Unused functions (Common's included) are dropped,
+ * constant arithmetic is folded and comments and whitespace are stripped;
+ * error lines are unaffected.
+ *
+ * @param shader Multipass shader
+ * @param enabled true to optimize
+ */
+void multipass_set_source_optimization(multipass_shader_t *shader, bool enabled);
+
+/**
+ * Bake inputs into specialized program variants
+ * Passes that read a specialized input get a variant with its value as a
+ * compile-time constant, so the driver can fold and unroll what depends on
+ * it. iResolution is baked once a pass's size has been the same for
+ * MULTIPASS_SPECIALIZE_SETTLE_FRAMES frames, and only while the resolution
+ * scale is fixed (adaptive resolution changes it too often); iMouse and
+ * iDate are frozen at their value in the next rendered frame. Variants are
+ * cached by their constants. Rendering only submits their builds where the
+ * driver compiles in the background; otherwise they wait for
+ * multipass_build_variants. The generic program renders until a variant is
+ * ready or if it fails.
+ *
+ * @param shader Multipass shader
+ * @param inputs MULTIPASS_INPUT_SPECIALIZABLE bits (0 = generic programs only)
+ */
+void multipass_set_specialization(multipass_shader_t *shader, unsigned int inputs);
+
+/**
+ * Check whether a pass is still waiting for its specialized variant
+ * Time-invariant buffers and variants that failed to build don't count.
+ *
+ * @param shader Multipass shader
+ * @return true if a variant is settling or building
+ */
+bool multipass_specialization_pending(const multipass_shader_t *shader);
+
+/**
+ * Build one specialized variant that rendering queued
+ * Without KHR_parallel_shader_compile variants aren't built while
+ * rendering; call this between frames, outside the render callback, until
+ * it returns false. Blocks for one compile and link. Requires the shader's
+ * GL context to be current.
+ *
+ * @param shader Multipass shader
+ * @return true if more variants are queued
+ */
+bool multipass_build_variants(multipass_shader_t *shader);
+
+/**
+ * Check whether an included file changed since the passes were compiled
+ *
+ * @param shader Multipass shader
+ * @return true if at least one pass was built from an older module version
+ */
+bool multipass_includes_stale(const multipass_shader_t *shader);
+
+/**
+ * Recompile only the passes built from an included file that changed
+ * Module versions are updated by shader_include_check_changes(); passes
+ * that don't include a changed module keep their programs.
+ *
+ * @param shader Multipass shader
+ * @return Number of passes recompiled (check multipass_has_errors afterwards)
+ */
+int multipass_refresh_includes(multipass_shader_t *shader);
+
 /**
  * Resize render targets
  * Called when window size changes
@@ -260,6 +587,16 @@ bool multipass_compile_all(multipass_shader_t *shader);
  */
 void multipass_resize(multipass_shader_t *shader, int width, int height);
 
+/**
+ * Free render target storage while keeping compiled programs
+ * Buffer contents (including feedback history) are lost; the next
+ * multipass_resize reallocates everything, so the shader can be
+ * rendered again without recompiling.
+ * 
+ * @param shader Multipass shader (GL context must be current)
+ */
+void multipass_release_render_targets(multipass_shader_t *shader);
+
 /**
  * Destroy multipass shader and free all resources
  * 
@@ -361,20 +698,65 @@ float multipass_get_resolution_scale(const multipass_shader_t *shader);
 
 /**
  * Enable/disable adaptive resolution scaling
- * When enabled, resolution automatically adjusts to maintain target FPS
+ * When enabled, resolution is chosen so the measured GPU time per frame
+ * stays within the budget. Per-pass GPU timer queries feed a cost model
+ * (time = fixed + k * pixels) that predicts the scale directly, so it can
+ * scale up as well as down regardless of vsync. Without timer queries the
+ * wall-clock frame interval is used instead, which cannot see below vsync:
+ * resolution is then only lowered when frames arrive clearly later than
+ * the presentation interval (see multipass_set_frame_interval).
  * 
  * @param shader Multipass shader
  * @param enabled Enable adaptive scaling
- * @param target_fps Target FPS to maintain (default 60)
+ * @param budget_ms GPU frame-time budget in milliseconds (e.g. 8 for a wallpaper)
  * @param min_scale Minimum resolution scale (default 0.25)
  * @param max_scale Maximum resolution scale (default 1.0)
  */
 void multipass_set_adaptive_resolution(multipass_shader_t *shader, 
                                         bool enabled,
-                                        float target_fps,
+                                        float budget_ms,
                                         float min_scale,
                                         float max_scale);
 
+/**
+ * Set the interval frames are presented at (refresh period, or the frame
+ * cap if that is longer). Without timer queries, frame intervals up to
+ * this long are vsync or cap waits rather than rendering cost.
+ * 
+ * @param shader Multipass shader
+ * @param interval_ms Presentation interval in milliseconds (0 = assume 60 Hz)
+ */
+void multipass_set_frame_interval(multipass_shader_t *shader, float interval_ms);
+
+/**
+ * Select the output reconstruction mode
+ * 
+ * CHECKERBOARD shades half the Image pass pixels each frame and fills the
+ * other half from the previous frame, clamped to the freshly shaded
+ * neighbours. TEMPORAL shades the Image pass at half the pixel count with
+ * a sub-pixel jitter sequence and accumulates into a history buffer with
+ * neighbourhood clamping. SPATIAL shades the Image pass at the current
+ * resolution_scale (clamped to MULTIPASS_SPATIAL_MIN_SCALE by the adaptive
+ * controller) and upscales it in a single edge-adaptive upscale + sharpen
+ * pass; at full scale it renders natively. Buffer passes are unaffected.
+ * GL resources are allocated lazily on the next multipass_render(); a mode
+ * change frees the previous mode's targets, so the shader's GL context must
+ * be current.
+ * 
+ * @param shader Multipass shader
+ * @param mode Reconstruction mode (MULTIPASS_RECONSTRUCT_NONE to disable)
+ */
+void multipass_set_reconstruction(multipass_shader_t *shader,
+                                  multipass_reconstruct_mode_t mode);
+
+/**
+ * Get the output reconstruction mode
+ * 
+ * @param shader Multipass shader
+ * @return Current reconstruction mode
+ */
+multipass_reconstruct_mode_t multipass_get_reconstruction(const multipass_shader_t *shader);
+
 /**
  * Check if adaptive resolution is enabled
  * 
@@ -391,12 +773,65 @@ bool multipass_is_adaptive_resolution(const multipass_shader_t *shader);
  */
 float multipass_get_current_fps(const multipass_shader_t *shader);
 
+/**
+ * Check if GPU timer queries are available on the current context
+ * 
+ * @param shader Multipass shader
+ * @return true if per-pass GPU times are being measured
+ */
+bool multipass_has_gpu_timers(const multipass_shader_t *shader);
+
+/**
+ * Get smoothed GPU time of a whole frame (all passes + reconstruction)
+ * 
+ * @param shader Multipass shader
+ * @return GPU milliseconds per frame, or 0 if timers are unavailable
+ */
+float multipass_get_gpu_time_ms(const multipass_shader_t *shader);
+
+/**
+ * Get smoothed GPU time of a single pass
+ * 
+ * @param shader Multipass shader
+ * @param pass_index Index of pass
+ * @return GPU milliseconds, or 0 if timers are unavailable
+ */
+float multipass_get_pass_gpu_time_ms(const multipass_shader_t *shader, int pass_index);
+
+/**
+ * Get the unsmoothed GPU times of the most recently collected frame
+ * Samples trail rendering by a few frames; compare the returned
+ * sequence number to tell new samples from ones already seen, and
+ * the frame number to tell which render produced them.
+ * 
+ * @param shader Multipass shader
+ * @param total_ms Receives the frame total (may be NULL)
+ * @param slot_ms Receives MULTIPASS_TIMER_SLOTS per-pass times, the last
+ *                slot being reconstruction; 0 for skipped passes (may be NULL)
+ * @param frame Receives the iFrame value of the frame measured (may be NULL)
+ * @return Sample sequence number (0 = no sample yet or timers unavailable)
+ */
+unsigned int multipass_get_gpu_sample(const multipass_shader_t *shader,
+                                      float *total_ms, float *slot_ms, int *frame);
+
+/**
+ * Collect the oldest frame whose timer queries are still outstanding,
+ * without rendering. After glFinish, call until it returns false to
+ * read the samples of the last frames rendered.
+ * 
+ * @param shader Multipass shader
+ * @return true if a frame was collected (its sample may have been dropped
+ *         if the GPU had not finished it)
+ */
+bool multipass_collect_gpu_sample(multipass_shader_t *shader);
+
 /**
  * Update adaptive resolution (called internally each frame)
- * Adjusts resolution scale based on current FPS
+ * Folds the latest timing sample into the cost model and moves the
+ * resolution scale towards the one predicted to fit the frame budget
  * 
  * @param shader Multipass shader
- * @param current_time Current time in seconds
+ * @param current_time Current wall-clock time in seconds
  */
 void multipass_update_adaptive_resolution(multipass_shader_t *shader, double current_time);
 
@@ -467,6 +902,98 @@ int multipass_get_pass_index(const multipass_shader_t *shader, multipass_type_t
 GLuint multipass_get_buffer_texture(const multipass_shader_t *shader, 
                                      multipass_type_t type);
 
+/**
+ * Get GPU memory held by render targets
+ * Counts buffer ping-pong textures (and mip chains) plus reconstruction
+ * targets, as allocated; compiled programs and the screen framebuffer are
+ * not included. This is what multipass_release_render_targets() frees.
+ * 
+ * @param shader Multipass shader
+ * @return Bytes of VRAM
+ */
+size_t multipass_estimate_vram(const multipass_shader_t *shader);
+
+/**
+ * Get GPU memory held by a shader, per pass and in total
+ * 
+ * @param shader Multipass shader
+ * @param usage Receives the breakdown, budget and degradation stage
+ */
+void multipass_get_vram_usage(const multipass_shader_t *shader, multipass_vram_usage_t *usage);
+
+/**
+ * Limit the GPU memory a shader may hold
+ * When the render targets wouldn't fit, the shader degrades in stages
+ * until they do: the buffer resolution scale is capped (down to half),
+ * then buffer mip chains are dropped, then buffers switch to RGBA8 and
+ * the scale may fall to the adaptive minimum. Applied at the next
+ * multipass_resize(); setting 0 restores everything.
+ * 
+ * @param shader Multipass shader
+ * @param bytes Budget in bytes (0 = unlimited)
+ */
+void multipass_set_vram_budget(multipass_shader_t *shader, size_t bytes);
+
+/**
+ * Get a short description of a VRAM degradation stage
+ * 
+ * @param stage Stage
+ * @return Static string (e.g. "no mipmaps")
+ */
+const char *multipass_vram_stage_name(multipass_vram_stage_t stage);
+
+/**
+ * Get the inputs the final image depends on
+ * Built after compilation from active uniforms (glGetActiveUniform) of every
+ * pass, propagated along the channels that are actually sampled.
+ * 
+ * @param shader Multipass shader
+ * @return Bitwise OR of multipass_input_t values (0 = fully static)
+ */
+unsigned int multipass_get_input_mask(const multipass_shader_t *shader);
+
+/**
+ * Get the cost predicted from the sources
+ * Made when the passes compile, before the first frame; the adaptive
+ * controller starts from the scale it predicts. Once GPU timers have
+ * measured a few frames of a large enough output (thumbnail-sized renders
+ * don't count) the units are re-calibrated for this GPU and the figures
+ * updated.
+ * 
+ * @param shader Multipass shader
+ * @return Estimate (valid is false before compilation)
+ */
+const multipass_cost_estimate_t *multipass_get_cost_estimate(const multipass_shader_t *shader);
+
+/**
+ * Get a display name for a wallpaper suitability score
+ * 
+ * @param suitability Score from multipass_cost_estimate_t
+ * @return "Excellent", "Good", "Fair" or "Heavy"
+ */
+const char *multipass_suitability_name(int suitability);
+
+/**
+ * Check whether the output only changes when an input changes
+ * True when nothing in MULTIPASS_INPUT_ANIMATED is referenced, so the
+ * caller only needs to re-render after a resize or a change to an input
+ * in the mask (e.g. the mouse).
+ * 
+ * @param shader Multipass shader
+ * @return true if re-rendering with unchanged inputs yields the same image
+ */
+bool multipass_is_static(const multipass_shader_t *shader);
+
+/**
+ * Get number of consecutive frames needed for a stable image after an input change
+ * 1 normally; checkerboard and temporal reconstruction need extra frames
+ * to fill in and converge their history.
+ * 
+ * @param shader Multipass shader
+ * @return Frame count (>= 1)
+ */
+int multipass_get_settle_frames(const multipass_shader_t *shader);
+
 /* ============================================
  * Utility Functions
  * ============================================ */
@@ -505,6 +1032,7 @@ multipass_channel_t multipass_default_channel(channel_source_t source);
 
 /**
  * Dump shader structure to log for debugging
+ * Returns immediately unless multipass debug logging is enabled.
  * 
  * @param shader Multipass shader
  */
@@ -0,0 +1,223 @@
+/* Shader Library Tracing
+ * Spans in a ring of fixed-size records, written out as Chrome trace JSON
+ *
+ * A span is recorded once, at its end, as a complete ("X") event, so a
+ * ring that wrapped never leaves a begin without its end. Writers claim a
+ * record with one atomic increment; the file is written after recording
+ * has stopped.
+ */
+
+#include "shader_trace.h"
+#include "shader_log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Name and detail text kept per span */
+#define TRACE_NAME_LENGTH   40
+#define TRACE_DETAIL_LENGTH 64
+
+/* Track of the GPU spans; CPU threads are numbered from 1 */
+#define TRACE_GPU_TID 0
+
+typedef struct {
+    uint64_t start_ns;
+    uint64_t duration_ns;
+    const char *category;
+    int tid;
+    char name[TRACE_NAME_LENGTH];
+    char detail[TRACE_DETAIL_LENGTH];
+} trace_event_t;
+
+static struct {
+    trace_event_t *events;          /* SHADER_TRACE_CAPACITY records */
+    atomic_size_t count;            /* Records claimed so far (wraps the ring) */
+    atomic_int next_tid;
+    uint64_t origin_ns;             /* Clock at start; timestamps are relative to it */
+    char *path;
+    bool exit_handler;
+} g_trace;
+
+atomic_bool shader_trace_enabled = false;
+
+static _Thread_local int t_tid;
+
+uint64_t shader_trace_clock(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+}
+
+static void copy_text(char *dst, size_t size, const char *src) {
+    if (!src) {
+        dst[0] = '\0';
+        return;
+    }
+    size_t len = strlen(src);
+    if (len >= size) len = size - 1;
+    memcpy(dst, src, len);
+    dst[len] = '\0';
+}
+
+static void record(uint64_t start_ns, uint64_t duration_ns, const char *category, int tid,
+                   const char *name, const char *detail) {
+    size_t index = atomic_fetch_add_explicit(&g_trace.count, 1, memory_order_relaxed);
+    trace_event_t *event = &g_trace.events[index & (SHADER_TRACE_CAPACITY - 1)];
+
+    event->start_ns = start_ns;
+    event->duration_ns = duration_ns;
+    event->category = category;
+    event->tid = tid;
+    copy_text(event->name, sizeof(event->name), name);
+    copy_text(event->detail, sizeof(event->detail), detail);
+}
+
+void shader_trace_record(uint64_t start_ns, const char *category, const char *name,
+                         const char *detail) {
+    if (!atomic_load_explicit(&shader_trace_enabled, memory_order_acquire)) return;
+
+    uint64_t end_ns = shader_trace_clock();
+    if (t_tid == 0) {
+        t_tid = atomic_fetch_add(&g_trace.next_tid, 1) + 1;
+    }
+    record(start_ns, end_ns > start_ns ? end_ns - start_ns : 0, category, t_tid, name, detail);
+}
+
+void shader_trace_gpu(uint64_t submit_ns, double duration_ms, const char *name) {
+    if (!submit_ns || !atomic_load_explicit(&shader_trace_enabled, memory_order_acquire)) return;
+    record(submit_ns, (uint64_t)(duration_ms * 1000000.0), SHADER_TRACE_GPU, TRACE_GPU_TID,
+           name, NULL);
+}
+
+/* ============================================
+ * Output
+ * ============================================ */
+
+static void write_json_string(FILE *f, const char *s) {
+    fputc('"', f);
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') {
+            fputc('\\', f);
+            fputc(c, f);
+        } else if (c < 0x20) {
+            fprintf(f, "\\u%04x", c);
+        } else {
+            fputc(c, f);
+        }
+    }
+    fputc('"', f);
+}
+
+static void write_thread_name(FILE *f, int tid, const char *name) {
+    fprintf(f, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":", tid);
+    write_json_string(f, name);
+    fprintf(f, "}}");
+}
+
+static bool write_trace(const char *path) {
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        log_error("Could not write trace to %s", path);
+        return false;
+    }
+
+    size_t count = atomic_load(&g_trace.count);
+    size_t first = (count > SHADER_TRACE_CAPACITY) ? count - SHADER_TRACE_CAPACITY : 0;
+
+    fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(f, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"gleditor\"}}");
+    write_thread_name(f, TRACE_GPU_TID, "GPU (timer queries, at submit time)");
+    int threads = atomic_load(&g_trace.next_tid);
+    for (int tid = 1; tid <= threads; tid++) {
+        char name[32];
+        snprintf(name, sizeof(name), tid == 1 ? "Main" : "Thread %d", tid);
+        write_thread_name(f, tid, name);
+    }
+
+    for (size_t i = first; i < count; i++) {
+        const trace_event_t *event = &g_trace.events[i & (SHADER_TRACE_CAPACITY - 1)];
+        if (event->start_ns < g_trace.origin_ns) continue;
+
+        fprintf(f, ",\n{\"name\":");
+        if (event->detail[0]) {
+            char name[TRACE_NAME_LENGTH + TRACE_DETAIL_LENGTH + 4];
+            snprintf(name, sizeof(name), "%s (%s)", event->name, event->detail);
+            write_json_string(f, name);
+        } else {
+            write_json_string(f, event->name);
+        }
+        fprintf(f, ",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+                event->category, event->tid,
+                (double)(event->start_ns - g_trace.origin_ns) / 1000.0,
+                (double)event->duration_ns / 1000.0);
+        if (event->detail[0]) {
+            fprintf(f, ",\"args\":{\"detail\":");
+            write_json_string(f, event->detail);
+            fputc('}', f);
+        }
+        fputc('}', f);
+    }
+    fprintf(f, "\n]}\n");
+
+    bool ok = !ferror(f);
+    if (fclose(f) != 0) ok = false;
+    if (ok) {
+        log_info("Wrote %zu trace events to %s%s", count - first, path,
+                 first > 0 ? " (oldest dropped)" : "");
+    }
+    return ok;
+}
+
+/* ============================================
+ * Control
+ * ============================================ */
+
+static void stop_at_exit(void) {
+    shader_trace_stop();
+}
+
+bool shader_trace_start(const char *path) {
+    if (!path || !path[0]) {
+        path = getenv("GLEDITOR_TRACE");
+        if (!path || !path[0]) return atomic_load(&shader_trace_enabled);
+    }
+
+    /* Already recording: keep the spans, write them to the new path */
+    char *copy = strdup(path);
+    if (!copy) return false;
+    free(g_trace.path);
+    g_trace.path = copy;
+    if (atomic_load(&shader_trace_enabled)) return true;
+
+    if (!g_trace.events) {
+        g_trace.events = calloc(SHADER_TRACE_CAPACITY, sizeof(trace_event_t));
+        if (!g_trace.events) {
+            log_error("Not enough memory to record a trace");
+            return false;
+        }
+    }
+    atomic_store(&g_trace.count, 0);
+    g_trace.origin_ns = shader_trace_clock();
+
+    if (!g_trace.exit_handler) {
+        atexit(stop_at_exit);
+        g_trace.exit_handler = true;
+    }
+
+    atomic_store_explicit(&shader_trace_enabled, true, memory_order_release);
+    log_info("Tracing to %s", g_trace.path);
+    return true;
+}
+
+bool shader_trace_stop(void) {
+    if (!atomic_exchange(&shader_trace_enabled, false)) return false;
+
+    /* The records stay allocated: a span that was ending on another
+     * thread may still be writing one */
+    bool ok = write_trace(g_trace.path);
+    free(g_trace.path);
+    g_trace.path = NULL;
+    return ok;
+}
@@ -0,0 +1,90 @@
+/* Shader Library Tracing
+ * Timestamped spans written as Chrome trace JSON (open in Perfetto or
+ * chrome://tracing) to see where a stall came from
+ *
+ * Compiled in always; off unless GLEDITOR_TRACE=FILE is set or --trace FILE
+ * is given. While off, a span costs one relaxed load at its start and a
+ * branch at its end. Spans are kept in memory (the most recent
+ * SHADER_TRACE_CAPACITY) and written when tracing stops or at exit.
+ *
+ * Usage:
+ *   uint64_t span = shader_trace_begin();
+ *   ... work ...
+ *   shader_trace_end(span, SHADER_TRACE_COMPILE, "compile", pass->name);
+ */
+
+#ifndef SHADER_TRACE_H
+#define SHADER_TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+/* Spans kept before the oldest are overwritten */
+#define SHADER_TRACE_CAPACITY (1 << 18)
+
+/* Categories (shown as "cat" and filterable in the viewer) */
+#define SHADER_TRACE_UI      "ui"          /* Editor callbacks */
+#define SHADER_TRACE_COMPILE "compile"     /* Parse, wrap, compile and link */
+#define SHADER_TRACE_RENDER  "render"      /* Frames and per-pass GL submission */
+#define SHADER_TRACE_GPU     "gpu"         /* Per-pass GPU time from timer queries */
+#define SHADER_TRACE_IO      "io"          /* File reads and writes */
+
+/* True while spans are being recorded */
+extern atomic_bool shader_trace_enabled;
+
+/* Monotonic clock in nanoseconds */
+uint64_t shader_trace_clock(void);
+
+/* Start a span: its start time, or 0 when tracing is off */
+static inline uint64_t shader_trace_begin(void) {
+    if (!atomic_load_explicit(&shader_trace_enabled, memory_order_relaxed)) return 0;
+    return shader_trace_clock();
+}
+
+/* Record a span started with shader_trace_begin() (spans started while off are ignored) */
+void shader_trace_record(uint64_t start_ns, const char *category, const char *name,
+                         const char *detail);
+
+/**
+ * End a span
+ *
+ * @param start Value shader_trace_begin() returned
+ * @param category One of the SHADER_TRACE_* categories (not copied)
+ * @param name What was done (copied)
+ * @param detail Pass, file, ... it was done to (copied, may be NULL)
+ */
+static inline void shader_trace_end(uint64_t start, const char *category, const char *name,
+                                    const char *detail) {
+    if (start) shader_trace_record(start, category, name, detail);
+}
+
+/**
+ * Record GPU work measured by a timer query
+ * Timer queries give durations only, so the span is placed on the GPU
+ * track at the time the work was submitted.
+ *
+ * @param submit_ns shader_trace_begin() taken when the query began (0 = skip)
+ * @param duration_ms Measured GPU time
+ * @param name Pass name (copied)
+ */
+void shader_trace_gpu(uint64_t submit_ns, double duration_ms, const char *name);
+
+/**
+ * Start recording
+ *
+ * @param path File the trace is written to, or NULL to use GLEDITOR_TRACE
+ *             (nothing happens if that isn't set either)
+ * @return true if tracing is on
+ */
+bool shader_trace_start(const char *path);
+
+/**
+ * Stop recording and write the trace file
+ * Runs automatically at exit while tracing.
+ *
+ * @return true if the file was written
+ */
+bool shader_trace_stop(void);
+
+#endif /* SHADER_TRACE_H */
@@ -0,0 +1,27 @@
+// Feedback
+// Buffer A accumulates a decaying trail of a moving dot from its previous
+// frame; the Image pass samples it. Exercises channel bindings, including
+// under --specialize.
+
+// Buffer A
+void mainImage(out vec4 fragColor, in vec2 fragCoord)
+{
+    vec2 uv = fragCoord / iResolution.xy;
+    vec2 px = 1.0 / iResolution.xy;
+
+    vec4 prev = texture(iChannel0, uv) * 0.4
+              + (texture(iChannel0, uv + vec2(px.x, 0.0)) + texture(iChannel0, uv - vec2(px.x, 0.0))
+               + texture(iChannel0, uv + vec2(0.0, px.y)) + texture(iChannel0, uv - vec2(0.0, px.y))) * 0.15;
+
+    vec2 pos = iMouse.z > 0.0 ? iMouse.xy : iResolution.xy * (0.5 + 0.35 * vec2(cos(iTime), sin(iTime * 1.3)));
+    float spot = smoothstep(12.0, 8.0, length(fragCoord - pos));
+
+    fragColor = vec4(max(prev.rgb * 0.97, vec3(spot) * vec3(1.0, 0.6, 0.2)), 1.0);
+}
+
+// Image
+void mainImage(out vec4 fragColor, in vec2 fragCoord)
+{
+    vec3 col = texture(iChannel0, fragCoord / iResolution.xy).rgb;
+    fragColor = vec4(pow(col, vec3(0.4545)), 1.0);
+}